@@ -0,0 +1,1644 @@
+#ifndef BENCH_APP_H
+#define BENCH_APP_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <random>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <whereami/whereami++.h>
+
+#include "app.h"
+#include "engine/core/window.h"
+#include "engine/render/shader.h"
+#include "engine/render/renderer.h"
+#include "engine/render/gpu_culling.h"
+#include "engine/render/light_clusters.h"
+#include "engine/render/deferred_shading.h"
+#include "engine/render/visibility_buffer.h"
+#include "engine/render/meshlet_culling.h"
+#include "engine/render/gpu_resources.h"
+#include "engine/render/asset_loader.h"
+#include "engine/render/frustum_culler.h"
+#include "engine/render/gl_state.h"
+#include "engine/render/bindless_textures.h"
+#include "engine/render/texture_arrays.h"
+#include "engine/render/texture_slot_manager.h"
+#include "engine/render/vertex_layout.h"
+#include "engine/scene/camera.h"
+#include "engine/scene/mesh_optimizer.h"
+#include "engine/scene/mesh_simplifier.h"
+#include "engine/scene/object.h"
+#include "engine/scene/scene.h"
+#include "engine/scene/texture.h"
+#include "engine/scene/transform_system.h"
+#include "engine/scene/models/cube.h"
+#include "engine/scene/models/icosahedron.h"
+#include "engine/scene/models/icosphere.hpp"
+#include "utils/timer.h"
+
+namespace fs = std::filesystem;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Runs the micro benchmarks of the engine and prints the results. Start it with
+	* `./main --bench`. The scenes are the same as the ones in TestApp::run() so that the
+	* numbers are representative for what the test app does each frame.
+	*/
+	class BenchApp : public App
+	{
+	private: // VARIABLES
+		Window& mWindow;
+		fs::path mShaderDir;
+
+	public: // FUNCTIONS
+		BenchApp(Window& window) : mWindow(window)
+		{
+			mShaderDir = fs::path(whereami::getExecutablePath().dirname()) / "shaders";
+		}
+
+		void run()
+		{
+			bench_uniforms();
+			bench_render_queue();
+			bench_texture_binding();
+			bench_frustum_culling();
+			bench_bvh();
+			bench_gpu_culling();
+			bench_resource_streaming();
+			bench_asset_streaming();
+			bench_vertex_formats();
+			bench_mesh_optimization();
+			bench_meshlet_culling();
+			bench_lod_selection();
+			bench_mesh_simplification();
+			bench_depth_prepass();
+			bench_clustered_lighting();
+			bench_deferred_shading();
+			bench_visibility_buffer();
+			bench_flat_shading();
+			bench_transforms();
+		}
+
+	private:
+		/*
+		* The 5x5 icosphere grid, the line of spheres, the cube and the icosahedron of TestApp::run().
+		* The grid radius can be increased to get denser scenes, TestApp uses radius = 2.
+		*/
+		static void build_grid_scene(Scene& scene, int radius = 2)
+		{
+			float d = 7.5f;
+			for (float i = -radius; i <= radius; i++)
+			{
+				for (float j = -radius; j <= radius; j++)
+				{
+					Object* newObjptr = new models::Icosphere((int)(i + radius) % 5);
+					float g = (i + radius) / (2 * radius) * 0.8 + 0.1;
+					float b = (j + radius) / (2 * radius) * 0.8 + 0.1;
+					newObjptr->set_color(vec3((b + g) / 2.0f, g, b));
+					newObjptr->set_position(vec3(d * i, d * j, -5.0f));
+					newObjptr->set_scale(3.0f);
+					scene.add_object(newObjptr);
+				}
+			}
+
+			for (int i = 0; i <= 5; i++)
+			{
+				models::Icosphere* sphere = new models::Icosphere(i);
+				sphere->set_position((i - 3.0f) * 2.5f, 2.5f, -1.0f);
+				scene.add_object(sphere);
+			}
+
+			Object* cube = new models::Cube();
+			Object* ico = new models::Icosahedron();
+			cube->set_position(3.0f, -1.0f, -2.0f);
+			ico->set_position(-3.0f, -1.0f, -2.0f);
+			scene.add_object(cube);
+			scene.add_object(ico);
+		}
+
+		/*
+		* The 3D grid of TestApp::run() (grid3D = true): (2r+1)^3 static spheres with the icosphere
+		* LOD chain.
+		*/
+		static void build_grid3D_scene(Scene& scene, int radius)
+		{
+			float d = 7.5f;
+			for (float i = -radius; i <= radius; i++)
+			{
+				for (float j = -radius; j <= radius; j++)
+				{
+					for (float k = -radius; k <= radius; k++)
+					{
+						Object* newObjptr = new models::Icosphere(5);
+						newObjptr->set_lod_chain(models::Icosphere::lod_chain());
+						newObjptr->set_color(vec3(k + radius, i + radius, j + radius) / (2.0f * radius) * 0.8f + 0.1f);
+						newObjptr->set_position(vec3(d * i, d * j, d * k));
+						newObjptr->set_scale(3.0f);
+						scene.add_object(newObjptr);
+					}
+				}
+			}
+		}
+
+		/*
+		* Layers of 16 overlapping spheres that cover the view of a camera at z = 12 several
+		* times, added far to near: the worst case for overdraw in submission order.
+		*/
+		static void build_layered_scene(Scene& scene, int layers)
+		{
+			for (int layer = 0; layer < layers; layer++)
+				for (int i = 0; i < 16; i++)
+				{
+					Object* sphere = new models::Icosphere(3);
+					sphere->set_position(vec3((i % 4 - 1.5f) * 3.0f + layer * 0.3f, (i / 4 - 1.5f) * 2.5f, -4.0f * (layers - 1 - layer)));
+					sphere->set_scale(2.5f);
+					sphere->set_color(vec3(0.2f + 0.1f * layer, 0.5f, 0.8f - 0.1f * layer));
+					scene.add_object(sphere);
+				}
+		}
+
+		/*
+		* Dense geometry: 48 objects with the mesh in a 8x6 grid that fills the view of a camera
+		* at z = 16.
+		*/
+		static void build_dense_scene(Scene& scene, const shared_ptr<Mesh>& mesh)
+		{
+			for (int i = 0; i < 48; i++)
+			{
+				Object* obj = new Object();
+				obj->set_mesh(mesh);
+				obj->set_position(vec3((i % 8 - 3.5f) * 2.5f, (i / 8 - 2.5f) * 2.5f, 0.0f));
+				obj->set_color(vec3(0.3f + 0.1f * (i % 8), 0.5f, 0.9f - 0.1f * (i / 8)));
+				scene.add_object(obj);
+			}
+		}
+
+		/*
+		* The renderer of the benchmarks that draw scenes: the phong shaders of TestApp and a
+		* camera on the z axis looking at the origin, like the one of TestApp.
+		*/
+		struct BenchRenderer
+		{
+			Shader shaderObjects;
+			Shader shaderLights;
+			Camera camera;
+			Renderer renderer;
+
+			BenchRenderer(const fs::path& shaderDir, Window& window, const vec3& cameraPosition = vec3(0.0f, 0.0f, 40.0f)) :
+				shaderObjects((shaderDir / "phong" / "object.vert").string().c_str(), (shaderDir / "phong" / "object.frag").string().c_str()),
+				shaderLights((shaderDir / "phong" / "object.vert").string().c_str(), (shaderDir / "phong" / "light_source.frag").string().c_str()),
+				renderer(&shaderObjects, &shaderLights, &window, &camera)
+			{
+				camera.set_position(cameraPosition);
+			}
+		};
+
+		/*
+		* Renders warmUp frames (uploads, pending queries, LOD hysteresis), then frames frames with
+		* glFinish() after every frame. Returns the ms per frame of the timed frames, CPU and GPU.
+		* cpuMs, if given, gets the ms per frame that render_scene() took on the CPU.
+		*/
+		static double time_frames(Renderer& renderer, Scene& scene, int frames, int warmUp = 2, double* cpuMs = nullptr)
+		{
+			for (int f = 0; f < warmUp; f++)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				renderer.render_scene(scene);
+			}
+			glFinish();
+
+			Timer timer, cpuTimer;
+			double cpuTotal = 0.0;
+			timer.start();
+			for (int f = 0; f < frames; f++)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				cpuTimer.start();
+				renderer.render_scene(scene);
+				cpuTimer.stop();
+				cpuTotal += cpuTimer.elapsed_time_ms();
+				glFinish();
+			}
+			timer.stop();
+			if (cpuMs) *cpuMs = cpuTotal / frames;
+			return timer.elapsed_time_ms() / frames;
+		}
+
+		/*
+		* Per-object uniform traffic that Renderer::render_object() had before the uniform and
+		* instance buffers existed: 12 uniforms per object per frame (shaders/bench/uniforms.*).
+		*	- old: the uniform name is passed as std::string and the location is queried
+		*	       with glGetUniformLocation() on every call (what Shader::setXXX() used to do)
+		*	- new: the locations are resolved once into UniformHandles and set directly
+		* Only the uniform calls are timed, the per-object values are computed up front.
+		*/
+		void bench_uniforms()
+		{
+			fs::path benchDir = mShaderDir / "bench";
+			Shader shader((benchDir / "uniforms.vert").string().c_str(), (benchDir / "uniforms.frag").string().c_str());
+			shader.use();
+			GLuint programID = shader.id();
+
+			struct ObjectValues { mat4 MVP; vec3 color, lightPos, cameraPos; Material material; };
+			struct Handles
+			{
+				UniformHandle<glm::mat4> MVP;
+				UniformHandle<glm::vec3> objColor, lightColor, lightPos, cameraPos;
+				UniformHandle<glm::vec3> matAmbient, matDiffuse, matSpecular;
+				UniformHandle<float> matShininess;
+				UniformHandle<glm::vec3> lightAmbient, lightDiffuse, lightSpecular;
+			};
+			Handles h{
+				shader.uniform<glm::mat4>("MVP"), shader.uniform<glm::vec3>("objColor"), shader.uniform<glm::vec3>("lightColor"),
+				shader.uniform<glm::vec3>("lightPosInObjSpace"), shader.uniform<glm::vec3>("cameraPosInObjSpace"),
+				shader.uniform<glm::vec3>("material.ambient"), shader.uniform<glm::vec3>("material.diffuse"),
+				shader.uniform<glm::vec3>("material.specular"), shader.uniform<float>("material.shininess"),
+				shader.uniform<glm::vec3>("light.ambient"), shader.uniform<glm::vec3>("light.diffuse"), shader.uniform<glm::vec3>("light.specular")
+			};
+
+			auto old_set_vec3 = [programID](const std::string& name, const vec3& v) { glUniform3f(glGetUniformLocation(programID, name.c_str()), v.x, v.y, v.z); };
+			auto old_set_float = [programID](const std::string& name, float f) { glUniform1f(glGetUniformLocation(programID, name.c_str()), f); };
+			auto old_set_mat4 = [programID](const std::string& name, const mat4& m) { glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()), 1, GL_FALSE, &m[0][0]); };
+
+			printf("[bench] uniform updates per frame (render_object() traffic, 12 uniforms per object)\n");
+			for (int radius : {2, 10, 30})
+			{
+				Scene scene;
+				build_grid_scene(scene, radius);
+
+				vector<ObjectValues> values;
+				for (Object* obj : scene.get_scene_objects())
+					values.push_back(ObjectValues{ obj->model_matrix(), obj->color(), vec3(0.0f, 5.0f, 3.0f), vec3(0.0f, 0.0f, 10.0f), obj->material() });
+				vec3 lightColor(1.0f), lightAmbient(0.2f), lightDiffuse(0.7f), lightSpecular(1.0f);
+
+				const int frames = radius == 2 ? 2000 : 50;
+				Timer timer;
+
+				glFinish();
+				timer.start();
+				for (int f = 0; f < frames; f++)
+				{
+					for (const ObjectValues& v : values)
+					{
+						old_set_vec3("objColor", v.color);
+						old_set_vec3("lightColor", lightColor);
+						old_set_vec3("lightPosInObjSpace", v.lightPos);
+						old_set_vec3("cameraPosInObjSpace", v.cameraPos);
+						old_set_vec3("material.ambient", v.material.ambient);
+						old_set_vec3("material.diffuse", v.material.diffuse);
+						old_set_vec3("material.specular", v.material.specular);
+						old_set_float("material.shininess", v.material.shininess);
+						old_set_vec3("light.ambient", lightAmbient);
+						old_set_vec3("light.diffuse", lightDiffuse);
+						old_set_vec3("light.specular", lightSpecular);
+						old_set_mat4("MVP", v.MVP);
+					}
+				}
+				glFinish();
+				timer.stop();
+				double oldUs = timer.elapsed_time_us() / frames;
+
+				timer.start();
+				for (int f = 0; f < frames; f++)
+				{
+					for (const ObjectValues& v : values)
+					{
+						shader.set(h.objColor, v.color);
+						shader.set(h.lightColor, lightColor);
+						shader.set(h.lightPos, v.lightPos);
+						shader.set(h.cameraPos, v.cameraPos);
+						shader.set(h.matAmbient, v.material.ambient);
+						shader.set(h.matDiffuse, v.material.diffuse);
+						shader.set(h.matSpecular, v.material.specular);
+						shader.set(h.matShininess, v.material.shininess);
+						shader.set(h.lightAmbient, lightAmbient);
+						shader.set(h.lightDiffuse, lightDiffuse);
+						shader.set(h.lightSpecular, lightSpecular);
+						shader.set(h.MVP, v.MVP);
+					}
+				}
+				glFinish();
+				timer.stop();
+				double newUs = timer.elapsed_time_us() / frames;
+
+				printf("  %6zu objects: old %10.1f us/frame, handles %10.1f us/frame (x%.1f)\n",
+					values.size(), oldUs, newUs, oldUs / newUs);
+			}
+		}
+
+		/*
+		* Renders the grid scene with each SortOrder and prints the state changes and draw commands
+		* of a frame next to the time of render_scene() (CPU submission + GPU, glFinish() after 
+		* every frame).
+		*/
+		void bench_render_queue()
+		{
+			BenchRenderer bench(mShaderDir, mWindow);
+			struct Order { SortOrder order; const char* name; };
+			const Order orders[] = { {SortOrder::SUBMISSION, "submission"}, {SortOrder::STATE, "state"}, {SortOrder::FRONT_TO_BACK, "front-to-back"} };
+
+			printf("[bench] render queue sort orders\n");
+			for (int radius : {2, 10})
+			{
+				Scene scene;
+				build_grid_scene(scene, radius);
+
+				for (const Order& order : orders)
+				{
+					bench.renderer.set_sort_order(order.order);
+					double frameMs = time_frames(bench.renderer, scene, 20, 1);
+					const Renderer::FrameStats& stats = bench.renderer.frame_stats();
+					printf("  %6zu objects, %-13s: %4u draw commands, %4u mesh changes, %3u texture changes, %2u shader changes, %8.2f ms/frame\n",
+						scene.get_scene_objects().size(), order.name, stats.drawCommands, stats.meshChanges, stats.textureChanges,
+						stats.shaderChanges, frameMs);
+				}
+			}
+		}
+
+		/*
+		* Material texture binding, with every PNG in resources/ (more textures than texture
+		* slots): per draw a texture of an "X O X O" pair (the low-priority lock pattern of
+		* TextureSlotManager) and every 4th draw a random one.
+		*	- slots: TextureSlotManager::bind_texture() + the sampler uniform per draw, what
+		*	         the renderer did before the texture arrays
+		*	- arrays: the array of the texture is bound once to the unit of its index and the
+		*	          draw only selects a layer (written to the instance data)
+		*	- bindless: the textures are made resident once and the draw only selects a handle
+		*	            index, only if ARB_bindless_texture is supported
+		* Then a scene of textured cubes is rendered with arrays and bindless textures to show 
+		* the renderer's texture changes.
+		* Run from the repository root, the benchmark is skipped if resources/ isn't there.
+		*/
+		void bench_texture_binding()
+		{
+			fs::path resourceDir = fs::current_path() / "resources";
+			if (!fs::is_directory(resourceDir))
+			{
+				printf("[bench] texture binding: skipped, no resources/ in the working directory\n");
+				return;
+			}
+
+			vector<shared_ptr<Texture>> textures;
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(resourceDir))
+			{
+				if (entry.path().extension() == ".png")
+					textures.push_back(std::make_shared<Texture>(entry.path().string().c_str()));
+			}
+			std::erase_if(textures, [](const shared_ptr<Texture>& texture) { return texture->ID() == 0; });
+			if (textures.size() < 3) return;
+
+			const int draws = 200000;
+			std::mt19937 rng(7);
+			std::uniform_int_distribution<size_t> randomTexture(2, textures.size() - 1);
+			vector<const Texture*> sequence(draws);
+			for (int i = 0; i < draws; i++)
+				sequence[i] = i % 4 == 3 ? textures[randomTexture(rng)].get() : textures[i % 2].get();
+
+			fs::path phongDir = mShaderDir / "phong";
+			Shader shader((phongDir / "object.vert").string().c_str(), (phongDir / "object.frag").string().c_str());
+			UniformHandle<int> sampler = shader.uniform<int>("materialTextures");
+			shader.use();
+
+			printf("[bench] material texture binding, %zu textures, %d texture slots, %d draws\n",
+				textures.size(), Texture::get_num_texture_slots_fragment_shader(), draws);
+
+			// slots
+			TextureSlotManager slotManager;
+			for (const Texture* texture : sequence) slotManager.bind_texture(*texture); // warm up
+			glFinish();
+			GLState::begin_frame();
+			Timer timer;
+			timer.start();
+			for (const Texture* texture : sequence)
+			{
+				GLuint slot = slotManager.bind_texture(*texture);
+				shader.set(sampler, slot - GL_TEXTURE0);
+			}
+			glFinish();
+			timer.stop();
+			GLState::Stats slotStats = GLState::stats();
+			printf("  slots   : %8.3f ms, %7u gl calls, %7u skipped\n", timer.elapsed_time_ms(), slotStats.calls, slotStats.skipped);
+
+			// arrays
+			TextureArrays arrays;
+			timer.start();
+			for (const shared_ptr<Texture>& texture : textures) arrays.add(texture);
+			glFinish();
+			timer.stop();
+			double addMs = timer.elapsed_time_ms();
+			glFinish();
+
+			vector<int> layers(draws);
+			GLState::begin_frame();
+			timer.start();
+			int lastArray = -1;
+			for (int i = 0; i < draws; i++)
+			{
+				TextureArrays::Layer layer = arrays.find(*sequence[i]);
+				if (layer.array != lastArray)
+				{
+					arrays.bind(layer.array, layer.array);
+					shader.set(sampler, layer.array);
+					lastArray = layer.array;
+				}
+				layers[i] = layer.layer;
+			}
+			glFinish();
+			timer.stop();
+			GLState::Stats arrayStats = GLState::stats();
+			printf("  arrays  : %8.3f ms, %7u gl calls, %7u skipped (%zu arrays, built in %.1f ms)\n",
+				timer.elapsed_time_ms(), arrayStats.calls, arrayStats.skipped, arrays.array_count(), addMs);
+
+			if (BindlessTextures::supported())
+			{
+				BindlessTextures bindless;
+				timer.start();
+				for (const shared_ptr<Texture>& texture : textures) bindless.add(texture);
+				bindless.bind();
+				timer.stop();
+				addMs = timer.elapsed_time_ms();
+				glFinish();
+
+				GLState::begin_frame();
+				timer.start();
+				for (int i = 0; i < draws; i++)
+					layers[i] = bindless.find(*sequence[i]);
+				glFinish();
+				timer.stop();
+				printf("  bindless: %8.3f ms, %7u gl calls, %7u skipped (%zu resident handles in %.1f ms)\n",
+					timer.elapsed_time_ms(), GLState::stats().calls, GLState::stats().skipped, bindless.size(), addMs);
+			}
+			else
+			{
+				printf("  bindless: skipped, GL_ARB_bindless_texture isn't supported\n");
+			}
+
+			// renderer
+			BenchRenderer bench(mShaderDir, mWindow);
+			Scene scene;
+			for (int i = 0; i < 1000; i++)
+			{
+				Object* cube = new models::Cube();
+				cube->set_position(vec3(i % 10, (i / 10) % 10, i / 100) * 2.5f - vec3(11.25f, 11.25f, 30.0f));
+				cube->set_texture(textures[i % textures.size()]);
+				scene.add_object(cube);
+			}
+			for (bool bindlessTextures : {false, true})
+			{
+				if (bindlessTextures && !BindlessTextures::supported()) break;
+				bench.renderer.set_bindless_textures(bindlessTextures);
+				double frameMs = time_frames(bench.renderer, scene, 10, 1); // the warm-up uploads the mesh and the textures
+				const Renderer::FrameStats& stats = bench.renderer.frame_stats();
+				printf("  renderer %-8s, %zu textured cubes: %u draw calls, %u texture changes, %u gl calls, %8.2f ms/frame\n",
+					bindlessTextures ? "bindless" : "arrays", scene.get_scene_objects().size(), stats.drawCalls, stats.textureChanges, 
+					stats.glCalls, frameMs);
+			}
+		}
+
+		/*
+		* FrustumCuller on random unit cubes scattered around the camera: the SIMD cull() against
+		* cull_scalar(), and the cost of transforming the mesh bounds with add(). Most objects are
+		* outside of the frustum.
+		*/
+		void bench_frustum_culling()
+		{
+			Camera camera;
+			glm::mat4 projection = glm::perspective(glm::radians(camera.fov()), mWindow.aspect_ratio(), 0.1f, 300.0f);
+			Frustum frustum = Frustum::from_matrix(projection * camera.view_matrix());
+
+			std::shared_ptr<Mesh> cube = models::Cube().mesh();
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+			printf("[bench] frustum culling (%s)\n", FrustumCuller::instruction_set());
+			for (size_t count : {1000, 10000, 100000})
+			{
+				vector<glm::mat4> models(count);
+				for (glm::mat4& model : models)
+					model = glm::translate(glm::mat4(1.0f), vec3(position(random), position(random), position(random)));
+
+				FrustumCuller culler;
+				vector<uint8_t> visible;
+				const int runs = 20;
+				Timer timer;
+				timer.start();
+				for (int run = 0; run < runs; run++)
+				{
+					culler.clear();
+					for (const glm::mat4& model : models)
+						culler.add(model, cube->bounds);
+				}
+				timer.stop();
+				double addUs = timer.elapsed_time_us() / runs;
+
+				size_t visibleCount = 0;
+				timer.start();
+				for (int run = 0; run < runs; run++)
+					visibleCount = culler.cull_scalar(frustum, visible);
+				timer.stop();
+				double scalarUs = timer.elapsed_time_us() / runs;
+
+				timer.start();
+				for (int run = 0; run < runs; run++)
+					visibleCount = culler.cull(frustum, visible);
+				timer.stop();
+				double simdUs = timer.elapsed_time_us() / runs;
+
+				printf("  %6zu objects (%6zu visible): add %9.1f us, scalar %9.1f us, simd %9.1f us (x%.1f)\n",
+					count, visibleCount, addUs, scalarUs, simdUs, scalarUs / simdUs);
+			}
+		}
+
+		/*
+		* Scene's BVH on 100k cubes and spheres scattered in a 1000^3 box: the build, the refit
+		* after moving 1% of the objects, and raycasts and box/sphere queries against a linear
+		* scan over the world space boxes of all objects. The linear scan gives the same
+		* results, the counts are printed to check that.
+		*/
+		void bench_bvh()
+		{
+			const size_t count = 100000;
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+			std::uniform_real_distribution<float> scale(0.5f, 3.0f);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+			Scene scene;
+			vector<Object*> objects;
+			for (size_t i = 0; i < count; i++)
+			{
+				Object* obj = i % 2 ? static_cast<Object*>(new models::Cube()) : new models::Icosphere(3);
+				obj->set_position(position(random), position(random), position(random));
+				obj->set_scale(scale(random));
+				scene.add_object(obj);
+				objects.push_back(obj);
+			}
+
+			printf("[bench] bvh (%zu objects)\n", count);
+			Timer timer;
+			timer.start();
+			scene.update_bvh();
+			timer.stop();
+			const Bvh& bvh = scene.bvh();
+			printf("  build %9.1f us, %zu nodes, sah cost %.1f\n", timer.elapsed_time_us(), bvh.node_count(), bvh.sah_cost());
+
+			timer.start();
+			for (size_t i = 0; i < count / 100; i++)
+			{
+				Object* obj = objects[random() % count];
+				obj->set_position(obj->position() + vec3(unit(random), unit(random), unit(random)) * 5.0f);
+			}
+			scene.update_bvh();
+			timer.stop();
+			printf("  refit after moving 1%%: %9.1f us, sah cost %.1f (x%.2f of the build)\n",
+				timer.elapsed_time_us(), bvh.sah_cost(), bvh.sah_cost() / bvh.build_cost());
+
+			vector<Aabb> boxes(count);
+			for (uint32_t i = 0; i < count; i++)
+				boxes[i] = bvh.item_bounds(i);
+
+			// rays from random points towards random points
+			const int rays = 1000;
+			vector<glm::vec3> origins(rays), directions(rays);
+			for (int i = 0; i < rays; i++)
+			{
+				origins[i] = vec3(position(random), position(random), position(random));
+				directions[i] = glm::normalize(vec3(position(random), position(random), position(random)) - origins[i]);
+			}
+
+			int bvhHits = 0, exactHits = 0, linearHits = 0;
+			RaycastHit hit;
+			timer.start();
+			for (int i = 0; i < rays; i++)
+				bvhHits += scene.raycast(origins[i], directions[i], hit, 2000.0f, false);
+			timer.stop();
+			double bvhUs = timer.elapsed_time_us() / rays;
+
+			timer.start();
+			for (int i = 0; i < rays; i++)
+				exactHits += scene.raycast(origins[i], directions[i], hit, 2000.0f, true);
+			timer.stop();
+			double exactUs = timer.elapsed_time_us() / rays;
+
+			timer.start();
+			for (int i = 0; i < rays; i++)
+			{
+				glm::vec3 inverseDirection = 1.0f / directions[i];
+				float nearest = -1.0f;
+				for (const Aabb& box : boxes)
+				{
+					float t = box.intersect_ray(origins[i], inverseDirection, nearest < 0.0f ? 2000.0f : nearest);
+					if (t >= 0.0f) nearest = t;
+				}
+				linearHits += nearest >= 0.0f;
+			}
+			timer.stop();
+			double linearUs = timer.elapsed_time_us() / rays;
+			printf("  raycast: bvh %7.2f us (%d hits), bvh + triangles %7.2f us (%d hits), linear %9.1f us (%d hits) (x%.0f)\n",
+				bvhUs, bvhHits, exactUs, exactHits, linearUs, linearHits, linearUs / bvhUs);
+
+			// nearest triangle of the exact raycast against all triangles of the objects whose box
+			// the ray hits, in world space, for rays aimed at objects so that most of them hit
+			const int checkedRays = 20;
+			int nearestMatches = 0;
+			for (int i = 0; i < checkedRays; i++)
+			{
+				Object* target = objects[random() % count];
+				glm::vec3 origin = target->position() + glm::normalize(vec3(unit(random), unit(random), unit(random))) * 30.0f;
+				glm::vec3 direction = glm::normalize(target->position() - origin);
+				glm::vec3 inverseDirection = 1.0f / direction;
+
+				Object* bruteObject = nullptr;
+				int bruteTriangle = -1;
+				float bruteDistance = 2000.0f;
+				for (Object* obj : objects)
+				{
+					const Mesh& mesh = *obj->mesh();
+					glm::mat4 model = obj->model_matrix();
+					if (Aabb::transformed(mesh.bounds, model).intersect_ray(origin, inverseDirection, bruteDistance) < 0.0f) continue;
+					for (size_t face = 0; face < mesh.faces.size(); face++)
+					{
+						const uvec3& f = mesh.faces[face];
+						glm::vec3 v0 = model * glm::vec4(mesh.vertices[f[0]], 1.0f);
+						glm::vec3 edge1 = glm::vec3(model * glm::vec4(mesh.vertices[f[1]], 1.0f)) - v0;
+						glm::vec3 edge2 = glm::vec3(model * glm::vec4(mesh.vertices[f[2]], 1.0f)) - v0;
+						glm::vec3 p = glm::cross(direction, edge2);
+						float determinant = glm::dot(edge1, p);
+						if (std::abs(determinant) < 1e-12f) continue;
+						glm::vec3 s = origin - v0;
+						float u = glm::dot(s, p) / determinant;
+						glm::vec3 q = glm::cross(s, edge1);
+						float v = glm::dot(direction, q) / determinant;
+						float t = glm::dot(edge2, q) / determinant;
+						if (u < 0.0f || u > 1.0f || v < 0.0f || u + v > 1.0f || t < 0.0f || t >= bruteDistance) continue;
+						bruteObject = obj;
+						bruteTriangle = static_cast<int>(face);
+						bruteDistance = t;
+					}
+				}
+
+				bool found = scene.raycast(origin, direction, hit, 2000.0f, true);
+				// faces sharing the hit point (edges, overlapping patches) may tie, the distance decides
+				if (!bruteObject) nearestMatches += !found;
+				else nearestMatches += found && ((hit.object == bruteObject && hit.triangle == bruteTriangle)
+					|| std::abs(hit.distance - bruteDistance) < 1e-4f * bruteDistance);
+			}
+			printf("  nearest triangle matches brute force for %d/%d rays\n", nearestMatches, checkedRays);
+
+			const int queries = 1000;
+			vector<Object*> found;
+			size_t bvhFound = 0, linearFound = 0;
+			vector<glm::vec3> centers(queries);
+			for (glm::vec3& center : centers)
+				center = vec3(position(random), position(random), position(random));
+
+			timer.start();
+			for (const glm::vec3& center : centers)
+			{
+				found.clear();
+				scene.query_aabb(Aabb(center - 25.0f, center + 25.0f), found);
+				bvhFound += found.size();
+			}
+			timer.stop();
+			bvhUs = timer.elapsed_time_us() / queries;
+
+			timer.start();
+			for (const glm::vec3& center : centers)
+			{
+				Aabb query(center - 25.0f, center + 25.0f);
+				for (const Aabb& box : boxes)
+					linearFound += box.intersects(query);
+			}
+			timer.stop();
+			linearUs = timer.elapsed_time_us() / queries;
+			printf("  query_aabb:   bvh %7.2f us, linear %9.1f us (%zu/%zu found) (x%.0f)\n",
+				bvhUs, linearUs, bvhFound, linearFound, linearUs / bvhUs);
+
+			bvhFound = linearFound = 0;
+			timer.start();
+			for (const glm::vec3& center : centers)
+			{
+				found.clear();
+				scene.query_sphere(center, 25.0f, found);
+				bvhFound += found.size();
+			}
+			timer.stop();
+			bvhUs = timer.elapsed_time_us() / queries;
+
+			timer.start();
+			for (const glm::vec3& center : centers)
+			{
+				for (const Aabb& box : boxes)
+					linearFound += box.intersects_sphere(center, 25.0f);
+			}
+			timer.stop();
+			linearUs = timer.elapsed_time_us() / queries;
+			printf("  query_sphere: bvh %7.2f us, linear %9.1f us (%zu/%zu found) (x%.0f)\n",
+				bvhUs, linearUs, bvhFound, linearFound, linearUs / bvhUs);
+		}
+
+		/*
+		* Renders the 3D grid scene on the CPU path (render queue, full detail meshes) and with
+		* GpuCulling, with and without occlusion culling. Prints the time render_scene() takes on
+		* the CPU (submission only) and for the whole frame (glFinish() after every frame), plus
+		* the culling counters of the last frame.
+		*/
+		void bench_gpu_culling()
+		{
+			BenchRenderer bench(mShaderDir, mWindow);
+			GpuCulling culling((mShaderDir / "culling").string());
+
+			enum class Path { CPU, GPU, GPU_OCCLUSION };
+			struct Config { Path path; const char* name; };
+			const Config configs[] = { {Path::CPU, "cpu"}, {Path::GPU, "gpu frustum"}, {Path::GPU_OCCLUSION, "gpu frustum+hi-z"} };
+
+			printf("[bench] GPU culling and LOD selection\n");
+			for (int radius : {2, 5, 10})
+			{
+				Scene scene;
+				build_grid3D_scene(scene, radius);
+				bench.camera.set_position(vec3(0.0f, 0.0f, 7.5f * radius + 15.0f));
+
+				for (const Config& config : configs)
+				{
+					bench.renderer.set_gpu_culling(config.path == Path::CPU ? nullptr : &culling);
+					culling.set_occlusion_culling(config.path == Path::GPU_OCCLUSION);
+					double cpuMs = 0.0;
+					double frameMs = time_frames(bench.renderer, scene, 10, 2, &cpuMs); // the warm-up builds the depth pyramid
+
+					printf("  %6zu objects, %-16s: cpu %8.3f ms/frame, frame %8.2f ms",
+						scene.get_scene_objects().size(), config.name, cpuMs, frameMs);
+					if (config.path != Path::CPU)
+					{
+						CullCounters counters = culling.read_counters();
+						printf(", %6u visible, %6u frustum culled, %6u occluded, %u draw commands", 
+							counters.visible, counters.frustumCulled, counters.occlusionCulled, counters.drawCount[0] + counters.drawCount[1]);
+					}
+					printf("\n");
+				}
+				bench.renderer.set_gpu_culling(nullptr);
+			}
+		}
+
+		/*
+		* A session that streams content: every 10 frames the scene is replaced by 20 spheres
+		* with meshes nobody else uses (as if loaded from disk), 600 frames in total. Shows
+		* the GPU memory at the end and the slowest frame for
+		*	- no eviction: what the geometry buffer did before, every mesh ever drawn is kept
+		*	- default: unreferenced meshes are dropped after GeometryBuffer::DEFAULT_EVICTION_AGE
+		*	- budget: the meshes that are still referenced are evicted too once the buffer holds
+		*	  more than 8 MB, after 30 frames without being drawn
+		*/
+		void bench_resource_streaming()
+		{
+			struct Config { const char* name; size_t budget; uint64_t evictionAge; };
+			const Config configs[] = {
+				{"no eviction", 0, std::numeric_limits<uint64_t>::max()},
+				{"default", GeometryBuffer::DEFAULT_BUDGET, GeometryBuffer::DEFAULT_EVICTION_AGE},
+				{"8 MB budget", size_t(8) << 20, 30} };
+
+			printf("[bench] streamed meshes, 600 frames, 20 new meshes every 10 frames\n");
+			for (const Config& config : configs)
+			{
+				BenchRenderer bench(mShaderDir, mWindow); // a new geometry buffer for each configuration
+				Renderer& renderer = bench.renderer;
+				renderer.geometry().set_budget(config.budget);
+				renderer.geometry().set_eviction_age(config.evictionAge);
+				vector<shared_ptr<Mesh>> keptMeshes; // stay referenced, like meshes of a cache
+				std::unique_ptr<Scene> scene;
+				unsigned int evicted = 0;
+				double slowestMs = 0.0;
+				Timer timer;
+				timer.start();
+				for (int frame = 0; frame < 600; frame++)
+				{
+					if (frame % 10 == 0)
+					{
+						scene = std::make_unique<Scene>();
+						for (int i = 0; i < 20; i++)
+						{
+							Object* sphere = new models::Icosphere(3);
+							sphere->set_mesh(std::make_shared<Mesh>(*sphere->mesh()));
+							sphere->set_position(vec3(i % 5 - 2.0f, i / 5 - 1.5f, 0.0f) * 3.0f);
+							scene->add_object(sphere);
+							if (i % 5 == 0) keptMeshes.push_back(sphere->mesh());
+						}
+					}
+
+					Timer frameTimer;
+					frameTimer.start();
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					renderer.render_scene(*scene);
+					frameTimer.stop();
+					slowestMs = std::max(slowestMs, frameTimer.elapsed_time_ms());
+					evicted += renderer.frame_stats().evictedMeshes;
+				}
+				glFinish();
+				timer.stop();
+
+				const Renderer::FrameStats& stats = renderer.frame_stats();
+				printf("  %-12s: meshes %7.2f MB in a %7.2f MB buffer, %5u evicted, gpu memory %7.2f MB, %3zu pending deletions, %6.2f ms/frame (slowest %6.2f ms)\n",
+					config.name, stats.meshBytes / 1048576.0, renderer.geometry().capacity_bytes() / 1048576.0, evicted, 
+					stats.gpuBytes / 1048576.0, stats.pendingDeletions, timer.elapsed_time_ms() / 600, slowestMs);
+			}
+			GpuResources::flush();
+		}
+
+		/*
+		* Frame times while assets stream in: every 10 frames a row of 8 spheres with new meshes
+		* and a new texture (the PNGs of resources/ in turn) is added to the scene, for 200
+		* frames and then until everything has been loaded.
+		*	- inline: the frame that adds a row loads its texture (Texture(const char*)) and
+		*	          uploads its meshes when it draws them, what the renderer did before
+		*	- loader: the texture and meshes go through an AssetLoader, the frames draw without
+		*	          texture and with placeholder meshes until they are published
+		* The frame time is the time spent on the main thread (adding the row and rendering).
+		* Run from the repository root, the benchmark is skipped if resources/ isn't there.
+		*/
+		void bench_asset_streaming()
+		{
+			fs::path resourceDir = fs::current_path() / "resources";
+			if (!fs::is_directory(resourceDir))
+			{
+				printf("[bench] asset streaming: skipped, no resources/ in the working directory\n");
+				return;
+			}
+			vector<std::string> paths;
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(resourceDir))
+			{
+				if (entry.path().extension() == ".png")
+					paths.push_back(entry.path().string());
+			}
+			if (paths.empty()) return;
+
+			printf("[bench] asset streaming, 200 frames, a row of 8 spheres with new meshes and a new texture every 10 frames\n");
+			for (bool streaming : { false, true })
+			{
+				std::unique_ptr<AssetLoader> loader;
+				if (streaming) loader = std::make_unique<AssetLoader>(mWindow);
+				BenchRenderer bench(mShaderDir, mWindow);
+				Renderer& renderer = bench.renderer;
+				renderer.set_asset_loader(loader.get());
+				Scene scene;
+				size_t nextPath = 0;
+				double totalMs = 0.0, slowestMs = 0.0;
+				int frame = 0;
+				for (; frame < 200 || (loader && (loader->pending() > 0 || renderer.geometry().streaming_meshes() > 0)); frame++)
+				{
+					Timer frameTimer;
+					frameTimer.start();
+					if (frame < 200 && frame % 10 == 0)
+					{
+						const std::string& path = paths[nextPath++ % paths.size()];
+						shared_ptr<Texture> texture = loader ? loader->load_texture(path) : std::make_shared<Texture>(path.c_str());
+						for (int i = 0; i < 8; i++)
+						{
+							Object* sphere = new models::Icosphere(3);
+							sphere->set_mesh(std::make_shared<Mesh>(*sphere->mesh()));
+							sphere->set_texture(texture);
+							sphere->set_position(vec3((i - 3.5f) * 3.0f, frame / 10 % 5 * 3.0f - 6.0f, -frame / 50 * 5.0f));
+							scene.add_object(sphere);
+						}
+					}
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					renderer.render_scene(scene);
+					frameTimer.stop();
+					totalMs += frameTimer.elapsed_time_ms();
+					slowestMs = std::max(slowestMs, frameTimer.elapsed_time_ms());
+				}
+				glFinish();
+
+				printf("  %-6s: %6.2f ms/frame, slowest %7.2f ms, %3d frames until everything was drawn\n",
+					streaming ? "loader" : "inline", totalMs / frame, slowestMs, frame);
+			}
+			GpuResources::flush();
+		}
+
+		/*
+		* Vertex bound scenes: a 3x3 grid of level 7 icospheres (640152 vertices, 32-bit 
+		* indexes) and one of level 5 icospheres (37272 vertices, 16-bit indexes with
+		* shortIndexes), small on screen so that the vertices and not the fragments dominate.
+		* Drawn with each vertex layout, the bytes per vertex are those of the vertex buffers:
+		*	- planar float: the layout the engine used before, one buffer per attribute
+		*	- interleaved float: the same attributes in one buffer
+		*	- half: half float positions, octahedral normals, unorm16 texture coordinates
+		*	- quantized: VertexLayout::quantized(), snorm16 positions instead of half floats
+		* The frame time includes glFinish().
+		*/
+		void bench_vertex_formats()
+		{
+			BenchRenderer bench(mShaderDir, mWindow, vec3(0.0f, 0.0f, 60.0f));
+
+			VertexLayout interleaved;
+			interleaved.interleaved = true;
+			VertexLayout half = VertexLayout::quantized();
+			half.position = VertexLayout::PositionFormat::HALF_FLOAT;
+			struct Config { const char* name; VertexLayout layout; };
+			const Config configs[] = { {"planar float", VertexLayout()}, {"interleaved float", interleaved}, {"half", half}, {"quantized", VertexLayout::quantized()} };
+
+			printf("[bench] vertex formats, 3x3 icospheres\n");
+			for (int level : {7, 5})
+			{
+				Scene scene;
+				for (int i = 0; i < 9; i++)
+				{
+					Object* sphere = new models::Icosphere(level);
+					sphere->set_position(vec3(i % 3 - 1.0f, i / 3 - 1.0f, 0.0f) * 6.0f);
+					sphere->set_scale(2.0f);
+					scene.add_object(sphere);
+				}
+
+				double referenceMs = 0.0;
+				for (const Config& config : configs)
+				{
+					bench.renderer.geometry().set_layout(config.layout);
+					double frameMs = time_frames(bench.renderer, scene, 10);
+					if (referenceMs == 0.0) referenceMs = frameMs;
+					GLenum indexType = config.layout.index_type(static_cast<GLuint>(scene.get_scene_objects().front()->mesh()->vertices.size()));
+					printf("  level %d, %-17s: %2u bytes/vertex, %2u-bit indexes, meshes %6.2f MB, %8.2f ms/frame (%+6.1f%%)\n",
+						level, config.name, config.layout.vertex_size(), VertexLayout::index_size(indexType) * 8,
+						bench.renderer.geometry().mesh_bytes() / 1048576.0, frameMs, (frameMs / referenceMs - 1.0) * 100.0);
+				}
+			}
+			GpuResources::flush();
+		}
+
+		/*
+		* Vertex cache metrics of the icospheres as generated and after MeshOptimizer, then a
+		* torus as an importer without indexing would deliver it: one vertex per corner, the
+		* faces in random order. Its frame time (3x3 tori) and the fragments that pass the
+		* depth test (overdraw) of one torus seen from several directions, before and after.
+		*/
+		void bench_mesh_optimization()
+		{
+			auto print_report = [](const char* name, const MeshOptimizer::Report& report, double ms)
+			{
+				printf("  %-10s: %7zu -> %7zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, optimized in %8.2f ms\n",
+					name, report.verticesBefore, report.verticesAfter, report.before.acmr, report.after.acmr,
+					report.before.atvr, report.after.atvr, ms);
+			};
+
+			printf("[bench] mesh optimization, FIFO cache of %u\n", MeshOptimizer::DEFAULT_CACHE_SIZE);
+			for (int level : {3, 5, 7})
+			{
+				shared_ptr<Mesh> sphere = models::Icosphere::init_mesh(level);
+				Timer timer;
+				timer.start();
+				MeshOptimizer::Report report = MeshOptimizer::optimize(*sphere);
+				timer.stop();
+				std::string name = "level " + std::to_string(level);
+				print_report(name.c_str(), report, timer.elapsed_time_ms());
+			}
+
+			// torus triangle soup, 256 x 128 quads
+			const int rings = 256, sides = 128;
+			const float majorRadius = 1.0f, minorRadius = 0.4f;
+			auto corner = [&](int ring, int side, vec3& position, vec3& normal, vec2& uv)
+			{
+				float u = glm::two_pi<float>() * ring / rings, v = glm::two_pi<float>() * side / sides;
+				normal = vec3(std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v));
+				position = vec3(std::cos(u), std::sin(u), 0.0f) * majorRadius + normal * minorRadius;
+				uv = vec2(static_cast<float>(ring) / rings, static_cast<float>(side) / sides);
+			};
+			vector<std::array<glm::ivec2, 3>> triangles;
+			for (int ring = 0; ring < rings; ring++)
+				for (int side = 0; side < sides; side++)
+				{
+					triangles.push_back({ glm::ivec2(ring, side), glm::ivec2(ring + 1, side), glm::ivec2(ring + 1, side + 1) });
+					triangles.push_back({ glm::ivec2(ring, side), glm::ivec2(ring + 1, side + 1), glm::ivec2(ring, side + 1) });
+				}
+			std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+			shared_ptr<Mesh> soup = std::make_shared<Mesh>();
+			for (const auto& triangle : triangles)
+			{
+				GLuint first = static_cast<GLuint>(soup->vertices.size());
+				for (const glm::ivec2& c : triangle)
+				{
+					vec3 position, normal;
+					vec2 uv;
+					corner(c.x, c.y, position, normal, uv);
+					soup->vertices.push_back(position);
+					soup->normals.push_back(normal);
+					soup->textureCoordinates.push_back(uv);
+				}
+				soup->faces.push_back(uvec3(first, first + 1, first + 2));
+			}
+			soup->update_bounds();
+			soup->optimized = true; // uploaded as it is
+
+			shared_ptr<Mesh> optimized = std::make_shared<Mesh>(*soup);
+			Timer optimizeTimer;
+			optimizeTimer.start();
+			MeshOptimizer::Report report = MeshOptimizer::optimize(*optimized);
+			optimizeTimer.stop();
+			print_report("torus soup", report, optimizeTimer.elapsed_time_ms());
+
+			BenchRenderer bench(mShaderDir, mWindow);
+			for (const auto& [name, mesh] : { std::pair{"soup", soup}, std::pair{"optimized", optimized} })
+			{
+				Scene grid;
+				for (int i = 0; i < 9; i++)
+				{
+					Object* torus = new Object();
+					torus->set_mesh(mesh);
+					torus->set_position(vec3(i % 3 - 1.0f, i / 3 - 1.0f, 0.0f) * 3.0f);
+					grid.add_object(torus);
+				}
+				bench.camera.set_position(vec3(0.0f, 0.0f, 12.0f));
+				double frameMs = time_frames(bench.renderer, grid, 10);
+
+				// one torus filling the view, turned around two axes
+				Scene single;
+				Object* torus = new Object();
+				torus->set_mesh(mesh);
+				single.add_object(torus);
+				bench.camera.set_position(vec3(0.0f, 0.0f, 4.0f));
+				GLuint query;
+				glGenQueries(1, &query);
+				GLuint64 fragments = 0;
+				const int directions = 32;
+				for (int d = 0; d < directions; d++)
+				{
+					torus->set_rotation(vec3(d * 97.0f, d * 137.5f, 0.0f)); // degrees, spread over the sphere
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					glBeginQuery(GL_SAMPLES_PASSED, query);
+					bench.renderer.render_scene(single);
+					glEndQuery(GL_SAMPLES_PASSED);
+					GLuint64 samples = 0;
+					glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+					fragments += samples;
+				}
+				glDeleteQueries(1, &query);
+
+				printf("    %-9s: %8.2f ms/frame (3x3), %8.0f fragments passed per view\n",
+					name, frameMs, static_cast<double>(fragments) / directions);
+			}
+			GpuResources::flush();
+		}
+
+		/*
+		* 3x3 level 6 spheres (81920 faces each) seen from close by, the outer ones partly out
+		* of view. Frame time (glFinish() after every frame) with the meshes drawn whole, with
+		* meshlet frustum culling only and with frustum and back-face (normal cone) culling,
+		* plus the meshlet counters of the last frame.
+		*/
+		void bench_meshlet_culling()
+		{
+			printf("[bench] meshlet culling\n");
+			models::Icosphere sphere(6);
+			const shared_ptr<Mesh>& mesh = sphere.mesh();
+			size_t vertices = 0;
+			for (const Meshlet& meshlet : mesh->meshlets)
+				vertices += meshlet.vertexCount;
+			printf("  level 6: %zu faces, %zu meshlets, %.1f faces and %.1f vertices per meshlet\n", mesh->faces.size(), mesh->meshlets.size(),
+				static_cast<double>(mesh->faces.size()) / mesh->meshlets.size(), static_cast<double>(vertices) / mesh->meshlets.size());
+
+			BenchRenderer bench(mShaderDir, mWindow, vec3(0.0f, 0.0f, 6.0f));
+			MeshletCulling culling((mShaderDir / "culling").string());
+
+			Scene grid;
+			for (int i = 0; i < 9; i++)
+			{
+				Object* obj = new Object();
+				obj->set_mesh(mesh);
+				obj->set_position(vec3(i % 3 - 1.0f, i / 3 - 1.0f, 0.0f) * 2.5f);
+				grid.add_object(obj);
+			}
+
+			struct Config { bool meshlets; bool backface; const char* name; };
+			const Config configs[] = { {false, false, "whole meshes"}, {true, false, "meshlets frustum"}, {true, true, "meshlets frustum+cone"} };
+			for (const Config& config : configs)
+			{
+				bench.renderer.set_meshlet_culling(config.meshlets ? &culling : nullptr);
+				culling.set_backface_culling(config.backface);
+				printf("  %-22s: %8.2f ms/frame", config.name, time_frames(bench.renderer, grid, 10));
+				if (config.meshlets)
+				{
+					MeshletCounters counters = culling.read_counters();
+					printf(", %6u meshlets: %6u drawn, %6u frustum culled, %6u back-facing", 
+						culling.work_count(), counters.visible, counters.frustumCulled, counters.backfaceCulled);
+				}
+				printf("\n");
+			}
+			bench.renderer.set_meshlet_culling(nullptr);
+			GpuResources::flush();
+		}
+
+		/*
+		* The 11^3 sphere grid on the CPU path with the levels of detail disabled (bias -20,
+		* every sphere at level 5), with the default 1 pixel error and with bias +1 and +2.
+		* The camera sees the whole grid. Prints the triangles drawn and the frame time
+		* (glFinish() after every frame), then moves the camera back and forth by 0.5 for 20
+		* frames and counts the LOD switches: spheres at a switching distance refine on the first
+		* move towards them, after that the hysteresis keeps them from switching back.
+		*/
+		void bench_lod_selection()
+		{
+			const int radius = 5;
+			Scene scene;
+			build_grid3D_scene(scene, radius);
+			vec3 cameraPosition(0.0f, 0.0f, 7.5f * radius * 4.0f);
+			BenchRenderer bench(mShaderDir, mWindow, cameraPosition);
+
+			printf("[bench] LOD selection (%zu spheres, cpu path)\n", scene.get_scene_objects().size());
+			for (float bias : {-20.0f, 0.0f, 1.0f, 2.0f})
+			{
+				bench.renderer.set_lod_bias(bias);
+				double frameMs = time_frames(bench.renderer, scene, 5);
+
+				size_t levels[6] = {};
+				for (Object* obj : scene.get_scene_objects())
+					levels[std::min<uint32_t>(obj->lod_level(), 5)]++;
+				printf("  bias %+5.1f: %8.2f ms/frame, %9zu triangles, spheres per level (5..0):", 
+					bias, frameMs, bench.renderer.frame_stats().triangles);
+				for (size_t level : levels)
+					printf(" %5zu", level);
+				printf("\n");
+			}
+
+			bench.renderer.set_lod_bias(0.0f);
+			vector<uint32_t> previous;
+			size_t firstSwitches = 0, switches = 0;
+			for (int f = 0; f < 20; f++)
+			{
+				bench.camera.set_position(cameraPosition + vec3(0.0f, 0.0f, f % 2 ? 0.5f : 0.0f));
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				bench.renderer.render_scene(scene);
+				size_t i = 0;
+				for (Object* obj : scene.get_scene_objects())
+				{
+					if (f > 0 && previous[i] != obj->lod_level()) (f == 1 ? firstSwitches : switches)++;
+					if (f == 0) previous.push_back(obj->lod_level());
+					else previous[i] = obj->lod_level();
+					i++;
+				}
+			}
+			printf("  camera moving back and forth by 0.5: %zu LOD switches on the first move, %zu in the 18 frames after it\n", firstSwitches, switches);
+			GpuResources::flush();
+		}
+
+		void bench_mesh_simplification()
+		{
+			// UV sphere with a UV seam from pole to pole and a vertex per segment at the poles
+			const int segments = 256, rings = 128;
+			shared_ptr<Mesh> sphere = std::make_shared<Mesh>();
+			for (int ring = 0; ring <= rings; ring++)
+				for (int segment = 0; segment <= segments; segment++)
+				{
+					float u = glm::two_pi<float>() * (segment % segments) / segments, v = glm::pi<float>() * ring / rings;
+					vec3 normal(std::sin(v) * std::cos(u), std::cos(v), std::sin(v) * std::sin(u));
+					if (ring == 0 || ring == rings) normal = vec3(0.0f, ring ? -1.0f : 1.0f, 0.0f);
+					sphere->vertices.push_back(normal);
+					sphere->normals.push_back(normal);
+					sphere->textureCoordinates.push_back(vec2(static_cast<float>(segment) / segments, static_cast<float>(ring) / rings));
+				}
+			for (int ring = 0; ring < rings; ring++)
+				for (int segment = 0; segment < segments; segment++)
+				{
+					GLuint a = ring * (segments + 1) + segment, b = a + segments + 1;
+					if (ring > 0) sphere->faces.push_back(uvec3(a, a + 1, b));
+					if (ring < rings - 1) sphere->faces.push_back(uvec3(a + 1, b + 1, b));
+				}
+			sphere->update_bounds();
+
+			// height field with an open border
+			const int cells = 256;
+			shared_ptr<Mesh> terrain = std::make_shared<Mesh>();
+			std::mt19937 rng(7);
+			std::uniform_real_distribution<float> noise(-0.002f, 0.002f);
+			for (int y = 0; y <= cells; y++)
+				for (int x = 0; x <= cells; x++)
+				{
+					float fx = static_cast<float>(x) / cells, fy = static_cast<float>(y) / cells;
+					terrain->vertices.push_back(vec3(fx, 0.1f * std::sin(fx * 6.0f) * std::cos(fy * 4.0f) + noise(rng), fy));
+					terrain->textureCoordinates.push_back(vec2(fx, fy));
+				}
+			for (int y = 0; y < cells; y++)
+				for (int x = 0; x < cells; x++)
+				{
+					GLuint a = y * (cells + 1) + x, b = a + cells + 1;
+					terrain->faces.push_back(uvec3(a, b, a + 1));
+					terrain->faces.push_back(uvec3(a + 1, b, b + 1));
+				}
+			terrain->update_vertex_normals();
+			terrain->update_bounds();
+
+			// edges of one face, counted over positions: 0 for a closed mesh, the border otherwise
+			auto open_edges = [](const Mesh& mesh)
+			{
+				std::map<std::pair<std::array<float, 3>, std::array<float, 3>>, int> edges;
+				for (const uvec3& face : mesh.faces)
+					for (int k = 0; k < 3; k++)
+					{
+						vec3 a = mesh.vertices[face[k]], b = mesh.vertices[face[(k + 1) % 3]];
+						std::array<float, 3> pa = { a.x, a.y, a.z }, pb = { b.x, b.y, b.z };
+						edges[std::minmax(pa, pb)]++;
+					}
+				size_t open = 0;
+				for (const auto& [edge, count] : edges)
+					open += count == 1;
+				return open;
+			};
+
+			printf("[bench] mesh simplification\n");
+			for (const auto& [name, mesh] : { std::pair{"uv sphere", sphere}, std::pair{"terrain", terrain} })
+			{
+				Timer timer;
+				timer.start();
+				shared_ptr<LodChain> chain = MeshSimplifier::build_lod_chain(mesh);
+				timer.stop();
+				printf("  %-9s: chain built in %8.2f ms\n", name, timer.elapsed_time_ms());
+				for (size_t level = 0; level < chain->size(); level++)
+				{
+					const Mesh& levelMesh = *chain->levels[level];
+					printf("    level %zu: %7zu faces, %7zu vertices, error %.5f (%.3f%% of radius), %5zu open edges\n", level,
+						levelMesh.faces.size(), levelMesh.vertices.size(), chain->errors[level],
+						100.0f * chain->errors[level] / mesh->bounds.radius, open_edges(levelMesh));
+				}
+			}
+
+			// load time: 8 distinct meshes on one thread, on all cores, and from the cache
+			vector<shared_ptr<Mesh>> meshes;
+			for (int i = 0; i < 8; i++)
+				meshes.push_back(std::make_shared<Mesh>(i % 2 ? *terrain : *sphere));
+			fs::path cacheDir = fs::temp_directory_path() / "ruya_bench_lod_cache";
+			fs::remove_all(cacheDir);
+			for (unsigned int threads : { 1u, 0u })
+			{
+				Timer timer;
+				timer.start();
+				MeshSimplifier::build_lod_chains(meshes, LodSettings(), "", threads);
+				timer.stop();
+				printf("  8 meshes, %2u threads: %8.2f ms\n", threads ? threads : std::max(std::thread::hardware_concurrency(), 1u), timer.elapsed_time_ms());
+			}
+			MeshSimplifier::build_lod_chains(meshes, LodSettings(), cacheDir.string());
+			Timer cacheTimer;
+			cacheTimer.start();
+			vector<shared_ptr<LodChain>> cached = MeshSimplifier::build_lod_chains(meshes, LodSettings(), cacheDir.string());
+			cacheTimer.stop();
+			size_t cachedFaces = 0;
+			for (const shared_ptr<LodChain>& chain : cached)
+				cachedFaces += chain->levels.back()->faces.size();
+			printf("  8 meshes, from cache:  %8.2f ms (%zu faces in the coarsest levels)\n", cacheTimer.elapsed_time_ms(), cachedFaces);
+			fs::remove_all(cacheDir);
+		}
+
+		/*
+		* Layers of overlapping spheres that cover the view several times, added far to near.
+		* Frame time (glFinish() after every frame) and fragments shaded per pixel, drawn in
+		* submission order (back to front, worst case), sorted front to back, and with the
+		* depth pre-pass in submission order.
+		*/
+		void bench_depth_prepass()
+		{
+			fs::path depthDir = mShaderDir / "depth";
+			Shader shaderDepth((depthDir / "depth.vert").string().c_str(), (depthDir / "depth.frag").string().c_str());
+			BenchRenderer bench(mShaderDir, mWindow, vec3(0.0f, 0.0f, 12.0f));
+			bench.renderer.set_depth_shader(&shaderDepth);
+
+			Scene scene;
+			const int layers = 8;
+			build_layered_scene(scene, layers);
+
+			printf("[bench] depth pre-pass (%zu spheres in %d layers)\n", scene.get_scene_objects().size(), layers);
+			struct Setup { const char* name; SortOrder order; bool prepass; };
+			for (const Setup& setup : { Setup{ "back to front", SortOrder::SUBMISSION, false }, Setup{ "front to back", SortOrder::FRONT_TO_BACK, false },
+										Setup{ "pre-pass", SortOrder::SUBMISSION, true } })
+			{
+				bench.renderer.set_sort_order(setup.order);
+				bench.renderer.set_depth_prepass(setup.prepass);
+				double frameMs = time_frames(bench.renderer, scene, 5, 5); // long warm-up, the fragment counts arrive a few frames later
+				const Renderer::FrameStats& stats = bench.renderer.frame_stats();
+				printf("  %-13s: %8.2f ms/frame, %8llu fragments shaded (%.2f per pixel), %8llu depth tested in the pre-pass\n", setup.name,
+					frameMs, static_cast<unsigned long long>(stats.shadedFragments), stats.overdraw,
+					static_cast<unsigned long long>(stats.depthFragments));
+			}
+			bench.renderer.set_depth_prepass(false);
+			GpuResources::flush();
+		}
+
+		/*
+		* Many lights: the grid scene lit by 1 to 1024 point lights of range 6 scattered in front
+		* of the grid, shaded by looping over all lights in every fragment and with
+		* LightClusters (only the lights of the fragment's cluster). The cluster columns show
+		* how many lights the clusters list on average and at most, and how many clusters are
+		* full (they drop the lights past LightClusters::cluster_capacity()).
+		*/
+		void bench_clustered_lighting()
+		{
+			BenchRenderer bench(mShaderDir, mWindow);
+			LightClusters clusters((mShaderDir / "lighting").string());
+
+			Scene scene;
+			build_grid_scene(scene, 3);
+
+			std::mt19937 rng(7);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			printf("[bench] clustered lighting (%zu objects, %ux%ux%u clusters)\n", scene.get_scene_objects().size(),
+				LightClusters::CLUSTERS_X, LightClusters::CLUSTERS_Y, LightClusters::CLUSTERS_Z);
+			for (int lightCount : { 1, 4, 16, 64, 256, 1024 })
+			{
+				while (static_cast<int>(scene.get_light_sources().size()) < lightCount)
+				{
+					LightSource* light = new LightSource();
+					light->set_position(vec3(unit(rng) * 50.0f - 25.0f, unit(rng) * 50.0f - 25.0f, unit(rng) * 8.0f - 4.0f));
+					vec3 color(unit(rng), unit(rng), unit(rng));
+					light->set_ambient(vec3(0.0f));
+					light->set_diffuse(color);
+					light->set_specular(color * 0.5f);
+					light->set_range(6.0f);
+					scene.add_light(light);
+				}
+
+				double ms[2] = {};
+				for (int clustered = 0; clustered < 2; clustered++)
+				{
+					bench.renderer.set_light_clusters(clustered ? &clusters : nullptr);
+					ms[clustered] = time_frames(bench.renderer, scene, 3, 1);
+				}
+
+				vector<GLuint> counts = clusters.read_light_counts();
+				size_t listed = 0, full = 0;
+				GLuint most = 0;
+				for (GLuint count : counts)
+				{
+					listed += count;
+					most = std::max(most, count);
+					if (count == clusters.cluster_capacity()) full++;
+				}
+				printf("  %4d lights: all lights %9.2f ms/frame, clustered %8.2f ms/frame (%5.1fx), %5.2f lights per cluster (max %u, %zu full)\n",
+					lightCount, ms[0], ms[1], ms[0] / ms[1], static_cast<double>(listed) / counts.size(), most, full);
+			}
+			GpuResources::flush();
+		}
+
+		/*
+		* Overdraw and many lights: the layered spheres of bench_depth_prepass() drawn back to
+		* front and lit by 64 and 256 point lights of range 6. Forward shading loops over all
+		* lights or the lights of the cluster in every shaded fragment (also with the depth
+		* pre-pass), deferred shading writes the G-buffer and lights each pixel once with the
+		* lights of its tile.
+		*/
+		void bench_deferred_shading()
+		{
+			fs::path depthDir = mShaderDir / "depth";
+			Shader shaderDepth((depthDir / "depth.vert").string().c_str(), (depthDir / "depth.frag").string().c_str());
+			BenchRenderer bench(mShaderDir, mWindow, vec3(0.0f, 0.0f, 12.0f));
+			bench.renderer.set_depth_shader(&shaderDepth);
+			bench.renderer.set_sort_order(SortOrder::SUBMISSION);
+			LightClusters clusters((mShaderDir / "lighting").string());
+			DeferredShading deferred(mShaderDir.string());
+
+			Scene scene;
+			const int layers = 8;
+			build_layered_scene(scene, layers);
+
+			std::mt19937 rng(11);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			printf("[bench] deferred shading (%zu spheres in %d layers, G-buffer of 16 bytes per pixel)\n", scene.get_scene_objects().size(), layers);
+			struct Setup { const char* name; bool clustered; bool prepass; bool deferred; };
+			for (int lightCount : { 64, 256 })
+			{
+				while (static_cast<int>(scene.get_light_sources().size()) < lightCount)
+				{
+					LightSource* light = new LightSource();
+					light->set_position(vec3(unit(rng) * 14.0f - 7.0f, unit(rng) * 12.0f - 6.0f, 4.0f - unit(rng) * 32.0f));
+					vec3 color(unit(rng), unit(rng), unit(rng));
+					light->set_ambient(vec3(0.0f));
+					light->set_diffuse(color);
+					light->set_specular(color * 0.5f);
+					light->set_range(6.0f);
+					scene.add_light(light);
+				}
+
+				printf("  %d lights\n", lightCount);
+				for (const Setup& setup : { Setup{ "forward", false, false, false }, Setup{ "clustered", true, false, false },
+											Setup{ "clustered + pre-pass", true, true, false }, Setup{ "deferred", false, false, true } })
+				{
+					bench.renderer.set_light_clusters(setup.clustered ? &clusters : nullptr);
+					bench.renderer.set_depth_prepass(setup.prepass);
+					bench.renderer.set_deferred_shading(setup.deferred ? &deferred : nullptr);
+					double frameMs = time_frames(bench.renderer, scene, 3, 5); // long warm-up, the fragment counts arrive a few frames later
+					printf("    %-20s: %9.2f ms/frame, %5.2f fragments per pixel", setup.name, frameMs, bench.renderer.frame_stats().overdraw);
+					if (setup.deferred)
+					{
+						vector<GLuint> counts = deferred.read_tile_light_counts();
+						size_t listed = 0;
+						GLuint most = 0;
+						for (GLuint count : counts)
+						{
+							listed += count;
+							most = std::max(most, count);
+						}
+						printf(", %5.2f lights per tile (max %u)", static_cast<double>(listed) / counts.size(), most);
+					}
+					printf("\n");
+				}
+			}
+			bench.renderer.set_deferred_shading(nullptr);
+			GpuResources::flush();
+		}
+
+		/*
+		* Dense geometry: 48 level 5 icospheres (81920 faces each) lit by 64 clustered lights,
+		* seen from close by and from far away, where most triangles cover less than a pixel.
+		* Forward shading runs the object shader for the (partly covered) 2x2 quads of every
+		* triangle, also with the depth pre-pass, the visibility buffer only writes triangle
+		* ids and shades every covered pixel once.
+		*/
+		void bench_visibility_buffer()
+		{
+			fs::path depthDir = mShaderDir / "depth";
+			Shader shaderDepth((depthDir / "depth.vert").string().c_str(), (depthDir / "depth.frag").string().c_str());
+			BenchRenderer bench(mShaderDir, mWindow);
+			bench.renderer.set_depth_shader(&shaderDepth);
+			LightClusters clusters((mShaderDir / "lighting").string());
+			bench.renderer.set_light_clusters(&clusters);
+			VisibilityBuffer visibility(mShaderDir.string());
+
+			models::Icosphere sphere(5);
+			Scene scene;
+			build_dense_scene(scene, sphere.mesh());
+			std::mt19937 rng(13);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+			for (int l = 0; l < 64; l++)
+			{
+				LightSource* light = new LightSource();
+				light->set_position(vec3(unit(rng) * 20.0f - 10.0f, unit(rng) * 15.0f - 7.5f, unit(rng) * 4.0f));
+				vec3 color(unit(rng), unit(rng), unit(rng));
+				light->set_ambient(vec3(0.02f));
+				light->set_diffuse(color);
+				light->set_specular(color * 0.5f);
+				light->set_range(6.0f);
+				scene.add_light(light);
+			}
+
+			printf("[bench] visibility buffer (%zu spheres of %zu faces, %zu lights)\n", scene.get_scene_objects().size(), sphere.mesh()->faces.size(),
+				scene.get_light_sources().size());
+			struct Setup { const char* name; bool prepass; bool visibility; };
+			for (float distance : { 16.0f, 60.0f })
+			{
+				bench.camera.set_position(vec3(0.0f, 0.0f, distance));
+				printf("  camera at %.0f\n", distance);
+				for (const Setup& setup : { Setup{ "forward", false, false }, Setup{ "forward + pre-pass", true, false }, Setup{ "visibility buffer", false, true } })
+				{
+					bench.renderer.set_depth_prepass(setup.prepass);
+					bench.renderer.set_visibility_buffer(setup.visibility ? &visibility : nullptr);
+					double frameMs = time_frames(bench.renderer, scene, 3, 5); // long warm-up, the fragment counts arrive a few frames later
+					const Renderer::FrameStats& stats = bench.renderer.frame_stats();
+					printf("    %-18s: %9.2f ms/frame, %10zu triangles, %5.2f fragments per pixel (%s)\n", setup.name, frameMs,
+						stats.triangles, stats.overdraw, setup.visibility ? "triangle ids" : "shaded");
+				}
+			}
+			bench.renderer.set_visibility_buffer(nullptr);
+			bench.renderer.set_depth_prepass(false);
+			GpuResources::flush();
+		}
+
+		/*
+		* Flat shading implementations (Renderer::FlatShading) on the icosphere grid of TestApp and
+		* on 48 spheres of 81920 faces: the geometry shader, face normals from derivatives and
+		* `flat` outputs of the provoking vertex. The provoking vertex needs a copy of each mesh
+		* with duplicated vertices (MeshOptimizer::assign_provoking_vertices()), its cost is
+		* measured on the largest icosphere.
+		*/
+		void bench_flat_shading()
+		{
+			fs::path phongDir = mShaderDir / "phong";
+			fs::path flatDir = mShaderDir / "flat";
+			Shader shaderGeometry((flatDir / "flat_vert.vert").string().c_str(), (flatDir / "flat_geom.geom").string().c_str(), (flatDir / "flat_frag.frag").string().c_str());
+			Shader shaderDerivatives((phongDir / "object.vert").string().c_str(), (flatDir / "flat_derivatives.frag").string().c_str());
+			Shader shaderProvoking((flatDir / "flat_provoking.vert").string().c_str(), (flatDir / "flat_frag.frag").string().c_str());
+			BenchRenderer bench(mShaderDir, mWindow);
+			bench.renderer.set_flat_shader(&shaderGeometry, Renderer::FlatShading::GEOMETRY_SHADER);
+			bench.renderer.set_flat_shader(&shaderDerivatives, Renderer::FlatShading::DERIVATIVES);
+			bench.renderer.set_flat_shader(&shaderProvoking, Renderer::FlatShading::PROVOKING_VERTEX);
+			bench.renderer.set_shading_mode(Renderer::ShadingMode::FLAT);
+
+			models::Icosphere sphere(5);
+			{
+				Mesh flat = *sphere.mesh();
+				Timer timer;
+				timer.start();
+				size_t added = MeshOptimizer::assign_provoking_vertices(flat);
+				timer.stop();
+				printf("[bench] flat shading, provoking vertices of %zu faces: %zu -> %zu vertices (+%zu) in %.2f ms\n", flat.faces.size(),
+					sphere.mesh()->vertices.size(), flat.vertices.size(), added, timer.elapsed_time_ms());
+			}
+
+			Scene grid, dense;
+			build_grid_scene(grid);
+			build_dense_scene(dense, sphere.mesh());
+			for (Scene* scene : { &grid, &dense })
+			{
+				LightSource* light = new LightSource();
+				light->set_position(vec3(0.0f, 5.0f, 10.0f));
+				scene->add_light(light);
+			}
+
+			struct Setup { const char* name; Renderer::FlatShading implementation; };
+			struct Case { const char* name; Scene* scene; vec3 cameraPosition; };
+			for (const Case& test : { Case{ "icosphere grid", &grid, vec3(0.0f, 0.0f, 20.0f) }, Case{ "48 dense spheres", &dense, vec3(0.0f, 0.0f, 16.0f) } })
+			{
+				bench.camera.set_position(test.cameraPosition);
+				printf("  %s\n", test.name);
+				for (const Setup& setup : { Setup{ "geometry shader", Renderer::FlatShading::GEOMETRY_SHADER }, Setup{ "derivatives", Renderer::FlatShading::DERIVATIVES },
+											Setup{ "provoking vertex", Renderer::FlatShading::PROVOKING_VERTEX } })
+				{
+					bench.renderer.set_flat_shading(setup.implementation);
+					double frameMs = time_frames(bench.renderer, *test.scene, 5, 3); // the warm-up builds the provoking vertex meshes
+					printf("    %-16s: %9.2f ms/frame, %10zu triangles, %6.2f MB of meshes\n", setup.name, frameMs,
+						bench.renderer.frame_stats().triangles, bench.renderer.frame_stats().meshBytes / (1024.0 * 1024.0));
+				}
+			}
+			bench.renderer.set_flat_shading(Renderer::FlatShading::GEOMETRY_SHADER);
+			GpuResources::flush();
+		}
+
+		/*
+		* Model matrices of 1k to 100k objects per frame: what the renderer did before the
+		* TransformSystem (scale, three Euler rotations and a translation, then glm::inverse(),
+		* for every object every frame) against the cached matrices, with 1% or all objects
+		* moved each frame (update() against update_scalar()). The matrices of all objects are
+		* read each frame in every case, like Renderer::write_instance_data() does.
+		*/
+		void bench_transforms()
+		{
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(0.0f, 360.0f), scale(0.5f, 2.0f);
+
+			printf("[bench] transforms (%s)\n", TransformSystem::instruction_set());
+			for (size_t count : {1000, 10000, 100000})
+			{
+				vector<Object> objects(count);
+				for (Object& obj : objects)
+				{
+					obj.set_position(vec3(position(random), position(random), position(random)));
+					obj.set_rotation(vec3(angle(random), angle(random), angle(random)));
+					obj.set_scale(vec3(scale(random), scale(random), scale(random)));
+				}
+				TransformSystem::update();
+
+				const int frames = 20;
+				glm::mat4 sum(0.0f); // keeps the matrices from being optimized away
+				Timer timer;
+				timer.start();
+				for (int f = 0; f < frames; f++)
+					for (Object& obj : objects)
+					{
+						vec3 rotation = vec3(f, 2.0f * f, 3.0f * f);
+						glm::mat4 rotationMatrix(1.0f);
+						rotationMatrix = glm::rotate(rotationMatrix, glm::radians(rotation.x), vec3(1.0f, 0.0f, 0.0f));
+						rotationMatrix = glm::rotate(rotationMatrix, glm::radians(rotation.y), vec3(0.0f, 1.0f, 0.0f));
+						rotationMatrix = glm::rotate(rotationMatrix, glm::radians(rotation.z), vec3(0.0f, 0.0f, 1.0f));
+						glm::mat4 model = glm::translate(glm::mat4(1.0f), obj.position()) * rotationMatrix * glm::scale(glm::mat4(1.0f), obj.scale());
+						sum += model + glm::inverse(model);
+					}
+				timer.stop();
+				double perFrameUs = timer.elapsed_time_us() / frames;
+
+				// moves every step-th object, then reads all matrices: time of the whole frame and of the update
+				auto run = [&](size_t step, bool simd) {
+					size_t updated = 0;
+					double updateUs = 0.0;
+					Timer frameTimer, updateTimer;
+					frameTimer.start();
+					for (int f = 0; f < frames; f++)
+					{
+						for (size_t i = f % step; i < count; i += step)
+							objects[i].rotate_y(1.0f);
+						updateTimer.start();
+						updated += simd ? TransformSystem::update() : TransformSystem::update_scalar();
+						updateTimer.stop();
+						updateUs += updateTimer.elapsed_time_us();
+						for (Object& obj : objects)
+							sum += obj.model_matrix() + obj.inverse_model_matrix();
+					}
+					frameTimer.stop();
+					return std::array<double, 3>{ frameTimer.elapsed_time_us() / frames, updateUs / frames, static_cast<double>(updated / frames) };
+				};
+				std::array<double, 3> few = run(100, true), allScalar = run(1, false), all = run(1, true);
+				volatile float sink = sum[0][0];
+				(void)sink;
+				printf("  %6zu objects: every frame %9.1f us | 1%% moved %9.1f us, update of %5.0f %7.1f us | all moved %9.1f us, update scalar %8.1f us, simd %8.1f us (x%.1f)\n",
+					count, perFrameUs, few[0], few[2], few[1], all[0], allScalar[1], all[1], allScalar[1] / all[1]);
+			}
+		}
+	};
+}
+
+#endif // BENCH_APP_H
\ No newline at end of file
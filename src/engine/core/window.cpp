@@ -1,4 +1,7 @@
 #include "window.h"
+#include "engine/render/gl_state.h"
+#include "engine/render/bindless_textures.h"
+#include "engine/render/gpu_resources.h"
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -30,6 +33,9 @@ ruya::Window::Window(int width, int height)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef RUYA_GL_VALIDATION
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
 
 	mGLFWwindow = glfwCreateWindow(width, height, "opengl window", nullptr, nullptr);
 	if (mGLFWwindow == nullptr)
@@ -46,6 +52,8 @@ ruya::Window::Window(int width, int height)
 	{
 		throw std::runtime_error("Failed to initialize GLAD (which is responsible for the opengl function pointers)");
 	}
+	GLState::init();
+	BindlessTextures::load((GLADloadproc)glfwGetProcAddress); // not part of glad
 
 	// opengl settings
 	glViewport(0, 0, width, height);
@@ -57,10 +65,27 @@ ruya::Window::Window(int width, int height)
 
 ruya::Window::~Window()
 {
+	GpuResources::flush(); // GL objects released since the last frame, while the context exists
 	glfwDestroyWindow(mGLFWwindow);
 	glfwTerminate(); // ? should this be removed in case multiple windows are being used ?
 }
 
+/*
+* Creates an invisible window whose context shares its objects (buffers, textures, syncs, ...)
+* with the context of this window, for threads that upload data (see AssetLoader). The caller
+* destroys it with glfwDestroyWindow(). Windows can only be created on the main thread.
+* @throws std::runtime_error if the window can't be created
+*/
+GLFWwindow* ruya::Window::create_shared_context()
+{
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // the context hints of the constructor still apply
+	GLFWwindow* context = glfwCreateWindow(1, 1, "shared context", nullptr, mGLFWwindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (context == nullptr)
+		throw std::runtime_error("Could not create a GLFW window with a shared context");
+	return context;
+}
+
 GLFWwindow* ruya::Window::get_GLFW_window()
 {
 	return mGLFWwindow;
@@ -120,11 +145,11 @@ void ruya::Window::process_inputs()
 		switch (renderMode)
 		{
 		case RenderMode::FILL:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			GLState::polygon_mode(GL_LINE);
 			renderMode = RenderMode::WIREFRAME;
 			break;
 		case RenderMode::WIREFRAME:
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			GLState::polygon_mode(GL_FILL);
 			renderMode = RenderMode::FILL;
 			break;
 		}
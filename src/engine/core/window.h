@@ -34,6 +34,7 @@ namespace ruya
 
 		// MANIPULATORS
 		void make_context_current() { glfwMakeContextCurrent(mGLFWwindow); }
+		GLFWwindow* create_shared_context();
 		void update();
 		void add_event_callback(int glfwEventID, VOID_FPTR callback);
 		void remove_event_callback(VOID_FPTR callback);
@@ -0,0 +1,222 @@
+#include <iostream>
+#include "asset_loader.h"
+#include "gpu_resources.h"
+#include "io/stb_image.h"
+
+/*
+* Creates the shared context and starts the loader thread.
+* @pre called on the main thread, with the window's context current
+*/
+ruya::AssetLoader::AssetLoader(Window& window)
+	: mContext(window.create_shared_context()), mStop(false), mPending(0)
+{
+	mThread = std::thread(&AssetLoader::run, this);
+}
+
+/*
+* Stops the loader thread once its current job is done and deletes what it uploaded but
+* wasn't published yet.
+* @pre the window's context is current
+*/
+ruya::AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mJobAdded.notify_one();
+	mThread.join();
+	glfwDestroyWindow(mContext);
+
+	for (Upload& upload : mUploads)
+		discard(upload);
+	for (Upload& upload : mInFlight)
+		discard(upload);
+	for (StagedMesh& staged : mStagedMeshes)
+		GpuResources::release(GpuResources::Type::BUFFER, staged.buffer);
+}
+
+/*
+* Queues the image file to be loaded, the texture stays empty until update() publishes it.
+*/
+shared_ptr<ruya::Texture> ruya::AssetLoader::load_texture(const string& path)
+{
+	shared_ptr<Texture> texture = std::make_shared<Texture>();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(Job{ texture, path, nullptr, VertexLayout() });
+	}
+	mJobAdded.notify_one();
+	mPending++;
+	return texture;
+}
+
+/*
+* Queues the mesh to be converted to the layout and written to a staging buffer, see
+* take_staged_meshes().
+* @pre the mesh isn't changed until it has been staged, the loader thread reads it
+*/
+void ruya::AssetLoader::stage_mesh(const shared_ptr<Mesh>& mesh, const VertexLayout& layout)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(Job{ nullptr, string(), mesh, layout });
+	}
+	mJobAdded.notify_one();
+	mPending++;
+}
+
+/*
+* Publishes the uploads whose fence has signaled: textures get their GL texture and pixel
+* data, staged meshes are handed to the next take_staged_meshes(). Fences signal in the
+* order they were placed in, the first one that hasn't ends the check. Call it once per
+* frame on the main thread.
+*/
+void ruya::AssetLoader::update()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (Upload& upload : mUploads)
+			mInFlight.push_back(std::move(upload));
+		mUploads.clear();
+	}
+
+	while (!mInFlight.empty() && glClientWaitSync(mInFlight.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+	{
+		publish(mInFlight.front());
+		mInFlight.pop_front();
+		mPending--;
+	}
+}
+
+/*
+* The meshes staged since the last call, the caller copies their data and releases their
+* staging buffers.
+*/
+std::vector<ruya::AssetLoader::StagedMesh> ruya::AssetLoader::take_staged_meshes()
+{
+	vector<StagedMesh> staged;
+	staged.swap(mStagedMeshes);
+	return staged;
+}
+
+/*
+* Loader thread: runs the jobs in order, each upload is fenced and flushed so that the main
+* context sees the fence.
+*/
+void ruya::AssetLoader::run()
+{
+	glfwMakeContextCurrent(mContext);
+	stbi_set_flip_vertically_on_load_thread(true); // like Texture(const char*)
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAdded.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+			if (mStop) break;
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		Upload upload = job.mesh ? upload_mesh(job) : upload_texture(job);
+		upload.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mUploads.push_back(std::move(upload));
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+/*
+* Loader thread: decodes the image and creates its texture from a pixel unpack buffer, the
+* copy to the texture and the mipmaps are left to the GPU.
+*/
+ruya::AssetLoader::Upload ruya::AssetLoader::upload_texture(Job& job)
+{
+	Upload upload;
+	upload.texture = std::move(job.texture);
+	upload.pixels = stbi_load(job.path.c_str(), &upload.width, &upload.height, &upload.channels, 0);
+	if (!upload.pixels)
+	{
+		std::cerr << "Error loading texture: " << stbi_failure_reason() << "\nTexture path: " << job.path << std::endl;
+		return upload;
+	}
+
+	GLsizeiptr size = static_cast<GLsizeiptr>(upload.width) * upload.height * upload.channels;
+	glCreateBuffers(1, &upload.unpackBuffer);
+	glNamedBufferStorage(upload.unpackBuffer, size, upload.pixels, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.unpackBuffer);
+	upload.textureID = Texture::create_texture(upload.width, upload.height, upload.channels, nullptr);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return upload;
+}
+
+/*
+* Loader thread: converts the mesh to the job's layout (see VertexLayout::encode()) and
+* writes it to a staging buffer in the order of StagedMesh.
+*/
+ruya::AssetLoader::Upload ruya::AssetLoader::upload_mesh(Job& job)
+{
+	Upload upload;
+	VertexLayout::EncodedMesh encoded = job.layout.encode(*job.mesh);
+	StagedMesh& staged = upload.mesh;
+	staged.mesh = std::move(job.mesh);
+	staged.layout = job.layout;
+	staged.vertexCount = encoded.vertexCount;
+	staged.indexCount = encoded.indexCount;
+	staged.indexType = encoded.indexType;
+	staged.meshletCount = static_cast<GLuint>(encoded.meshlets.size());
+	staged.dequantization = encoded.dequantization;
+
+	GLsizeiptr meshletSize = encoded.meshlets.size() * sizeof(MeshletData);
+	GLsizeiptr size = encoded.indexes.size() + meshletSize;
+	for (GLuint s = 0; s < job.layout.stream_count(); s++)
+		size += encoded.streams[s].size();
+	glCreateBuffers(1, &staged.buffer);
+	glNamedBufferStorage(staged.buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	GLintptr offset = 0;
+	for (GLuint s = 0; s < job.layout.stream_count(); s++)
+	{
+		glNamedBufferSubData(staged.buffer, offset, encoded.streams[s].size(), encoded.streams[s].data());
+		offset += encoded.streams[s].size();
+	}
+	glNamedBufferSubData(staged.buffer, offset, encoded.indexes.size(), encoded.indexes.data());
+	offset += encoded.indexes.size();
+	if (meshletSize > 0) glNamedBufferSubData(staged.buffer, offset, meshletSize, encoded.meshlets.data());
+	return upload;
+}
+
+/*
+* Main thread: hands the objects of a finished upload over to the texture or to the staged
+* meshes, the unpack buffer isn't needed anymore.
+*/
+void ruya::AssetLoader::publish(Upload& upload)
+{
+	glDeleteSync(upload.fence);
+	if (upload.mesh.mesh)
+	{
+		mStagedMeshes.push_back(std::move(upload.mesh));
+		return;
+	}
+
+	GpuResources::release(GpuResources::Type::BUFFER, upload.unpackBuffer);
+	if (upload.textureID != 0)
+		upload.texture->set_image(upload.textureID, upload.width, upload.height, upload.channels, upload.pixels);
+}
+
+/*
+* Main thread: deletes the objects of an upload that won't be published.
+*/
+void ruya::AssetLoader::discard(Upload& upload)
+{
+	glDeleteSync(upload.fence);
+	GpuResources::release(GpuResources::Type::BUFFER, upload.unpackBuffer);
+	GpuResources::release(GpuResources::Type::BUFFER, upload.mesh.buffer);
+	GpuResources::release(GpuResources::Type::TEXTURE, upload.textureID);
+	stbi_image_free(upload.pixels);
+}
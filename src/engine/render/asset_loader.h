@@ -0,0 +1,122 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+
+#include "engine/core/window.h"
+#include "engine/render/vertex_layout.h"
+#include "engine/scene/mesh.h"
+#include "engine/scene/texture.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Loads textures and uploads meshes on a thread with its own OpenGL context, which shares
+	* its objects with the context of the window, so that the frame that needs an asset doesn't
+	* stall on decoding or uploading it.
+	*	- load_texture() returns an empty Texture right away (ID() == 0, objects with it are
+	*	  drawn without texture). The image is decoded on the loader thread and uploaded
+	*	  through a pixel unpack buffer
+	*	- stage_mesh() converts a mesh to a vertex layout and writes it to a staging buffer on
+	*	  the loader thread, GeometryBuffer copies it into its buffers on the GPU and draws a
+	*	  placeholder until then (see GeometryBuffer::set_loader())
+	*	- every upload is followed by a fence. update() publishes the assets whose fence has
+	*	  signaled and never waits, an asset is used by the first frame after its upload has
+	*	  finished
+	*
+	* Only the main thread touches GLState and GpuResources, the loader thread creates its
+	* GL objects on its own context and update() hands them over. Jobs that haven't been
+	* started when the loader is destroyed are dropped.
+	*/
+	class AssetLoader
+	{
+	public:
+		/*
+		* Vertex and index data of a mesh in a staging buffer, encoded in the layout and
+		* tightly packed in this order: the vertexCount vertices of each stream of the layout,
+		* indexCount indexes of indexType and meshletCount MeshletData.
+		*/
+		struct StagedMesh
+		{
+			shared_ptr<Mesh> mesh;
+			GLuint buffer = 0; // owned by whoever takes the StagedMesh, see take_staged_meshes()
+			VertexLayout layout;
+			GLuint vertexCount = 0;
+			GLuint indexCount = 0;
+			GLenum indexType = GL_UNSIGNED_INT;
+			GLuint meshletCount = 0;
+			VertexLayout::Dequantization dequantization;
+		};
+
+		AssetLoader(Window& window);
+		~AssetLoader();
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+
+		shared_ptr<Texture> load_texture(const string& path);
+		void stage_mesh(const shared_ptr<Mesh>& mesh, const VertexLayout& layout);
+		void update();
+		vector<StagedMesh> take_staged_meshes();
+
+		size_t pending() const { return mPending; } // requested assets that haven't been published yet
+
+	private:
+		/*
+		* A texture to load or a mesh to stage.
+		*/
+		struct Job
+		{
+			shared_ptr<Texture> texture;
+			string path;
+			shared_ptr<Mesh> mesh;
+			VertexLayout layout;
+		};
+
+		/*
+		* Result of a job, published by update() once the loader thread's commands up to its
+		* fence have finished.
+		*/
+		struct Upload
+		{
+			GLsync fence = 0;
+			shared_ptr<Texture> texture;
+			GLuint textureID = 0; // 0 if the image failed to load
+			GLuint unpackBuffer = 0;
+			int width = 0, height = 0, channels = 0;
+			unsigned char* pixels = nullptr;
+			StagedMesh mesh;
+		};
+
+		void run();
+		Upload upload_texture(Job& job);
+		Upload upload_mesh(Job& job);
+		void publish(Upload& upload);
+		void discard(Upload& upload);
+
+		GLFWwindow* mContext; // invisible window, current on the loader thread
+		std::thread mThread;
+		std::mutex mMutex; // guards mJobs, mUploads and mStop
+		std::condition_variable mJobAdded;
+		std::deque<Job> mJobs;
+		vector<Upload> mUploads; // done by the loader thread, taken by update()
+		bool mStop;
+
+		// main thread only
+		std::deque<Upload> mInFlight; // taken from mUploads, in fence order
+		vector<StagedMesh> mStagedMeshes;
+		size_t mPending;
+	};
+}
+
+#endif // !ASSET_LOADER_H
@@ -0,0 +1,119 @@
+#include <cstring>
+#include "bindless_textures.h"
+#include "uniform_blocks.h"
+
+bool ruya::BindlessTextures::sSupported = false;
+ruya::BindlessTextures::GetTextureHandleProc ruya::BindlessTextures::sGetTextureHandle = nullptr;
+ruya::BindlessTextures::TextureHandleResidencyProc ruya::BindlessTextures::sMakeTextureHandleResident = nullptr;
+ruya::BindlessTextures::TextureHandleResidencyProc ruya::BindlessTextures::sMakeTextureHandleNonResident = nullptr;
+
+/*
+* Detects ARB_bindless_texture and loads its entry points with the loader that was given
+* to glad. Has to be called once the context is current.
+*/
+void ruya::BindlessTextures::load(GLADloadproc loader)
+{
+	sSupported = false;
+
+	bool extension = false;
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount && !extension; i++)
+		extension = std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_bindless_texture") == 0;
+	if (!extension) return;
+
+	sGetTextureHandle = reinterpret_cast<GetTextureHandleProc>(loader("glGetTextureHandleARB"));
+	sMakeTextureHandleResident = reinterpret_cast<TextureHandleResidencyProc>(loader("glMakeTextureHandleResidentARB"));
+	sMakeTextureHandleNonResident = reinterpret_cast<TextureHandleResidencyProc>(loader("glMakeTextureHandleNonResidentARB"));
+	sSupported = sGetTextureHandle && sMakeTextureHandleResident && sMakeTextureHandleNonResident;
+}
+
+ruya::BindlessTextures::BindlessTextures()
+	: mHandleBuffer(StorageBindings::MATERIAL_TEXTURES), mHandlesChanged(false)
+{
+}
+
+ruya::BindlessTextures::~BindlessTextures()
+{
+	if (!sSupported) return;
+	for (auto& [id, entry] : mIndexes)
+	{
+		if (!entry.texture.expired())
+			sMakeTextureHandleNonResident(mHandles[entry.index]);
+	}
+}
+
+/*
+* Makes the texture resident and stores its handle at a free index or at the end, textures
+* that were added before keep their index.
+* @returns the index of the texture's handle, -1 for textures that failed to load or when
+*          bindless textures aren't supported
+*/
+int ruya::BindlessTextures::add(const shared_ptr<Texture>& texture)
+{
+	int found = find(*texture);
+	if (found >= 0) return found;
+	if (!sSupported || texture->ID() == 0) return -1;
+
+	auto stale = mIndexes.find(texture->ID()); // of a destroyed texture that had the same name
+	if (stale != mIndexes.end()) mFreeIndexes.push_back(stale->second.index);
+
+	GLuint64 handle = sGetTextureHandle(texture->ID());
+	sMakeTextureHandleResident(handle);
+	int index;
+	if (!mFreeIndexes.empty())
+	{
+		index = mFreeIndexes.back();
+		mFreeIndexes.pop_back();
+		mHandles[index] = handle;
+	}
+	else
+	{
+		index = static_cast<int>(mHandles.size());
+		mHandles.push_back(handle);
+	}
+	mHandlesChanged = true;
+	mIndexes[texture->ID()] = Entry{ index, texture };
+	return index;
+}
+
+/*
+* The index of the handle of a texture that has been added, -1 otherwise.
+*/
+int ruya::BindlessTextures::find(const Texture& texture) const
+{
+	auto it = mIndexes.find(texture.ID());
+	if (it == mIndexes.end()) return -1;
+	shared_ptr<Texture> added = it->second.texture.lock();
+	return added.get() == &texture ? it->second.index : -1;
+}
+
+/*
+* Frees the indexes of the textures that have been destroyed since they were added, their
+* handles were deleted with them.
+*/
+void ruya::BindlessTextures::collect()
+{
+	for (auto it = mIndexes.begin(); it != mIndexes.end();)
+	{
+		if (it->second.texture.expired())
+		{
+			mFreeIndexes.push_back(it->second.index);
+			it = mIndexes.erase(it);
+		}
+		else it++;
+	}
+}
+
+/*
+* Uploads the handles if textures were added and binds the handle buffer.
+*/
+void ruya::BindlessTextures::bind()
+{
+	if (mHandlesChanged)
+	{
+		mHandleBuffer.upload(mHandles);
+		mHandlesChanged = false;
+	}
+	mHandleBuffer.bind();
+}
@@ -0,0 +1,77 @@
+#ifndef BINDLESS_TEXTURES_H
+#define BINDLESS_TEXTURES_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "engine/render/storage_buffer.h"
+#include "engine/scene/texture.h"
+
+using std::shared_ptr;
+using std::weak_ptr;
+using std::unordered_map;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Material textures sampled through ARB_bindless_texture handles instead of texture units.
+	* Every texture is made resident once, by the first add(), and its 64-bit handle is stored
+	* in a storage buffer (StorageBindings::MATERIAL_TEXTURES). The shaders sample an object's
+	* texture with the index of its handle (InstanceData::textureLayer), nothing is bound per
+	* texture and no texture unit is used (see shaders/common/material_textures.glsl).
+	*	- the extension is detected at runtime by load(), without it supported() is false and
+	*	  the renderer falls back to TextureArrays
+	*	- glad is generated without the extension, its entry points are loaded by load()
+	*	- the handles stay resident until the BindlessTextures is destroyed or their texture
+	*	  is, deleting a texture deletes its handles. collect() frees the indexes of the
+	*	  destroyed textures so that new textures reuse them
+	*/
+	class BindlessTextures
+	{
+	public:
+		static void load(GLADloadproc loader);
+		static bool supported() { return sSupported; }
+
+		BindlessTextures();
+		~BindlessTextures();
+		BindlessTextures(const BindlessTextures&) = delete;
+		BindlessTextures& operator=(const BindlessTextures&) = delete;
+
+		int add(const shared_ptr<Texture>& texture);
+		int find(const Texture& texture) const;
+		void collect();
+		void bind();
+
+		size_t size() const { return mHandles.size(); }
+
+	private:
+		typedef GLuint64 (APIENTRYP GetTextureHandleProc)(GLuint texture);
+		typedef void (APIENTRYP TextureHandleResidencyProc)(GLuint64 handle);
+
+		static bool sSupported;
+		static GetTextureHandleProc sGetTextureHandle;
+		static TextureHandleResidencyProc sMakeTextureHandleResident;
+		static TextureHandleResidencyProc sMakeTextureHandleNonResident;
+
+		/*
+		* The texture is kept to tell a destroyed texture apart from a new one that got the
+		* same GL name.
+		*/
+		struct Entry
+		{
+			int index;
+			weak_ptr<Texture> texture;
+		};
+
+		vector<GLuint64> mHandles; // indexed by the shaders, the handles of free indexes are stale
+		vector<int> mFreeIndexes; // of destroyed textures
+		unordered_map<GLuint, Entry> mIndexes; // by Texture::ID()
+		StorageBuffer mHandleBuffer;
+		bool mHandlesChanged; // handles were added since the last upload
+	};
+}
+
+#endif // !BINDLESS_TEXTURES_H
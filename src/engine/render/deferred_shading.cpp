@@ -0,0 +1,151 @@
+#include <stdexcept>
+
+#include "deferred_shading.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "engine/scene/texture.h"
+
+ruya::DeferredShading::DeferredShading(const std::string& shaderDir)
+	: mGBufferShader((shaderDir + "/phong/object.vert").c_str(), (shaderDir + "/deferred/gbuffer.frag").c_str()),
+	  mFlatNormalsUniform(mGBufferShader.uniform<int>("flatNormals")),
+	  mLightingShader((shaderDir + "/deferred/tiled_lighting.comp").c_str()),
+	  mLightingAlbedoUniform(mLightingShader.uniform<int>("gbufferAlbedo")),
+	  mLightingSpecularUniform(mLightingShader.uniform<int>("gbufferSpecular")),
+	  mLightingNormalUniform(mLightingShader.uniform<int>("gbufferNormal")),
+	  mLightingDepthUniform(mLightingShader.uniform<int>("gbufferDepth")),
+	  mInverseViewProjectionUniform(mLightingShader.uniform<glm::mat4>("inverseViewProjection")),
+	  mTileLightCounts(StorageBindings::TILE_LIGHT_COUNTS),
+	  mCompositeShader((shaderDir + "/deferred/fullscreen.vert").c_str(), (shaderDir + "/deferred/composite.frag").c_str()),
+	  mCompositeAccumulationUniform(mCompositeShader.uniform<int>("lightAccumulation")),
+	  mCompositeDepthUniform(mCompositeShader.uniform<int>("gbufferDepth")),
+	  mEmptyVaoID(0), mFramebufferID(0),
+	  mAlbedoTexture(0), mSpecularTexture(0), mNormalTexture(0), mDepthTexture(0), mAccumulationTexture(0),
+	  mWidth(0), mHeight(0)
+{
+	glCreateVertexArrays(1, &mEmptyVaoID);
+	GpuResources::track(GpuResources::Type::VERTEX_ARRAY, mEmptyVaoID, 0);
+}
+
+ruya::DeferredShading::~DeferredShading()
+{
+	delete_targets();
+	GpuResources::release(GpuResources::Type::VERTEX_ARRAY, mEmptyVaoID);
+}
+
+/*
+* Binds and clears the G-buffer, the objects are then drawn with gbuffer_shader(). The
+* render targets are recreated when the size changed.
+*/
+void ruya::DeferredShading::begin(GLsizei width, GLsizei height, bool flatNormals)
+{
+	if (width != mWidth || height != mHeight)
+		create_targets(width, height);
+
+	GLState::bind_framebuffer(mFramebufferID);
+	GLState::depth_mask(true); // clears respect the write masks
+	GLState::color_mask(true);
+	const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat up[2] = { 0.0f, 1.0f }; // any valid normal, the pixel is background anyway
+	const GLfloat farDepth = 1.0f;
+	RUYA_GL(glClearNamedFramebufferfv(mFramebufferID, GL_COLOR, 0, black));
+	RUYA_GL(glClearNamedFramebufferfv(mFramebufferID, GL_COLOR, 1, black));
+	RUYA_GL(glClearNamedFramebufferfv(mFramebufferID, GL_COLOR, 2, up));
+	RUYA_GL(glClearNamedFramebufferfv(mFramebufferID, GL_DEPTH, 0, &farDepth));
+
+	mGBufferShader.use();
+	mGBufferShader.set(mFlatNormalsUniform, flatNormals ? 1 : 0);
+}
+
+/*
+* Lights the G-buffer and writes the result to the default framebuffer, with the depth of
+* the G-buffer so that what is drawn afterwards is still depth tested against the scene.
+* @pre the frame constants, the lighting constants and the lights must have been bound for
+*	   this frame, the depth mask must be enabled
+*/
+void ruya::DeferredShading::resolve(const glm::mat4& viewProjection)
+{
+	GLState::bind_framebuffer(0);
+
+	// the G-buffer is sampled on the units after the ones the texture slot manager uses
+	GLuint unit = Texture::get_num_texture_slots_fragment_shader();
+	GLState::bind_texture_unit(unit + 0, GL_TEXTURE_2D, mAlbedoTexture);
+	GLState::bind_texture_unit(unit + 1, GL_TEXTURE_2D, mSpecularTexture);
+	GLState::bind_texture_unit(unit + 2, GL_TEXTURE_2D, mNormalTexture);
+	GLState::bind_texture_unit(unit + 3, GL_TEXTURE_2D, mDepthTexture);
+	GLState::bind_texture_unit(unit + 4, GL_TEXTURE_2D, mAccumulationTexture);
+
+	mTileLightCounts.reserve(static_cast<GLsizeiptr>(tile_count()) * sizeof(GLuint));
+	mTileLightCounts.bind();
+	mLightingShader.use();
+	mLightingShader.set(mLightingAlbedoUniform, (int)unit + 0);
+	mLightingShader.set(mLightingSpecularUniform, (int)unit + 1);
+	mLightingShader.set(mLightingNormalUniform, (int)unit + 2);
+	mLightingShader.set(mLightingDepthUniform, (int)unit + 3);
+	mLightingShader.set(mInverseViewProjectionUniform, glm::inverse(viewProjection));
+	RUYA_GL(glBindImageTexture(0, mAccumulationTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F));
+	RUYA_GL(glDispatchCompute(tiles_x(), tiles_y(), 1));
+	RUYA_GL(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT));
+
+	mCompositeShader.use();
+	mCompositeShader.set(mCompositeAccumulationUniform, (int)unit + 4);
+	mCompositeShader.set(mCompositeDepthUniform, (int)unit + 3);
+	GLState::bind_vertex_array(mEmptyVaoID);
+	RUYA_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+}
+
+/*
+* Number of lights each tile was shaded with in the last resolve() (before dropping the
+* ones over MAX_TILE_LIGHTS), tiles are ordered by row, then column. Waits for the GPU to
+* finish (stalls the pipeline, meant for statistics and benchmarks).
+*/
+std::vector<GLuint> ruya::DeferredShading::read_tile_light_counts() const
+{
+	std::vector<GLuint> counts(tile_count());
+	if (counts.empty()) return counts;
+	glGetNamedBufferSubData(mTileLightCounts.ID(), 0, counts.size() * sizeof(GLuint), counts.data());
+	return counts;
+}
+
+void ruya::DeferredShading::create_targets(GLsizei width, GLsizei height)
+{
+	delete_targets();
+	mWidth = width;
+	mHeight = height;
+
+	auto create_texture = [this](GLuint& texture, GLenum format, size_t texelBytes)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, format, mWidth, mHeight);
+		GpuResources::track(GpuResources::Type::TEXTURE, texture, GpuResources::texture_bytes(mWidth, mHeight, 1, texelBytes, false));
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	};
+	create_texture(mAlbedoTexture, GL_RGBA8, 4);
+	create_texture(mSpecularTexture, GL_RGBA8, 4);
+	create_texture(mNormalTexture, GL_RG16_SNORM, 4);
+	create_texture(mDepthTexture, GL_DEPTH_COMPONENT32F, 4);
+	create_texture(mAccumulationTexture, GL_RGBA16F, 8);
+
+	glCreateFramebuffers(1, &mFramebufferID);
+	glNamedFramebufferTexture(mFramebufferID, GL_COLOR_ATTACHMENT0, mAlbedoTexture, 0);
+	glNamedFramebufferTexture(mFramebufferID, GL_COLOR_ATTACHMENT1, mSpecularTexture, 0);
+	glNamedFramebufferTexture(mFramebufferID, GL_COLOR_ATTACHMENT2, mNormalTexture, 0);
+	glNamedFramebufferTexture(mFramebufferID, GL_DEPTH_ATTACHMENT, mDepthTexture, 0);
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glNamedFramebufferDrawBuffers(mFramebufferID, 3, drawBuffers);
+	GpuResources::track(GpuResources::Type::FRAMEBUFFER, mFramebufferID, 0);
+	if (glCheckNamedFramebufferStatus(mFramebufferID, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("[DeferredShading] G-buffer framebuffer is incomplete");
+}
+
+void ruya::DeferredShading::delete_targets()
+{
+	GpuResources::release(GpuResources::Type::FRAMEBUFFER, mFramebufferID);
+	GpuResources::release(GpuResources::Type::TEXTURE, mAlbedoTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mSpecularTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mNormalTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mDepthTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mAccumulationTexture);
+	mFramebufferID = mAlbedoTexture = mSpecularTexture = mNormalTexture = mDepthTexture = mAccumulationTexture = 0;
+	mWidth = mHeight = 0;
+}
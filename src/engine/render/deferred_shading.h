@@ -0,0 +1,95 @@
+#ifndef DEFERRED_SHADING_H
+#define DEFERRED_SHADING_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "engine/render/shader.h"
+#include "engine/render/storage_buffer.h"
+#include "engine/render/uniform_blocks.h"
+
+namespace ruya
+{
+	/*
+	* Deferred shading: the Renderer draws the objects into a G-buffer that only holds their
+	* surface, the lights are applied afterwards once per visible pixel. Shading costs
+	* pixels x lights per tile, no matter how many objects overlap in a pixel.
+	*	- G-buffer (16 bytes per pixel): diffuse color with the ambient as a fraction of it
+	*	  (RGBA8), specular color (RGBA8), octahedral world space normal (RG16_SNORM) and
+	*	  depth (32-bit float), positions are reconstructed from the depth. The layout is
+	*	  described in shaders/deferred/gbuffer_data.glsl
+	*	- lighting: a compute pass over tiles of TILE_SIZE x TILE_SIZE pixels, each tile lists
+	*	  the lights that reach the depth range of its pixels (at most MAX_TILE_LIGHTS, any
+	*	  further lights are dropped) and shades its pixels with them into an RGBA16F light
+	*	  accumulation texture
+	*	- composite: a full screen pass writes the lit pixels and their depth to the
+	*	  framebuffer, the background keeps its clear color and the light sources are then
+	*	  drawn on top with depth testing as usual
+	*	- ShadingMode::FLAT takes the face normals from the screen space derivatives of the
+	*	  positions, without specular highlights (like the flat shader)
+	*
+	* The Renderer draws the G-buffer with gbuffer_shader() between begin() and resolve(). The
+	* textures follow the size of the window.
+	*
+	* Shaders: shaders/deferred/gbuffer.frag (after phong/object.vert), tiled_lighting.comp,
+	* fullscreen.vert and composite.frag
+	*/
+	class DeferredShading
+	{
+	public:
+		static constexpr GLuint TILE_SIZE = 16; // local size of tiled_lighting.comp
+		static constexpr GLuint MAX_TILE_LIGHTS = 256; // same as in tiled_lighting.comp
+
+		DeferredShading(const std::string& shaderDir); // the shaders folder, the G-buffer pass uses phong/object.vert
+		~DeferredShading();
+		DeferredShading(const DeferredShading&) = delete;
+		DeferredShading& operator=(const DeferredShading&) = delete;
+
+		Shader& gbuffer_shader() { return mGBufferShader; }
+		void begin(GLsizei width, GLsizei height, bool flatNormals);
+		void resolve(const glm::mat4& viewProjection);
+		std::vector<GLuint> read_tile_light_counts() const;
+
+		GLsizei width() const { return mWidth; }
+		GLsizei height() const { return mHeight; }
+		GLuint tile_count() const { return tiles_x() * tiles_y(); }
+
+	private:
+		void create_targets(GLsizei width, GLsizei height);
+		void delete_targets();
+		GLuint tiles_x() const { return (mWidth + TILE_SIZE - 1) / TILE_SIZE; }
+		GLuint tiles_y() const { return (mHeight + TILE_SIZE - 1) / TILE_SIZE; }
+
+		// G-buffer pass
+		Shader mGBufferShader;
+		UniformHandle<int> mFlatNormalsUniform;
+
+		// lighting pass
+		Shader mLightingShader;
+		UniformHandle<int> mLightingAlbedoUniform;
+		UniformHandle<int> mLightingSpecularUniform;
+		UniformHandle<int> mLightingNormalUniform;
+		UniformHandle<int> mLightingDepthUniform;
+		UniformHandle<glm::mat4> mInverseViewProjectionUniform;
+		StorageBuffer mTileLightCounts;
+
+		// composite pass
+		Shader mCompositeShader;
+		UniformHandle<int> mCompositeAccumulationUniform;
+		UniformHandle<int> mCompositeDepthUniform;
+		GLuint mEmptyVaoID; // the full screen triangle has no vertex data
+
+		// render targets, recreated when the size changes
+		GLuint mFramebufferID;
+		GLuint mAlbedoTexture;
+		GLuint mSpecularTexture;
+		GLuint mNormalTexture;
+		GLuint mDepthTexture;
+		GLuint mAccumulationTexture;
+		GLsizei mWidth, mHeight;
+	};
+}
+
+#endif // !DEFERRED_SHADING_H
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+#include "depth_pyramid.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "engine/scene/texture.h"
+
+namespace
+{
+	constexpr GLuint LOCAL_SIZE = 8; // depth_pyramid.comp: local_size_x = local_size_y = 8
+
+	GLuint group_count(GLsizei size) { return (size + LOCAL_SIZE - 1) / LOCAL_SIZE; }
+}
+
+ruya::DepthPyramid::DepthPyramid(const std::string& shaderPath)
+	: mShader(shaderPath.c_str()),
+	  mCopyDepthUniform(mShader.uniform<int>("copyDepth")), mDepthTextureUniform(mShader.uniform<int>("depthTexture")),
+	  mDepthTexture(0), mPyramidTexture(0), mWidth(0), mHeight(0), mLevels(0)
+{
+}
+
+ruya::DepthPyramid::~DepthPyramid()
+{
+	delete_textures();
+}
+
+/*
+* Copies the depth buffer of the current read framebuffer and builds the pyramid from it.
+* The textures are recreated when the size of the framebuffer changed.
+*/
+void ruya::DepthPyramid::build(GLsizei width, GLsizei height)
+{
+	if (width <= 0 || height <= 0) return;
+	if (width != mWidth || height != mHeight)
+		create_textures(width, height);
+
+	RUYA_GL(glCopyTextureSubImage2D(mDepthTexture, 0, 0, 0, 0, 0, mWidth, mHeight));
+
+	// the depth texture is sampled on the unit after the ones the texture slot manager uses
+	GLuint unit = Texture::get_num_texture_slots_fragment_shader();
+	GLState::bind_texture_unit(unit, GL_TEXTURE_2D, mDepthTexture);
+
+	mShader.use();
+	mShader.set(mDepthTextureUniform, (int)unit);
+	for (GLsizei level = 0; level < mLevels; level++)
+	{
+		GLsizei levelWidth = std::max(mWidth >> level, 1);
+		GLsizei levelHeight = std::max(mHeight >> level, 1);
+
+		// level 0 is copied from the depth texture, the source image is then unused
+		mShader.set(mCopyDepthUniform, level == 0 ? 1 : 0);
+		RUYA_GL(glBindImageTexture(0, mPyramidTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F));
+		RUYA_GL(glBindImageTexture(1, mPyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F));
+		RUYA_GL(glDispatchCompute(group_count(levelWidth), group_count(levelHeight), 1));
+		RUYA_GL(glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT));
+	}
+	RUYA_GL(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT));
+}
+
+/*
+* Binds the pyramid to the texture unit, its texels are read with texelFetch() (no filtering).
+*/
+void ruya::DepthPyramid::bind(GLuint textureUnit) const
+{
+	GLState::bind_texture_unit(textureUnit, GL_TEXTURE_2D, mPyramidTexture);
+}
+
+void ruya::DepthPyramid::create_textures(GLsizei width, GLsizei height)
+{
+	delete_textures();
+	mWidth = width;
+	mHeight = height;
+	mLevels = static_cast<GLsizei>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &mDepthTexture);
+	glTextureStorage2D(mDepthTexture, 1, GL_DEPTH_COMPONENT32F, mWidth, mHeight);
+	GpuResources::track(GpuResources::Type::TEXTURE, mDepthTexture, GpuResources::texture_bytes(mWidth, mHeight, 1, 4, false));
+	glTextureParameteri(mDepthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(mDepthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &mPyramidTexture);
+	glTextureStorage2D(mPyramidTexture, mLevels, GL_R32F, mWidth, mHeight);
+	GpuResources::track(GpuResources::Type::TEXTURE, mPyramidTexture, GpuResources::texture_bytes(mWidth, mHeight, 1, 4, true));
+	glTextureParameteri(mPyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(mPyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(mPyramidTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(mPyramidTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void ruya::DepthPyramid::delete_textures()
+{
+	GpuResources::release(GpuResources::Type::TEXTURE, mDepthTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mPyramidTexture);
+	mDepthTexture = mPyramidTexture = 0;
+	mWidth = mHeight = mLevels = 0;
+}
@@ -0,0 +1,52 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <memory>
+#include <string>
+#include <glad/glad.h>
+
+#include "engine/render/shader.h"
+
+namespace ruya
+{
+	/*
+	* Hierarchical depth buffer (Hi-Z) for occlusion culling: a single channel float texture
+	* with a full mip chain where level 0 is a copy of the depth buffer and every texel of
+	* a next level holds the farthest depth of the 2x2 (up to 3x3 for odd sizes) texels below
+	* it. A bounding rectangle that covers at most 2x2 texels of some level is occluded if 
+	* its nearest depth is farther than those texels.
+	*	- built by shaders/culling/depth_pyramid.comp, one dispatch per level
+	*	- the depth is copied from the current read framebuffer, so build() has to be called
+	*	  after the frame has been drawn
+	*/
+	class DepthPyramid
+	{
+	public:
+		DepthPyramid(const std::string& shaderPath);
+		~DepthPyramid();
+		DepthPyramid(const DepthPyramid&) = delete;
+		DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+		void build(GLsizei width, GLsizei height);
+		void bind(GLuint textureUnit) const;
+
+		GLuint texture() const { return mPyramidTexture; }
+		GLsizei width() const { return mWidth; }
+		GLsizei height() const { return mHeight; }
+		GLsizei levels() const { return mLevels; }
+		bool valid() const { return mPyramidTexture != 0; } // false until the first build()
+
+	private:
+		void create_textures(GLsizei width, GLsizei height);
+		void delete_textures();
+
+		Shader mShader;
+		UniformHandle<int> mCopyDepthUniform;
+		UniformHandle<int> mDepthTextureUniform;
+		GLuint mDepthTexture; // copy of the depth buffer
+		GLuint mPyramidTexture;
+		GLsizei mWidth, mHeight, mLevels;
+	};
+}
+
+#endif // !DEPTH_PYRAMID_H
@@ -0,0 +1,54 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+namespace ruya
+{
+	/*
+	* The six planes of a view frustum in world space, extracted from a view-projection
+	* matrix (Gribb & Hartmann). A plane is stored as (normal, d) with the normal pointing
+	* into the frustum and normalized, so dot(plane.xyz, p) + plane.w is the signed distance
+	* of point p to the plane.
+	*/
+	struct Frustum
+	{
+		enum Plane { LEFT, RIGHT, BOTTOM, TOP, FRONT, BACK, PLANE_COUNT }; // FRONT = near plane, BACK = far plane
+
+		glm::vec4 planes[PLANE_COUNT];
+
+		static Frustum from_matrix(const glm::mat4& viewProjection)
+		{
+			// rows of the matrix (glm is column major)
+			glm::vec4 row[4];
+			for (int i = 0; i < 4; i++)
+				row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+			Frustum frustum;
+			frustum.planes[LEFT] = row[3] + row[0];
+			frustum.planes[RIGHT] = row[3] - row[0];
+			frustum.planes[BOTTOM] = row[3] + row[1];
+			frustum.planes[TOP] = row[3] - row[1];
+			frustum.planes[FRONT] = row[3] + row[2];
+			frustum.planes[BACK] = row[3] - row[2];
+			for (glm::vec4& plane : frustum.planes)
+				plane /= glm::length(glm::vec3(plane));
+			return frustum;
+		}
+
+		/*
+		* false if the sphere lies completely outside of one of the planes.
+		*/
+		bool intersects_sphere(const glm::vec3& center, float radius) const
+		{
+			for (const glm::vec4& plane : planes)
+			{
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+					return false;
+			}
+			return true;
+		}
+	};
+}
+
+#endif // !FRUSTUM_H
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include "frustum_culler.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define RUYA_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define RUYA_CULL_SSE
+#endif
+
+void ruya::FrustumCuller::clear()
+{
+	for (vector<float>* component : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ, &mRadius })
+		component->clear();
+}
+
+void ruya::FrustumCuller::reserve(size_t count)
+{
+	for (vector<float>* component : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ, &mRadius })
+		component->reserve(count);
+}
+
+/*
+* Transforms the local bounds of a mesh to world space and appends them.
+*	- the box is the axis aligned box around the transformed box (Arvo): its half extent on
+*	  world axis i is the sum of the local half extents weighted by |model[j][i]|
+*	- the sphere radius is scaled by the largest scale of the model matrix
+* @pre bounds must be up to date, see Mesh::update_bounds()
+*/
+void ruya::FrustumCuller::add(const glm::mat4& model, const MeshBounds& bounds)
+{
+	glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+	glm::vec3 halfExtent = (bounds.max - bounds.min) * 0.5f;
+	glm::mat3 absModel(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+	glm::vec3 extent = absModel * halfExtent;
+	float scale = std::sqrt(std::max({ glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+									   glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+									   glm::dot(glm::vec3(model[2]), glm::vec3(model[2])) }));
+
+	mCenterX.push_back(center.x);	mCenterY.push_back(center.y);	mCenterZ.push_back(center.z);
+	mExtentX.push_back(extent.x);	mExtentY.push_back(extent.y);	mExtentZ.push_back(extent.z);
+	mRadius.push_back(bounds.radius * scale);
+}
+
+/*
+* Sets visible[i] to 1 for the objects that intersect the frustum and to 0 for the others,
+* in the order they were added.
+* @returns the number of visible objects
+*/
+size_t ruya::FrustumCuller::cull(const Frustum& frustum, vector<uint8_t>& visible) const
+{
+	const size_t count = size();
+	visible.resize(count);
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#if defined(RUYA_CULL_AVX)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&mCenterX[i]), cy = _mm256_loadu_ps(&mCenterY[i]), cz = _mm256_loadu_ps(&mCenterZ[i]);
+		__m256 ex = _mm256_loadu_ps(&mExtentX[i]), ey = _mm256_loadu_ps(&mExtentY[i]), ez = _mm256_loadu_ps(&mExtentZ[i]);
+		__m256 radius = _mm256_loadu_ps(&mRadius[i]);
+		__m256 outside = _mm256_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), cx), _mm256_mul_ps(_mm256_set1_ps(plane.y), cy)),
+											_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), cz), _mm256_set1_ps(plane.w)));
+			__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex), _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey)),
+										 _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+			reach = _mm256_min_ps(reach, radius);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), reach), _CMP_LT_OQ));
+		}
+		int outsideMask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			visible[i + lane] = ((outsideMask >> lane) & 1) ^ 1;
+			visibleCount += visible[i + lane];
+		}
+	}
+#elif defined(RUYA_CULL_SSE)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&mCenterX[i]), cy = _mm_loadu_ps(&mCenterY[i]), cz = _mm_loadu_ps(&mCenterZ[i]);
+		__m128 ex = _mm_loadu_ps(&mExtentX[i]), ey = _mm_loadu_ps(&mExtentY[i]), ez = _mm_loadu_ps(&mExtentZ[i]);
+		__m128 radius = _mm_loadu_ps(&mRadius[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+										 _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex), _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey)),
+									  _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+			reach = _mm_min_ps(reach, radius);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), reach)));
+		}
+		int outsideMask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			visible[i + lane] = ((outsideMask >> lane) & 1) ^ 1;
+			visibleCount += visible[i + lane];
+		}
+	}
+#endif
+
+	// objects that don't fill a whole register
+	return visibleCount + cull_range(frustum, visible.data(), i, count);
+}
+
+/*
+* Same result as cull() without SIMD, one object at a time.
+*/
+size_t ruya::FrustumCuller::cull_scalar(const Frustum& frustum, vector<uint8_t>& visible) const
+{
+	visible.resize(size());
+	return cull_range(frustum, visible.data(), 0, size());
+}
+
+const char* ruya::FrustumCuller::instruction_set()
+{
+#if defined(RUYA_CULL_AVX)
+	return "AVX";
+#elif defined(RUYA_CULL_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+/*
+* Culls the objects [first, last) one by one.
+*/
+size_t ruya::FrustumCuller::cull_range(const Frustum& frustum, uint8_t* visible, size_t first, size_t last) const
+{
+	size_t visibleCount = 0;
+	for (size_t i = first; i < last; i++)
+	{
+		bool outside = false;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			float distance = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+			float reach = std::abs(plane.x) * mExtentX[i] + std::abs(plane.y) * mExtentY[i] + std::abs(plane.z) * mExtentZ[i];
+			outside |= distance < -std::min(reach, mRadius[i]);
+		}
+		visible[i] = outside ? 0 : 1;
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
@@ -0,0 +1,45 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "engine/render/frustum.h"
+#include "engine/scene/mesh.h"
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Tests the world space bounds of many objects against a frustum at once. The bounds are
+	* kept as structure of arrays (one array per component) so that the test runs on 8 (AVX)
+	* or 4 (SSE) objects per instruction.
+	*	- an object is culled if it lies outside of one of the planes, with the distance it
+	*	  reaches towards a plane being the smallest of its box and its sphere
+	*	- add() the objects of a frame after clear(), then cull()
+	*/
+	class FrustumCuller
+	{
+	public:
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::mat4& model, const MeshBounds& bounds);
+		size_t cull(const Frustum& frustum, vector<uint8_t>& visible) const;
+		size_t cull_scalar(const Frustum& frustum, vector<uint8_t>& visible) const;
+
+		size_t size() const { return mRadius.size(); }
+		static const char* instruction_set(); // used by cull()
+
+	private:
+		size_t cull_range(const Frustum& frustum, uint8_t* visible, size_t first, size_t last) const;
+
+		// world space bounding box (center, half extents) and sphere (same center, radius)
+		vector<float> mCenterX, mCenterY, mCenterZ;
+		vector<float> mExtentX, mExtentY, mExtentZ;
+		vector<float> mRadius;
+	};
+}
+
+#endif // !FRUSTUM_CULLER_H
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "geometry_buffer.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+namespace
+{
+	/*
+	* Replaces buffer by a new buffer of newSize bytes that starts with the first usedSize
+	* bytes of the old one.
+	*/
+	void grow_buffer(GLuint& buffer, GLsizeiptr usedSize, GLsizeiptr newSize)
+	{
+		GLuint newBuffer;
+		glCreateBuffers(1, &newBuffer);
+		glNamedBufferStorage(newBuffer, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		ruya::GpuResources::track(ruya::GpuResources::Type::BUFFER, newBuffer, newSize);
+		if (buffer != 0 && usedSize > 0)
+			glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, usedSize);
+		ruya::GpuResources::release(ruya::GpuResources::Type::BUFFER, buffer);
+		buffer = newBuffer;
+	}
+
+	/*
+	* Takes count elements from the first free block that is large enough.
+	* @returns false if no block is
+	*/
+	template <class Block>
+	bool take_block(std::vector<Block>& freeBlocks, GLuint count, GLuint& first)
+	{
+		for (auto it = freeBlocks.begin(); it != freeBlocks.end(); it++)
+		{
+			if (it->count < count) continue;
+			first = it->first;
+			it->first += count;
+			it->count -= count;
+			if (it->count == 0) freeBlocks.erase(it);
+			return true;
+		}
+		return false;
+	}
+
+	/*
+	* Returns a block to the sorted free list, merging it with its neighbours.
+	*/
+	template <class Block>
+	void give_block(std::vector<Block>& freeBlocks, Block block)
+	{
+		if (block.count == 0) return;
+		auto it = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), block, [](const Block& a, const Block& b) { return a.first < b.first; });
+		it = freeBlocks.insert(it, block);
+		if (it + 1 != freeBlocks.end() && it->first + it->count == (it + 1)->first)
+		{
+			it->count += (it + 1)->count;
+			freeBlocks.erase(it + 1);
+		}
+		if (it != freeBlocks.begin() && (it - 1)->first + (it - 1)->count == it->first)
+		{
+			(it - 1)->count += it->count;
+			freeBlocks.erase(it);
+		}
+	}
+
+	/*
+	* Box of the bounds of a mesh, drawn in its place while the mesh is being staged.
+	*/
+	std::shared_ptr<ruya::Mesh> bounds_box(const ruya::MeshBounds& bounds)
+	{
+		std::shared_ptr<ruya::Mesh> box = std::make_shared<ruya::Mesh>();
+		for (int i = 0; i < 8; i++) // bit 0, 1, 2 of i: max x, y, z
+			box->vertices.push_back(glm::vec3(i & 1 ? bounds.max.x : bounds.min.x, i & 2 ? bounds.max.y : bounds.min.y, i & 4 ? bounds.max.z : bounds.min.z));
+		box->faces = {
+			uvec3(0, 4, 6), uvec3(0, 6, 2), uvec3(1, 3, 7), uvec3(1, 7, 5), // -x, +x
+			uvec3(0, 1, 5), uvec3(0, 5, 4), uvec3(2, 6, 7), uvec3(2, 7, 3), // -y, +y
+			uvec3(0, 2, 3), uvec3(0, 3, 1), uvec3(4, 5, 7), uvec3(4, 7, 6) }; // -z, +z
+		box->update_vertex_normals();
+		box->update_bounds();
+		return box;
+	}
+}
+
+ruya::GeometryBuffer::GeometryBuffer(const VertexLayout& layout)
+	: mLayout(layout), mVaoID(0), mPositionVaoID(0), mVertexBuffers{}, mEBO(0),
+	  mVertexCount(0), mVertexCapacity(0), mIndexSlots(0), mIndexSlotCapacity(0), mMeshletBuffer(0), mMeshletCount(0), mMeshletCapacity(0),
+	  mNextMeshIndex(0), mLoader(nullptr),
+	  mFrame(0), mBudget(DEFAULT_BUDGET), mEvictionAge(DEFAULT_EVICTION_AGE), mMeshBytes(0), mEvictedMeshes(0)
+{
+	glCreateVertexArrays(1, &mVaoID);
+	GpuResources::track(GpuResources::Type::VERTEX_ARRAY, mVaoID, 0);
+	glCreateVertexArrays(1, &mPositionVaoID);
+	GpuResources::track(GpuResources::Type::VERTEX_ARRAY, mPositionVaoID, 0);
+	create_buffers();
+}
+
+ruya::GeometryBuffer::~GeometryBuffer()
+{
+	GpuResources::release(GpuResources::Type::VERTEX_ARRAY, mVaoID);
+	GpuResources::release(GpuResources::Type::VERTEX_ARRAY, mPositionVaoID);
+	for (GLuint buffer : mVertexBuffers)
+		GpuResources::release(GpuResources::Type::BUFFER, buffer);
+	GpuResources::release(GpuResources::Type::BUFFER, mEBO);
+	GpuResources::release(GpuResources::Type::BUFFER, mMeshletBuffer);
+}
+
+/*
+* Returns where the data of the mesh is stored, the mesh is uploaded first if this is the
+* first time it is requested (or if it was evicted). Marks the mesh as used this frame.
+* With a loader, the range of the mesh's placeholder is returned until it has been staged.
+*/
+const ruya::GeometryBuffer::MeshRange& ruya::GeometryBuffer::mesh_range(const shared_ptr<Mesh>& mesh)
+{
+	auto it = mMeshRanges.find(mesh);
+	if (it != mMeshRanges.end())
+	{
+		it->second.lastUsedFrame = mFrame;
+		return it->second;
+	}
+	return mLoader ? placeholder_range(mesh) : add_mesh(mesh);
+}
+
+/*
+* Range of the placeholder of a mesh that is being staged, the first request hands the mesh
+* to the loader. Placeholders are small and uploaded right away.
+*/
+const ruya::GeometryBuffer::MeshRange& ruya::GeometryBuffer::placeholder_range(const shared_ptr<Mesh>& mesh)
+{
+	auto [placeholder, inserted] = mPlaceholders.try_emplace(mesh);
+	if (inserted)
+	{
+		placeholder->second = bounds_box(mesh->bounds);
+		mLoader->stage_mesh(mesh, mLayout);
+	}
+
+	auto it = mMeshRanges.find(placeholder->second);
+	if (it != mMeshRanges.end())
+	{
+		it->second.lastUsedFrame = mFrame;
+		return it->second;
+	}
+	return add_mesh(placeholder->second);
+}
+
+/*
+* Starts a frame: frees the ranges of evicted meshes the GPU is done with, then evicts the
+* meshes that weren't used for more than the eviction age, see the class description.
+* @pre called before any mesh_range() of the frame
+*/
+void ruya::GeometryBuffer::begin_frame()
+{
+	mFrame++;
+	mEvictedMeshes = 0;
+
+	auto done = std::partition(mEvictions.begin(), mEvictions.end(), [](const Eviction& eviction) { return eviction.frame > GpuResources::completed_frame(); });
+	for (auto it = done; it != mEvictions.end(); it++)
+	{
+		give_block(mFreeVertices, it->vertices);
+		give_block(mFreeIndexes, it->indexes);
+		give_block(mFreeMeshlets, it->meshlets);
+		mFreeMeshIndexes.push_back(it->meshIndex);
+	}
+	mEvictions.erase(done, mEvictions.end());
+
+	if (mLoader)
+	{
+		for (const AssetLoader::StagedMesh& staged : mLoader->take_staged_meshes())
+			add_staged_mesh(staged);
+	}
+
+	// unreferenced meshes can't be drawn anymore, the others are only evicted over budget
+	vector<unordered_map<shared_ptr<Mesh>, MeshRange>::iterator> candidates;
+	for (auto it = mMeshRanges.begin(); it != mMeshRanges.end();)
+	{
+		auto current = it++;
+		if (mFrame - current->second.lastUsedFrame <= mEvictionAge) continue;
+		if (current->first.use_count() == 1) evict(current);
+		else if (mBudget > 0) candidates.push_back(current);
+	}
+	if (mBudget == 0 || mMeshBytes <= mBudget) return;
+
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a->second.lastUsedFrame < b->second.lastUsedFrame; });
+	for (size_t i = 0; i < candidates.size() && mMeshBytes > mBudget; i++)
+		evict(candidates[i]);
+}
+
+/*
+* Binds the VAO, the element buffer is part of its state.
+*/
+void ruya::GeometryBuffer::bind() const
+{
+	GLState::bind_vertex_array(mVaoID);
+}
+
+/*
+* Binds the VAO that only fetches the positions (VertexLayout::POSITION_ATTRIB), for shaders
+* that only declare the position attribute.
+*/
+void ruya::GeometryBuffer::bind_positions() const
+{
+	GLState::bind_vertex_array(mPositionVaoID);
+}
+
+/*
+* Binds the meshlets of all meshes to StorageBindings::MESHLETS, the meshlets of a mesh are
+* [MeshRange::firstMeshlet, firstMeshlet + meshletCount).
+*/
+void ruya::GeometryBuffer::bind_meshlets() const
+{
+	GLState::bind_buffer_base(GL_SHADER_STORAGE_BUFFER, StorageBindings::MESHLETS, mMeshletBuffer);
+}
+
+/*
+* Binds the buffer of each stream of the vertex layout to StorageBindings::VERTEX_STREAMS +
+* stream and the element buffer to VERTEX_INDEXES. The shaders read them as arrays of 32-bit
+* words: vertex v of a stream starts at word v * stride / 4, 16-bit indexes are packed two
+* per word (the first one in the low half). The bindings of streams the layout doesn't use
+* get the first stream, so that every block of the shaders has a buffer.
+*/
+void ruya::GeometryBuffer::bind_storage() const
+{
+	for (GLuint stream = 0; stream < VertexLayout::ATTRIB_COUNT; stream++)
+	{
+		GLuint buffer = mVertexBuffers[stream < mLayout.stream_count() ? stream : 0];
+		GLState::bind_buffer_base(GL_SHADER_STORAGE_BUFFER, StorageBindings::VERTEX_STREAMS + stream, buffer);
+	}
+	GLState::bind_buffer_base(GL_SHADER_STORAGE_BUFFER, StorageBindings::VERTEX_INDEXES, mEBO);
+}
+
+/*
+* Switches to another vertex layout: all meshes are dropped and uploaded again in the new
+* layout the next time they are drawn, the old buffers are released. Meshes that were
+* staged in the old layout are converted when they arrive.
+*/
+void ruya::GeometryBuffer::set_layout(const VertexLayout& layout)
+{
+	if (layout == mLayout) return;
+
+	for (GLuint& buffer : mVertexBuffers)
+		GpuResources::release(GpuResources::Type::BUFFER, buffer);
+	GpuResources::release(GpuResources::Type::BUFFER, mEBO);
+	GpuResources::release(GpuResources::Type::BUFFER, mMeshletBuffer);
+	std::fill(std::begin(mVertexBuffers), std::end(mVertexBuffers), 0);
+	mEBO = mMeshletBuffer = 0;
+	mVertexCount = mVertexCapacity = 0;
+	mIndexSlots = mIndexSlotCapacity = 0;
+	mMeshletCount = mMeshletCapacity = 0;
+	mMeshRanges.clear();
+	mFreeVertices.clear();
+	mFreeIndexes.clear();
+	mFreeMeshlets.clear();
+	mFreeMeshIndexes.clear();
+	mNextMeshIndex = 0;
+	mEvictions.clear(); // their ranges were in the released buffers
+	mMeshBytes = 0;
+
+	mLayout = layout;
+	create_buffers();
+}
+
+/*
+* Converts the mesh to the layout and writes it to free ranges of the buffers, see allocate().
+*/
+const ruya::GeometryBuffer::MeshRange& ruya::GeometryBuffer::add_mesh(const shared_ptr<Mesh>& mesh)
+{
+	VertexLayout::EncodedMesh encoded = mLayout.encode(*mesh);
+	MeshRange& range = allocate(mesh, encoded.vertexCount, encoded.indexCount, encoded.indexType, static_cast<GLuint>(encoded.meshlets.size()));
+	range.dequantization = encoded.dequantization;
+	for (GLuint s = 0; s < mLayout.stream_count(); s++)
+		glNamedBufferSubData(mVertexBuffers[s], static_cast<GLintptr>(range.baseVertex) * mLayout.stride(s), encoded.streams[s].size(), encoded.streams[s].data());
+	glNamedBufferSubData(mEBO, static_cast<GLintptr>(range.firstIndex) * VertexLayout::index_size(range.indexType), encoded.indexes.size(), encoded.indexes.data());
+	if (range.meshletCount > 0)
+		glNamedBufferSubData(mMeshletBuffer, static_cast<GLintptr>(range.firstMeshlet) * sizeof(MeshletData), encoded.meshlets.size() * sizeof(MeshletData), encoded.meshlets.data());
+	return range;
+}
+
+/*
+* Copies a mesh the loader has staged into free ranges of the buffers, in place of its
+* placeholder, and releases the staging buffer. The data doesn't go through the CPU, unless
+* it was staged in another layout than the current one.
+*/
+void ruya::GeometryBuffer::add_staged_mesh(const AssetLoader::StagedMesh& staged)
+{
+	auto placeholder = mPlaceholders.find(staged.mesh);
+	if (placeholder != mPlaceholders.end())
+	{
+		auto it = mMeshRanges.find(placeholder->second);
+		if (it != mMeshRanges.end()) evict(it);
+		mPlaceholders.erase(placeholder);
+	}
+
+	if (mMeshRanges.find(staged.mesh) == mMeshRanges.end())
+	{
+		if (staged.layout == mLayout)
+		{
+			MeshRange& range = allocate(staged.mesh, staged.vertexCount, staged.indexCount, staged.indexType, staged.meshletCount);
+			range.dequantization = staged.dequantization;
+			GLintptr offset = 0;
+			for (GLuint s = 0; s < mLayout.stream_count(); s++)
+			{
+				GLsizeiptr size = static_cast<GLsizeiptr>(staged.vertexCount) * mLayout.stride(s);
+				glCopyNamedBufferSubData(staged.buffer, mVertexBuffers[s], offset, static_cast<GLintptr>(range.baseVertex) * mLayout.stride(s), size);
+				offset += size;
+			}
+			GLuint indexSize = VertexLayout::index_size(range.indexType);
+			glCopyNamedBufferSubData(staged.buffer, mEBO, offset, static_cast<GLintptr>(range.firstIndex) * indexSize, static_cast<GLsizeiptr>(staged.indexCount) * indexSize);
+			offset += static_cast<GLsizeiptr>(staged.indexCount) * indexSize;
+			if (range.meshletCount > 0)
+				glCopyNamedBufferSubData(staged.buffer, mMeshletBuffer, offset, static_cast<GLintptr>(range.firstMeshlet) * sizeof(MeshletData), static_cast<GLsizeiptr>(range.meshletCount) * sizeof(MeshletData));
+		}
+		else
+		{
+			add_mesh(staged.mesh);
+		}
+	}
+	GpuResources::release(GpuResources::Type::BUFFER, staged.buffer);
+}
+
+/*
+* Takes ranges for the vertices, indexes and meshlets of a mesh from the free lists, or
+* appends them and grows the buffers if necessary. The caller writes the data and sets the
+* dequantization.
+*/
+ruya::GeometryBuffer::MeshRange& ruya::GeometryBuffer::allocate(const shared_ptr<Mesh>& mesh, GLuint vertexCount, GLuint indexCount, GLenum indexType, GLuint meshletCount)
+{
+	MeshRange range;
+	range.vertexCount = vertexCount;
+	range.indexCount = indexCount;
+	range.indexType = indexType;
+	range.meshletCount = meshletCount;
+	range.lastUsedFrame = mFrame;
+	if (!mFreeMeshIndexes.empty())
+	{
+		range.meshIndex = mFreeMeshIndexes.back();
+		mFreeMeshIndexes.pop_back();
+	}
+	else
+	{
+		range.meshIndex = mNextMeshIndex++;
+	}
+
+	// index ranges are rounded up to an even number of slots, so that every range starts
+	// 4-byte aligned and 32-bit indexes can go anywhere
+	GLuint slotCount = index_block(range).count;
+	GLuint baseVertex, firstSlot, firstMeshlet;
+	bool vertexBlock = take_block(mFreeVertices, range.vertexCount, baseVertex);
+	bool indexBlock = take_block(mFreeIndexes, slotCount, firstSlot);
+	bool meshletBlock = take_block(mFreeMeshlets, range.meshletCount, firstMeshlet);
+	GLuint vertexEnd = vertexBlock ? mVertexCount : mVertexCount + range.vertexCount;
+	GLuint slotEnd = indexBlock ? mIndexSlots : mIndexSlots + slotCount;
+	GLuint meshletEnd = meshletBlock ? mMeshletCount : mMeshletCount + range.meshletCount;
+	range.baseVertex = vertexBlock ? baseVertex : mVertexCount;
+	range.firstIndex = (indexBlock ? firstSlot : mIndexSlots) / (VertexLayout::index_size(indexType) / 2);
+	range.firstMeshlet = meshletBlock ? firstMeshlet : mMeshletCount;
+
+	GLuint vertexCapacity = mVertexCapacity, slotCapacity = mIndexSlotCapacity, meshletCapacity = mMeshletCapacity;
+	while (vertexCapacity < vertexEnd) vertexCapacity *= 2;
+	while (slotCapacity < slotEnd) slotCapacity *= 2;
+	while (meshletCapacity < meshletEnd) meshletCapacity *= 2;
+	reserve(vertexCapacity, slotCapacity, meshletCapacity);
+
+	mVertexCount = vertexEnd;
+	mIndexSlots = slotEnd;
+	mMeshletCount = meshletEnd;
+	mMeshBytes += mesh_bytes(range);
+	return mMeshRanges[mesh] = range;
+}
+
+/*
+* Drops the mesh, its ranges are freed once the GPU can no longer be reading them.
+*/
+void ruya::GeometryBuffer::evict(unordered_map<shared_ptr<Mesh>, MeshRange>::iterator it)
+{
+	const MeshRange& range = it->second;
+	Block vertices{ static_cast<GLuint>(range.baseVertex), range.vertexCount };
+	Block meshlets{ range.firstMeshlet, range.meshletCount };
+	mEvictions.push_back(Eviction{ GpuResources::frame(), vertices, index_block(range), meshlets, range.meshIndex });
+	mMeshBytes -= mesh_bytes(range);
+	mMeshRanges.erase(it);
+	mEvictedMeshes++;
+}
+
+size_t ruya::GeometryBuffer::capacity_bytes() const
+{
+	return static_cast<size_t>(mVertexCapacity) * mLayout.vertex_size() + static_cast<size_t>(mIndexSlotCapacity) * 2
+		+ static_cast<size_t>(mMeshletCapacity) * sizeof(MeshletData);
+}
+
+size_t ruya::GeometryBuffer::mesh_bytes(const MeshRange& range) const
+{
+	return static_cast<size_t>(range.vertexCount) * mLayout.vertex_size() + static_cast<size_t>(range.indexCount) * VertexLayout::index_size(range.indexType)
+		+ static_cast<size_t>(range.meshletCount) * sizeof(MeshletData);
+}
+
+/*
+* The index slots of the range, see allocate().
+*/
+ruya::GeometryBuffer::Block ruya::GeometryBuffer::index_block(const MeshRange& range)
+{
+	GLuint slotsPerIndex = VertexLayout::index_size(range.indexType) / 2;
+	return Block{ range.firstIndex * slotsPerIndex, (range.indexCount * slotsPerIndex + 1) & ~1u };
+}
+
+/*
+* Sets up the VAOs for the layout and creates the initial buffers.
+*/
+void ruya::GeometryBuffer::create_buffers()
+{
+	mLayout.set_formats(mVaoID);
+	mLayout.set_formats(mPositionVaoID, 1);
+	reserve(1 << 16, 1 << 19, 1 << 10);
+}
+
+/*
+* Makes sure the buffers can hold at least the given number of vertices, index slots and
+* meshlets, the stored data is copied to the new buffers.
+*/
+void ruya::GeometryBuffer::reserve(GLuint vertexCapacity, GLuint indexSlotCapacity, GLuint meshletCapacity)
+{
+	if (vertexCapacity > mVertexCapacity)
+	{
+		for (GLuint s = 0; s < mLayout.stream_count(); s++)
+			grow_buffer(mVertexBuffers[s], static_cast<GLsizeiptr>(mVertexCount) * mLayout.stride(s), static_cast<GLsizeiptr>(vertexCapacity) * mLayout.stride(s));
+		mVertexCapacity = vertexCapacity;
+	}
+	if (indexSlotCapacity > mIndexSlotCapacity)
+	{
+		grow_buffer(mEBO, static_cast<GLsizeiptr>(mIndexSlots) * 2, static_cast<GLsizeiptr>(indexSlotCapacity) * 2);
+		mIndexSlotCapacity = indexSlotCapacity;
+	}
+	if (meshletCapacity > mMeshletCapacity)
+	{
+		grow_buffer(mMeshletBuffer, static_cast<GLsizeiptr>(mMeshletCount) * sizeof(MeshletData), static_cast<GLsizeiptr>(meshletCapacity) * sizeof(MeshletData));
+		mMeshletCapacity = meshletCapacity;
+	}
+	attach_buffers();
+}
+
+/*
+* Points the VAOs to the current buffers, needed each time a buffer has been replaced.
+* Bindings the layout doesn't use are cleared.
+*/
+void ruya::GeometryBuffer::attach_buffers()
+{
+	for (GLuint vao : { mVaoID, mPositionVaoID })
+	{
+		for (GLuint s = 0; s < VertexLayout::ATTRIB_COUNT; s++)
+			glVertexArrayVertexBuffer(vao, s, mVertexBuffers[s], 0, s < mLayout.stream_count() ? mLayout.stride(s) : 0);
+		glVertexArrayElementBuffer(vao, mEBO);
+	}
+}
+
+/*
+* Draw data of a draw command of the mesh.
+*/
+ruya::DrawData ruya::GeometryBuffer::MeshRange::draw_data(GLuint firstInstance) const
+{
+	DrawData draw{};
+	draw.firstInstance = firstInstance;
+	draw.positionScale = dequantization.positionScale;
+	draw.positionOffset = dequantization.positionOffset;
+	draw.texCoordTransform = dequantization.texCoordTransform;
+	return draw;
+}
@@ -0,0 +1,171 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "engine/scene/mesh.h"
+#include "engine/render/asset_loader.h"
+#include "engine/render/uniform_blocks.h"
+#include "engine/render/vertex_layout.h"
+
+using std::shared_ptr;
+using std::unordered_map;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Holds the vertex and index data of all meshes in one set of buffers with a single VAO,
+	* so that meshes can be drawn with multi-draw (indirect) calls without switching buffers.
+	*	- the vertices are stored in the VertexLayout of the buffer: one buffer per stream
+	*	  (per attribute, or one for interleaved layouts), the vertex attribute indexes are
+	*	  the ones the shaders declare with layout(location = ..)
+	*	- indexes are stored relative to the first vertex of their mesh, draw calls pass the
+	*	  MeshRange::baseVertex and MeshRange::firstIndex of the mesh. Meshes with 16-bit and
+	*	  32-bit indexes share the element buffer, a draw call only covers meshes of one
+	*	  MeshRange::indexType
+	*	- a mesh is added the first time its range is requested, in the first free range
+	*	  that fits or at the end. The buffers grow (double) when they are full, so existing
+	*	  ranges stay valid
+	*	- a second VAO over the same buffers only fetches the positions, for passes that
+	*	  don't need the other attributes (bind_positions())
+	*	- the meshlets of the meshes (MeshletData) are stored the same way in a storage
+	*	  buffer, see bind_meshlets() and MeshletCulling
+	*	- bind_storage() binds the vertex and index buffers as storage buffers, for passes
+	*	  that fetch the vertices of a triangle themselves (VisibilityBuffer)
+	*
+	* Eviction: the buffer holds a reference to every mesh it stores. begin_frame() drops the
+	* meshes whose range hasn't been requested for more than the eviction age (in frames):
+	* meshes nobody else references anymore always, the others least recently used first
+	* while the meshes take up more than the budget. A dropped mesh is uploaded again when 
+	* it is drawn again. Its ranges are reused once GpuResources tells the GPU has finished
+	* the frames that might have drawn it. The buffers never shrink, the budget keeps them
+	* from growing.
+	*
+	* Streaming: with an AssetLoader (set_loader()) a new mesh isn't uploaded by the
+	* mesh_range() that requests it. The loader stages it on its thread, until begin_frame()
+	* copies the staged data into the buffers (on the GPU) mesh_range() returns the range of
+	* a placeholder: a box of the mesh's bounds.
+	*/
+	class GeometryBuffer
+	{
+	public:
+		/*
+		* Where the data of a mesh is stored in the shared buffers.
+		*/
+		struct MeshRange
+		{
+			GLint baseVertex = 0;
+			GLuint firstIndex = 0; // in indexes of indexType
+			GLuint indexCount = 0;
+			GLuint vertexCount = 0;
+			GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, see VertexLayout::shortIndexes
+			GLuint firstMeshlet = 0; // in the meshlet buffer
+			GLuint meshletCount = 0;
+			GLuint meshIndex = 0; // identifies the mesh while it is stored, reused after an eviction
+			uint64_t lastUsedFrame = 0; // see begin_frame()
+			VertexLayout::Dequantization dequantization;
+
+			DrawData draw_data(GLuint firstInstance) const;
+		};
+
+		static constexpr size_t DEFAULT_BUDGET = size_t(256) << 20; // bytes
+		static constexpr uint64_t DEFAULT_EVICTION_AGE = 300; // frames
+
+		GeometryBuffer(const VertexLayout& layout = VertexLayout());
+		~GeometryBuffer();
+		GeometryBuffer(const GeometryBuffer&) = delete;
+		GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+
+		const MeshRange& mesh_range(const shared_ptr<Mesh>& mesh);
+		void begin_frame();
+		void bind() const;
+		void bind_positions() const;
+		void bind_meshlets() const;
+		void bind_storage() const;
+		void set_layout(const VertexLayout& layout);
+		const VertexLayout& layout() const { return mLayout; }
+
+		void set_budget(size_t bytes) { mBudget = bytes; } // 0: no budget, only unreferenced meshes are evicted
+		size_t budget() const { return mBudget; }
+		void set_eviction_age(uint64_t frames) { mEvictionAge = frames; }
+		uint64_t eviction_age() const { return mEvictionAge; }
+		void set_loader(AssetLoader* loader) { mLoader = loader; } // nullptr: meshes are uploaded by the first mesh_range()
+		AssetLoader* loader() const { return mLoader; }
+
+		GLuint VAO() const { return mVaoID; }
+		GLuint position_VAO() const { return mPositionVaoID; }
+		GLuint vertex_count() const { return mVertexCount; } // end of the used vertex ranges
+		size_t index_bytes() const { return static_cast<size_t>(mIndexSlots) * 2; } // end of the used index ranges
+		size_t mesh_count() const { return mMeshRanges.size(); } // including placeholders
+		size_t streaming_meshes() const { return mPlaceholders.size(); } // drawn as placeholder
+		size_t mesh_bytes() const { return mMeshBytes; } // of the stored meshes
+		size_t capacity_bytes() const;
+		unsigned int evicted_meshes() const { return mEvictedMeshes; } // by the last begin_frame()
+
+	private:
+		/*
+		* Range of vertices, of 16-bit index slots (a 32-bit index takes two) or of meshlets.
+		*/
+		struct Block
+		{
+			GLuint first;
+			GLuint count;
+		};
+
+		/*
+		* Ranges of an evicted mesh, free once the GPU has finished the given GpuResources frame.
+		*/
+		struct Eviction
+		{
+			uint64_t frame;
+			Block vertices;
+			Block indexes;
+			Block meshlets;
+			GLuint meshIndex;
+		};
+
+		const MeshRange& add_mesh(const shared_ptr<Mesh>& mesh);
+		const MeshRange& placeholder_range(const shared_ptr<Mesh>& mesh);
+		void add_staged_mesh(const AssetLoader::StagedMesh& staged);
+		MeshRange& allocate(const shared_ptr<Mesh>& mesh, GLuint vertexCount, GLuint indexCount, GLenum indexType, GLuint meshletCount);
+		void evict(unordered_map<shared_ptr<Mesh>, MeshRange>::iterator it);
+		void create_buffers();
+		void reserve(GLuint vertexCapacity, GLuint indexSlotCapacity, GLuint meshletCapacity);
+		void attach_buffers();
+		size_t mesh_bytes(const MeshRange& range) const;
+		static Block index_block(const MeshRange& range);
+
+		VertexLayout mLayout;
+		GLuint mVaoID;
+		GLuint mPositionVaoID; // same buffers, only the position attribute enabled
+		GLuint mVertexBuffers[VertexLayout::ATTRIB_COUNT]; // one per stream of the layout
+		GLuint mEBO;
+		GLuint mVertexCount, mVertexCapacity;
+		GLuint mIndexSlots, mIndexSlotCapacity; // in 16-bit slots, every range starts at an even slot
+		GLuint mMeshletBuffer;
+		GLuint mMeshletCount, mMeshletCapacity;
+
+		unordered_map<shared_ptr<Mesh>, MeshRange> mMeshRanges;
+		vector<Block> mFreeVertices; // sorted, adjacent blocks are merged
+		vector<Block> mFreeIndexes; // index slots
+		vector<Block> mFreeMeshlets;
+		vector<GLuint> mFreeMeshIndexes;
+		GLuint mNextMeshIndex;
+		vector<Eviction> mEvictions; // ranges the GPU might still read
+		AssetLoader* mLoader;
+		unordered_map<shared_ptr<Mesh>, shared_ptr<Mesh>> mPlaceholders; // of the meshes being staged
+
+		uint64_t mFrame;
+		size_t mBudget;
+		uint64_t mEvictionAge;
+		size_t mMeshBytes;
+		unsigned int mEvictedMeshes;
+	};
+}
+
+#endif // !GEOMETRY_BUFFER_H
@@ -0,0 +1,405 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "gl_state.h"
+
+GLuint ruya::GLState::sProgram = UNKNOWN;
+GLuint ruya::GLState::sVertexArray = UNKNOWN;
+GLuint ruya::GLState::sFramebuffer = UNKNOWN;
+GLuint ruya::GLState::sActiveUnit = UNKNOWN;
+std::array<std::array<GLuint, ruya::GLState::TEXTURE_TARGET_COUNT>, ruya::GLState::MAX_TEXTURE_UNITS> ruya::GLState::sTextures;
+std::array<GLuint, ruya::GLState::BUFFER_TARGET_COUNT> ruya::GLState::sBuffers;
+std::array<ruya::GLState::IndexedBinding, ruya::GLState::MAX_INDEXED_BINDINGS> ruya::GLState::sUniformBindings;
+std::array<ruya::GLState::IndexedBinding, ruya::GLState::MAX_INDEXED_BINDINGS> ruya::GLState::sStorageBindings;
+std::array<GLuint, ruya::GLState::CAPABILITY_COUNT> ruya::GLState::sCapabilities;
+GLenum ruya::GLState::sPolygonMode = UNKNOWN;
+GLenum ruya::GLState::sDepthFunc = UNKNOWN;
+GLuint ruya::GLState::sDepthMask = UNKNOWN;
+GLuint ruya::GLState::sColorMask = UNKNOWN;
+ruya::GLState::Stats ruya::GLState::sStats;
+#ifdef RUYA_GL_VALIDATION
+bool ruya::GLState::sValidation = true;
+#endif
+
+/*
+* Call once the context is current and the GL functions are loaded: forgets all cached
+* state and sets up the debug output of the validation mode.
+*/
+void ruya::GLState::init()
+{
+	invalidate();
+	set_validation(validation());
+}
+
+void ruya::GLState::use_program(GLuint program)
+{
+	if (program == sProgram) return skipped();
+	glUseProgram(program);
+	sProgram = program;
+	issued("glUseProgram");
+}
+
+void ruya::GLState::bind_vertex_array(GLuint vertexArray)
+{
+	if (vertexArray == sVertexArray) return skipped();
+	glBindVertexArray(vertexArray);
+	sVertexArray = vertexArray;
+	issued("glBindVertexArray");
+}
+
+void ruya::GLState::bind_framebuffer(GLuint framebuffer)
+{
+	if (framebuffer == sFramebuffer) return skipped();
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	sFramebuffer = framebuffer;
+	issued("glBindFramebuffer");
+}
+
+void ruya::GLState::active_texture(GLenum textureSlot)
+{
+	GLuint unit = textureSlot - GL_TEXTURE0;
+	if (unit == sActiveUnit) return skipped();
+	glActiveTexture(textureSlot);
+	sActiveUnit = unit;
+	issued("glActiveTexture");
+}
+
+void ruya::GLState::bind_texture(GLenum target, GLuint texture)
+{
+	TextureTarget cached = texture_target(target);
+	bool tracked = cached != UNTRACKED_TEXTURE_TARGET && sActiveUnit < MAX_TEXTURE_UNITS;
+	if (tracked && sTextures[sActiveUnit][cached] == texture) return skipped();
+
+	glBindTexture(target, texture);
+	if (tracked) sTextures[sActiveUnit][cached] = texture;
+	issued("glBindTexture");
+}
+
+/*
+* Binds the texture to the unit without changing the active unit (glBindTextureUnit()).
+* @param target: target of the texture, only used for the cache (glBindTextureUnit() derives it)
+*/
+void ruya::GLState::bind_texture_unit(GLuint unit, GLenum target, GLuint texture)
+{
+	TextureTarget cached = texture_target(target);
+	bool tracked = cached != UNTRACKED_TEXTURE_TARGET && unit < MAX_TEXTURE_UNITS;
+	if (tracked && sTextures[unit][cached] == texture) return skipped();
+
+	glBindTextureUnit(unit, texture);
+	if (tracked)
+	{
+		sTextures[unit][cached] = texture;
+	}
+	else if (unit < MAX_TEXTURE_UNITS)
+	{
+		// the texture went to a target that isn't tracked, unbinding (texture 0) clears all targets though
+		if (texture == 0) sTextures[unit].fill(0);
+	}
+	issued("glBindTextureUnit");
+}
+
+void ruya::GLState::bind_buffer(GLenum target, GLuint buffer)
+{
+	BufferTarget cached = buffer_target(target);
+	if (cached != UNTRACKED_BUFFER_TARGET && sBuffers[cached] == buffer) return skipped();
+
+	glBindBuffer(target, buffer);
+	if (cached != UNTRACKED_BUFFER_TARGET) sBuffers[cached] = buffer;
+	issued("glBindBuffer");
+}
+
+/*
+* Binds the whole buffer to an indexed binding point, like glBindBufferBase() this also
+* binds it to the generic target.
+*/
+void ruya::GLState::bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+	IndexedBinding* binding = indexed_binding(target, index);
+	if (binding && binding->buffer == buffer && binding->size == 0) return skipped();
+
+	glBindBufferBase(target, index, buffer);
+	if (binding) *binding = IndexedBinding{ buffer, 0, 0 };
+	BufferTarget cached = buffer_target(target);
+	if (cached != UNTRACKED_BUFFER_TARGET) sBuffers[cached] = buffer;
+	issued("glBindBufferBase");
+}
+
+/*
+* Binds a range of the buffer to an indexed binding point, like glBindBufferRange() this
+* also binds it to the generic target.
+*/
+void ruya::GLState::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	IndexedBinding* binding = indexed_binding(target, index);
+	if (binding && binding->buffer == buffer && binding->offset == offset && binding->size == size) return skipped();
+
+	glBindBufferRange(target, index, buffer, offset, size);
+	if (binding) *binding = IndexedBinding{ buffer, offset, size };
+	BufferTarget cached = buffer_target(target);
+	if (cached != UNTRACKED_BUFFER_TARGET) sBuffers[cached] = buffer;
+	issued("glBindBufferRange");
+}
+
+void ruya::GLState::enable(GLenum capability)
+{
+	set_capability(capability, true);
+}
+
+void ruya::GLState::disable(GLenum capability)
+{
+	set_capability(capability, false);
+}
+
+void ruya::GLState::polygon_mode(GLenum mode)
+{
+	if (mode == sPolygonMode) return skipped();
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+	sPolygonMode = mode;
+	issued("glPolygonMode");
+}
+
+void ruya::GLState::depth_func(GLenum func)
+{
+	if (func == sDepthFunc) return skipped();
+	glDepthFunc(func);
+	sDepthFunc = func;
+	issued("glDepthFunc");
+}
+
+void ruya::GLState::depth_mask(bool write)
+{
+	if (sDepthMask == (write ? 1u : 0u)) return skipped();
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	sDepthMask = write ? 1 : 0;
+	issued("glDepthMask");
+}
+
+void ruya::GLState::color_mask(bool write)
+{
+	if (sColorMask == (write ? 1u : 0u)) return skipped();
+	GLboolean mask = write ? GL_TRUE : GL_FALSE;
+	glColorMask(mask, mask, mask, mask);
+	sColorMask = write ? 1 : 0;
+	issued("glColorMask");
+}
+
+/*
+* Deleting a program that is in use doesn't unbind it, but the cache can't tell the
+* program apart from a new one that gets the same name.
+*/
+void ruya::GLState::forget_program(GLuint program)
+{
+	if (sProgram == program) sProgram = UNKNOWN;
+}
+
+void ruya::GLState::forget_vertex_array(GLuint vertexArray)
+{
+	if (sVertexArray == vertexArray) sVertexArray = 0; // deleting the bound vertex array binds 0
+}
+
+void ruya::GLState::forget_framebuffer(GLuint framebuffer)
+{
+	if (sFramebuffer == framebuffer) sFramebuffer = 0; // deleting the bound framebuffer binds the default one
+}
+
+void ruya::GLState::forget_texture(GLuint texture)
+{
+	// deleting a texture unbinds it from the units of the context
+	for (auto& unit : sTextures)
+	{
+		for (GLuint& bound : unit)
+		{
+			if (bound == texture) bound = 0;
+		}
+	}
+}
+
+void ruya::GLState::forget_buffer(GLuint buffer)
+{
+	// deleting a buffer unbinds it from the generic targets, but not from the indexed binding points
+	for (GLuint& bound : sBuffers)
+	{
+		if (bound == buffer) bound = 0;
+	}
+	for (auto* bindings : { &sUniformBindings, &sStorageBindings })
+	{
+		for (IndexedBinding& binding : *bindings)
+		{
+			if (binding.buffer == buffer) binding.buffer = UNKNOWN;
+		}
+	}
+}
+
+/*
+* Forgets all cached state, the next bind of everything is issued.
+*/
+void ruya::GLState::invalidate()
+{
+	sProgram = sVertexArray = sFramebuffer = sActiveUnit = UNKNOWN;
+	for (auto& unit : sTextures) unit.fill(UNKNOWN);
+	sBuffers.fill(UNKNOWN);
+	sUniformBindings.fill(IndexedBinding());
+	sStorageBindings.fill(IndexedBinding());
+	sCapabilities.fill(UNKNOWN);
+	sPolygonMode = sDepthFunc = UNKNOWN;
+	sDepthMask = sColorMask = UNKNOWN;
+}
+
+#ifdef RUYA_GL_VALIDATION
+/*
+* Turns the validation mode on or off, with a current context.
+*/
+void ruya::GLState::set_validation(bool enabled)
+{
+	sValidation = enabled;
+	if (enabled)
+	{
+		glEnable(GL_DEBUG_OUTPUT);
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		glDebugMessageCallback(debug_message_callback, nullptr);
+	}
+	else
+	{
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		glDisable(GL_DEBUG_OUTPUT);
+	}
+}
+#endif
+
+ruya::GLState::TextureTarget ruya::GLState::texture_target(GLenum target)
+{
+	switch (target)
+	{
+		case GL_TEXTURE_2D: return TEXTURE_2D;
+		case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+		case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+		case GL_TEXTURE_3D: return TEXTURE_3D;
+		default: return UNTRACKED_TEXTURE_TARGET;
+	}
+}
+
+ruya::GLState::BufferTarget ruya::GLState::buffer_target(GLenum target)
+{
+	switch (target)
+	{
+		case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+		case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+		case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE_BUFFER;
+		case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+		case GL_DISPATCH_INDIRECT_BUFFER: return DISPATCH_INDIRECT_BUFFER;
+		case GL_PARAMETER_BUFFER: return PARAMETER_BUFFER;
+		case GL_COPY_READ_BUFFER: return COPY_READ_BUFFER;
+		case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER;
+		case GL_PIXEL_PACK_BUFFER: return PIXEL_PACK_BUFFER;
+		case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER;
+		default: return UNTRACKED_BUFFER_TARGET; // GL_ELEMENT_ARRAY_BUFFER is vertex array state
+	}
+}
+
+ruya::GLState::Capability ruya::GLState::capability(GLenum capability)
+{
+	switch (capability)
+	{
+		case GL_DEPTH_TEST: return DEPTH_TEST;
+		case GL_CULL_FACE: return CULL_FACE;
+		case GL_BLEND: return BLEND;
+		case GL_STENCIL_TEST: return STENCIL_TEST;
+		case GL_SCISSOR_TEST: return SCISSOR_TEST;
+		case GL_MULTISAMPLE: return MULTISAMPLE;
+		default: return UNTRACKED_CAPABILITY;
+	}
+}
+
+ruya::GLState::IndexedBinding* ruya::GLState::indexed_binding(GLenum target, GLuint index)
+{
+	if (index >= MAX_INDEXED_BINDINGS) return nullptr;
+	switch (target)
+	{
+		case GL_UNIFORM_BUFFER: return &sUniformBindings[index];
+		case GL_SHADER_STORAGE_BUFFER: return &sStorageBindings[index];
+		default: return nullptr;
+	}
+}
+
+void ruya::GLState::set_capability(GLenum capability, bool enabled)
+{
+	Capability cached = GLState::capability(capability);
+	if (cached != UNTRACKED_CAPABILITY && sCapabilities[cached] == static_cast<GLuint>(enabled)) return skipped();
+
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+	if (cached != UNTRACKED_CAPABILITY) sCapabilities[cached] = enabled;
+	issued(enabled ? "glEnable" : "glDisable");
+}
+
+/*
+* Throws if OpenGL recorded errors, the message lists all of them.
+*/
+void ruya::GLState::check_errors(const char* call, const char* file, int line)
+{
+	GLenum error = glGetError();
+	if (error == GL_NO_ERROR) return;
+
+	std::string message = std::string("OpenGL error after ") + call;
+	if (file) message += std::string(" (") + file + ":" + std::to_string(line) + ")";
+	message += ":";
+	for (; error != GL_NO_ERROR; error = glGetError())
+	{
+		switch (error)
+		{
+			case GL_INVALID_ENUM: message += " GL_INVALID_ENUM"; break;
+			case GL_INVALID_VALUE: message += " GL_INVALID_VALUE"; break;
+			case GL_INVALID_OPERATION: message += " GL_INVALID_OPERATION"; break;
+			case GL_INVALID_FRAMEBUFFER_OPERATION: message += " GL_INVALID_FRAMEBUFFER_OPERATION"; break;
+			case GL_OUT_OF_MEMORY: message += " GL_OUT_OF_MEMORY"; break;
+			default: message += " " + std::to_string(error); break;
+		}
+	}
+	throw std::runtime_error(message);
+}
+
+void GLAPIENTRY ruya::GLState::debug_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, 
+													  GLsizei length, const GLchar* message, const void* userParam)
+{
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+
+	const char* strSeverity = "Unknown";
+	switch (severity)
+	{
+		case GL_DEBUG_SEVERITY_HIGH: strSeverity = "High"; break;
+		case GL_DEBUG_SEVERITY_MEDIUM: strSeverity = "Medium"; break;
+		case GL_DEBUG_SEVERITY_LOW: strSeverity = "Low"; break;
+		case GL_DEBUG_SEVERITY_NOTIFICATION: strSeverity = "Notification"; break;
+	}
+
+	const char* strType = "Unknown";
+	switch (type)
+	{
+		case GL_DEBUG_TYPE_ERROR: strType = "** ERROR **"; break;
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: strType = "Depracated Behavior"; break;
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: strType = "Undefined Behavior"; break;
+		case GL_DEBUG_TYPE_PORTABILITY: strType = "Portability"; break;
+		case GL_DEBUG_TYPE_PERFORMANCE: strType = "Performance"; break;
+		case GL_DEBUG_TYPE_OTHER: strType = "Other"; break;
+		case GL_DEBUG_TYPE_MARKER: strType = "Marker"; break;
+		case GL_DEBUG_TYPE_PUSH_GROUP: strType = "Push Group"; break;
+		case GL_DEBUG_TYPE_POP_GROUP: strType = "Pop Group"; break;
+	}
+
+	const char* strSource = "Unknown";
+	switch (source)
+	{
+		case GL_DEBUG_SOURCE_API: strSource = "API"; break;
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: strSource = "Window System"; break;
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: strSource = "Shader Compiler"; break;
+		case GL_DEBUG_SOURCE_THIRD_PARTY: strSource = "Third Party"; break;
+		case GL_DEBUG_SOURCE_APPLICATION: strSource = "Application"; break;
+		case GL_DEBUG_SOURCE_OTHER: strSource = "Other"; break;
+	}
+
+	std::cerr << "[DEBUG] type = " << strType
+		<< "\n\t source = " << strSource
+		<< "\n\t severity = " << strSeverity
+		<< "\n\t message = " << message
+		<< "\n\n";
+}
@@ -0,0 +1,139 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <array>
+#include <glad/glad.h>
+
+/*
+* Wraps a GL call that doesn't go through GLState (draws, dispatches, barriers, ...) so that
+* it is counted in GLState::stats() and checked for errors in validation mode.
+*/
+#define RUYA_GL(call) do { call; ::ruya::GLState::called(#call, __FILE__, __LINE__); } while (0)
+
+namespace ruya
+{
+	/*
+	* Cache of the OpenGL binding state of the context, bind calls that wouldn't change the
+	* state are skipped. All binds of the engine have to go through here, a bind made behind
+	* its back leaves the cache stale (call invalidate() after code that binds things itself).
+	*	- tracked: program, vertex array, framebuffer, active texture unit, textures per unit (2D, 2D array,
+	*	  cube map and 3D targets), buffers per target, indexed uniform and storage buffer
+	*	  bindings, capabilities (glEnable), the polygon mode, the depth function and the
+	*	  depth and color write masks
+	*	- objects that are deleted have to be forgotten (forget_xxx()), OpenGL unbinds them
+	*	  and might hand out their name again
+	*	- the calls that go through GLState or RUYA_GL() are counted per frame
+	*
+	* Validation mode: OpenGL errors are checked after every call that goes through here and
+	* synchronous debug output is enabled. Only compiled in with RUYA_GL_VALIDATION defined
+	* (Debug builds), where it is on by default. Without it, validation() is a constant false
+	* and the checks compile away.
+	*
+	* There is only one context, so the state is static.
+	*/
+	class GLState
+	{
+	public:
+		/*
+		* Counters since the last begin_frame().
+		*/
+		struct Stats
+		{
+			unsigned int calls = 0; // GL calls issued through GLState or RUYA_GL()
+			unsigned int skipped = 0; // redundant binds that were not issued
+		};
+
+		static constexpr GLuint MAX_TEXTURE_UNITS = 48; // units above are bound without caching
+		static constexpr GLuint MAX_INDEXED_BINDINGS = 16; // same for uniform and storage buffer binding points
+
+		static void use_program(GLuint program);
+		static void bind_vertex_array(GLuint vertexArray);
+		static void bind_framebuffer(GLuint framebuffer); // GL_FRAMEBUFFER (draw and read), 0 = default framebuffer
+		static void active_texture(GLenum textureSlot); // GL_TEXTUREi
+		static void bind_texture(GLenum target, GLuint texture); // to the active unit
+		static void bind_texture_unit(GLuint unit, GLenum target, GLuint texture);
+		static void bind_buffer(GLenum target, GLuint buffer);
+		static void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+		static void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+		static void enable(GLenum capability);
+		static void disable(GLenum capability);
+		static void polygon_mode(GLenum mode); // GL_FRONT_AND_BACK
+		static void depth_func(GLenum func);
+		static void depth_mask(bool write);
+		static void color_mask(bool write); // all four channels
+
+		static void init();
+		static void forget_program(GLuint program);
+		static void forget_vertex_array(GLuint vertexArray);
+		static void forget_framebuffer(GLuint framebuffer);
+		static void forget_texture(GLuint texture);
+		static void forget_buffer(GLuint buffer);
+		static void invalidate();
+
+		static void begin_frame() { sStats = Stats(); }
+		static const Stats& stats() { return sStats; }
+
+#ifdef RUYA_GL_VALIDATION
+		static void set_validation(bool enabled);
+		static bool validation() { return sValidation; }
+#else
+		static void set_validation(bool /*enabled*/) {}
+		static constexpr bool validation() { return false; }
+#endif
+
+		static void called(const char* call, const char* file, int line)
+		{
+			sStats.calls++;
+			if (validation()) check_errors(call, file, line);
+		}
+
+	private:
+		// texture targets with a cached binding per unit
+		enum TextureTarget { TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_CUBE_MAP, TEXTURE_3D, TEXTURE_TARGET_COUNT, UNTRACKED_TEXTURE_TARGET = TEXTURE_TARGET_COUNT };
+		// buffer targets with a cached (generic) binding
+		enum BufferTarget { ARRAY_BUFFER, UNIFORM_BUFFER, SHADER_STORAGE_BUFFER, DRAW_INDIRECT_BUFFER, DISPATCH_INDIRECT_BUFFER, PARAMETER_BUFFER,
+							COPY_READ_BUFFER, COPY_WRITE_BUFFER, PIXEL_PACK_BUFFER, PIXEL_UNPACK_BUFFER, BUFFER_TARGET_COUNT, UNTRACKED_BUFFER_TARGET = BUFFER_TARGET_COUNT };
+		// capabilities whose state is cached
+		enum Capability { DEPTH_TEST, CULL_FACE, BLEND, STENCIL_TEST, SCISSOR_TEST, MULTISAMPLE, CAPABILITY_COUNT, UNTRACKED_CAPABILITY = CAPABILITY_COUNT };
+
+		static constexpr GLuint UNKNOWN = 0xFFFFFFFF; // cached value of state that has to be set regardless
+
+		struct IndexedBinding
+		{
+			GLuint buffer = UNKNOWN;
+			GLintptr offset = 0;
+			GLsizeiptr size = 0; // 0 for glBindBufferBase()
+		};
+
+		static TextureTarget texture_target(GLenum target);
+		static BufferTarget buffer_target(GLenum target);
+		static Capability capability(GLenum capability);
+		static IndexedBinding* indexed_binding(GLenum target, GLuint index);
+		static void set_capability(GLenum capability, bool enabled);
+		static void issued(const char* call) { called(call, nullptr, 0); }
+		static void skipped() { sStats.skipped++; }
+		static void check_errors(const char* call, const char* file, int line);
+		static void GLAPIENTRY debug_message_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+													  const GLchar* message, const void* userParam);
+
+		static GLuint sProgram;
+		static GLuint sVertexArray;
+		static GLuint sFramebuffer;
+		static GLuint sActiveUnit;
+		static std::array<std::array<GLuint, TEXTURE_TARGET_COUNT>, MAX_TEXTURE_UNITS> sTextures;
+		static std::array<GLuint, BUFFER_TARGET_COUNT> sBuffers;
+		static std::array<IndexedBinding, MAX_INDEXED_BINDINGS> sUniformBindings;
+		static std::array<IndexedBinding, MAX_INDEXED_BINDINGS> sStorageBindings;
+		static std::array<GLuint, CAPABILITY_COUNT> sCapabilities; // 0, 1 or UNKNOWN
+		static GLenum sPolygonMode;
+		static GLenum sDepthFunc;
+		static GLuint sDepthMask; // 0, 1 or UNKNOWN
+		static GLuint sColorMask;
+		static Stats sStats;
+#ifdef RUYA_GL_VALIDATION
+		static bool sValidation;
+#endif
+	};
+}
+
+#endif // !GL_STATE_H
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include "gpu_culling.h"
+#include "gl_state.h"
+#include "engine/scene/texture.h"
+
+namespace
+{
+	constexpr GLuint CULL_LOCAL_SIZE = 64; // local_size_x of cull_objects.comp and compact_draws.comp
+
+	GLuint group_count(size_t count) { return static_cast<GLuint>((count + CULL_LOCAL_SIZE - 1) / CULL_LOCAL_SIZE); }
+
+	/*
+	* Reorders the elements: element i becomes the old element order[i].
+	*/
+	template <class T>
+	void permute(std::vector<T>& elements, const std::vector<GLuint>& order)
+	{
+		std::vector<T> permuted;
+		permuted.reserve(elements.size());
+		for (GLuint i : order)
+			permuted.push_back(std::move(elements[i]));
+		elements.swap(permuted);
+	}
+}
+
+ruya::GpuCulling::GpuCulling(const std::string& shaderDir)
+	: mCullShader((shaderDir + "/cull_objects.comp").c_str()),
+	  mCompactShader((shaderDir + "/compact_draws.comp").c_str()),
+	  mObjectCountUniform(mCullShader.uniform<int>("objectCount")),
+	  mOcclusionCullingUniform(mCullShader.uniform<int>("occlusionCulling")),
+	  mPyramidViewProjectionUniform(mCullShader.uniform<glm::mat4>("pyramidViewProjection")),
+	  mDepthPyramidUniform(mCullShader.uniform<int>("depthPyramid")),
+	  mCommandCountUniform(mCompactShader.uniform<int>("commandCount")),
+	  mShortCommandCountUniform(mCompactShader.uniform<int>("shortCommandCount")),
+	  mObjectList(nullptr), mListSize(0), mRebuild(false), mShortCommandCount(0), mGeometry(nullptr), mInstanceCapacity(0),
+	  mObjectInstanceBuffer(StorageBindings::OBJECT_INSTANCES), mBoundsBuffer(StorageBindings::OBJECT_BOUNDS),
+	  mLodLevelBuffer(StorageBindings::LOD_LEVELS), mObjectLodBuffer(StorageBindings::OBJECT_LODS), mCommandTemplateBuffer(StorageBindings::CULL_COMMANDS), mCommandDrawBuffer(StorageBindings::CULL_DRAWS),
+	  mCullCommandBuffer(StorageBindings::CULL_COMMANDS), mCounterBuffer(StorageBindings::CULL_COUNTERS, sizeof(CullCounters)),
+	  mInstanceBuffer(StorageBindings::INSTANCES), mDrawBuffer(StorageBindings::DRAWS), mDrawCommandBuffer(StorageBindings::DRAW_COMMANDS),
+	  mDepthPyramid(shaderDir + "/depth_pyramid.comp"), mPyramidViewProjection(1.0f), mOcclusionCulling(true)
+{
+}
+
+ruya::GpuCulling::~GpuCulling()
+{
+	for (Object* obj : mObjects)
+	{
+		if (obj) obj->remove_observer(this);
+	}
+}
+
+/*
+* Brings the GPU copies of the objects up to date: objects appended to the list since the
+* last call are added, only the objects that notified a change are rewritten. When objects
+* were added or destroyed or a mesh changed, the draw commands and LOD table are rebuilt.
+* Objects can only be appended to the list, a different or shorter list starts over.
+*/
+void ruya::GpuCulling::sync(list<Object*>& objects, GeometryBuffer& geometry)
+{
+	bool allDestroyed = !mObjects.empty() && std::all_of(mObjects.begin(), mObjects.end(), [](Object* obj) { return obj == nullptr; });
+	if (&objects != mObjectList || objects.size() < mListSize || allDestroyed)
+	{
+		reset();
+		mObjectList = &objects;
+	}
+
+	if (objects.size() > mListSize)
+	{
+		auto it = objects.begin();
+		std::advance(it, mListSize);
+		for (; it != objects.end(); it++)
+			track(*it);
+		mListSize = objects.size();
+	}
+
+	if (mRebuild || &geometry != mGeometry)
+		rebuild(geometry);
+	else
+		upload_dirty_objects();
+
+	// the commands point into the geometry buffer, keep their meshes from being evicted and
+	// follow the ones that were evicted over budget and uploaded again elsewhere, or that
+	// were streamed in and replaced their placeholder. A mesh whose index type changed
+	// (placeholder with 16-bit indexes, new layout) moves to the other group of commands.
+	bool moved = false;
+	for (size_t c = 0; c < mCommandMeshes.size(); c++)
+	{
+		const GeometryBuffer::MeshRange& range = geometry.mesh_range(mCommandMeshes[c]);
+		if (range.indexType != mCommandIndexTypes[c])
+		{
+			rebuild(geometry);
+			return;
+		}
+
+		DrawElementsIndirectCommand& command = mCommands[c];
+		DrawData draw = range.draw_data(command.baseInstance);
+		if (command.firstIndex == range.firstIndex && command.baseVertex == range.baseVertex && command.count == range.indexCount && draw == mCommandDraws[c]) continue;
+		command.count = range.indexCount;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		mCommandDraws[c] = draw;
+		moved = true;
+	}
+	if (moved)
+	{
+		mCommandTemplateBuffer.upload(mCommands);
+		mCommandDrawBuffer.upload(mCommandDraws);
+	}
+}
+
+/*
+* Stops observing all objects and forgets them.
+*/
+void ruya::GpuCulling::reset()
+{
+	for (Object* obj : mObjects)
+	{
+		if (obj) obj->remove_observer(this);
+	}
+	mObjectList = nullptr;
+	mListSize = 0;
+	mObjects.clear();
+	mMeshes.clear();
+	mLodChains.clear();
+	mDirty.clear();
+	mDirtyIndexes.clear();
+	mInstances.clear();
+	mBounds.clear();
+	mRebuild = true;
+}
+
+void ruya::GpuCulling::track(Object* obj)
+{
+	uint32_t index = static_cast<uint32_t>(mObjects.size());
+	mObjects.push_back(obj);
+	mMeshes.push_back(obj->mesh());
+	mLodChains.push_back(obj->lod_chain());
+	mDirty.push_back(false);
+	mInstances.emplace_back();
+	mBounds.emplace_back();
+	obj->add_observer(this, index);
+	mRebuild = true;
+}
+
+void ruya::GpuCulling::object_changed(Object& obj, uint32_t index)
+{
+	if (index >= mObjects.size() || mDirty[index]) return;
+	mDirty[index] = true;
+	mDirtyIndexes.push_back(index);
+}
+
+void ruya::GpuCulling::object_destroyed(uint32_t index)
+{
+	if (index >= mObjects.size()) return;
+	mObjects[index] = nullptr;
+	mRebuild = true;
+}
+
+/*
+* Recreates the draw commands (one per mesh), the LOD table and all per-object data.
+*	- the instance slots of a command are [baseInstance, baseInstance + capacity) where the
+*	  capacity is the number of objects that have the mesh as one of their levels
+*	- objects with the same LodChain (or the same mesh without chain) share their LOD levels
+*	- the commands with 16-bit indexes are moved to the front
+*/
+void ruya::GpuCulling::rebuild(GeometryBuffer& geometry)
+{
+	mGeometry = &geometry;
+	mCommands.clear();
+	mCommandDraws.clear();
+	mCommandMeshes.clear();
+	mCommandIndexTypes.clear();
+	mLodLevels.clear();
+
+	unordered_map<const Mesh*, GLuint> commandOfMesh;
+	unordered_map<const void*, GLuint> firstLodOf; // per LodChain or per mesh without chain
+	vector<GLuint> capacities;
+	auto command_of = [&](const shared_ptr<Mesh>& mesh) {
+		auto [it, inserted] = commandOfMesh.try_emplace(mesh.get(), static_cast<GLuint>(mCommands.size()));
+		if (inserted)
+		{
+			const GeometryBuffer::MeshRange& range = geometry.mesh_range(mesh);
+			DrawElementsIndirectCommand& command = mCommands.emplace_back();
+			command.count = range.indexCount;
+			command.instanceCount = 0;
+			command.firstIndex = range.firstIndex;
+			command.baseVertex = range.baseVertex;
+			mCommandMeshes.push_back(mesh);
+			mCommandIndexTypes.push_back(range.indexType);
+			capacities.push_back(0);
+		}
+		return it->second;
+	};
+
+	for (uint32_t i = 0; i < mObjects.size(); i++)
+	{
+		Object* obj = mObjects[i];
+		mBounds[i] = ObjectBounds{};
+		mDirty[i] = false;
+		if (!obj) continue;
+
+		mMeshes[i] = obj->mesh();
+		mLodChains[i] = obj->lod_chain();
+		const shared_ptr<LodChain>& chain = mLodChains[i];
+		if (!chain && !mMeshes[i]) continue;
+
+		const void* key = chain ? static_cast<const void*>(chain.get()) : mMeshes[i].get();
+		auto [it, inserted] = firstLodOf.try_emplace(key, static_cast<GLuint>(mLodLevels.size()));
+		if (inserted)
+		{
+			if (chain)
+			{
+				// the bounding sphere is the one of the most detailed level, see update_object()
+				float radius = std::max(chain->levels.front()->bounds.radius, std::numeric_limits<float>::min());
+				for (size_t level = 0; level < chain->size(); level++)
+					mLodLevels.push_back(LodLevel{ command_of(chain->levels[level]), chain->errors[level] / radius });
+			}
+			else
+			{
+				mLodLevels.push_back(LodLevel{ command_of(mMeshes[i]), 0.0f });
+			}
+		}
+		GLuint lodCount = chain ? static_cast<GLuint>(chain->size()) : 1;
+		for (GLuint level = it->second; level < it->second + lodCount; level++)
+			capacities[mLodLevels[level].command]++;
+		update_object(i);
+		mBounds[i].firstLod = it->second;
+		mBounds[i].lodCount = lodCount;
+	}
+	mDirtyIndexes.clear();
+
+	vector<GLuint> order(mCommands.size());
+	std::iota(order.begin(), order.end(), 0);
+	auto shortEnd = std::stable_partition(order.begin(), order.end(), [this](GLuint c) { return mCommandIndexTypes[c] == GL_UNSIGNED_SHORT; });
+	mShortCommandCount = static_cast<GLuint>(shortEnd - order.begin());
+	vector<GLuint> newIndex(order.size());
+	for (GLuint i = 0; i < order.size(); i++)
+		newIndex[order[i]] = i;
+	for (LodLevel& level : mLodLevels)
+		level.command = newIndex[level.command];
+	permute(mCommands, order);
+	permute(mCommandMeshes, order);
+	permute(mCommandIndexTypes, order);
+	permute(capacities, order);
+
+	mInstanceCapacity = 0;
+	for (size_t c = 0; c < mCommands.size(); c++)
+	{
+		mCommands[c].baseInstance = mInstanceCapacity;
+		mInstanceCapacity += capacities[c];
+		mCommandDraws.push_back(geometry.mesh_range(mCommandMeshes[c]).draw_data(mCommands[c].baseInstance));
+	}
+
+	mObjectInstanceBuffer.upload(mInstances);
+	mBoundsBuffer.upload(mBounds);
+	mLodLevelBuffer.upload(mLodLevels);
+	mObjectLodBuffer.upload(vector<GLuint>(mObjects.size(), 0));
+	mCommandTemplateBuffer.upload(mCommands);
+	mCommandDrawBuffer.upload(mCommandDraws);
+	mCullCommandBuffer.reserve(mCommands.size() * sizeof(DrawElementsIndirectCommand));
+	mDrawCommandBuffer.reserve(mCommands.size() * sizeof(DrawElementsIndirectCommand));
+	mDrawBuffer.reserve(mCommands.size() * sizeof(DrawData));
+	mInstanceBuffer.reserve(mInstanceCapacity * sizeof(InstanceData));
+	mRebuild = false;
+}
+
+/*
+* Writes the instance data and bounding sphere of an object to the CPU copies, the LOD
+* range of its bounds is left as is.
+*/
+void ruya::GpuCulling::update_object(uint32_t index)
+{
+	Object* obj = mObjects[index];
+	const Material& material = obj->material();
+
+	InstanceData& instance = mInstances[index];
+	instance.model = obj->model_matrix(); // cached, see TransformSystem
+	instance.inverseModel = obj->inverse_model_matrix();
+	instance.color = vec4(obj->color(), 1.0f);
+	instance.materialAmbient = vec4(material.ambient, 1.0f);
+	instance.materialDiffuse = vec4(material.diffuse, 1.0f);
+	instance.materialSpecular = vec4(material.specular, material.shininess);
+	instance.textureLayer = -1; // textures aren't supported, see gpu_culling.h
+
+	// the most detailed level bounds the whole chain
+	const shared_ptr<Mesh>& mesh = mLodChains[index] ? mLodChains[index]->levels.front() : mMeshes[index];
+	if (!mesh) return;
+	vec3 scale = glm::abs(obj->scale());
+	mBounds[index].sphere = vec4(vec3(instance.model * vec4(mesh->bounds.center, 1.0f)), mesh->bounds.radius * std::max({ scale.x, scale.y, scale.z }));
+}
+
+/*
+* Rewrites the objects that notified a change since the last sync, one upload per buffer
+* covering the range [lowest, highest] dirty index. A changed mesh or LOD chain triggers a
+* rebuild instead.
+*/
+void ruya::GpuCulling::upload_dirty_objects()
+{
+	if (mDirtyIndexes.empty()) return;
+
+	uint32_t first = std::numeric_limits<uint32_t>::max(), last = 0;
+	for (uint32_t index : mDirtyIndexes)
+	{
+		mDirty[index] = false;
+		Object* obj = mObjects[index];
+		if (!obj) continue;
+		if (obj->mesh() != mMeshes[index] || obj->lod_chain() != mLodChains[index])
+		{
+			mDirtyIndexes.clear();
+			rebuild(*mGeometry);
+			return;
+		}
+		update_object(index);
+		first = std::min(first, index);
+		last = std::max(last, index);
+	}
+	mDirtyIndexes.clear();
+	if (first > last) return;
+
+	GLsizeiptr count = last - first + 1;
+	mObjectInstanceBuffer.update(&mInstances[first], count * sizeof(InstanceData), first * sizeof(InstanceData));
+	mBoundsBuffer.update(&mBounds[first], count * sizeof(ObjectBounds), first * sizeof(ObjectBounds));
+}
+
+/*
+* Culls all objects and builds the draw commands of the visible ones on the GPU.
+* @pre the frame constants must have been bound for this frame
+*/
+void ruya::GpuCulling::cull()
+{
+	if (mCommands.empty()) return;
+
+	// reset the instance counts of the commands and the counters
+	RUYA_GL(glCopyNamedBufferSubData(mCommandTemplateBuffer.ID(), mCullCommandBuffer.ID(), 0, 0, mCommands.size() * sizeof(DrawElementsIndirectCommand)));
+	RUYA_GL(glClearNamedBufferData(mCounterBuffer.ID(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+
+	mObjectInstanceBuffer.bind();
+	mBoundsBuffer.bind();
+	mLodLevelBuffer.bind();
+	mObjectLodBuffer.bind();
+	mCullCommandBuffer.bind();
+	mCommandDrawBuffer.bind();
+	mCounterBuffer.bind();
+	mInstanceBuffer.bind();
+	mDrawBuffer.bind();
+	mDrawCommandBuffer.bind();
+
+	// the pyramid is sampled on a unit after the ones the material textures use
+	GLuint pyramidUnit = Texture::get_num_texture_slots_fragment_shader();
+	bool occlusion = mOcclusionCulling && mDepthPyramid.valid();
+	if (occlusion) mDepthPyramid.bind(pyramidUnit);
+
+	mCullShader.use();
+	mCullShader.set(mObjectCountUniform, (int)mObjects.size());
+	mCullShader.set(mOcclusionCullingUniform, occlusion ? 1 : 0);
+	mCullShader.set(mPyramidViewProjectionUniform, mPyramidViewProjection);
+	mCullShader.set(mDepthPyramidUniform, (int)pyramidUnit);
+	RUYA_GL(glDispatchCompute(group_count(mObjects.size()), 1, 1));
+	RUYA_GL(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+
+	mCompactShader.use();
+	mCompactShader.set(mCommandCountUniform, (int)mCommands.size());
+	mCompactShader.set(mShortCommandCountUniform, (int)mShortCommandCount);
+	RUYA_GL(glDispatchCompute(group_count(mCommands.size()), 1, 1));
+	RUYA_GL(glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+/*
+* Draws the visible objects with one glMultiDrawElementsIndirectCount() call per index
+* type, drawOffset is set to the first command of each call. positionsOnly fetches only the
+* positions of the vertices (depth pre-pass, see GeometryBuffer::bind_positions()).
+* @pre cull() must have been called this frame
+* @pre the shader program must be current
+* @returns the number of multi-draw calls
+*/
+GLsizei ruya::GpuCulling::draw(Shader& shader, UniformHandle<int> drawOffset, bool positionsOnly)
+{
+	if (mCommands.empty()) return 0;
+
+	if (positionsOnly) mGeometry->bind_positions();
+	else mGeometry->bind();
+	mInstanceBuffer.bind();
+	mDrawBuffer.bind();
+	GLState::bind_buffer(GL_DRAW_INDIRECT_BUFFER, mDrawCommandBuffer.ID());
+	GLState::bind_buffer(GL_PARAMETER_BUFFER, mCounterBuffer.ID()); // CullCounters::drawCount[group] is at offset 4 * group
+
+	GLsizei calls = 0;
+	GLuint firstCommands[3] = { 0, mShortCommandCount, static_cast<GLuint>(mCommands.size()) };
+	for (GLuint group = 0; group < 2; group++)
+	{
+		GLsizei maxCount = static_cast<GLsizei>(firstCommands[group + 1] - firstCommands[group]);
+		if (maxCount == 0) continue;
+		shader.set(drawOffset, (int)firstCommands[group]);
+		const void* offset = (const void*)(firstCommands[group] * sizeof(DrawElementsIndirectCommand));
+		GLenum indexType = group == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		RUYA_GL(glMultiDrawElementsIndirectCount(GL_TRIANGLES, indexType, offset, group * sizeof(GLuint), maxCount, 0));
+		calls++;
+	}
+	// Mesa keeps reading the draw count from a bound parameter buffer in later
+	// glMultiDrawElementsIndirect() calls (the CPU path draws the light sources after this)
+	GLState::bind_buffer(GL_PARAMETER_BUFFER, 0);
+	return calls;
+}
+
+/*
+* Builds the depth pyramid from the depth buffer of the frame that was just drawn, the
+* next frame tests its objects against it.
+* @param viewProjection: view-projection matrix the frame was drawn with
+*/
+void ruya::GpuCulling::update_depth_pyramid(const glm::mat4& viewProjection, GLsizei width, GLsizei height)
+{
+	if (!mOcclusionCulling) return;
+	mDepthPyramid.build(width, height);
+	mPyramidViewProjection = viewProjection;
+}
+
+/*
+* Counters of the last cull(), waits for the GPU to finish culling (stalls the pipeline,
+* meant for statistics and benchmarks).
+*/
+ruya::CullCounters ruya::GpuCulling::read_counters()
+{
+	CullCounters counters{};
+	glGetNamedBufferSubData(mCounterBuffer.ID(), 0, sizeof(CullCounters), &counters);
+	return counters;
+}
@@ -0,0 +1,128 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "engine/scene/object.h"
+#include "engine/render/shader.h"
+#include "engine/render/storage_buffer.h"
+#include "engine/render/geometry_buffer.h"
+#include "engine/render/depth_pyramid.h"
+#include "engine/render/uniform_blocks.h"
+
+using std::list;
+using std::unordered_map;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* GPU driven rendering of the objects of a scene: culling, LOD selection and the
+	* building of the draw commands are done by compute shaders, the objects are drawn with
+	* one glMultiDrawElementsIndirectCount() call per index type, without the CPU touching
+	* any of them.
+	*	- the instance data and bounding spheres of all objects live in GPU buffers, they
+	*	  are only rewritten for objects that changed (the culling observes the objects)
+	*	- every mesh (each level of a LodChain) gets one draw command with a fixed range of
+	*	  instance slots, large enough for all objects that might use the mesh
+	*	- cull_objects.comp tests each object against the frustum and the depth pyramid of
+	*	  the previous frame, picks its level of detail from the projected error of the levels
+	*	  (with the hysteresis of LodChain::select_level(), the previous level of each object
+	*	  stays on the GPU) and appends its instance data to the slots of that level's command, compact_draws.comp then removes the empty commands
+	*	  and copies the DrawData of the others (with the dequantization of their mesh)
+	*	- the commands of meshes with 16-bit indexes come first, each index type is drawn
+	*	  by its own glMultiDrawElementsIndirectCount() call
+	*	- occluded objects that become visible show up one frame late
+	*	- textures aren't supported, objects are drawn with the shader as is
+	*
+	* Shaders: shaders/culling/cull_objects.comp, compact_draws.comp and depth_pyramid.comp
+	*/
+	class GpuCulling : public ObjectObserver
+	{
+	public:
+		GpuCulling(const std::string& shaderDir);
+		~GpuCulling();
+		GpuCulling(const GpuCulling&) = delete;
+		GpuCulling& operator=(const GpuCulling&) = delete;
+
+		void sync(list<Object*>& objects, GeometryBuffer& geometry);
+		void cull();
+		GLsizei draw(Shader& shader, UniformHandle<int> drawOffset, bool positionsOnly = false);
+		void update_depth_pyramid(const glm::mat4& viewProjection, GLsizei width, GLsizei height);
+		CullCounters read_counters();
+
+		void set_occlusion_culling(bool enabled) { mOcclusionCulling = enabled; }
+		bool occlusion_culling() const { return mOcclusionCulling; }
+		size_t object_count() const { return mObjects.size(); }
+		size_t command_count() const { return mCommands.size(); }
+
+		// ObjectObserver
+		void object_changed(Object& obj, uint32_t index) override;
+		void object_destroyed(uint32_t index) override;
+
+	private:
+		void reset();
+		void track(Object* obj);
+		void rebuild(GeometryBuffer& geometry);
+		void update_object(uint32_t index);
+		void upload_dirty_objects();
+
+		// programs and their uniforms
+		Shader mCullShader;
+		Shader mCompactShader;
+		UniformHandle<int> mObjectCountUniform;
+		UniformHandle<int> mOcclusionCullingUniform;
+		UniformHandle<glm::mat4> mPyramidViewProjectionUniform;
+		UniformHandle<int> mDepthPyramidUniform;
+		UniformHandle<int> mCommandCountUniform;
+		UniformHandle<int> mShortCommandCountUniform;
+
+		// observed objects, mObjects[i] is nullptr once object i has been destroyed
+		const list<Object*>* mObjectList;
+		size_t mListSize; // entries of mObjectList that are being tracked
+		vector<Object*> mObjects;
+		vector<shared_ptr<Mesh>> mMeshes; // mesh and LOD chain of each object at the last rebuild
+		vector<shared_ptr<LodChain>> mLodChains;
+		vector<bool> mDirty;
+		vector<uint32_t> mDirtyIndexes;
+		bool mRebuild; // objects were added or destroyed, or changed mesh
+
+		// CPU copies of the per-object buffers, see rebuild() and update_object()
+		vector<InstanceData> mInstances;
+		vector<ObjectBounds> mBounds;
+		vector<LodLevel> mLodLevels;
+		vector<DrawElementsIndirectCommand> mCommands; // instanceCount = 0, reset to this every frame
+		vector<DrawData> mCommandDraws; // draw data of each command
+		vector<shared_ptr<Mesh>> mCommandMeshes; // mesh of each command
+		vector<GLenum> mCommandIndexTypes;
+		GLuint mShortCommandCount; // the commands [0, mShortCommandCount) have 16-bit indexes
+		GeometryBuffer* mGeometry;
+		GLuint mInstanceCapacity; // instance slots of all commands together
+
+		// GPU buffers
+		StorageBuffer mObjectInstanceBuffer;
+		StorageBuffer mBoundsBuffer;
+		StorageBuffer mLodLevelBuffer;
+		StorageBuffer mObjectLodBuffer; // level of each object in the previous frame, for the hysteresis
+		StorageBuffer mCommandTemplateBuffer;
+		StorageBuffer mCommandDrawBuffer;
+		StorageBuffer mCullCommandBuffer;
+		StorageBuffer mCounterBuffer;
+		StorageBuffer mInstanceBuffer; // outputs, read by the draw call
+		StorageBuffer mDrawBuffer;
+		StorageBuffer mDrawCommandBuffer;
+
+		// occlusion culling against the depth of the previous frame
+		DepthPyramid mDepthPyramid;
+		glm::mat4 mPyramidViewProjection;
+		bool mOcclusionCulling;
+	};
+}
+
+#endif // !GPU_CULLING_H
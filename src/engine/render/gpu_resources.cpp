@@ -0,0 +1,151 @@
+#include <algorithm>
+#include "gpu_resources.h"
+#include "gl_state.h"
+
+std::unordered_map<uint64_t, size_t> ruya::GpuResources::sTracked;
+std::array<size_t, static_cast<size_t>(ruya::GpuResources::Type::COUNT)> ruya::GpuResources::sBytes{};
+std::array<size_t, static_cast<size_t>(ruya::GpuResources::Type::COUNT)> ruya::GpuResources::sCounts{};
+size_t ruya::GpuResources::sTotalBytes = 0;
+std::vector<ruya::GpuResources::Resource> ruya::GpuResources::sReleased;
+std::deque<ruya::GpuResources::Frame> ruya::GpuResources::sFramesInFlight;
+uint64_t ruya::GpuResources::sFrame = 1;
+uint64_t ruya::GpuResources::sCompletedFrame = 0;
+
+/*
+* Registers an object that holds bytes of GPU memory, an object that is tracked already
+* gets its size replaced (e.g. a buffer whose storage was reallocated).
+*/
+void ruya::GpuResources::track(Type type, GLuint name, size_t bytes)
+{
+	if (name == 0) return;
+
+	size_t t = static_cast<size_t>(type);
+	auto [it, inserted] = sTracked.try_emplace(key(type, name), 0);
+	if (inserted) sCounts[t]++;
+	sBytes[t] += bytes - it->second;
+	sTotalBytes += bytes - it->second;
+	it->second = bytes;
+}
+
+/*
+* Forgets the object and queues its deletion, see end_frame(). Objects that were never
+* tracked are deleted the same way. Name 0 is ignored.
+*/
+void ruya::GpuResources::release(Type type, GLuint name)
+{
+	if (name == 0) return;
+
+	auto it = sTracked.find(key(type, name));
+	if (it != sTracked.end())
+	{
+		size_t t = static_cast<size_t>(type);
+		sBytes[t] -= it->second;
+		sTotalBytes -= it->second;
+		sCounts[t]--;
+		sTracked.erase(it);
+	}
+	sReleased.push_back(Resource{ type, name });
+}
+
+/*
+* Fences the commands of the frame together with the objects released during it, then
+* deletes the objects of the oldest frames the GPU has finished. Frames finish in order,
+* so the first fence that hasn't signaled ends the check.
+* @pre all commands that use the objects released this frame must have been issued
+*/
+void ruya::GpuResources::end_frame()
+{
+	Frame& ended = sFramesInFlight.emplace_back();
+	ended.frame = sFrame++;
+	ended.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ended.released.swap(sReleased);
+
+	while (!sFramesInFlight.empty() && glClientWaitSync(sFramesInFlight.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+	{
+		Frame& done = sFramesInFlight.front();
+		for (const Resource& resource : done.released)
+			destroy(resource);
+		glDeleteSync(done.fence);
+		sCompletedFrame = done.frame;
+		sFramesInFlight.pop_front();
+	}
+}
+
+/*
+* Waits until the GPU is idle and deletes all released objects, including the ones of the
+* current frame.
+*/
+void ruya::GpuResources::flush()
+{
+	glFinish();
+	for (Frame& frame : sFramesInFlight)
+	{
+		for (const Resource& resource : frame.released)
+			destroy(resource);
+		glDeleteSync(frame.fence);
+	}
+	sFramesInFlight.clear();
+	for (const Resource& resource : sReleased)
+		destroy(resource);
+	sReleased.clear();
+	sCompletedFrame = sFrame;
+}
+
+/*
+* Number of released objects that haven't been deleted yet.
+*/
+size_t ruya::GpuResources::pending_deletions()
+{
+	size_t count = sReleased.size();
+	for (const Frame& frame : sFramesInFlight)
+		count += frame.released.size();
+	return count;
+}
+
+/*
+* Estimated size of a texture (array) with the given number of bytes per texel, a full
+* mipmap chain adds a third.
+*/
+size_t ruya::GpuResources::texture_bytes(GLsizei width, GLsizei height, GLsizei layers, size_t bytesPerTexel, bool mipmaps)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += static_cast<size_t>(width) * height * layers * bytesPerTexel;
+		if (!mipmaps || (width == 1 && height == 1)) return bytes;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+}
+
+void ruya::GpuResources::destroy(const Resource& resource)
+{
+	switch (resource.type)
+	{
+		case Type::BUFFER:
+			glDeleteBuffers(1, &resource.name);
+			GLState::forget_buffer(resource.name);
+			break;
+		case Type::VERTEX_ARRAY:
+			glDeleteVertexArrays(1, &resource.name);
+			GLState::forget_vertex_array(resource.name);
+			break;
+		case Type::TEXTURE:
+			glDeleteTextures(1, &resource.name);
+			GLState::forget_texture(resource.name);
+			break;
+		case Type::PROGRAM:
+			glDeleteProgram(resource.name);
+			GLState::forget_program(resource.name);
+			break;
+		case Type::QUERY:
+			glDeleteQueries(1, &resource.name);
+			break;
+		case Type::FRAMEBUFFER:
+			glDeleteFramebuffers(1, &resource.name);
+			GLState::forget_framebuffer(resource.name);
+			break;
+		default:
+			break;
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+namespace ruya
+{
+	/*
+	* Owner of the lifetime of the OpenGL objects of the engine (buffers, vertex arrays,
+	* textures and programs) and the memory they take up.
+	*	- objects are registered with track() once they have storage, with an estimate of
+	*	  their size in bytes, which is what bytes() adds up (the driver doesn't tell)
+	*	- release() replaces glDeleteXxx(): the object is deleted once the GPU has finished
+	*	  all commands issued up to the end of the frame in which it was released, so code
+	*	  can drop objects that draw calls in flight still read without stalling the frame
+	*	- end_frame() places the fence of the frame and deletes the objects of the frames
+	*	  whose fence has signaled, it never waits. completed_frame() tells up to which frame
+	*	  the GPU is done, for memory that is reused instead of deleted (GeometryBuffer)
+	*	- flush() waits for the GPU and deletes everything that was released (shutdown)
+	*
+	* There is only one context, so the state is static, like GLState.
+	*/
+	class GpuResources
+	{
+	public:
+		enum class Type { BUFFER, VERTEX_ARRAY, TEXTURE, PROGRAM, QUERY, FRAMEBUFFER, COUNT };
+
+		static void track(Type type, GLuint name, size_t bytes);
+		static void release(Type type, GLuint name);
+		static void end_frame();
+		static void flush();
+
+		static uint64_t frame() { return sFrame; } // frames ended so far + 1
+		static uint64_t completed_frame() { return sCompletedFrame; } // the GPU finished frames <= this one
+		static size_t bytes() { return sTotalBytes; }
+		static size_t bytes(Type type) { return sBytes[static_cast<size_t>(type)]; }
+		static size_t count(Type type) { return sCounts[static_cast<size_t>(type)]; }
+		static size_t pending_deletions();
+
+		static size_t texture_bytes(GLsizei width, GLsizei height, GLsizei layers, size_t bytesPerTexel, bool mipmaps);
+
+	private:
+		struct Resource
+		{
+			Type type;
+			GLuint name;
+		};
+
+		/*
+		* Objects released during a frame, deleted once its fence has signaled.
+		*/
+		struct Frame
+		{
+			uint64_t frame = 0;
+			GLsync fence = 0;
+			std::vector<Resource> released;
+		};
+
+		static uint64_t key(Type type, GLuint name) { return (static_cast<uint64_t>(type) << 32) | name; }
+		static void destroy(const Resource& resource);
+
+		static std::unordered_map<uint64_t, size_t> sTracked; // bytes by key()
+		static std::array<size_t, static_cast<size_t>(Type::COUNT)> sBytes;
+		static std::array<size_t, static_cast<size_t>(Type::COUNT)> sCounts;
+		static size_t sTotalBytes;
+		static std::vector<Resource> sReleased; // this frame
+		static std::deque<Frame> sFramesInFlight; // oldest first
+		static uint64_t sFrame;
+		static uint64_t sCompletedFrame;
+	};
+}
+
+#endif // !GPU_RESOURCES_H
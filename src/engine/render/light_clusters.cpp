@@ -0,0 +1,64 @@
+#include <cmath>
+
+#include "light_clusters.h"
+#include "gl_state.h"
+
+namespace
+{
+	constexpr GLuint ASSIGN_LOCAL_SIZE = 64; // local_size_x of light_clusters.comp
+}
+
+ruya::LightClusters::LightClusters(const std::string& shaderDir)
+	: mAssignShader((shaderDir + "/light_clusters.comp").c_str()),
+	  mScreenSizeUniform(mAssignShader.uniform<glm::vec2>("screenSize")),
+	  mScreenSize(0.0f), mCapacity(DEFAULT_CLUSTER_CAPACITY),
+	  mCountBuffer(StorageBindings::CLUSTER_LIGHT_COUNTS, cluster_count() * sizeof(GLuint)),
+	  mIndexBuffer(StorageBindings::CLUSTER_LIGHT_INDEXES)
+{
+}
+
+/*
+* Fills in the cluster fields of the constants for a view of width x height pixels, the
+* near and far plane must already be set.
+*/
+void ruya::LightClusters::configure(LightingConstants& constants, GLsizei width, GLsizei height)
+{
+	mScreenSize = glm::vec2(width, height);
+	constants.clusterCount = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, mCapacity);
+	constants.tileSize = glm::vec2(std::ceil(static_cast<float>(width) / CLUSTERS_X), std::ceil(static_cast<float>(height) / CLUSTERS_Y));
+	// slice 0 starts at the near plane, slice CLUSTERS_Z ends at the far plane
+	float slices = static_cast<float>(CLUSTERS_Z);
+	float depthRange = std::log(constants.farPlane / constants.nearPlane);
+	constants.sliceScale = slices / depthRange;
+	constants.sliceBias = -slices * std::log(constants.nearPlane) / depthRange;
+}
+
+/*
+* Lists the lights of each cluster on the GPU, binds the lists to
+* StorageBindings::CLUSTER_LIGHT_COUNTS and CLUSTER_LIGHT_INDEXES.
+* @pre the frame constants, the lighting constants (with the fields of configure()) and the
+*	   lights must have been bound for this frame
+*/
+void ruya::LightClusters::assign()
+{
+	mIndexBuffer.reserve(static_cast<GLsizeiptr>(cluster_count()) * mCapacity * sizeof(GLuint));
+	mCountBuffer.bind();
+	mIndexBuffer.bind();
+
+	mAssignShader.use();
+	mAssignShader.set(mScreenSizeUniform, mScreenSize);
+	RUYA_GL(glDispatchCompute((cluster_count() + ASSIGN_LOCAL_SIZE - 1) / ASSIGN_LOCAL_SIZE, 1, 1));
+	RUYA_GL(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+/*
+* Number of lights listed for each cluster by the last assign(), clusters are ordered by
+* slice, then row, then column. Waits for the GPU to finish (stalls the pipeline, meant for
+* statistics and benchmarks).
+*/
+std::vector<GLuint> ruya::LightClusters::read_light_counts() const
+{
+	std::vector<GLuint> counts(cluster_count());
+	glGetNamedBufferSubData(mCountBuffer.ID(), 0, counts.size() * sizeof(GLuint), counts.data());
+	return counts;
+}
@@ -0,0 +1,64 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "engine/render/shader.h"
+#include "engine/render/storage_buffer.h"
+#include "engine/render/uniform_blocks.h"
+
+namespace ruya
+{
+	/*
+	* Clustered forward lighting: the view frustum is split in clusters (froxels), tiles of
+	* the screen that are cut in slices along the view depth, and a compute pass lists the
+	* lights that reach each cluster. The object shaders then only loop over the lights of
+	* the cluster of their fragment instead of over all lights of the scene.
+	*	- the slices grow exponentially with the depth, so that clusters are about as deep as
+	*	  they are wide everywhere in the view
+	*	- the lights are tested as spheres (position, LightSource::range()) against the view
+	*	  space bounding box of each cluster, lights without range are in every cluster
+	*	- each cluster lists at most cluster_capacity() lights, any further lights that
+	*	  reach it are dropped
+	*	- the lists are rebuilt every frame, for the lights and the camera of the frame
+	*
+	* The Renderer fills in the cluster fields of its LightingConstants with configure(),
+	* streams the constants and the lights and then runs assign().
+	*
+	* Shader: shaders/lighting/light_clusters.comp, the lookup is in shaders/common/lights.glsl
+	*/
+	class LightClusters
+	{
+	public:
+		static constexpr GLuint CLUSTERS_X = 16;
+		static constexpr GLuint CLUSTERS_Y = 9;
+		static constexpr GLuint CLUSTERS_Z = 24;
+		static constexpr GLuint DEFAULT_CLUSTER_CAPACITY = 128;
+
+		LightClusters(const std::string& shaderDir);
+		LightClusters(const LightClusters&) = delete;
+		LightClusters& operator=(const LightClusters&) = delete;
+
+		void configure(LightingConstants& constants, GLsizei width, GLsizei height);
+		void assign();
+		std::vector<GLuint> read_light_counts() const;
+
+		void set_cluster_capacity(GLuint lights) { mCapacity = lights > 0 ? lights : 1; }
+		GLuint cluster_capacity() const { return mCapacity; }
+		static constexpr GLuint cluster_count() { return CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z; }
+
+	private:
+		Shader mAssignShader;
+		UniformHandle<glm::vec2> mScreenSizeUniform;
+		glm::vec2 mScreenSize; // of the last configure()
+		GLuint mCapacity;
+
+		StorageBuffer mCountBuffer; // lights per cluster
+		StorageBuffer mIndexBuffer; // mCapacity light indexes per cluster
+	};
+}
+
+#endif // !LIGHT_CLUSTERS_H
@@ -0,0 +1,126 @@
+#include "meshlet_culling.h"
+#include "gl_state.h"
+
+namespace
+{
+	constexpr GLuint CULL_LOCAL_SIZE = 64; // local_size_x of cull_meshlets.comp
+}
+
+ruya::MeshletCulling::MeshletCulling(const std::string& shaderDir)
+	: mCullShader((shaderDir + "/cull_meshlets.comp").c_str()),
+	  mJobCountUniform(mCullShader.uniform<int>("jobCount")),
+	  mWorkCountUniform(mCullShader.uniform<int>("workCount")),
+	  mShortCommandCountUniform(mCullShader.uniform<int>("shortCommandCount")),
+	  mBackfaceCullingUniform(mCullShader.uniform<int>("backfaceCulling")),
+	  mWorkCount(0), mShortWorkCount(0), mMinMeshlets(DEFAULT_MIN_MESHLETS), mBackfaceCulling(true),
+	  mJobBuffer(StorageBindings::MESHLET_JOBS), mCounterBuffer(StorageBindings::MESHLET_COUNTERS, sizeof(MeshletCounters)),
+	  mDrawBuffer(StorageBindings::DRAWS), mDrawCommandBuffer(StorageBindings::DRAW_COMMANDS)
+{
+}
+
+/*
+* Drops the jobs of the previous frame.
+*/
+void ruya::MeshletCulling::clear()
+{
+	mJobs.clear();
+	mWorkCount = 0;
+	mShortWorkCount = 0;
+}
+
+/*
+* Adds the instances [firstInstance, firstInstance + instanceCount) of the instance buffer
+* of the frame, they all use the mesh of the range.
+* @pre accepts(range)
+*/
+void ruya::MeshletCulling::add(const GeometryBuffer::MeshRange& range, GLuint firstInstance, GLuint instanceCount)
+{
+	MeshletJob& job = mJobs.emplace_back();
+	job.firstWork = mWorkCount;
+	job.firstMeshlet = range.firstMeshlet;
+	job.meshletCount = range.meshletCount;
+	job.firstInstance = firstInstance;
+	job.instanceCount = instanceCount;
+	job.firstIndex = range.firstIndex;
+	job.baseVertex = range.baseVertex;
+	job.shortIndexes = range.indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+	job.draw = range.draw_data(firstInstance);
+
+	GLuint work = range.meshletCount * instanceCount;
+	mWorkCount += work;
+	if (job.shortIndexes) mShortWorkCount += work;
+}
+
+/*
+* Culls the meshlets of all jobs and builds the draw commands of the visible ones on the GPU.
+* Binds its own draw data and draw commands to StorageBindings::DRAWS and DRAW_COMMANDS.
+* @pre the frame constants and the instance data of the jobs must have been bound for this frame
+*/
+void ruya::MeshletCulling::cull(const GeometryBuffer& geometry)
+{
+	if (mJobs.empty()) return;
+
+	RUYA_GL(glClearNamedBufferData(mCounterBuffer.ID(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+	mJobBuffer.upload(mJobs);
+	mDrawBuffer.reserve(mWorkCount * sizeof(DrawData));
+	mDrawCommandBuffer.reserve(mWorkCount * sizeof(DrawElementsIndirectCommand));
+
+	geometry.bind_meshlets();
+	mJobBuffer.bind();
+	mCounterBuffer.bind();
+	mDrawBuffer.bind();
+	mDrawCommandBuffer.bind();
+
+	mCullShader.use();
+	mCullShader.set(mJobCountUniform, (int)mJobs.size());
+	mCullShader.set(mWorkCountUniform, (int)mWorkCount);
+	mCullShader.set(mShortCommandCountUniform, (int)mShortWorkCount);
+	mCullShader.set(mBackfaceCullingUniform, mBackfaceCulling ? 1 : 0);
+	RUYA_GL(glDispatchCompute((mWorkCount + CULL_LOCAL_SIZE - 1) / CULL_LOCAL_SIZE, 1, 1));
+	RUYA_GL(glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+/*
+* Draws the visible meshlets with one glMultiDrawElementsIndirectCount() call per index
+* type, drawOffset is set to the first command of each call. positionsOnly: see
+* GpuCulling::draw().
+* @pre cull() must have been called this frame
+* @pre the shader program must be current
+* @returns the number of multi-draw calls
+*/
+GLsizei ruya::MeshletCulling::draw(const GeometryBuffer& geometry, Shader& shader, UniformHandle<int> drawOffset, bool positionsOnly)
+{
+	if (mJobs.empty()) return 0;
+
+	if (positionsOnly) geometry.bind_positions();
+	else geometry.bind();
+	mDrawBuffer.bind();
+	GLState::bind_buffer(GL_DRAW_INDIRECT_BUFFER, mDrawCommandBuffer.ID());
+	GLState::bind_buffer(GL_PARAMETER_BUFFER, mCounterBuffer.ID()); // MeshletCounters::drawCount[group] is at offset 4 * group
+
+	GLsizei calls = 0;
+	GLuint firstCommands[3] = { 0, mShortWorkCount, mWorkCount };
+	for (GLuint group = 0; group < 2; group++)
+	{
+		GLsizei maxCount = static_cast<GLsizei>(firstCommands[group + 1] - firstCommands[group]);
+		if (maxCount == 0) continue;
+		shader.set(drawOffset, (int)firstCommands[group]);
+		const void* offset = (const void*)(firstCommands[group] * sizeof(DrawElementsIndirectCommand));
+		GLenum indexType = group == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		RUYA_GL(glMultiDrawElementsIndirectCount(GL_TRIANGLES, indexType, offset, group * sizeof(GLuint), maxCount, 0));
+		calls++;
+	}
+	GLState::bind_buffer(GL_PARAMETER_BUFFER, 0); // see GpuCulling::draw()
+	return calls;
+}
+
+/*
+* Counters of the last cull(), waits for the GPU to finish culling (stalls the pipeline,
+* meant for statistics and benchmarks).
+*/
+ruya::MeshletCounters ruya::MeshletCulling::read_counters()
+{
+	MeshletCounters counters{};
+	glGetNamedBufferSubData(mCounterBuffer.ID(), 0, sizeof(MeshletCounters), &counters);
+	return counters;
+}
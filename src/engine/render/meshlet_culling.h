@@ -0,0 +1,79 @@
+#ifndef MESHLET_CULLING_H
+#define MESHLET_CULLING_H
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "engine/render/shader.h"
+#include "engine/render/storage_buffer.h"
+#include "engine/render/geometry_buffer.h"
+#include "engine/render/uniform_blocks.h"
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Draws dense meshes meshlet by meshlet (see Meshlet), so that the parts of an object that
+	* are outside of the view or that face away from the camera aren't drawn.
+	*	- the Renderer hands over the instance groups whose mesh has at least min_meshlets()
+	*	  meshlets as jobs (add()) instead of drawing them with one command per group
+	*	- cull_meshlets.comp tests every meshlet of every instance against the frustum
+	*	  (bounding sphere) and the camera position (normal cone) and appends a draw command
+	*	  of one instance of the meshlet's faces for each visible one, with its DrawData
+	*	- the commands of meshes with 16-bit indexes come first, each index type is drawn
+	*	  by its own glMultiDrawElementsIndirectCount() call
+	*	- back-face culling assumes closed meshes seen from outside, like GL_CULL_FACE would:
+	*	  meshlets seen from their back side are dropped even though no faces are culled
+	*	- only for the objects drawn by the Renderer on the CPU path, GpuCulling draws whole
+	*	  meshes
+	*
+	* Small meshes are drawn whole: a command per meshlet costs more than the faces it saves.
+	*
+	* Shader: shaders/culling/cull_meshlets.comp
+	*/
+	class MeshletCulling
+	{
+	public:
+		static constexpr GLuint DEFAULT_MIN_MESHLETS = 32;
+
+		MeshletCulling(const std::string& shaderDir);
+		MeshletCulling(const MeshletCulling&) = delete;
+		MeshletCulling& operator=(const MeshletCulling&) = delete;
+
+		bool accepts(const GeometryBuffer::MeshRange& range) const { return range.meshletCount >= mMinMeshlets; }
+		void clear();
+		void add(const GeometryBuffer::MeshRange& range, GLuint firstInstance, GLuint instanceCount);
+		void cull(const GeometryBuffer& geometry);
+		GLsizei draw(const GeometryBuffer& geometry, Shader& shader, UniformHandle<int> drawOffset, bool positionsOnly = false);
+		MeshletCounters read_counters();
+
+		void set_min_meshlets(GLuint count) { mMinMeshlets = count; }
+		GLuint min_meshlets() const { return mMinMeshlets; }
+		void set_backface_culling(bool enabled) { mBackfaceCulling = enabled; }
+		bool backface_culling() const { return mBackfaceCulling; }
+		size_t job_count() const { return mJobs.size(); }
+		GLuint work_count() const { return mWorkCount; } // meshlets to test, for all instances
+
+	private:
+		Shader mCullShader;
+		UniformHandle<int> mJobCountUniform;
+		UniformHandle<int> mWorkCountUniform;
+		UniformHandle<int> mShortCommandCountUniform;
+		UniformHandle<int> mBackfaceCullingUniform;
+
+		vector<MeshletJob> mJobs; // of the current frame
+		GLuint mWorkCount;
+		GLuint mShortWorkCount; // work of the jobs with 16-bit indexes, their commands are [0, mShortWorkCount)
+		GLuint mMinMeshlets;
+		bool mBackfaceCulling;
+
+		StorageBuffer mJobBuffer;
+		StorageBuffer mCounterBuffer;
+		StorageBuffer mDrawBuffer; // outputs, read by the draw call
+		StorageBuffer mDrawCommandBuffer;
+	};
+}
+
+#endif // !MESHLET_CULLING_H
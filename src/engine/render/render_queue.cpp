@@ -0,0 +1,58 @@
+#include <algorithm>
+
+#include "render_queue.h"
+
+/*
+* Packs the draw in a 64-bit key, from most to least significant bits:
+*	- STATE:			pass (2) | shader (6) | texture (16) | mesh (16) | depth (24)
+*	- FRONT_TO_BACK:	pass (2) | shader (6) | depth (24) | texture (16) | mesh (16)
+*	- SUBMISSION:		pass (2) | shader (6) | sequence (56)
+*/
+uint64_t ruya::RenderQueue::make_key(const DrawKey& key, SortOrder order)
+{
+	uint64_t pass = key.pass & 0x3;
+	uint64_t shader = key.shader & 0x3F;
+	uint64_t texture = key.texture & 0xFFFF;
+	uint64_t mesh = key.mesh & 0xFFFF;
+	uint64_t depth = static_cast<uint64_t>(std::clamp(key.depth, 0.0f, 1.0f) * 0xFFFFFF);
+
+	uint64_t result = (pass << 62) | (shader << 56);
+	switch (order)
+	{
+		case SortOrder::STATE:			result |= (texture << 40) | (mesh << 24) | depth;	break;
+		case SortOrder::FRONT_TO_BACK:	result |= (depth << 32) | (texture << 16) | mesh;	break;
+		case SortOrder::SUBMISSION:		result |= key.sequence;								break;
+	}
+	return result;
+}
+
+/*
+* Sorts the items on their key with an LSD radix sort, one pass per byte of the key. The
+* sort is stable, so items with equal keys keep the order in which they were pushed. Bytes
+* that are the same for all items (unused key fields) are skipped.
+*/
+void ruya::RenderQueue::sort()
+{
+	if (mItems.size() < 2) return;
+
+	mScratch.resize(mItems.size());
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (const Item& item : mItems)
+			counts[(item.key >> shift) & 0xFF]++;
+		if (counts[(mItems[0].key >> shift) & 0xFF] == mItems.size())
+			continue;
+
+		size_t offset = 0;
+		for (size_t& count : counts)
+		{
+			size_t c = count;
+			count = offset;
+			offset += c;
+		}
+		for (const Item& item : mItems)
+			mScratch[counts[(item.key >> shift) & 0xFF]++] = item;
+		mItems.swap(mScratch);
+	}
+}
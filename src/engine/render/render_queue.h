@@ -0,0 +1,63 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Order in which the draws of a pass are sorted.
+	*	- STATE: by shader, texture and mesh, so that draws sharing state end up next to
+	*	  each other (fewest state changes, largest instance groups), then front to back
+	*	- FRONT_TO_BACK: by shader then depth, so that early-z rejects as many hidden
+	*	  fragments as possible, draws with the same state only merge when they are adjacent
+	*	- SUBMISSION: the order in which the draws were pushed (the scene order)
+	*/
+	enum class SortOrder { STATE, FRONT_TO_BACK, SUBMISSION };
+
+	/*
+	* Everything that determines where a draw ends up in the queue. Fields are truncated to
+	* the number of bits they get in the key, see make_key().
+	*/
+	struct DrawKey
+	{
+		uint32_t pass = 0;		// 2 bits, passes are drawn in increasing order
+		uint32_t shader = 0;	// 6 bits
+		uint32_t texture = 0;	// 16 bits, 0 = no texture
+		uint32_t mesh = 0;		// 16 bits
+		float depth = 0.0f;		// 24 bits, distance to the camera divided by the far plane, [0, 1]
+		uint32_t sequence = 0;	// used instead of the other fields for SortOrder::SUBMISSION
+	};
+
+	/*
+	* Queue of draws that are sorted on a 64-bit key. Each item carries a 32-bit value, the
+	* index of the draw in whatever list the caller keeps.
+	*/
+	class RenderQueue
+	{
+	public:
+		struct Item
+		{
+			uint64_t key;
+			uint32_t value;
+		};
+
+		static uint64_t make_key(const DrawKey& key, SortOrder order);
+
+		void push(uint64_t key, uint32_t value) { mItems.push_back(Item{ key, value }); }
+		void sort();
+		void clear() { mItems.clear(); }
+
+		const vector<Item>& items() const { return mItems; }
+		size_t size() const { return mItems.size(); }
+
+	private:
+		vector<Item> mItems;
+		vector<Item> mScratch; // radix sort ping-pong buffer
+	};
+}
+
+#endif // !RENDER_QUEUE_H
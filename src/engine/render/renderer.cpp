@@ -1,5 +1,9 @@
 #include <list>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,390 +11,725 @@
 #include "glm/gtx/string_cast.hpp"
 
 #include "engine/render/renderer.h"
+#include "engine/render/frustum.h"
 #include "engine/scene/texture.h"
+#include "engine/scene/mesh_optimizer.h"
 
 
 using std::list;
 using glm::mat4;	using glm::mat3;
 
+namespace
+{
+	/*
+	* Binds a chunk of the stream buffer to an indexed binding point (uniform block or 
+	* shader storage block).
+	*/
+	void bind_range(GLenum target, GLuint bindingPoint, const ruya::RingBuffer::Allocation& allocation)
+	{
+		if (allocation.size > 0)
+			ruya::GLState::bind_buffer_range(target, bindingPoint, allocation.buffer, allocation.offset, allocation.size);
+	}
+}
+
 ruya::Renderer::Renderer(Shader* shaderObjects, Shader* shaderLights, Window* window, Camera* camera)
 	: mWindow(window), mCamera(camera), mSmoothShaderObjects(shaderObjects), mShaderLights(shaderLights),
-	  mFlatShaderObjects(nullptr), mShadingMode(ShadingMode::SMOOTH),
-	INDEX_VERTEX_ATTRIB(0),
-	INDEX_NORMAL_ATTRIB(1),
-	INDEX_TEXTURE_ATTRIB(2)
+	  mFlatShaderObjects{}, mShadingMode(ShadingMode::SMOOTH),
+	  mSmoothUniforms(*shaderObjects), mLightUniforms(*shaderLights),
+	  mClock(true),
+	  mInstancing(true),
+	  mStreamBuffer(1 << 20), mUniformAlignment(RingBuffer::uniform_alignment()), mStorageAlignment(RingBuffer::storage_alignment()),
+	  mLodError(1.0f), mLodBias(0.0f), mLodScale(0.0f),
+	  mSortOrder(SortOrder::STATE), mLastShader(nullptr), mLastTextureArray(-1),
+	  mBindless(BindlessTextures::supported()),
+	  mLoader(nullptr),
+	  mGpuCulling(nullptr), mViewProjection(1.0f),
+	  mMeshletCulling(nullptr),
+	  mLightClusters(nullptr),
+	  mDeferred(nullptr),
+	  mVisibilityBuffer(nullptr),
+	  mFlatShading(FlatShading::GEOMETRY_SHADER), mFrameIndex(0),
+	  mDepthPrepass(false), mDepthShaders{}, mFragmentQueries{}, mQueriesIssued{}, mQueryFrame(0)
 {
 	// enable depth test
-	glEnable(GL_DEPTH_TEST);
+	GLState::enable(GL_DEPTH_TEST);
 
-	// During init, enable debug output
-	glEnable(GL_DEBUG_OUTPUT);
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-	glDebugMessageCallback(debug_mesage_callback, 0);
+	glCreateQueries(GL_SAMPLES_PASSED, QUERY_FRAMES * 2, &mFragmentQueries[0][0]);
+	for (const auto& queries : mFragmentQueries)
+		for (GLuint query : queries) GpuResources::track(GpuResources::Type::QUERY, query, 0);
+}
+
+ruya::Renderer::~Renderer()
+{
+	for (const auto& queries : mFragmentQueries)
+		for (GLuint query : queries) GpuResources::release(GpuResources::Type::QUERY, query);
+}
+
+/*
+* Shader of ShadingMode::FLAT for the given implementation, selected with set_flat_shading().
+*/
+void ruya::Renderer::set_flat_shader(Shader* flatShader, FlatShading implementation)
+{
+	mFlatShaderObjects[static_cast<int>(implementation)] = flatShader;
+	mFlatUniforms[static_cast<int>(implementation)] = flatShader ? ObjectUniforms(*flatShader) : ObjectUniforms();
+}
+
+/*
+* Shader of the depth pre-pass (see set_depth_prepass()) for the objects drawn in the given
+* shading mode. GL_EQUAL only passes if both passes compute exactly the same positions, so
+* it has to run the same vertex stages as the object shader of the mode with an invariant
+* gl_Position: shaders/depth/depth.vert for the phong shaders and the flat shaders without
+* geometry shader (FlatShading::DERIVATIVES and PROVOKING_VERTEX use the depth shader of
+* ShadingMode::SMOOTH), flat_vert and flat_geom for the FlatShading::GEOMETRY_SHADER flat
+* shader. The fragment shader is shaders/depth/depth.frag.
+*/
+void ruya::Renderer::set_depth_shader(Shader* depthShader, ShadingMode mode)
+{
+	mDepthShaders[static_cast<int>(mode)] = depthShader;
+	mDepthUniforms[static_cast<int>(mode)] = depthShader ? ObjectUniforms(*depthShader) : ObjectUniforms();
+}
+
+/*
+* Renders the objects deferred (see DeferredShading) in both shading modes, the depth
+* pre-pass then always uses the depth shader of ShadingMode::SMOOTH since the G-buffer
+* shader runs shaders/phong/object.vert.
+*/
+void ruya::Renderer::set_deferred_shading(DeferredShading* deferred)
+{
+	mDeferred = deferred;
+	mDeferredUniforms = deferred ? ObjectUniforms(deferred->gbuffer_shader()) : ObjectUniforms();
+}
+
+/*
+* Renders the objects through the visibility buffer (see VisibilityBuffer) in both shading
+* modes. Only on the CPU path, render_scene() throws with GpuCulling or DeferredShading. The
+* meshes MeshletCulling would take are drawn whole, the depth pre-pass uses the depth shader
+* of ShadingMode::SMOOTH.
+*/
+void ruya::Renderer::set_visibility_buffer(VisibilityBuffer* visibility)
+{
+	mVisibilityBuffer = visibility;
+	mVisibilityUniforms = visibility ? ObjectUniforms(visibility->visibility_shader()) : ObjectUniforms();
 }
 
 void ruya::Renderer::render_scene(Scene& scene)
 {
-	// OBJECTS
-	// activate object shader to render objects
+	mFrameStats = FrameStats();
+	mFrameStats.transformsUpdated = TransformSystem::update(); // the objects moved since the last frame, in batches
+	GLState::begin_frame();
+	mStreamBuffer.begin_frame();
+	if (mLoader) mLoader->update(); // before the geometry takes the staged meshes
+	mGeometry.begin_frame();
+	mTextureArrays.collect();
+	mBindlessTextures.collect();
+
+	// camera and light data is the same for every object, write it once for the whole frame
+	list<LightSource*>& lights = scene.get_light_sources();
+	update_frame_constants();
+	update_lights(lights);
+
 	Shader* activeObjectShader = nullptr;
+	const ObjectUniforms* activeUniforms = nullptr;
 	switch (mShadingMode)
 	{
-		case ShadingMode::SMOOTH:	activeObjectShader = mSmoothShaderObjects;	break;
-		case ShadingMode::FLAT:		activeObjectShader = mFlatShaderObjects;	break;
+		case ShadingMode::SMOOTH:	activeObjectShader = mSmoothShaderObjects;	activeUniforms = &mSmoothUniforms;	break;
+		case ShadingMode::FLAT:
+			activeObjectShader = mFlatShaderObjects[static_cast<int>(mFlatShading)];
+			activeUniforms = &mFlatUniforms[static_cast<int>(mFlatShading)];
+			break;
+	}
+	// provoking vertex meshes: only where the objects are drawn with the flat shader
+	bool flatMeshes = mShadingMode == ShadingMode::FLAT && mFlatShading == FlatShading::PROVOKING_VERTEX && !mDeferred && !mVisibilityBuffer;
+	if (mShadingMode == ShadingMode::FLAT && !activeObjectShader && !mDeferred && !mVisibilityBuffer)
+		throw std::runtime_error("[Renderer] no flat shader for the flat shading implementation, see set_flat_shader()");
+	if (flatMeshes && mGpuCulling)
+		throw std::runtime_error("[Renderer] flat shading with the provoking vertex only works on the CPU path");
+	collect_flat_meshes();
+	if (mDeferred)
+	{
+		activeObjectShader = &mDeferred->gbuffer_shader();
+		activeUniforms = &mDeferredUniforms;
+	}
+	if (mVisibilityBuffer)
+	{
+		if (mGpuCulling || mDeferred)
+			throw std::runtime_error("[Renderer] the visibility buffer only works on the CPU path and without deferred shading");
+		activeObjectShader = &mVisibilityBuffer->visibility_shader();
+		activeUniforms = &mVisibilityUniforms;
 	}
-	activeObjectShader->use();
-
-	// get view-projection matrix
-	mat4 projection = glm::perspective(glm::radians(mCamera->fov()), mWindow->aspect_ratio(), 0.1f, 300.0f);
-	mat4 VP = projection * mCamera->view_matrix();
 
-	// render scene objects
-	list<Object*>& objects = scene.get_scene_objects();
-	for (Object* obj : objects)
+	// GPU driven: the objects are culled and batched without any per-object work here
+	if (mGpuCulling)
 	{
-		render_object(*obj, VP, **(scene.get_light_sources().begin()), activeObjectShader);
+		mGpuCulling->sync(scene.get_scene_objects(), mGeometry);
+		mGpuCulling->cull();
 	}
 
-	// LIGHT SOURCES
-	mShaderLights->use();
-	list<LightSource*> lights = scene.get_light_sources();
+	// sort the draws of objects and light sources, group the ones that share a mesh, then 
+	// stream all their per-instance data and draw commands to the GPU at once
+	mQueue.clear();
+	mQueuedObjects.clear();
+	mQueuedMeshes.clear();
+	if (!mGpuCulling)
+	{
+		cull_objects(scene.get_scene_objects());
+		for (size_t i = 0; i < mCulledObjects.size(); i++)
+		{
+			if (mVisibility[i])
+			{
+				shared_ptr<Mesh> mesh = lod_mesh(*mCulledObjects[i], mCulledSpheres[i]);
+				queue_draw(*mCulledObjects[i], RenderPass::OBJECTS, *activeObjectShader, flatMeshes ? flat_mesh(mesh) : mesh);
+			}
+		}
+	}
 	for (LightSource* light : lights)
+		queue_draw(light->model(), RenderPass::LIGHTS, *mShaderLights, light->model().mesh());
+	mQueue.sort();
+	build_instance_groups();
+
+	mInstanceData.clear();
+	write_instance_data(mObjectGroups);
+	write_instance_data(mLightGroups);
+
+	mDrawData.clear();
+	mDrawCommands.clear();
+	if (mMeshletCulling)
+		mMeshletCulling->clear();
+	write_draw_commands(mObjectGroups, mObjectBatches, mVisibilityBuffer ? nullptr : mMeshletCulling);
+	write_draw_commands(mLightGroups, mLightBatches);
+	upload_frame_data();
+	if (mVisibilityBuffer)
+		write_visible_draws();
+	if (mBindless)
+		mBindlessTextures.bind();
+	if (mMeshletCulling && mMeshletCulling->job_count() > 0)
 	{
-		render_light_source(*light, VP);
+		mMeshletCulling->cull(mGeometry);
+		mFrameStats.meshlets = mMeshletCulling->work_count();
+		bind_frame_data(); // the culling bound its own draw data
 	}
-}
 
-/*
-* Handles the necessary OpenGL calls to render the object with the shader program
-* that this Renderer has. If the Mesh of the Object is being rendered for the first
-* time, the necessary buffers (VAO, VBO & EBO) will be created automatically.
-* 
-* @pre the correct shader program needs to be made current before calling this function.
-*/
-void ruya::Renderer::render_object(Object& obj, const mat4& viewProjectTransform, const LightSource& light, Shader* activeShader)
-{	
-	// Bind the textures and set their uniform location
-	if (obj.texture())
+	// OBJECTS: with the pre-pass, only the fragments whose depth equals the nearest depth of
+	// their pixel are shaded. Deferred, they are drawn to the G-buffer and lit afterwards.
+	read_fragment_queries();
+	if (mDeferred)
+		mDeferred->begin(mWindow->width(), mWindow->height(), mShadingMode == ShadingMode::FLAT);
+	if (mVisibilityBuffer)
+		mVisibilityBuffer->begin(mWindow->width(), mWindow->height());
+	if (mDepthPrepass)
 	{
-		GLuint textureSlot = mSlotManager.bind_texture(*obj.texture());
-		activeShader->setInt("ourTexture", textureSlot - GL_TEXTURE0); // TODO: save texture uniform name in Shader class instead of hardcoding
+		bool geometryShader = mShadingMode == ShadingMode::FLAT && mFlatShading == FlatShading::GEOMETRY_SHADER && !mDeferred && !mVisibilityBuffer;
+		int mode = static_cast<int>(geometryShader ? ShadingMode::FLAT : ShadingMode::SMOOTH);
+		if (!mDepthShaders[mode])
+			throw std::runtime_error("[Renderer] the depth pre-pass has no depth shader for the shading mode, see set_depth_shader()");
+		GLState::color_mask(false);
+		RUYA_GL(glBeginQuery(GL_SAMPLES_PASSED, mFragmentQueries[mQueryFrame][0]));
+		draw_objects(mDepthShaders[mode], mDepthUniforms[mode], true, false);
+		RUYA_GL(glEndQuery(GL_SAMPLES_PASSED));
+		mQueriesIssued[mQueryFrame][0] = true;
+		GLState::color_mask(true);
+		GLState::depth_func(GL_EQUAL);
+		GLState::depth_mask(false);
 	}
+	RUYA_GL(glBeginQuery(GL_SAMPLES_PASSED, mFragmentQueries[mQueryFrame][1]));
+	draw_objects(activeObjectShader, *activeUniforms, mVisibilityBuffer != nullptr, true);
+	RUYA_GL(glEndQuery(GL_SAMPLES_PASSED));
+	mQueriesIssued[mQueryFrame][1] = true;
+	mQueryFrame = (mQueryFrame + 1) % QUERY_FRAMES;
+	GLState::depth_func(GL_LESS);
+	GLState::depth_mask(true);
+	if (mDeferred)
+		mDeferred->resolve(mViewProjection);
+	if (mVisibilityBuffer)
+		mVisibilityBuffer->resolve(mGeometry, mBindless ? nullptr : &mTextureArrays, static_cast<GLuint>(mVisibleDraws.size()), mShadingMode == ShadingMode::FLAT);
 
-	std::pair<mat4, mat4> Model_ModelInv = obj.model_matrix_and_inverse();
-
-	// pass uniform data
-	activeShader->setVec3("objColor", obj.color());
-	activeShader->setVec3("lightColor", light.color());
-
-	mat4 inverseModelMat = glm::inverse(Model_ModelInv.first);
-	vec4 lightPosInObjSpace = inverseModelMat * vec4(light.position(), 1.0f);
-	vec4 cameraPosInObjSpace = inverseModelMat * vec4(mCamera->position(), 1.0f);
-	activeShader->setVec3("lightPosInObjSpace", vec3(lightPosInObjSpace) / lightPosInObjSpace.w);
-	activeShader->setVec3("cameraPosInObjSpace", vec3(cameraPosInObjSpace) / cameraPosInObjSpace.w);
-
-	// material uniform
-	Material& material = obj.material();
-	activeShader->setVec3("material.ambient", material.ambient);
-	activeShader->setVec3("material.diffuse", material.diffuse);
-	activeShader->setVec3("material.specular", material.specular);
-	activeShader->setFloat("material.shininess", material.shininess);
-
-	// light uniform
-	activeShader->setVec3("light.ambient", light.ambient());
-	activeShader->setVec3("light.diffuse", light.diffuse());
-	activeShader->setVec3("light.specular", light.specular());
-
-	// calc model-view-projection matrix
-	mat4 MVP = viewProjectTransform * Model_ModelInv.first;
-	activeShader->setMatrix4D("MVP", MVP);
-
-	// render mesh
-	draw_mesh(obj.mesh());
+	// LIGHT SOURCES
+	use_shader(mShaderLights);
+	draw_batches(mLightBatches, mShaderLights, mLightUniforms);
+
+	// occlusion culling of the next frame tests against the depth of this one
+	if (mGpuCulling)
+		mGpuCulling->update_depth_pyramid(mViewProjection, mWindow->width(), mWindow->height());
+
+	mStreamBuffer.end_frame();
+	GpuResources::end_frame();
+	mFrameStats.evictedMeshes = mGeometry.evicted_meshes();
+	mFrameStats.meshBytes = mGeometry.mesh_bytes();
+	mFrameStats.gpuBytes = GpuResources::bytes();
+	mFrameStats.pendingDeletions = GpuResources::pending_deletions();
+	mFrameStats.pendingAssets = mLoader ? mLoader->pending() : 0;
+	mFrameStats.streamingMeshes = mGeometry.streaming_meshes();
+	mFrameStats.bytesStreamed = mStreamBuffer.bytes_allocated();
+	mFrameStats.fenceWaitMs = mStreamBuffer.fence_wait_ms();
+	mFrameStats.glCalls = GLState::stats().calls;
+	mFrameStats.glCallsSkipped = GLState::stats().skipped;
 }
 
-void ruya::Renderer::render_light_source(LightSource& light, const mat4& viewProjectTransform)
+/*
+* Writes the view and projection of the camera to the frame constants uniform buffer.
+*/
+void ruya::Renderer::update_frame_constants()
 {
-	// color uniform
-	mShaderLights->setVec3("objColor", light.model().color());
-
-	// calc model-view-projection matrix
-	mat4 MVP = viewProjectTransform * light.model().model_matrix();
-	mShaderLights->setMatrix4D("MVP", MVP);
-
-	// render mesh
-	draw_mesh(light.model().mesh());
+	FrameConstants frame;
+	frame.view = mCamera->view_matrix();
+	frame.projection = glm::perspective(glm::radians(mCamera->fov()), mWindow->aspect_ratio(), NEAR_PLANE, FAR_PLANE);
+	frame.viewProjection = frame.projection * frame.view;
+	mViewProjection = frame.viewProjection;
+	frame.cameraPosition = vec4(mCamera->position(), 1.0f);
+	Frustum frustum = Frustum::from_matrix(frame.viewProjection);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), frame.frustumPlanes);
+	frame.time = static_cast<float>(mClock.time_since_creation_s());
+	frame.bindlessTextures = mBindless ? 1 : 0;
+	frame.octahedralNormals = mGeometry.layout().normal == VertexLayout::NormalFormat::OCTAHEDRAL ? 1 : 0;
+	// an error e at distance d covers e * projection[1][1] / d half screen heights
+	mLodScale = frame.projection[1][1] * 0.5f * mWindow->height() / (mLodError * std::exp2(mLodBias));
+	frame.lodScale = mLodScale;
+	bind_range(GL_UNIFORM_BUFFER, UniformBindings::FRAME_CONSTANTS, mStreamBuffer.write(frame, mUniformAlignment));
 }
 
-
-
-void ruya::Renderer::render_object(Object& obj)
+/*
+* Collects the lights of the scene in mLights and binds them, a scene without light sources
+* is rendered black.
+*/
+void ruya::Renderer::update_lights(const list<LightSource*>& lights)
 {
-	// TODO:	when a mesh gets deleted that is in the unordered_map, it needs to be removed.
-	//			Consider attaching a custom destroctor on the shared_ptr that is being used as
-	//			key, that will remove the 'null' shared_ptr.
-
-	// Check if the Mesh of the object already had been buffered, if not create the buffers
-	if (mMeshVaoMap.find(obj.mesh()) == mMeshVaoMap.end())
+	mLights.clear();
+	for (const LightSource* light : lights)
 	{
-		GLuint meshVaoID = buffer_mesh(*obj.mesh());
-		mMeshVaoMap[obj.mesh()] = meshVaoID;
+		LightData& data = mLights.emplace_back();
+		data.position = vec4(light->position(), light->range());
+		data.ambient = vec4(light->ambient(), 1.0f);
+		data.diffuse = vec4(light->diffuse(), 1.0f);
+		data.specular = vec4(light->specular(), 1.0f);
 	}
+	mFrameStats.lights = static_cast<unsigned int>(mLights.size());
+	bind_lights();
+}
+
+/*
+* Writes mLights and their LightingConstants to the stream buffer and binds them, then has
+* the LightClusters (if any) list the lights of each cluster for the current camera.
+* @pre update_frame_constants() must have been called for this frame
+*/
+void ruya::Renderer::bind_lights()
+{
+	LightingConstants lighting{};
+	lighting.nearPlane = NEAR_PLANE;
+	lighting.farPlane = FAR_PLANE;
+	lighting.lightCount = static_cast<GLuint>(mLights.size());
+	if (mLightClusters)
+		mLightClusters->configure(lighting, mWindow->width(), mWindow->height());
+	bind_range(GL_UNIFORM_BUFFER, UniformBindings::LIGHTING_CONSTANTS, mStreamBuffer.write(lighting, mUniformAlignment));
+	bind_range(GL_SHADER_STORAGE_BUFFER, StorageBindings::LIGHTS, mStreamBuffer.write(mLights, mStorageAlignment));
+	if (mLightClusters)
+		mLightClusters->assign();
+}
 
-	// Bind the textures and set their uniform location
-	if (obj.texture())
+/*
+* Tests the objects (that have a mesh) against the view frustum of the frame, the result is
+* in mCulledObjects, mVisibility and mCulledSpheres. Objects with a LodChain are culled with
+* the bounds of its most detailed level.
+* @pre update_frame_constants() must have been called for this frame
+*/
+void ruya::Renderer::cull_objects(list<Object*>& objects)
+{
+	mCuller.clear();
+	mCulledObjects.clear();
+	mCulledSpheres.clear();
+	for (Object* obj : objects)
 	{
-		GLuint textureSlot = mSlotManager.bind_texture(*obj.texture());
-		mSmoothShaderObjects->setInt("ourTexture", textureSlot - GL_TEXTURE0); // TODO: save texture uniform name in Shader class instead of hardcoding
+		if (!obj->mesh()) continue;
+		shared_ptr<LodChain> chain = obj->lod_chain();
+		const MeshBounds& bounds = chain ? chain->levels.front()->bounds : obj->mesh()->bounds;
+		const mat4& model = obj->model_matrix();
+		mCuller.add(model, bounds);
+		mCulledObjects.push_back(obj);
+
+		vec3 scale = glm::abs(obj->scale());
+		mCulledSpheres.emplace_back(vec3(model * vec4(bounds.center, 1.0f)), bounds.radius * std::max({ scale.x, scale.y, scale.z }));
 	}
 
-	// pass the color
-	mSmoothShaderObjects->setVec3("objColor", obj.color());
-
-	// calc model-view-projection matrix
-	mat4 projection = glm::perspective(glm::radians(mCamera->fov()), mWindow->aspect_ratio(), 0.1f, 300.0f);
-	mat4 MVP = projection * mCamera->view_matrix() * obj.model_matrix();
-	mSmoothShaderObjects->setMatrix4D("MVP", MVP);
-
-	// Bind the vao and render
-	draw_mesh(obj.mesh());
+	mFrameStats.visibleObjects = mCuller.cull(Frustum::from_matrix(mViewProjection), mVisibility);
+	mFrameStats.culledObjects = mCulledObjects.size() - mFrameStats.visibleObjects;
 }
 
-void GLAPIENTRY ruya::Renderer::debug_mesage_callback(GLenum source, GLenum type, GLuint id, GLenum severity, 
-													  GLsizei length, const GLchar* message, const void* userParam)
+/*
+* The level of the object's LodChain to draw it with this frame, picked from the projected
+* error of the levels (see LodChain::select_level()), or its mesh if it has no chain.
+* @param sphere: world space bounding sphere of the object, w = radius
+*/
+shared_ptr<ruya::Mesh> ruya::Renderer::lod_mesh(Object& obj, const vec4& sphere)
 {
-	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+	shared_ptr<LodChain> chain = obj.lod_chain();
+	if (!chain || chain->size() < 2) return obj.mesh();
+
+	// the errors are in the units of the meshes, the sphere radius is the one of levels[0] scaled
+	float distance = std::max(glm::length(vec3(sphere) - mCamera->position()), 0.0001f);
+	float errorScale = sphere.w / std::max(chain->levels.front()->bounds.radius, std::numeric_limits<float>::min()) * mLodScale / distance;
+	size_t level = chain->select_level(errorScale, std::min<size_t>(obj.lod_level(), chain->size() - 1));
+	obj.set_lod_level(static_cast<uint32_t>(level));
+	return chain->levels[level];
+}
 
-	const char* strSeverity = "Unknown";
-	switch (severity)
+/*
+* Copy of the mesh for FlatShading::PROVOKING_VERTEX, built the first time the mesh is drawn
+* with it (see MeshOptimizer::assign_provoking_vertices()) and again when the mesh at that
+* address isn't the same one anymore. Changes to the mesh aren't tracked.
+*/
+shared_ptr<ruya::Mesh> ruya::Renderer::flat_mesh(const shared_ptr<Mesh>& mesh)
+{
+	if (!mesh) return mesh;
+	FlatMesh& flat = mFlatMeshes[mesh.get()];
+	if (flat.source.lock() != mesh || !flat.mesh)
 	{
-		case GL_DEBUG_SEVERITY_HIGH: strSeverity = "High"; break;
-		case GL_DEBUG_SEVERITY_MEDIUM: strSeverity = "Medium"; break;
-		case GL_DEBUG_SEVERITY_LOW: strSeverity = "Low"; break;
-		case GL_DEBUG_SEVERITY_NOTIFICATION: strSeverity = "Notification"; break;
+		flat.source = mesh;
+		flat.mesh = std::make_shared<Mesh>(*mesh);
+		MeshOptimizer::assign_provoking_vertices(*flat.mesh);
 	}
+	flat.lastUsedFrame = mFrameIndex;
+	return flat.mesh;
+}
+
+/*
+* Drops the flat meshes whose mesh is gone or that haven't been drawn for FLAT_MESH_AGE
+* frames, the geometry buffer evicts them once nothing references them anymore.
+*/
+void ruya::Renderer::collect_flat_meshes()
+{
+	mFrameIndex++;
+	std::erase_if(mFlatMeshes, [&](const auto& entry) {
+		return entry.second.source.expired() || mFrameIndex - entry.second.lastUsedFrame > FLAT_MESH_AGE;
+	});
+}
 
-	const char* strType = "Unknown";
-	switch (type)
+/*
+* Adds a draw of the object with the given mesh (its mesh or one of its levels of detail) to
+* the render queue, its key is built according to mSortOrder. The mesh is added to the
+* geometry buffer and the texture to the texture arrays (or made resident) if this is the
+* first time they are drawn.
+*/
+void ruya::Renderer::queue_draw(Object& obj, RenderPass pass, const Shader& shader, const shared_ptr<Mesh>& mesh)
+{
+	if (!mesh) return;
+
+	DrawKey key;
+	key.pass = static_cast<uint32_t>(pass);
+	key.shader = shader_index(shader);
+	if (obj.texture() && mBindless)
+		mBindlessTextures.add(obj.texture());
+	else if (obj.texture())
+		mTextureArrays.add(obj.texture());
+	key.texture = texture_layer(obj).array + 1; // 0 = no texture or bindless
+	// meshes with 32-bit indexes sort after the others, so that they share multi-draw calls
+	const GeometryBuffer::MeshRange& range = mGeometry.mesh_range(mesh);
+	key.mesh = (range.indexType == GL_UNSIGNED_INT ? 0x8000 : 0) | (range.meshIndex & 0x7FFF);
+	key.depth = glm::length(obj.position() - mCamera->position()) / FAR_PLANE;
+	key.sequence = mQueuedObjects.size();
+
+	mQueue.push(RenderQueue::make_key(key, mSortOrder), mQueuedObjects.size());
+	mQueuedObjects.push_back(&obj);
+	mQueuedMeshes.push_back(mesh);
+}
+
+/*
+* Walks the sorted render queue and puts consecutive draws with the same mesh and texture
+* array in one instance group, in the object or light groups depending on their pass. With 
+* instancing disabled every draw gets its own group.
+*/
+void ruya::Renderer::build_instance_groups()
+{
+	mObjectGroups.clear();
+	mLightGroups.clear();
+	for (const RenderQueue::Item& item : mQueue.items())
 	{
-		case GL_DEBUG_TYPE_ERROR: strType = "** ERROR **";
-		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: strType = "Depracated Behavior";
-		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: strType = "Undefined Behavior";
-		case GL_DEBUG_TYPE_PORTABILITY: strType = "Portability";
-		case GL_DEBUG_TYPE_PERFORMANCE: strType = "Performance";
-		case GL_DEBUG_TYPE_OTHER: strType = "Other";
-		case GL_DEBUG_TYPE_MARKER: strType = "Marker";
-		case GL_DEBUG_TYPE_PUSH_GROUP: strType = "Push Group";
-		case GL_DEBUG_TYPE_POP_GROUP: strType = "Pop Group";
+		Object* obj = mQueuedObjects[item.value];
+		const shared_ptr<Mesh>& mesh = mQueuedMeshes[item.value];
+		RenderPass pass = static_cast<RenderPass>(item.key >> 62); // the pass is in the top 2 bits of the key
+		vector<InstanceGroup>& groups = pass == RenderPass::LIGHTS ? mLightGroups : mObjectGroups;
+
+		int textureArray = texture_layer(*obj).array;
+		if (!mInstancing || groups.empty() || groups.back().mesh != mesh || groups.back().textureArray != textureArray)
+		{
+			InstanceGroup& group = groups.emplace_back();
+			group.mesh = mesh;
+			group.textureArray = textureArray;
+		}
+		groups.back().objects.push_back(obj);
 	}
+}
 
-	const char* strSource = "Unknown";
-	switch (source)
+/*
+* Appends the per-instance data of the objects of each group to mInstanceData and sets
+* the firstInstance of the groups accordingly.
+*/
+void ruya::Renderer::write_instance_data(vector<InstanceGroup>& groups)
+{
+	for (InstanceGroup& group : groups)
 	{
-		case GL_DEBUG_SOURCE_API: strSource = "API";
-		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: strSource = "Window System";
-		case GL_DEBUG_SOURCE_SHADER_COMPILER: strSource = "Shader Compiler";
-		case GL_DEBUG_SOURCE_THIRD_PARTY: strSource = "Third Party";
-		case GL_DEBUG_SOURCE_APPLICATION: strSource = "Application";
-		case GL_DEBUG_SOURCE_OTHER: strSource = "Other";
+		group.firstInstance = mInstanceData.size();
+		for (Object* obj : group.objects)
+		{
+			const Material& material = obj->material();
+
+			InstanceData& instance = mInstanceData.emplace_back();
+			instance.model = obj->model_matrix(); // cached, see TransformSystem
+			instance.inverseModel = obj->inverse_model_matrix();
+			instance.color = vec4(obj->color(), 1.0f);
+			instance.materialAmbient = vec4(material.ambient, 1.0f);
+			instance.materialDiffuse = vec4(material.diffuse, 1.0f);
+			instance.materialSpecular = vec4(material.specular, material.shininess);
+			instance.textureLayer = texture_layer(*obj).layer;
+		}
 	}
-
-	
-
-	std::cerr << "[DEBUG] type = " << strType
-		<< "\n\t source = " << strSource
-		<< "\n\t severity = " << strSeverity
-		<< "\n\t message = " << message
-		<< "\n\n";
-	//fprintf(stderr, " % s \n\tsource = 0x \n\ttype = 0x % x \n\tseverity = 0x % x \n\tmessage = % s\n\n",
-	//				strError, source, type, severity, message);
 }
+
 /*
-* Renders the given mesh by binding the vao and making the draw call.
-* Is also responsible for checking if the mesh has been buffered yet.
-* @pre the mesh must have been buffered earlier with buffer_mesh()
+* Creates one draw command (and its DrawData) per group, the geometry of meshes that are 
+* rendered for the first time is added to the geometry buffer. Consecutive groups with the 
+* same texture array and index type are put in the same batch. Groups of dense meshes
+* without texture array go to the meshlet culling instead, if there is one.
+* @pre the firstInstance of the groups must have been set by write_instance_data()
 */
-void ruya::Renderer::draw_mesh(const shared_ptr<Mesh>& mesh)
+void ruya::Renderer::write_draw_commands(const vector<InstanceGroup>& groups, vector<DrawBatch>& batches, MeshletCulling* meshlets)
 {
-	// TODO:	when a mesh gets deleted that is in the unordered_map, it needs to be removed.
-	//			Consider attaching a custom destroctor on the shared_ptr that is being used as
-	//			key, that will remove the 'null' shared_ptr.
-	
-	// Check if the Mesh of the object already had been buffered, if not create the buffers
-	if (mMeshVaoMap.find(mesh) == mMeshVaoMap.end())
+	batches.clear();
+	for (const InstanceGroup& group : groups)
 	{
-		GLuint meshVaoID = buffer_mesh(*mesh);
-		mMeshVaoMap[mesh] = meshVaoID;
+		const GeometryBuffer::MeshRange& range = mGeometry.mesh_range(group.mesh);
+		mFrameStats.triangles += range.indexCount / 3 * group.objects.size();
+		if (meshlets && group.textureArray < 0 && meshlets->accepts(range))
+		{
+			meshlets->add(range, group.firstInstance, group.objects.size());
+			mFrameStats.instances += group.objects.size();
+			continue;
+		}
+		if (!mDrawCommands.empty() && mDrawCommands.back().firstIndex != range.firstIndex)
+			mFrameStats.meshChanges++;
+
+		if (batches.empty() || batches.back().textureArray != group.textureArray || batches.back().indexType != range.indexType)
+		{
+			DrawBatch& batch = batches.emplace_back();
+			batch.textureArray = group.textureArray;
+			batch.indexType = range.indexType;
+			batch.firstCommand = mDrawCommands.size();
+		}
+		batches.back().commandCount++;
+
+		DrawElementsIndirectCommand& command = mDrawCommands.emplace_back();
+		command.count = range.indexCount;
+		command.instanceCount = group.objects.size();
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = group.firstInstance;
+		mDrawData.push_back(range.draw_data(group.firstInstance));
 	}
-	int error = glGetError();
-
-
-	size_t numIndexes = mesh->faces.size() * 3;
-	glBindVertexArray(mMeshVaoMap[mesh]);
-	glDrawElements(GL_TRIANGLES, numIndexes, GL_UNSIGNED_INT, 0);
-	error = glGetError();
-	int a = 0;
 }
 
 /*
-* Does the necessary OpenGL calls the create VAO, VBO and EBO for the given mesh.
-* @returns the VAO ID that contains info about the buffers containing the mesh's data.
+* Writes the instance data, draw data and draw commands of the frame to the stream buffer 
+* and binds them to their storage blocks.
 */
-GLuint ruya::Renderer::buffer_mesh(const Mesh& mesh)
+void ruya::Renderer::upload_frame_data()
 {
-	// create a vertex buffer object (VAO) so we don't have to repeat VBO and vertex attribute stuff
-	GLuint vaoID;
-	glGenVertexArrays(1, &vaoID);
-	glBindVertexArray(vaoID);
-
-	// element buffer
-	GLuint eboID;
-	glGenBuffers(1, &eboID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.size_faces(), mesh.faces.data(), GL_STATIC_DRAW);
-
-	// vertex buffer, concatenate mesh data: first vertex data then texture data, ...
-	GLuint vboID;
-	long int sizeVert = mesh.size_vertices();
-	long int sizeNormals = mesh.size_normals();
-	long int sizeTex = mesh.size_texture_coords();
-	long int meshSize = sizeVert + sizeNormals + sizeTex;
-	
-	glGenBuffers(1, &vboID); // create a buffer
-	glBindBuffer(GL_ARRAY_BUFFER, vboID); // set buffer's type to array buffer
-	glBufferData(GL_ARRAY_BUFFER, meshSize, NULL, GL_STATIC_DRAW); // allocate memory and copy vertices to GPU
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeVert, mesh.vertices.data());
-	glBufferSubData(GL_ARRAY_BUFFER, sizeVert, sizeNormals, mesh.normals.data());
-	glBufferSubData(GL_ARRAY_BUFFER, sizeVert + sizeNormals, sizeTex, mesh.textureCoordinates.data());
-	
-
-	// specify vertex attributes, how the data in the VBO should be evaluated
-	// UPDATED according to the concatenated data format
-	glVertexAttribPointer(INDEX_VERTEX_ATTRIB, 3, GL_FLOAT, GL_FALSE, 0, (void*)0); // loc data
-	glEnableVertexAttribArray(INDEX_VERTEX_ATTRIB);
-	glVertexAttribPointer(INDEX_NORMAL_ATTRIB, 3, GL_FLOAT, GL_FALSE, 0, (void*)(sizeVert)); // normal data
-	glEnableVertexAttribArray(INDEX_NORMAL_ATTRIB);
-	glVertexAttribPointer(INDEX_TEXTURE_ATTRIB, 2, GL_FLOAT, GL_FALSE, 0, (void*)(sizeVert + sizeNormals)); // texture data
-	glEnableVertexAttribArray(INDEX_TEXTURE_ATTRIB);
-
-	// unbind vertex array buffer
-	glBindVertexArray(0);
-	return vaoID;
+	mInstanceAllocation = mStreamBuffer.write(mInstanceData, mStorageAlignment);
+	mDrawDataAllocation = mStreamBuffer.write(mDrawData, mStorageAlignment);
+	mDrawCommandAllocation = mStreamBuffer.write(mDrawCommands, mStorageAlignment);
+	bind_frame_data();
 }
 
+/*
+* Binds the frame data written by upload_frame_data() (again) to their storage blocks.
+*/
+void ruya::Renderer::bind_frame_data()
+{
+	bind_range(GL_SHADER_STORAGE_BUFFER, StorageBindings::INSTANCES, mInstanceAllocation);
+	bind_range(GL_SHADER_STORAGE_BUFFER, StorageBindings::DRAWS, mDrawDataAllocation);
+	bind_range(GL_SHADER_STORAGE_BUFFER, StorageBindings::DRAW_COMMANDS, mDrawCommandAllocation);
+}
 
-/************************************************************************************************
-*
-*	CLASS TextureSlotManager
-*	 
-************************************************************************************************/
-ruya::Renderer::TextureSlotManager::TextureSlotManager()
+/*
+* Numbers the triangles of the draw commands of the objects for the visibility buffer, see
+* VisibleDraw, and binds them to StorageBindings::VISIBLE_DRAWS. The commands of the objects
+* are the first ones of the frame, so the visible draws have the indexes of their commands.
+* @pre the draw commands must have been written, without meshlet culling
+*/
+void ruya::Renderer::write_visible_draws()
 {
-	// init slot maps and priority list
-	int fragShaderMaxSlots = Texture::get_num_texture_slots_fragment_shader();
-	for (int i = GL_TEXTURE0; i < GL_TEXTURE0 + fragShaderMaxSlots; i++)
+	mVisibleDraws.clear();
+	GLuint nextTriangle = 1; // 0 is the background
+	for (const DrawBatch& batch : mObjectBatches)
 	{
-		// init all slots to 0 (= contains no texture)
-		mSlotTextureMap[i] = 0; 
-		// init priorities in numerical order
-		list<GLuint>::iterator slotIter = mSlotPriority.insert(mSlotPriority.end(), i); 
-		// init slot iterators
-		mSlotPriorityRefMap[i] = slotIter;
+		for (GLuint i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+		{
+			const DrawElementsIndirectCommand& command = mDrawCommands[i];
+			VisibleDraw& draw = mVisibleDraws.emplace_back();
+			draw.firstTriangle = nextTriangle;
+			draw.triangleCount = command.count / 3;
+			draw.shortIndexes = batch.indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+			draw.textureArray = batch.textureArray;
+			nextTriangle += draw.triangleCount * command.instanceCount;
+		}
 	}
+	bind_range(GL_SHADER_STORAGE_BUFFER, StorageBindings::VISIBLE_DRAWS, mStreamBuffer.write(mVisibleDraws, mStorageAlignment));
 }
 
 /*
-* Binds given texture to one of the slots and returns the slot number so that the
-* caller set the uniform location of the texture sampler to the correct slot number.
-* 
-* @pre: the given texture must have already been created with glTexImage2D()
-*		(which is done by default by the Texture class' constructor)
+* Draws the objects of the frame: the batches of the CPU path or the objects GpuCulling
+* culled, then the meshlets MeshletCulling culled. positionsOnly: only the positions are
+* fetched (depth pre-pass, visibility buffer). counted: the draws are counted in the
+* instance stats (not for the depth pre-pass).
+* @pre the frame data must have been uploaded and the meshlets culled
 */
-GLuint ruya::Renderer::TextureSlotManager::bind_texture(const ruya::Texture& texture)
+void ruya::Renderer::draw_objects(Shader* shader, const ObjectUniforms& uniforms, bool positionsOnly, bool counted)
 {
-	// Check whether the texture is already bound
-	if (mTextureSlotMap[texture.ID()] == 0)
+	use_shader(shader);
+	if (mGpuCulling)
 	{
-		// free new slot and set map values to new texture id
-		GLuint newSlot = free_slot();
-		mSlotTextureMap[newSlot] = texture.ID();
-		mTextureSlotMap[texture.ID()] = newSlot;
-
-		// make new slot top priority
-		set_top_priority(mSlotPriorityRefMap[newSlot]);
-
-		// bind texture to new slot
-		glActiveTexture(newSlot);
-		glBindTexture(GL_TEXTURE_2D, texture.ID());
+		mFrameStats.drawCalls += mGpuCulling->draw(*shader, uniforms.drawOffset, positionsOnly);
+		bind_frame_data(); // the culling bound its own instance and draw data
 	}
 	else
+		draw_batches(mObjectBatches, shader, uniforms, positionsOnly, counted);
+
+	if (mMeshletCulling && mMeshletCulling->job_count() > 0)
 	{
-		// texture is already bound to a slot, increment slot priority
-		GLuint textureSlot = mTextureSlotMap[texture.ID()];
-		increment_priority(mSlotPriorityRefMap[textureSlot]);
+		mFrameStats.drawCalls += mMeshletCulling->draw(mGeometry, *shader, uniforms.drawOffset, positionsOnly);
+		bind_frame_data();
 	}
-
-	// return slot number the texture has been (or was already) bound to
-	return mTextureSlotMap[texture.ID()];
 }
 
 /*
-* Frees a texture slot to be used by a new Texture.
-*	Is responsible for internal state changes of TextureSlotManager() when freeing a slot
-* @returns slot number that has been freed.
+* Submits each batch with one glMultiDrawElementsIndirect() call. positionsOnly and counted:
+* see draw_objects(), with positionsOnly no textures are bound.
+* 
+* @pre the shader program needs to be made current before calling this function.
+* @pre uniforms must have been resolved from shader.
+* @pre the frame constants, lights, instance data and draw commands must have been 
+*	   uploaded for this frame.
 */
-GLuint ruya::Renderer::TextureSlotManager::free_slot()
+void ruya::Renderer::draw_batches(const vector<DrawBatch>& batches, Shader* shader, const ObjectUniforms& uniforms, bool positionsOnly, bool counted)
 {
-	// get number of least priority slot
-	GLuint slot = mSlotPriority.back();
-
-	// unregister texture residing in that slot
-	GLuint oldTextureId = mSlotTextureMap[slot];
-	mTextureSlotMap[oldTextureId] = 0; // tex id might be 0 (invalid) but does no harm
-
-	// mark texture slot as free by setting its mapped texture value to 0
-	mSlotTextureMap[slot] = 0;
-
-	// return slot num
-	return slot;
+	if (positionsOnly) mGeometry.bind_positions();
+	else mGeometry.bind();
+	GLState::bind_buffer(GL_DRAW_INDIRECT_BUFFER, mDrawCommandAllocation.buffer);
+	for (const DrawBatch& batch : batches)
+	{
+		// all arrays share one unit, binding the same array again is skipped by GLState
+		if (batch.textureArray >= 0 && !positionsOnly)
+		{
+			if (batch.textureArray != mLastTextureArray)
+				mFrameStats.textureChanges++;
+			mLastTextureArray = batch.textureArray;
+			mTextureArrays.bind(batch.textureArray, MATERIAL_TEXTURE_UNIT);
+			shader->set(uniforms.textureArray, (int)MATERIAL_TEXTURE_UNIT);
+		}
+		shader->set(uniforms.drawOffset, (int)batch.firstCommand);
+
+		const void* offset = (const void*)(mDrawCommandAllocation.offset + batch.firstCommand * sizeof(DrawElementsIndirectCommand));
+		RUYA_GL(glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType, offset, batch.commandCount, 0));
+		mFrameStats.drawCalls++;
+		if (!counted) continue;
+		mFrameStats.drawCommands += batch.commandCount;
+		for (GLuint i = batch.firstCommand; i < batch.firstCommand + batch.commandCount; i++)
+			mFrameStats.instances += mDrawCommands[i].instanceCount;
+	}
 }
 
 /*
-* Moves given slot up one position in the priority list.
-* (this is done when an already-binded texture is being rendered again)
+* Fills in the overdraw stats from the queries issued QUERY_FRAMES frames ago in the slot of
+* this frame, which are free to be issued again afterwards.
 */
-void ruya::Renderer::TextureSlotManager::increment_priority(list<GLuint>::iterator& slotIt)
+void ruya::Renderer::read_fragment_queries()
 {
-	// can't increment position if it's the first in the list
-	if (slotIt == mSlotPriority.begin())
-		return;
-
-	// swap values of elements at pos "slotIt" and the one before
-	GLuint temp1 = *slotIt;
-	slotIt--;
-	GLuint temp2 = *slotIt;
-	*slotIt = temp1;
-	slotIt++;
-	*slotIt = temp2;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (!mQueriesIssued[mQueryFrame][pass]) continue;
+		GLuint64 samples = 0;
+		RUYA_GL(glGetQueryObjectui64v(mFragmentQueries[mQueryFrame][pass], GL_QUERY_RESULT, &samples));
+		(pass == 0 ? mFrameStats.depthFragments : mFrameStats.shadedFragments) = samples;
+		mQueriesIssued[mQueryFrame][pass] = false;
+	}
+	float pixels = static_cast<float>(mWindow->width()) * mWindow->height();
+	mFrameStats.overdraw = pixels > 0.0f ? mFrameStats.shadedFragments / pixels : 0.0f;
 }
 
 /*
-* Makes given slot from the mSlotPriority list top priority by placing it at the front of the list.
-* @post: slotIt has been updated but is still pointing to the same slot (that is now at the front of the priority list)
+* Renders a single object with the smooth shader, outside of render_scene(). Uses the
+* lights of the last rendered scene. Every call uses its own stream buffer frame.
 */
-void ruya::Renderer::TextureSlotManager::set_top_priority(list<GLuint>::iterator& slotIt)
+void ruya::Renderer::render_object(Object& obj)
 {
-	// save slot number and remove slot from priority list
-	GLuint slot = *slotIt;
-	mSlotPriority.erase(slotIt);
+	mStreamBuffer.begin_frame();
+
+	// view-projection is read from the frame constants, refresh them since the camera might have moved
+	update_frame_constants();
+	bind_lights();
+
+	mQueue.clear();
+	mQueuedObjects.clear();
+	mQueuedMeshes.clear();
+	queue_draw(obj, RenderPass::OBJECTS, *mSmoothShaderObjects, obj.mesh());
+	build_instance_groups();
+
+	mInstanceData.clear();
+	write_instance_data(mObjectGroups);
+	mDrawData.clear();
+	mDrawCommands.clear();
+	write_draw_commands(mObjectGroups, mObjectBatches);
+	upload_frame_data();
 
-	// reinsert slot to the front
-	mSlotPriority.push_front(slot);
+	use_shader(mSmoothShaderObjects);
+	draw_batches(mObjectBatches, mSmoothShaderObjects, mSmoothUniforms);
 
-	// update slotIt iterator since it was invalidated with the erase operation
-	slotIt = mSlotPriority.begin();
+	mStreamBuffer.end_frame();
 }
 
+/*
+* Small index of the shader for the sort keys, which only have 6 bits for it: GL program
+* names can be anything. Shaders get the next index the first time they are queued.
+* @throws std::runtime_error if more than 64 shaders are queued
+*/
+uint32_t ruya::Renderer::shader_index(const Shader& shader)
+{
+	auto it = std::find(mShaderPrograms.begin(), mShaderPrograms.end(), shader.id());
+	if (it != mShaderPrograms.end()) return static_cast<uint32_t>(it - mShaderPrograms.begin());
+	if (mShaderPrograms.size() == 64)
+		throw std::runtime_error("[Renderer] more than 64 shaders in the render queue");
+	mShaderPrograms.push_back(shader.id());
+	return static_cast<uint32_t>(mShaderPrograms.size() - 1);
+}
 
+/*
+* Layer of the object's texture in the texture arrays, invalid for objects without texture.
+* With bindless textures the array is -1 (nothing to bind) and the layer is the index of the
+* texture's handle.
+* @pre the texture has been added by queue_draw()
+*/
+ruya::TextureArrays::Layer ruya::Renderer::texture_layer(Object& obj) const
+{
+	if (!obj.texture()) return TextureArrays::Layer();
+	if (mBindless) return TextureArrays::Layer{ -1, mBindlessTextures.find(*obj.texture()) };
+	return mTextureArrays.find(*obj.texture());
+}
 
+/*
+* Makes the shader current, counts a shader change if it wasn't current yet.
+*/
+void ruya::Renderer::use_shader(Shader* shader)
+{
+	if (shader != mLastShader)
+		mFrameStats.shaderChanges++;
+	mLastShader = shader;
+	shader->use();
+}
 
+/************************************************************************************************
+*
+*	STRUCT ObjectUniforms
+*	 
+************************************************************************************************/
+ruya::Renderer::ObjectUniforms::ObjectUniforms(const Shader& shader)
+	: textureArray(shader.uniform<int>("materialTextures")),
+	  drawOffset(shader.uniform<int>("drawOffset"))
+{
+}
@@ -4,18 +4,36 @@
 #include <unordered_map>
 #include <list>
 #include <memory>
+#include <vector>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glad/glad.h>
 
 #include "engine/scene/scene.h"
 #include "engine/scene/mesh.h"
+#include "engine/render/gl_state.h"
 #include "engine/render/shader.h"
+#include "engine/render/ring_buffer.h"
+#include "engine/render/geometry_buffer.h"
+#include "engine/render/gpu_resources.h"
+#include "engine/render/asset_loader.h"
+#include "engine/render/render_queue.h"
+#include "engine/render/frustum_culler.h"
+#include "engine/render/texture_arrays.h"
+#include "engine/render/bindless_textures.h"
+#include "engine/render/gpu_culling.h"
+#include "engine/render/meshlet_culling.h"
+#include "engine/render/light_clusters.h"
+#include "engine/render/deferred_shading.h"
+#include "engine/render/visibility_buffer.h"
+#include "engine/render/uniform_blocks.h"
 #include "engine/core/window.h"
 #include "engine/scene/camera.h"
+#include "utils/timer.h"
 
 using std::unordered_map;
 using std::list;
 using std::shared_ptr;
+using std::vector;
 using glm::mat4;
 using ruya::Shader;
 using ruya::Window;
@@ -33,119 +51,285 @@ namespace ruya
 	{
 	private:
 		/*
-		* Manages which texture slots to use next for object textures.
-		*
-		* This is done with a priority list where the slots at the front have high priority
-		* and the ones at the back low priority. The goal is to put slots that are frequently
-		* and/or recently used at the front and the ones that haven't been used for a while at
-		* the back by moving up the position of a slot each time it is used.
-		*
-		* When a texture has to be rendered that is not yet placed in a slot, it will get the
-		* slot at the back of the priority list. That slot will be placed at the front of the
-		* priority list making it highest priority. This is necessary because of a "low-priority
-		* lock" see explanation comment lock below.
+		* Handles of the uniforms used by the object and light source shaders. Resolved once per
+		* shader so that rendering doesn't need to look up any uniform names. Per-frame data 
+		* (camera, lights) lives in uniform and storage buffers and per-object data in the instance buffer, 
+		* see uniform_blocks.h.
 		*/
-		class TextureSlotManager
+		struct ObjectUniforms
 		{
-		public:
-			TextureSlotManager();
-			GLuint bind_texture(const ruya::Texture & texture);
-
-		private:
-			GLuint free_slot();
-			void increment_priority(list<GLuint>::iterator& slotIt);
-			void set_top_priority(list<GLuint>::iterator& slotIt);
-
-			unordered_map<GLuint, GLuint> mTextureSlotMap; // mapping texture id to texture slot, not loaded if slot = 0
-			unordered_map<GLuint, GLuint> mSlotTextureMap; // mapping slots to textures
-			list<GLuint> mSlotPriority; // last item in map is the next one to use (and free up for new textures if necessary)
-			unordered_map<GLuint, list<GLuint>::iterator> mSlotPriorityRefMap; // for each slot, contains iterator pointing to its location in the priority list.
+			ObjectUniforms() = default;
+			ObjectUniforms(const Shader& shader);
+
+			UniformHandle<int> textureArray; // sampler2DArray materialTextures
+			UniformHandle<int> drawOffset; // index of the first draw command of a multi-draw call
+		};
+
+		/*
+		* Objects that share the same mesh and texture array, they are drawn together with one 
+		* instanced draw command. Their per-instance data is stored at [firstInstance, 
+		* firstInstance + size) in the instance buffer.
+		*/
+		struct InstanceGroup
+		{
+			shared_ptr<Mesh> mesh;
+			int textureArray = -1; // index in mTextureArrays, -1 for objects without texture
+			vector<Object*> objects;
+			GLuint firstInstance = 0;
+		};
+
+		/*
+		* Consecutive draw commands [firstCommand, firstCommand + commandCount) in the draw
+		* indirect buffer that use the same texture array and index type, submitted with one 
+		* multi-draw call.
+		*/
+		struct DrawBatch
+		{
+			int textureArray = -1;
+			GLenum indexType = GL_UNSIGNED_INT;
+			GLuint firstCommand = 0;
+			GLuint commandCount = 0;
 		};
 
+		enum class RenderPass : uint32_t { OBJECTS = 0, LIGHTS = 1 }; // drawn in this order
+
 	public:
 		enum class ShadingMode { SMOOTH, FLAT };
 
+		/*
+		* How ShadingMode::FLAT keeps the lighting constant over a face, each needs its flat
+		* shader (see set_flat_shader()):
+		*	- GEOMETRY_SHADER: flat_vert, flat_geom and flat_frag, the geometry shader passes
+		*	  the face center and average normal to all three vertices
+		*	- DERIVATIVES: phong/object.vert and flat_derivatives.frag, the normal comes from
+		*	  the screen space derivatives of the position, lit per fragment
+		*	- PROVOKING_VERTEX: flat_provoking.vert and flat_frag, the objects are drawn with
+		*	  copies of their meshes whose provoking vertices carry the face normals (see
+		*	  MeshOptimizer::assign_provoking_vertices()), lit at the provoking vertex. Only
+		*	  on the CPU path, render_scene() throws with GpuCulling
+		* DeferredShading and the VisibilityBuffer shade flat faces themselves.
+		*/
+		enum class FlatShading { GEOMETRY_SHADER = 0, DERIVATIVES = 1, PROVOKING_VERTEX = 2 };
+
+		/*
+		* Counters of the last rendered frame.
+		*/
+		struct FrameStats
+		{
+			unsigned int drawCalls = 0; // multi-draw calls
+			unsigned int drawCommands = 0; // instanced draws in the multi-draw calls
+			unsigned int instances = 0; // rendered objects and light sources (without the objects drawn by GpuCulling, see GpuCulling::read_counters())
+			unsigned int shaderChanges = 0; // shader programs made current
+			unsigned int textureChanges = 0; // batches whose texture array differs from the previous one (0 with bindless textures)
+			unsigned int meshChanges = 0; // consecutive draw commands with a different mesh
+			unsigned int visibleObjects = 0; // objects inside the view frustum (CPU path)
+			unsigned int culledObjects = 0; // objects outside of it, not drawn
+			size_t transformsUpdated = 0; // model matrices recomputed at the start of the frame, see TransformSystem::update()
+			unsigned int meshlets = 0; // tested by MeshletCulling for all instances, see MeshletCulling::read_counters()
+			unsigned int lights = 0; // in the light buffer, each fragment is only lit by those of its cluster with LightClusters
+			size_t triangles = 0; // of the drawn instances, before meshlet culling (CPU path)
+			size_t bytesStreamed = 0; // per-frame data written to the stream buffer
+			double fenceWaitMs = 0.0; // time spent waiting for the GPU to release stream buffer memory
+			unsigned int glCalls = 0; // GL calls issued through GLState (binds, draws, dispatches, ...)
+			unsigned int glCallsSkipped = 0; // redundant binds elided by GLState
+			unsigned int evictedMeshes = 0; // dropped from the geometry buffer, see GeometryBuffer::begin_frame()
+			size_t meshBytes = 0; // of the meshes in the geometry buffer
+			size_t gpuBytes = 0; // all GL objects tracked by GpuResources
+			size_t pendingDeletions = 0; // GL objects released, waiting for the GPU to finish with them
+			size_t pendingAssets = 0; // requested from the AssetLoader, not published yet
+			size_t streamingMeshes = 0; // drawn as placeholder until the loader has staged them
+			// overdraw of the objects (not the light sources), from samples passed queries that
+			// are read QUERY_FRAMES frames after the frame they were issued in
+			uint64_t depthFragments = 0; // passed the depth test of the depth pre-pass, 0 without it
+			uint64_t shadedFragments = 0; // ran the object shader (the G-buffer shader with DeferredShading, the triangle id shader with the VisibilityBuffer)
+			float overdraw = 0.0f; // shaded fragments per pixel of the window, at most 1 with the depth pre-pass
+		};
+
 		Renderer(Shader* shaderObjects, Shader* shaderLights, Window* window, Camera* camera);
+		~Renderer();
+		Renderer(const Renderer&) = delete; // owns its queries
+		Renderer& operator=(const Renderer&) = delete;
 		void render_scene(Scene& scene);
 		void render_object(Object& obj);
-		void set_flat_shader(Shader* flatShader) { mFlatShaderObjects = flatShader; }
+		void set_flat_shader(Shader* flatShader, FlatShading implementation = FlatShading::GEOMETRY_SHADER);
+		void set_flat_shading(FlatShading implementation) { mFlatShading = implementation; } // GEOMETRY_SHADER by default
+		FlatShading flat_shading() const { return mFlatShading; }
+		void set_depth_shader(Shader* depthShader, ShadingMode mode = ShadingMode::SMOOTH);
+		void set_depth_prepass(bool enabled) { mDepthPrepass = enabled; } // needs the depth shader of the shading mode
+		bool depth_prepass() const { return mDepthPrepass; }
 		void set_shading_mode(ShadingMode mode) { mShadingMode = mode; }
 		ShadingMode shading_mode() const { return mShadingMode; }
+		void set_instancing(bool enabled) { mInstancing = enabled; } // false: one draw command per object
+		bool instancing() const { return mInstancing; }
+		void set_sort_order(SortOrder order) { mSortOrder = order; }
+		SortOrder sort_order() const { return mSortOrder; }
+		void set_gpu_culling(GpuCulling* culling) { mGpuCulling = culling; } // nullptr: cull and batch the objects on the CPU
+		GpuCulling* gpu_culling() const { return mGpuCulling; }
+		void set_meshlet_culling(MeshletCulling* culling) { mMeshletCulling = culling; } // nullptr: dense meshes are drawn whole
+		MeshletCulling* meshlet_culling() const { return mMeshletCulling; }
+		void set_light_clusters(LightClusters* clusters) { mLightClusters = clusters; } // nullptr: every fragment loops over all lights
+		LightClusters* light_clusters() const { return mLightClusters; }
+		void set_deferred_shading(DeferredShading* deferred); // nullptr: forward shading with the object shader of the shading mode
+		DeferredShading* deferred_shading() const { return mDeferred; }
+		void set_visibility_buffer(VisibilityBuffer* visibility); // nullptr: the objects are shaded while they are rasterized
+		VisibilityBuffer* visibility_buffer() const { return mVisibilityBuffer; }
+		GeometryBuffer& geometry() { return mGeometry; } // set_budget(), set_eviction_age(), set_layout()
+		void set_asset_loader(AssetLoader* loader) { mLoader = loader; mGeometry.set_loader(loader); } // nullptr: meshes are uploaded when first drawn
+		AssetLoader* asset_loader() const { return mLoader; }
+		void set_lod_error(float pixels) { mLodError = pixels; } // largest projected error of a level of detail, 1 pixel by default
+		float lod_error() const { return mLodError; }
+		void set_lod_bias(float bias) { mLodBias = bias; } // every +1 doubles the allowed error (coarser levels), every -1 halves it
+		float lod_bias() const { return mLodBias; }
+		void set_bindless_textures(bool enabled) { mBindless = enabled && BindlessTextures::supported(); } // false: texture arrays
+		bool bindless_textures() const { return mBindless; }
+		const FrameStats& frame_stats() const { return mFrameStats; }
 
 	private:
-		static void GLAPIENTRY debug_mesage_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, 
-														const GLchar* message, const void* userParam);
-
-		void render_object(Object& obj, const mat4& viewProjectTransform, const LightSource& light, Shader * activeShader);
-		void render_light_source(LightSource& light, const mat4& viewProjectTransform);
-		void draw_mesh(const shared_ptr<Mesh>& mesh);
+		void cull_objects(list<Object*>& objects);
+		shared_ptr<Mesh> lod_mesh(Object& obj, const vec4& sphere);
+		shared_ptr<Mesh> flat_mesh(const shared_ptr<Mesh>& mesh);
+		void collect_flat_meshes();
+		void queue_draw(Object& obj, RenderPass pass, const Shader& shader, const shared_ptr<Mesh>& mesh);
+		void build_instance_groups();
+		void write_instance_data(vector<InstanceGroup>& groups);
+		void write_draw_commands(const vector<InstanceGroup>& groups, vector<DrawBatch>& batches, MeshletCulling* meshlets = nullptr);
+		void upload_frame_data();
+		void bind_frame_data();
+		void write_visible_draws();
+		void draw_objects(Shader* shader, const ObjectUniforms& uniforms, bool positionsOnly, bool counted);
+		void draw_batches(const vector<DrawBatch>& batches, Shader* shader, const ObjectUniforms& uniforms, bool positionsOnly = false, bool counted = true);
+		void read_fragment_queries();
+		void update_frame_constants();
+		void update_lights(const list<LightSource*>& lights);
+		void bind_lights();
+		void use_shader(Shader* shader);
+		TextureArrays::Layer texture_layer(Object& obj) const;
+		uint32_t shader_index(const Shader& shader);
 
-		GLuint buffer_mesh(const Mesh& mesh);
 		Shader* mSmoothShaderObjects;
 		Shader* mShaderLights;
-		Shader* mFlatShaderObjects;
+		Shader* mFlatShaderObjects[3]; // per FlatShading
 		Window* mWindow;
 		Camera* mCamera;
 		ShadingMode mShadingMode;
+		ObjectUniforms mSmoothUniforms;
+		ObjectUniforms mFlatUniforms[3];
+		ObjectUniforms mLightUniforms;
+		Timer mClock; // time since creation, passed to the shaders
+		FrameStats mFrameStats;
 
-		unordered_map<shared_ptr<Mesh>, GLuint> mMeshVaoMap;
-		const GLuint INDEX_VERTEX_ATTRIB; // indexes of the attributes used in the vertex shader
-		const GLuint INDEX_NORMAL_ATTRIB;
-		const GLuint INDEX_TEXTURE_ATTRIB;
-		TextureSlotManager mSlotManager;
+		static constexpr float NEAR_PLANE = 0.1f;
+		static constexpr float FAR_PLANE = 300.0f;
+		// texture unit of the material texture array, the units past the fragment shader's
+		// slots are taken by the depth pyramid
+		static constexpr GLuint MATERIAL_TEXTURE_UNIT = 0;
+
+		// instancing: objects are grouped per mesh and texture, their data is streamed to the GPU each frame
+		bool mInstancing;
+		vector<InstanceData> mInstanceData;
+		vector<InstanceGroup> mObjectGroups;
+		vector<InstanceGroup> mLightGroups;
+
+		// multi-draw indirect: all meshes live in one geometry buffer, every group becomes a draw 
+		// command and each pass is submitted with one glMultiDrawElementsIndirect() per texture
+		GeometryBuffer mGeometry;
+		vector<DrawData> mDrawData;
+		vector<DrawElementsIndirectCommand> mDrawCommands;
+		vector<DrawBatch> mObjectBatches;
+		vector<DrawBatch> mLightBatches;
+
+		// all per-frame data (uniform blocks, instance data, draw data and commands) is streamed 
+		// through one persistently mapped ring buffer
+		RingBuffer mStreamBuffer;
+		GLsizeiptr mUniformAlignment;
+		GLsizeiptr mStorageAlignment;
+		RingBuffer::Allocation mInstanceAllocation; // of the current frame
+		RingBuffer::Allocation mDrawDataAllocation;
+		RingBuffer::Allocation mDrawCommandAllocation; // read by draw_batches()
+
+		// frustum culling: the world bounds of the objects are tested against the frustum in batches
+		FrustumCuller mCuller;
+		vector<Object*> mCulledObjects; // objects added to mCuller, in order
+		vector<uint8_t> mVisibility; // 1 if mCulledObjects[i] is visible
+		vector<vec4> mCulledSpheres; // world space bounding sphere of mCulledObjects[i], w = radius
+
+		// levels of detail: the coarsest level whose error projects to at most mLodError pixels
+		float mLodError;
+		float mLodBias;
+		float mLodScale; // FrameConstants::lodScale of the frame
+
+		// render queue: the draws of a frame are sorted on a key, objects with the same mesh and
+		// texture that end up next to each other are put in the same instance group
+		SortOrder mSortOrder;
+		RenderQueue mQueue;
+		vector<Object*> mQueuedObjects; // the values of the queue items index this list
+		vector<shared_ptr<Mesh>> mQueuedMeshes; // mesh (level of detail) each queued object is drawn with
+		vector<GLuint> mShaderPrograms; // the shader field of the keys indexes this list
+		const Shader* mLastShader; // state of the previous draw, to count state changes
+		int mLastTextureArray;
+
+		// material textures: packed in texture arrays, or resident bindless textures when the GPU 
+		// supports them, the layer or handle index of each object is in its instance data
+		TextureArrays mTextureArrays;
+		BindlessTextures mBindlessTextures;
+		bool mBindless;
+
+		// streaming: the loader publishes finished assets at the start of each frame
+		AssetLoader* mLoader;
+
+		// GPU driven path: objects are culled and drawn by GpuCulling, only lights go through the queue
+		GpuCulling* mGpuCulling;
+		mat4 mViewProjection; // of the current frame, the depth pyramid is built with it
+
+		// CPU path: dense meshes are drawn meshlet by meshlet, the meshlets are culled on the GPU
+		MeshletCulling* mMeshletCulling;
+
+		// lighting: all lights of the scene are streamed to the light buffer each frame, with
+		// LightClusters the fragments only loop over the lights listed for their cluster
+		vector<LightData> mLights; // of the last rendered scene, reused by render_object()
+		LightClusters* mLightClusters;
+
+		// deferred shading: the objects are drawn to the G-buffer of mDeferred in both shading
+		// modes, lit per pixel and composited before the light sources are drawn
+		DeferredShading* mDeferred;
+		ObjectUniforms mDeferredUniforms;
+
+		// visibility buffer: the objects only write their triangle ids (CPU path, dense meshes
+		// are drawn whole), every pixel is shaded once by the resolve of mVisibilityBuffer
+		VisibilityBuffer* mVisibilityBuffer;
+		ObjectUniforms mVisibilityUniforms;
+		vector<VisibleDraw> mVisibleDraws; // one per draw command of the objects
+
+		// flat shading: without the geometry shader the pre-pass uses the depth shader of
+		// ShadingMode::SMOOTH. With the provoking vertex the objects are drawn with flat copies
+		// of their meshes, dropped FLAT_MESH_AGE frames after their last use or with their mesh.
+		struct FlatMesh
+		{
+			std::weak_ptr<Mesh> source;
+			shared_ptr<Mesh> mesh;
+			uint64_t lastUsedFrame = 0;
+		};
+		static constexpr uint64_t FLAT_MESH_AGE = GeometryBuffer::DEFAULT_EVICTION_AGE;
+		FlatShading mFlatShading;
+		unordered_map<const Mesh*, FlatMesh> mFlatMeshes;
+		uint64_t mFrameIndex; // frames rendered by render_scene()
+
+		// depth pre-pass: the objects are drawn with the depth shader of the shading mode first
+		// (positions only, no color writes), then shaded with GL_EQUAL depth testing, every
+		// visible pixel is shaded once
+		bool mDepthPrepass;
+		Shader* mDepthShaders[2]; // per ShadingMode
+		ObjectUniforms mDepthUniforms[2];
+
+		// overdraw statistics: samples passed by the pre-pass and by the object shader, read
+		// QUERY_FRAMES frames later, the GPU is done with them by then
+		static constexpr size_t QUERY_FRAMES = 4;
+		GLuint mFragmentQueries[QUERY_FRAMES][2]; // [frame][0 = pre-pass, 1 = shading]
+		bool mQueriesIssued[QUERY_FRAMES][2];
+		size_t mQueryFrame; // slot of the current frame
 
 		bool test = true;
 	};
 }
 
 #endif
-
-
-// LOW_PRIORITY LOCK PROBLEM DESCRIPTION
-/*
-*		Suppose you want to render a million pairs of objects. You render the first obj
-*		of the pair then the second. The texture of the first one will get the last slot
-*		then that slot will be pushed up by 1. Then, the second texture will get the current
-*		last slot and will be pushed up 1 position, above the first one. If the two textures
-*		get used again and again in the same order they will keep pushing each other down,
-*		neither of the two every reaching the top of the priority list as they should. This
-*		can be visualized as follows, 'X': texture 1, 'O': texture 2, '.': other textures.
-*
-*		.  .  .  .  .  .  .  .  .  .  .
-*		.  .  .  .  .  .  .  .  .  .  .   ...
-*		.  O  X  O  X  O  X  O  X  O  X
-*		.  .  O  X  O  X  O  X  O  X  O
-*
-*		Now suppose now and then some random object gets rendered while the million pair-
-*		objects are being rendered. The texture of the random object will get the slot at
-*		the end of the priority queue so one of the textures of the pair objects that were
-*		racing each other will be removed from its slot, and the random texture will be
-*		placed in it, also moving its position up by one. Then when rendering the pairs
-*		again, the texture that was kicked out will replace the texture of the other pair,
-*		and move one slot up, above the random texture. The random texture will be kicked
-*		out by the texture that was just kicked out and move one slot up, above the pair
-*		texture that had just moved up, and they will race each other again.
-*		This beats the purpose of the priority queue and makes it worse than just selecting
-*		random texture slots in the first place.
-*
-*		One might think that moving a used slot up 2 positions will solve the problem, which
-*		is true if there are only 2 textures being rendered one after the other. When there
-*		are 3 textures, then moving up 2 positions brings the same problem as before. And if
-*		we were to move up 1 position with 3 textures, then each texture would push out the
-*		texture that will be rendered right after itself, making the shader keep loading in
-*		and out texture data from texture slots. 'T': texture 3
-* 		OXT
-*
-*		.  .  .  .  .  .  .  .  .  .  .
-*		.  .  .  .  .  .  .  .  .  .  .    ...
-*		.  O  X  T  O  X  T  O  X  T  O
-*		.  .  O  X  T  O  X  T  O  X  T
-*		-------------------------------
-*			     O  X  T  O  X  T  O  X    pushed out
-*
-*		Very long problem description for a simple solution that I came up while starting to
-*		write the last paragraph: when a new texture is moved to the lowest priority slot,
-*		move that slot to the beginning of the list........
-*		.....and making sure that there isn't a giant sequence of 33 textures that will be
-*		rendered back-to-back a million times. (33 because the max # of slots for my gpu is 32)
-*/
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "ring_buffer.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "utils/timer.h"
+
+namespace
+{
+	constexpr GLbitfield STORAGE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+}
+
+/*
+* Creates a buffer of framesInFlight segments of frameCapacity bytes and maps it.
+*/
+ruya::RingBuffer::RingBuffer(GLsizeiptr frameCapacity, unsigned int framesInFlight)
+	: mBufferID(0), mMapped(nullptr), mFrameCapacity(0), mFramesInFlight(framesInFlight), mFrame(0), mHead(0),
+	  mFences(framesInFlight, 0), mBytesAllocated(0), mFenceWaitMs(0.0)
+{
+	create_buffer(frameCapacity);
+}
+
+ruya::RingBuffer::~RingBuffer()
+{
+	delete_fences();
+	glUnmapNamedBuffer(mBufferID);
+	GpuResources::release(GpuResources::Type::BUFFER, mBufferID);
+}
+
+/*
+* Moves to the next segment and waits until the GPU is done with the frame that used it
+* before.
+*/
+void ruya::RingBuffer::begin_frame()
+{
+	mFrame = (mFrame + 1) % mFramesInFlight;
+	mHead = 0;
+	mBytesAllocated = 0;
+	mFenceWaitMs = 0.0;
+
+	if (mFences[mFrame])
+	{
+		mFenceWaitMs = wait(mFences[mFrame]);
+		glDeleteSync(mFences[mFrame]);
+		mFences[mFrame] = 0;
+	}
+}
+
+/*
+* Places the fence that guards the segment of the current frame.
+* @pre all commands that read data of this frame must have been issued
+*/
+void ruya::RingBuffer::end_frame()
+{
+	mFences[mFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/*
+* Allocates size bytes in the segment of the current frame, the offset of the chunk is a
+* multiple of alignment (e.g. uniform_alignment() for chunks that are bound as uniform block).
+* If the segment is full, the buffer is replaced by one with segments that are at least
+* twice as large.
+*/
+ruya::RingBuffer::Allocation ruya::RingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLsizeiptr start = (mHead + alignment - 1) / alignment * alignment;
+	if (start + size > mFrameCapacity)
+	{
+		GLsizeiptr newCapacity = mFrameCapacity * 2;
+		while (newCapacity < size) newCapacity *= 2;
+
+		glUnmapNamedBuffer(mBufferID);
+		GpuResources::release(GpuResources::Type::BUFFER, mBufferID); // deleted once the draws of this frame that read it are done
+		delete_fences();
+		create_buffer(newCapacity);
+		start = 0;
+	}
+
+	Allocation allocation;
+	allocation.buffer = mBufferID;
+	allocation.offset = mFrame * mFrameCapacity + start;
+	allocation.size = size;
+	allocation.data = mMapped + allocation.offset;
+
+	mHead = start + size;
+	mBytesAllocated += size;
+	return allocation;
+}
+
+/*
+* Offset alignment required by glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+*/
+GLsizeiptr ruya::RingBuffer::uniform_alignment()
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return alignment;
+}
+
+/*
+* Offset alignment required by glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ...)
+*/
+GLsizeiptr ruya::RingBuffer::storage_alignment()
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return alignment;
+}
+
+/*
+* Creates the immutable storage and maps all of it for the lifetime of the buffer.
+*/
+void ruya::RingBuffer::create_buffer(GLsizeiptr frameCapacity)
+{
+	mFrameCapacity = frameCapacity;
+	glCreateBuffers(1, &mBufferID);
+	glNamedBufferStorage(mBufferID, mFrameCapacity * mFramesInFlight, nullptr, STORAGE_FLAGS);
+	GpuResources::track(GpuResources::Type::BUFFER, mBufferID, mFrameCapacity * mFramesInFlight);
+	mMapped = static_cast<char*>(glMapNamedBufferRange(mBufferID, 0, mFrameCapacity * mFramesInFlight, STORAGE_FLAGS));
+}
+
+/*
+* Deletes the fences of all segments, the segments are considered unused.
+*/
+void ruya::RingBuffer::delete_fences()
+{
+	for (GLsync& fence : mFences)
+	{
+		if (fence) glDeleteSync(fence);
+		fence = 0;
+	}
+}
+
+/*
+* Blocks until the fence is signaled.
+* @returns the time spent waiting in milliseconds
+*/
+double ruya::RingBuffer::wait(GLsync fence)
+{
+	if (glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+		return 0.0;
+
+	Timer timer(true);
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) // 1 ms
+		flags = 0;
+	timer.stop();
+	return timer.elapsed_time_ms();
+}
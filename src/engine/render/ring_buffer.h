@@ -0,0 +1,98 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Persistently mapped buffer for data that is streamed to the GPU every frame (frame
+	* constants, instance data, draw commands, ...). The buffer is split in one segment per
+	* frame in flight, a frame suballocates aligned chunks from its segment and writes to them
+	* directly through the mapping.
+	*	- begin_frame() waits on the fence of the frame that last used the segment, so the CPU
+	*	  never overwrites data the GPU might still be reading (no implicit driver syncs)
+	*	- end_frame() places the fence after the draw calls that read the frame's data
+	*	- when a frame needs more than a segment, a buffer with larger segments is created,
+	*	  allocations made before keep pointing to the old buffer, which is released to
+	*	  GpuResources (deleted once the GPU is done with the frame)
+	*/
+	class RingBuffer
+	{
+	public:
+		/*
+		* A chunk of the buffer, only valid until the end of the frame it was allocated in.
+		*/
+		struct Allocation
+		{
+			GLuint buffer = 0;
+			GLintptr offset = 0;
+			GLsizeiptr size = 0;
+			void* data = nullptr; // mapped memory, write only
+		};
+
+		RingBuffer(GLsizeiptr frameCapacity, unsigned int framesInFlight = 3);
+		~RingBuffer();
+		RingBuffer(const RingBuffer&) = delete;
+		RingBuffer& operator=(const RingBuffer&) = delete;
+
+		void begin_frame();
+		void end_frame();
+		Allocation allocate(GLsizeiptr size, GLsizeiptr alignment);
+		template <class T>
+		Allocation write(const vector<T>& elements, GLsizeiptr alignment);
+		template <class T>
+		Allocation write(const T& block, GLsizeiptr alignment);
+
+		GLuint ID() const { return mBufferID; }
+		GLsizeiptr frame_capacity() const { return mFrameCapacity; }
+		unsigned int frames_in_flight() const { return mFramesInFlight; }
+		GLsizeiptr bytes_allocated() const { return mBytesAllocated; } // this frame
+		double fence_wait_ms() const { return mFenceWaitMs; } // by the last begin_frame()
+
+		static GLsizeiptr uniform_alignment();
+		static GLsizeiptr storage_alignment();
+
+	private:
+		void create_buffer(GLsizeiptr frameCapacity);
+		void delete_fences();
+		double wait(GLsync fence);
+
+		GLuint mBufferID;
+		char* mMapped;
+		GLsizeiptr mFrameCapacity;
+		unsigned int mFramesInFlight;
+		unsigned int mFrame; // segment of the current frame
+		GLsizeiptr mHead; // next free byte in the segment of the current frame
+		vector<GLsync> mFences; // one per segment, 0 if the segment hasn't been used yet
+
+		GLsizeiptr mBytesAllocated;
+		double mFenceWaitMs;
+	};
+
+	/*
+	* Allocates a chunk for the elements and copies them to it.
+	*/
+	template <class T>
+	RingBuffer::Allocation RingBuffer::write(const vector<T>& elements, GLsizeiptr alignment)
+	{
+		Allocation allocation = allocate(elements.size() * sizeof(T), alignment);
+		if (allocation.size > 0)
+			std::memcpy(allocation.data, elements.data(), allocation.size);
+		return allocation;
+	}
+
+	template <class T>
+	RingBuffer::Allocation RingBuffer::write(const T& block, GLsizeiptr alignment)
+	{
+		Allocation allocation = allocate(sizeof(T), alignment);
+		std::memcpy(allocation.data, &block, sizeof(T));
+		return allocation;
+	}
+}
+
+#endif // !RING_BUFFER_H
@@ -1,6 +1,10 @@
 #include "shader.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <filesystem>
 #include <stdexcept>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -27,15 +31,50 @@ namespace
 		vertexShaderFile.close();
 		return vertexShaderText;
 	}
+
+	/*
+	* Reads a shader file and replaces each `#include "file"` line with the contents of that
+	* file, the path being relative to the including file. Included files can include others.
+	* This way blocks that are shared by many shaders (uniform blocks, ...) are defined once.
+	* @throws std::ifstream::failure if one of the files can't be read
+	* @throws std::runtime_error for a malformed #include or too deeply nested includes
+	*/
+	std::string readShaderSource(const std::filesystem::path& shaderPath, int depth = 0)
+	{
+		if (depth > 16)
+			throw std::runtime_error("[readShaderSource()] #include nested too deep (cyclic include?) in " + shaderPath.string());
+
+		std::istringstream lines(readFileContents(shaderPath.string().c_str()));
+		std::string line, source;
+		while (std::getline(lines, line))
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+			{
+				size_t open = line.find('"', start);
+				size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+				if (close == std::string::npos)
+					throw std::runtime_error("[readShaderSource()] malformed #include in " + shaderPath.string() + ": " + line);
+
+				source += readShaderSource(shaderPath.parent_path() / line.substr(open + 1, close - open - 1), depth + 1);
+			}
+			else
+			{
+				source += line;
+			}
+			source += "\n";
+		}
+		return source;
+	}
 }
 
-ruya::Shader::Shader() : mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0)
+ruya::Shader::Shader() : mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0), mComputeShaderID(0)
 {
 	
 }
 
 ruya::Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath)
-	: mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0)
+	: mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0), mComputeShaderID(0)
 {
 	//setShaders(vertexShaderPath, "", fragmentShaderPath);
 	setShader(Type::VERTEX_SHADER, vertexShaderPath);
@@ -45,7 +84,7 @@ ruya::Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPat
 
 
 ruya::Shader::Shader(const char* vertexShaderPath, const char* geometryShaderPath, const char* fragmentShaderPath)
-	: mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0)
+	: mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0), mComputeShaderID(0)
 {
 	setShader(Type::VERTEX_SHADER, vertexShaderPath);
 	setShader(Type::FRAGMENT_SHADER, fragmentShaderPath);
@@ -53,11 +92,23 @@ ruya::Shader::Shader(const char* vertexShaderPath, const char* geometryShaderPat
 	createShaderProgram();
 }
 
+/*
+* Compute shader program, run it with use() and glDispatchCompute().
+*/
+ruya::Shader::Shader(const char* computeShaderPath)
+	: mProgramID(0), mVertexShaderID(0), mFragmentShaderID(0), mGeometryShaderID(0), mComputeShaderID(0)
+{
+	setShader(Type::COMPUTE_SHADER, computeShaderPath);
+	createShaderProgram();
+}
+
 ruya::Shader::~Shader()
 {
+	GpuResources::release(GpuResources::Type::PROGRAM, mProgramID);
 	glDeleteShader(mVertexShaderID);
 	glDeleteShader(mFragmentShaderID);
 	glDeleteShader(mGeometryShaderID);
+	glDeleteShader(mComputeShaderID);
 }
 
 /*
@@ -98,7 +149,7 @@ void ruya::Shader::setShaders(const char* vertexShaderPath, const char* geometry
 }
 
 /*
-* Sets the corresponding shader type to given shader file
+* Sets the corresponding shader type to given shader file, #include lines are expanded.
 * @pre: shaderPath must be the path of a shader file, cannot be ""
 */
 void ruya::Shader::setShader(Type shaderType, const char* shaderPath)
@@ -106,17 +157,22 @@ void ruya::Shader::setShader(Type shaderType, const char* shaderPath)
 	if (shaderType == Type::VERTEX_SHADER)
 	{
 		if (mVertexShaderID > 0) glDeleteShader(mVertexShaderID);
-		mVertexShaderID = createShader(GL_VERTEX_SHADER, readFileContents(shaderPath));
+		mVertexShaderID = createShader(GL_VERTEX_SHADER, readShaderSource(shaderPath));
 	}
 	else if (shaderType == Type::GEOMETRY_SHADER)
 	{
 		if (mGeometryShaderID > 0) glDeleteShader(mGeometryShaderID);
-		mGeometryShaderID = createShader(GL_GEOMETRY_SHADER, readFileContents(shaderPath));
+		mGeometryShaderID = createShader(GL_GEOMETRY_SHADER, readShaderSource(shaderPath));
 	}
 	else if (shaderType == Type::FRAGMENT_SHADER)
 	{
 		if (mFragmentShaderID > 0) glDeleteShader(mFragmentShaderID);
-		mFragmentShaderID = createShader(GL_FRAGMENT_SHADER, readFileContents(shaderPath));
+		mFragmentShaderID = createShader(GL_FRAGMENT_SHADER, readShaderSource(shaderPath));
+	}
+	else if (shaderType == Type::COMPUTE_SHADER)
+	{
+		if (mComputeShaderID > 0) glDeleteShader(mComputeShaderID);
+		mComputeShaderID = createShader(GL_COMPUTE_SHADER, readShaderSource(shaderPath));
 	}
 }
 
@@ -125,36 +181,81 @@ void ruya::Shader::setShader(Type shaderType, const char* shaderPath)
 */
 void ruya::Shader::use()
 {
-	glUseProgram(mProgramID);
+	GLState::use_program(mProgramID);
 }
 
+/*
+* The setXXX("name") functions look the location up in the uniform table that was filled
+* when the program was linked, so they don't query OpenGL. For uniforms that are set for
+* every draw, prefer resolving a UniformHandle once with uniform<T>() and using set().
+*/
 void ruya::Shader::setInt(const std::string& uniformName, int value)
 {
-	glUniform1i(glGetUniformLocation(mProgramID, uniformName.c_str()), value);
+	glUniform1i(uniform_location(uniformName), value);
 }
 
 void ruya::Shader::setMatrix4D(const std::string& uniformName, const glm::mat4& matrix)
 {
-	unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-	glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(uniform_location(uniformName), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
 void ruya::Shader::setVec3(const std::string& uniformName, const glm::vec3& vec)
 {
-	unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-	glUniform3f(loc, vec.x, vec.y, vec.z);
+	glUniform3f(uniform_location(uniformName), vec.x, vec.y, vec.z);
 }
 
 void ruya::Shader::setVec3(const std::string& uniformName, float x, float y, float z)
 {
-	unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-	glUniform3f(loc, x, y, z);
+	glUniform3f(uniform_location(uniformName), x, y, z);
 }
 
 void ruya::Shader::setFloat(const std::string& uniformName, float value)
 {
-	unsigned int loc = glGetUniformLocation(mProgramID, uniformName.c_str());
-	glUniform1f(loc, value);
+	glUniform1f(uniform_location(uniformName), value);
+}
+
+/*
+* Set uniforms through handles resolved earlier with uniform<T>().
+* @pre this shader program must be current (see use()).
+*/
+void ruya::Shader::set(UniformHandle<int> handle, int value)
+{
+	glUniform1i(handle.location, value);
+}
+
+void ruya::Shader::set(UniformHandle<float> handle, float value)
+{
+	glUniform1f(handle.location, value);
+}
+
+void ruya::Shader::set(UniformHandle<glm::vec2> handle, const glm::vec2& vec)
+{
+	glUniform2f(handle.location, vec.x, vec.y);
+}
+
+void ruya::Shader::set(UniformHandle<glm::vec3> handle, const glm::vec3& vec)
+{
+	glUniform3f(handle.location, vec.x, vec.y, vec.z);
+}
+
+void ruya::Shader::set(UniformHandle<glm::ivec3> handle, const glm::ivec3& vec)
+{
+	glUniform3i(handle.location, vec.x, vec.y, vec.z);
+}
+
+void ruya::Shader::set(UniformHandle<glm::mat4> handle, const glm::mat4& matrix)
+{
+	glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+/*
+* Location of the given uniform in the linked program.
+* @returns -1 if the program has no active uniform with that name.
+*/
+GLint ruya::Shader::uniform_location(const std::string& uniformName) const
+{
+	auto it = mUniformLocations.find(uniformName);
+	return it == mUniformLocations.end() ? -1 : it->second;
 }
 
 /*####################################################################################################################################
@@ -190,6 +291,8 @@ GLuint ruya::Shader::createShader(GLenum shaderType, const std::string& shaderCo
 		errorMsg = "[ruya::Shader::createShader()] ";
 		if (shaderType == GL_VERTEX_SHADER) errorMsg += "Vertex ";
 		else if (shaderType == GL_FRAGMENT_SHADER) errorMsg += "Fragment ";
+		else if (shaderType == GL_GEOMETRY_SHADER) errorMsg += "Geometry ";
+		else if (shaderType == GL_COMPUTE_SHADER) errorMsg += "Compute ";
 		errorMsg += "shader compilation failed.\n";
 		errorMsg += textBuffer;
 		throw std::runtime_error(errorMsg);
@@ -209,10 +312,11 @@ GLuint ruya::Shader::createShader(GLenum shaderType, const std::string& shaderCo
 GLuint ruya::Shader::createShaderProgram()
 {
 	// link shaders into one shader program to be used for the render calls
-	if (mProgramID > 0) glDeleteProgram(mProgramID);
+	GpuResources::release(GpuResources::Type::PROGRAM, mProgramID);
 	mProgramID = glCreateProgram();
+	GpuResources::track(GpuResources::Type::PROGRAM, mProgramID, 0); // size unknown, only counted
 
-	for (const GLuint shaderID : {mVertexShaderID, mFragmentShaderID, mGeometryShaderID})
+	for (const GLuint shaderID : {mVertexShaderID, mFragmentShaderID, mGeometryShaderID, mComputeShaderID})
 	{
 		if (shaderID > 0) glAttachShader(mProgramID, shaderID);
 	}
@@ -231,5 +335,38 @@ GLuint ruya::Shader::createShaderProgram()
 		throw std::runtime_error(errorMsg);
 	}
 
+	reflect_uniforms();
 	return mProgramID;
 }
+
+/*
+* Enumerates the active uniforms of the linked program and stores their locations in
+* mUniformLocations, so that setting uniforms doesn't require glGetUniformLocation().
+*	- uniforms inside uniform blocks have no location and are skipped
+*	- arrays are stored as "name[0]" (as reported by OpenGL) and as "name"
+*/
+void ruya::Shader::reflect_uniforms()
+{
+	mUniformLocations.clear();
+
+	GLint numUniforms = 0, maxNameLength = 0;
+	glGetProgramInterfaceiv(mProgramID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
+	glGetProgramInterfaceiv(mProgramID, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+	std::string name(maxNameLength, '\0');
+	const GLenum property = GL_LOCATION;
+	for (GLint i = 0; i < numUniforms; i++)
+	{
+		GLint location = -1;
+		glGetProgramResourceiv(mProgramID, GL_UNIFORM, i, 1, &property, 1, nullptr, &location);
+		if (location < 0) continue;
+
+		GLsizei length = 0;
+		glGetProgramResourceName(mProgramID, GL_UNIFORM, i, maxNameLength, &length, name.data());
+		std::string uniformName(name.data(), length);
+		mUniformLocations[uniformName] = location;
+
+		if (uniformName.size() > 3 && uniformName.ends_with("[0]"))
+			mUniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+	}
+}
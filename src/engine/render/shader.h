@@ -3,13 +3,30 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include "glad/glad.h"
 #include <glm/glm.hpp>
 
 using std::vector;
+using std::unordered_map;
 
 namespace ruya
 {
+	/*
+	* Typed handle to a uniform of a Shader program.
+	* 
+	* Resolve it once with Shader::uniform<T>("name") and pass it to Shader::set() in 
+	* the render loop. Setting a uniform through a handle does no string hashing, no 
+	* allocation and no glGetUniformLocation() query, unlike the setXXX("name") variants.
+	* A handle of a uniform that is not active in the program has location -1, setting it
+	* is a no-op (same as OpenGL does for location -1).
+	*/
+	template <class T>
+	struct UniformHandle
+	{
+		GLint location = -1;
+		bool valid() const { return location >= 0; }
+	};
 
 	class Shader
 	{
@@ -18,7 +35,10 @@ namespace ruya
 		Shader();
 		Shader(const char * vertexShaderPath, const char * fragmentShaderPath);
 		Shader(const char * vertexShaderPath, const char* geometryShaderPath, const char * fragmentShaderPath);
+		explicit Shader(const char * computeShaderPath);
 		~Shader();
+		Shader(const Shader&) = delete; // owns its program
+		Shader& operator=(const Shader&) = delete;
 		
 		// MANIPULATORS
 		void use();
@@ -30,20 +50,34 @@ namespace ruya
 		void setVec3(const std::string& uniformName, float x, float y, float z);
 		void setMatrix4D(const std::string& uniformName, const glm::mat4& matrix);
 
+		// UNIFORM HANDLES: resolve once, then set without lookups
+		template <class T>
+		UniformHandle<T> uniform(const std::string& uniformName) const { return UniformHandle<T>{ uniform_location(uniformName) }; }
+		void set(UniformHandle<int> handle, int value);
+		void set(UniformHandle<float> handle, float value);
+		void set(UniformHandle<glm::vec2> handle, const glm::vec2& vec);
+		void set(UniformHandle<glm::vec3> handle, const glm::vec3& vec);
+		void set(UniformHandle<glm::ivec3> handle, const glm::ivec3& vec);
+		void set(UniformHandle<glm::mat4> handle, const glm::mat4& matrix);
+
 		// GETTERS
-		GLuint id() { return mProgramID; }
+		GLuint id() const { return mProgramID; }
+		GLint uniform_location(const std::string& uniformName) const;
+		const unordered_map<std::string, GLint>& uniform_locations() const { return mUniformLocations; }
 
 	private:
 		GLuint mProgramID; // the shader id
-		GLuint mVertexShaderID, mFragmentShaderID, mGeometryShaderID;
+		GLuint mVertexShaderID, mFragmentShaderID, mGeometryShaderID, mComputeShaderID;
+		unordered_map<std::string, GLint> mUniformLocations; // active uniforms of the linked program, filled by reflect_uniforms()
 
 		// HELPER FUNCTIONS
-		enum class Type{VERTEX_SHADER, GEOMETRY_SHADER, FRAGMENT_SHADER};
+		enum class Type{VERTEX_SHADER, GEOMETRY_SHADER, FRAGMENT_SHADER, COMPUTE_SHADER};
 		void setShaders(const char* vertexShaderPath, const char* geometryShaderPath, const char* fragmentShaderPath);
 		void setShader(Type shaderType, const char* shaderPath);
 
 		GLuint createShader(GLenum shaderType, const std::string& shaderContent);
 		GLuint createShaderProgram();
+		void reflect_uniforms();
 	};
 
 }
@@ -0,0 +1,38 @@
+#version 460 core
+
+struct Material 
+{
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+}; 
+uniform Material material;
+
+struct Light 
+{
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+uniform Light light; 
+
+uniform vec3 objColor;
+uniform vec3 lightColor;
+flat in vec3 lightPos;
+flat in vec3 cameraPos;
+in vec3 fragPositionInObjSpace;
+in vec3 normalInLocalSpace;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec3 norm = normalize(normalInLocalSpace);
+    vec3 lightDir = normalize(fragPositionInObjSpace - lightPos);
+    vec3 viewDir = normalize(fragPositionInObjSpace - cameraPos);
+    float diff = max(dot(-lightDir, norm), 0.0);
+    float spec = pow(max(dot(reflect(lightDir, norm), -viewDir), 0.0), material.shininess);
+    vec3 result = light.ambient * material.ambient + light.diffuse * diff * material.diffuse + light.specular * spec * material.specular;
+    FragColor = vec4(result * objColor * lightColor, 1.0);
+}
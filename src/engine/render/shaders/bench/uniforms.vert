@@ -0,0 +1,24 @@
+#version 460 core
+
+// Declares the per-object uniforms that Renderer::render_object() used to set before the
+// uniform buffers and the instance buffer existed, for BenchApp::bench_uniforms().
+
+layout (location = 0) in vec3 vertexLocalPos;
+layout (location = 1) in vec3 inpNormal;
+
+uniform mat4 MVP;
+uniform vec3 lightPosInObjSpace;
+uniform vec3 cameraPosInObjSpace;
+out vec3 fragPositionInObjSpace;
+out vec3 normalInLocalSpace;
+flat out vec3 lightPos;
+flat out vec3 cameraPos;
+
+void main()
+{
+    gl_Position = MVP * vec4(vertexLocalPos, 1.0);
+    normalInLocalSpace = inpNormal;
+    fragPositionInObjSpace = vertexLocalPos;
+    lightPos = lightPosInObjSpace;
+    cameraPos = cameraPosInObjSpace;
+}
@@ -0,0 +1,25 @@
+// Per-draw data of a multi-draw call, see DrawData in engine/render/uniform_blocks.h
+// The draw of a vertex is draws[drawOffset + gl_DrawID], drawOffset is set per multi-draw call.
+struct DrawData
+{
+    uint firstInstance;
+    vec4 positionScale; // dequantization of the draw's mesh, see vertex_attributes.glsl
+    vec4 positionOffset;
+    vec4 texCoordTransform; // xy = scale, zw = offset
+};
+
+// shaders that write the draw buffer (compute) only need the struct
+#ifndef DRAW_DATA_STRUCT_ONLY
+layout (std430, binding = 1) readonly buffer DrawBuffer
+{
+    DrawData draws[];
+};
+
+uniform int drawOffset;
+
+// index of the instance of the current vertex in the instance buffer
+int instance_index()
+{
+    return int(draws[drawOffset + gl_DrawID].firstInstance) + gl_InstanceID;
+}
+#endif
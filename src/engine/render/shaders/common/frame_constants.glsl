@@ -0,0 +1,13 @@
+// Constant for a whole frame, see FrameConstants in engine/render/uniform_blocks.h
+layout (std140, binding = 0) uniform FrameConstants
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 frustumPlanes[6]; // world space, normals point inwards: left, right, bottom, top, near, far
+    float time;
+    int bindlessTextures; // see material_textures.glsl
+    int octahedralNormals; // see vertex_attributes.glsl
+    float lodScale; // error at distance 1 -> screen size relative to the allowed error
+} frame;
@@ -0,0 +1,21 @@
+// Per-instance data of the rendered objects, see InstanceData in engine/render/uniform_blocks.h
+// The instance of a vertex is found with instance_index() from draw_data.glsl.
+struct InstanceData
+{
+    mat4 model;
+    mat4 inverseModel;
+    vec4 color;
+    vec4 materialAmbient;
+    vec4 materialDiffuse;
+    vec4 materialSpecular; // w = shininess
+    int textureLayer; // see material_textures.glsl, -1 without texture
+    int padding[3];
+};
+
+// shaders that declare their own instance buffers (compute) only need the struct
+#ifndef INSTANCE_DATA_STRUCT_ONLY
+layout (std430, binding = 0) readonly buffer InstanceBuffer
+{
+    InstanceData instances[];
+};
+#endif
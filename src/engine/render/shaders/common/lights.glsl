@@ -0,0 +1,106 @@
+// The lights of the frame and how the fragments find the ones that reach them, see
+// LightingConstants and LightData in engine/render/uniform_blocks.h and LightClusters
+layout (std140, binding = 1) uniform LightingConstants
+{
+    uvec4 clusterCount; // xyz = clusters along the width, height and depth of the view (x = 0: no clusters), w = lights per cluster
+    vec2 tileSize; // pixels
+    float sliceScale;
+    float sliceBias;
+    float nearPlane;
+    float farPlane;
+    uint lightCount;
+} lighting;
+
+struct Light
+{
+    vec4 position; // world space, w = range (0 = unlimited)
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout (std430, binding = 14) readonly buffer Lights
+{
+    Light lights[];
+};
+
+// distance from the camera of a depth buffer value in [0, 1]
+float view_depth(float depth)
+{
+    float n = lighting.nearPlane, f = lighting.farPlane;
+    return 2.0 * n * f / (f + n - (2.0 * depth - 1.0) * (f - n));
+}
+
+// compute passes that work on the lights themselves (light_clusters.comp writes the cluster
+// lists, deferred/tiled_lighting.comp builds its own per tile) define LIGHTS_ONLY
+#ifndef LIGHTS_ONLY
+layout (std430, binding = 15) readonly buffer ClusterLightCounts
+{
+    uint clusterLightCounts[];
+};
+
+layout (std430, binding = 16) readonly buffer ClusterLightIndexes
+{
+    uint clusterLightIndexes[]; // clusterCount.w per cluster
+};
+
+// the lights that may reach a fragment: [first, first + count) in clusterLightIndexes, or
+// in lights without clusters
+struct LightList
+{
+    uint first;
+    uint count;
+};
+
+// the lights of the cluster of a pixel (window coordinates) at a depth buffer depth
+LightList pixel_lights(vec2 pixel, float depth)
+{
+    if (lighting.clusterCount.x == 0)
+        return LightList(0, lighting.lightCount);
+
+    uvec3 cluster;
+    cluster.xy = min(uvec2(pixel / lighting.tileSize), lighting.clusterCount.xy - 1);
+    float slice = floor(log(view_depth(depth)) * lighting.sliceScale + lighting.sliceBias);
+    cluster.z = uint(clamp(slice, 0.0, float(lighting.clusterCount.z - 1)));
+    uint index = (cluster.z * lighting.clusterCount.y + cluster.y) * lighting.clusterCount.x + cluster.x;
+    return LightList(index * lighting.clusterCount.w, clusterLightCounts[index]);
+}
+
+LightList fragment_lights()
+{
+    return pixel_lights(gl_FragCoord.xy, gl_FragCoord.z);
+}
+
+Light list_light(LightList list, uint i)
+{
+    return lights[lighting.clusterCount.x == 0 ? list.first + i : clusterLightIndexes[list.first + i]];
+}
+#endif
+
+// fades the light out towards its range
+float light_attenuation(Light light, float distance)
+{
+    float range = light.position.w;
+    if (range <= 0.0)
+        return 1.0;
+    float x = clamp(1.0 - (distance * distance) / (range * range), 0.0, 1.0);
+    return x * x;
+}
+
+// adds the phong terms of the light at a surface point to the sums, everything in world
+// space, viewDir points from the camera to the point
+void accumulate_light(Light light, vec3 position, vec3 normal, vec3 viewDir, inout vec3 ambient, inout vec3 diffuse, inout vec3 specular)
+{
+    vec3 toPosition = position - light.position.xyz;
+    float attenuation = light_attenuation(light, length(toPosition));
+    if (attenuation <= 0.0)
+        return;
+
+    vec3 lightDir = normalize(toPosition);
+    float diff = max(dot(-lightDir, normal), 0.0);
+    vec3 reflectionDir = reflect(lightDir, normal);
+    float specularEffect = pow(max(dot(reflectionDir, -viewDir), 0.0), 32);
+    ambient += attenuation * light.ambient.rgb;
+    diffuse += attenuation * diff * light.diffuse.rgb;
+    specular += attenuation * specularEffect * light.specular.rgb;
+}
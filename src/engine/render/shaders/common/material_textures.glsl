@@ -0,0 +1,23 @@
+// Material textures of the objects, see TextureArrays and BindlessTextures in engine/render.
+// Needs frame_constants.glsl, and `#extension GL_ARB_bindless_texture : enable` right after
+// the #version of the including shader (without the extension only the array path is compiled).
+
+// texture arrays: the array of the draw is bound to this sampler, the index is its layer
+uniform sampler2DArray materialTextures;
+
+#ifdef GL_ARB_bindless_texture
+// bindless: the index is the position of the texture's handle
+layout (std430, binding = 8) readonly buffer MaterialTextureHandles
+{
+    uvec2 materialTextureHandles[];
+};
+#endif
+
+vec3 material_texture(int textureIndex, vec2 textureCoordinates)
+{
+#ifdef GL_ARB_bindless_texture
+    if (frame.bindlessTextures != 0)
+        return texture(sampler2D(materialTextureHandles[textureIndex]), textureCoordinates).rgb;
+#endif
+    return texture(materialTextures, vec3(textureCoordinates, textureIndex)).rgb;
+}
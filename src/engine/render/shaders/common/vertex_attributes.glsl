@@ -0,0 +1,38 @@
+// Decoding of the vertex attributes stored in the layout of the geometry buffer, see
+// VertexLayout in engine/render/vertex_layout.h. Include after frame_constants.glsl and
+// draw_data.glsl. Float attributes decode to themselves.
+
+// quantized positions are in [-1, 1] over the bounding box of their mesh
+vec3 decode_position(vec3 position, DrawData draw)
+{
+    return position * draw.positionScale.xyz + draw.positionOffset.xyz;
+}
+
+// octahedral normals only use xy, the lower hemisphere is folded onto the corners
+vec3 decode_normal(vec3 normal)
+{
+    if (frame.octahedralNormals == 0) return normal;
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+// quantized texture coordinates are in [0, 1] over the range of their mesh
+vec2 decode_texture_coordinates(vec2 textureCoordinates, DrawData draw)
+{
+    return textureCoordinates * draw.texCoordTransform.xy + draw.texCoordTransform.zw;
+}
+
+// vertex shaders: the attributes of the current draw
+#ifndef DRAW_DATA_STRUCT_ONLY
+vec3 decode_position(vec3 position)
+{
+    return decode_position(position, draws[drawOffset + gl_DrawID]);
+}
+
+vec2 decode_texture_coordinates(vec2 textureCoordinates)
+{
+    return decode_texture_coordinates(textureCoordinates, draws[drawOffset + gl_DrawID]);
+}
+#endif
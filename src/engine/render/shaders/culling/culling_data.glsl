@@ -0,0 +1,53 @@
+// Buffers of the GPU culling pass, see ObjectBounds, LodLevel and CullCounters in 
+// engine/render/uniform_blocks.h and GpuCulling in engine/render/gpu_culling.h
+struct ObjectBounds
+{
+    vec4 sphere; // world space center, w = radius
+    uint firstLod;
+    uint lodCount;
+};
+
+struct LodLevel
+{
+    uint command;
+    float error; // relative to the radius of the bounds
+};
+
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 4) readonly buffer ObjectBoundsBuffer
+{
+    ObjectBounds bounds[];
+};
+
+layout (std430, binding = 5) readonly buffer LodLevelBuffer
+{
+    LodLevel lodLevels[];
+};
+
+// level of each object in the previous frame, relative to its firstLod
+layout (std430, binding = 13) buffer ObjectLodBuffer
+{
+    uint objectLods[];
+};
+
+// one command per mesh, instanceCount is incremented for every visible object using the mesh
+layout (std430, binding = 6) coherent buffer CullCommandBuffer
+{
+    DrawElementsIndirectCommand cullCommands[];
+};
+
+layout (std430, binding = 7) coherent buffer CullCounterBuffer
+{
+    uint drawCount[2]; // with 16-bit and with 32-bit indexes
+    uint visibleCount;
+    uint frustumCulledCount;
+    uint occlusionCulledCount;
+};
@@ -0,0 +1,55 @@
+// Buffers of the meshlet culling pass, see MeshletData, MeshletJob and MeshletCounters in
+// engine/render/uniform_blocks.h and MeshletCulling in engine/render/meshlet_culling.h
+
+#define DRAW_DATA_STRUCT_ONLY
+#include "../common/draw_data.glsl"
+
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct MeshletData
+{
+    vec4 sphere; // local space center, w = radius
+    vec4 coneApex;
+    vec4 coneAxis; // w = cutoff, never culled above 1
+    uint firstIndex; // relative to the first index of the mesh
+    uint indexCount;
+};
+
+struct MeshletJob
+{
+    uint firstWork;
+    uint firstMeshlet;
+    uint meshletCount;
+    uint firstInstance;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint shortIndexes;
+    DrawData draw;
+};
+
+layout (std430, binding = 10) readonly buffer MeshletBuffer
+{
+    MeshletData meshlets[];
+};
+
+// sorted on firstWork
+layout (std430, binding = 11) readonly buffer MeshletJobBuffer
+{
+    MeshletJob jobs[];
+};
+
+layout (std430, binding = 12) coherent buffer MeshletCounterBuffer
+{
+    uint drawCount[2]; // with 16-bit and with 32-bit indexes
+    uint visibleCount;
+    uint frustumCulledCount;
+    uint backfaceCulledCount;
+};
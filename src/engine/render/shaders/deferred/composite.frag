@@ -0,0 +1,19 @@
+#version 460 core
+
+// Writes the lit pixels of the G-buffer to the framebuffer with their depth, the background
+// keeps the clear color. After fullscreen.vert.
+
+uniform sampler2D lightAccumulation; // written by tiled_lighting.comp
+uniform sampler2D gbufferDepth;
+
+out vec4 FragColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, pixel, 0).r;
+    if (depth >= 1.0)
+        discard;
+    FragColor = vec4(texelFetch(lightAccumulation, pixel, 0).rgb, 1.0);
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,9 @@
+#version 460 core
+
+// One triangle that covers the screen, drawn without vertex data (3 vertices).
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2); // (0, 0), (2, 0), (0, 2)
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
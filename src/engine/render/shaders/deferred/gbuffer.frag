@@ -0,0 +1,37 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : enable
+
+// Writes the surface of the objects to the G-buffer, after phong/object.vert.
+
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/material_textures.glsl"
+#include "gbuffer_data.glsl"
+
+flat in int instanceIndex;
+in vec3 fragPositionInWorldSpace;
+in vec3 normalInWorldSpace;
+in vec2 textureCoordinates;
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outSpecular;
+layout (location = 2) out vec2 outNormal;
+
+uniform int flatNormals; // 1: ShadingMode::FLAT, the normal of the face from the screen space derivatives of the position
+
+void main()
+{
+    vec3 objColor = instances[instanceIndex].color.rgb;
+    int textureLayer = instances[instanceIndex].textureLayer;
+    if (textureLayer >= 0)
+        objColor *= material_texture(textureLayer, textureCoordinates);
+    vec3 materialAmbient = instances[instanceIndex].materialAmbient.rgb;
+    vec3 materialDiffuse = instances[instanceIndex].materialDiffuse.rgb;
+    vec3 materialSpecular = instances[instanceIndex].materialSpecular.rgb;
+
+    vec3 norm = flatNormals != 0 ? cross(dFdx(fragPositionInWorldSpace), dFdy(fragPositionInWorldSpace)) : normalInWorldSpace;
+
+    outAlbedo = vec4(objColor * materialDiffuse, encode_ambient(materialAmbient, materialDiffuse));
+    outSpecular = vec4(flatNormals != 0 ? vec3(0.0) : objColor * materialSpecular, 1.0); // no highlights with flat shading, like flat/flat_frag.frag
+    outNormal = encode_octahedral(normalize(norm));
+}
@@ -0,0 +1,37 @@
+// Layout of the G-buffer of the deferred path, see DeferredShading in engine/render:
+//  - albedo   RGBA8        rgb = diffuse color (object color * texture * material diffuse),
+//                          a = material ambient / material diffuse, halved
+//  - specular RGBA8        rgb = specular color (object color * texture * material specular)
+//  - normal   RG16_SNORM   world space normal, octahedral encoded
+//  - depth    DEPTH32F
+// The ambient color is stored as a fraction of the diffuse color, which is exact for the
+// materials whose ambient and diffuse colors have the same hue (gray ones included).
+
+// the lower hemisphere is folded onto the corners, see decode_normal() in vertex_attributes.glsl
+vec2 encode_octahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.xy;
+}
+
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+float encode_ambient(vec3 materialAmbient, vec3 materialDiffuse)
+{
+    float diffuse = materialDiffuse.r + materialDiffuse.g + materialDiffuse.b;
+    float ambient = materialAmbient.r + materialAmbient.g + materialAmbient.b;
+    return diffuse > 0.0 ? clamp(ambient / diffuse * 0.5, 0.0, 1.0) : 0.0;
+}
+
+vec3 decode_ambient(vec4 albedo)
+{
+    return albedo.rgb * albedo.a * 2.0;
+}
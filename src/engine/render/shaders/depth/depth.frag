@@ -0,0 +1,6 @@
+#version 460 core
+
+// Depth pre-pass: color writes are off, the depth is written by the fixed function.
+void main()
+{
+}
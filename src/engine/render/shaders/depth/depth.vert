@@ -0,0 +1,20 @@
+#version 460 core
+
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
+
+// Depth pre-pass: only the position stream is fetched (GeometryBuffer::bind_positions()). The
+// shading pass tests with GL_EQUAL against this depth, gl_Position is invariant here and in
+// the object shaders and computed with the same expression so that both passes produce
+// exactly the same depth.
+layout (location = 0) in vec3 inpPosition; // as stored, see vertex_attributes.glsl
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 vertexLocalPos = decode_position(inpPosition);
+    gl_Position = frame.viewProjection * instances[instance_index()].model * vec4(vertexLocalPos, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : enable
+
+#include "../common/frame_constants.glsl"
+#include "../common/lights.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/material_textures.glsl"
+
+// Flat shading without a geometry shader: the face normal is the cross product of the screen
+// space derivatives of the world position, which are constant over a triangle. It always
+// faces the camera, whatever the winding. Runs after phong/object.vert, the vertex normals
+// aren't used and the lights are evaluated at the fragment instead of the face center.
+flat in int instanceIndex;
+in vec3 fragPositionInWorldSpace;
+in vec3 normalInWorldSpace;
+in vec2 textureCoordinates;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec3 objColor = instances[instanceIndex].color.rgb;
+    int textureLayer = instances[instanceIndex].textureLayer;
+    if (textureLayer >= 0)
+        objColor *= material_texture(textureLayer, textureCoordinates);
+    vec3 materialAmbient = instances[instanceIndex].materialAmbient.rgb;
+    vec3 materialDiffuse = instances[instanceIndex].materialDiffuse.rgb;
+
+    vec3 norm = normalize(cross(dFdx(fragPositionInWorldSpace), dFdy(fragPositionInWorldSpace)));
+    vec3 ambientComponent = vec3(0.0);
+    vec3 diffuseComponent = vec3(0.0);
+
+    // only the lights of the fragment's cluster can reach it
+    LightList lightList = fragment_lights();
+    for (uint i = 0; i < lightList.count; i++)
+    {
+        Light light = list_light(lightList, i);
+        vec3 toLight = light.position.xyz - fragPositionInWorldSpace;
+        float attenuation = light_attenuation(light, length(toLight));
+        if (attenuation <= 0.0)
+            continue;
+
+        // ambient color
+        ambientComponent += attenuation * light.ambient.rgb * materialAmbient;
+
+        // diffuse color
+        float diff = max(dot(normalize(toLight), norm), 0.0);
+        diffuseComponent += attenuation * light.diffuse.rgb * (diff * materialDiffuse);
+    }
+
+    // resulting fragment color
+    vec3 result = (ambientComponent + diffuseComponent) * objColor;
+    FragColor = vec4(result, 1.0);
+}
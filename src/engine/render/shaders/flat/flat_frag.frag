@@ -1,45 +1,52 @@
 #version 460 core
+#extension GL_ARB_bindless_texture : enable
 
-struct Material 
-{
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-uniform Material material;
-
-struct Light 
-{
-    vec3 position;  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-uniform Light light;
-
-uniform vec3 objColor;
-uniform vec3 lightColor;
-uniform vec3 lightPosInObjSpace;
-uniform vec3 cameraPosInObjSpace;
-in vec3 fragPositionInObjSpace;
-in vec3 surfaceNormalInLocalSpace;
+#include "../common/frame_constants.glsl"
+#include "../common/lights.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/material_textures.glsl"
+
+flat in int instanceIndex;
+flat in vec3 fragPositionInWorldSpace; // center of the face (flat_geom.geom) or its provoking vertex (flat_provoking.vert)
+flat in vec3 surfaceNormalInWorldSpace;
+in vec2 textureCoordinates;
 
 out vec4 FragColor;
 
 void main()
 {
-    // ambient color
-    vec3 ambientComponent = light.ambient * material.ambient;
+    vec3 objColor = instances[instanceIndex].color.rgb;
+    int textureLayer = instances[instanceIndex].textureLayer;
+    if (textureLayer >= 0)
+        objColor *= material_texture(textureLayer, textureCoordinates);
+    vec3 materialAmbient = instances[instanceIndex].materialAmbient.rgb;
+    vec3 materialDiffuse = instances[instanceIndex].materialDiffuse.rgb;
+
+    vec3 norm = normalize(surfaceNormalInWorldSpace);
+    vec3 ambientComponent = vec3(0.0);
+    vec3 diffuseComponent = vec3(0.0);
+
+    // only the lights of the fragment's cluster can reach it, they are evaluated at the face center
+    // (or at the provoking vertex)
+    LightList lightList = fragment_lights();
+    for (uint i = 0; i < lightList.count; i++)
+    {
+        Light light = list_light(lightList, i);
+        vec3 toLight = light.position.xyz - fragPositionInWorldSpace;
+        float attenuation = light_attenuation(light, length(toLight));
+        if (attenuation <= 0.0)
+            continue;
+
+        // ambient color
+        ambientComponent += attenuation * light.ambient.rgb * materialAmbient;
 
-    // diffuse color
-    vec3 norm = normalize(surfaceNormalInLocalSpace);
-    vec3 lightDir = normalize(lightPosInObjSpace - fragPositionInObjSpace);
-    float diff = max(dot(lightDir, norm), 0.0);
-    vec3 diffuseComponent = light.diffuse * (diff * material.diffuse);
+        // diffuse color
+        float diff = max(dot(normalize(toLight), norm), 0.0);
+        diffuseComponent += attenuation * light.diffuse.rgb * (diff * materialDiffuse);
+    }
 
     // resulting fragment color
     vec3 result = (ambientComponent + diffuseComponent) * objColor;
     FragColor = vec4(result, 1.0);
-    //FragColor = vec4(fragPositionInObjSpace, 1.0);
+    //FragColor = vec4(fragPositionInWorldSpace, 1.0);
 } 
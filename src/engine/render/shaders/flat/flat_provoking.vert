@@ -0,0 +1,35 @@
+#version 460 core
+
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
+
+// Flat shading without a geometry shader: the `flat` outputs of a triangle are those of its
+// provoking vertex (the last one), which MeshOptimizer::assign_provoking_vertices() made
+// unique to the triangle and gave the normal of the face. Lit at the provoking vertex
+// instead of the face center. Fragment shader: flat_frag.frag.
+layout (location = 0) in vec3 inpPosition; // as stored, see vertex_attributes.glsl
+layout (location = 1) in vec3 inpNormal;
+layout (location = 2) in vec2 inpTexCoords;
+
+flat out int instanceIndex;
+flat out vec3 fragPositionInWorldSpace;
+flat out vec3 surfaceNormalInWorldSpace;
+out vec2 textureCoordinates; // interpolated, only the lighting is flat
+
+invariant gl_Position; // same depth as in the depth pre-pass, see depth/depth.vert
+
+void main()
+{
+    instanceIndex = instance_index();
+    InstanceData instance = instances[instanceIndex];
+    vec3 vertexLocalPos = decode_position(inpPosition); // coordinate of vertex in local space of its obj
+
+    gl_Position = frame.viewProjection * instance.model * vec4(vertexLocalPos, 1.0);
+    textureCoordinates = decode_texture_coordinates(inpTexCoords);
+
+    // lighting is done in world space, where the lights are
+    fragPositionInWorldSpace = (instance.model * vec4(vertexLocalPos, 1.0)).xyz;
+    surfaceNormalInWorldSpace = transpose(mat3(instance.inverseModel)) * decode_normal(inpNormal);
+}
@@ -1,22 +1,29 @@
 #version 460 core
 
-layout (location = 0) in vec3 localPosition; // coordinate of vertex in local space of its obj
-layout (location = 1) in vec3 localNormal;
-//layout (location = 2) in vec2 texCoords;
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
 
-uniform mat4 MVP;
+layout (location = 0) in vec3 inpPosition; // as stored, see vertex_attributes.glsl
+layout (location = 1) in vec3 inpNormal;
+layout (location = 2) in vec2 inpTexCoords;
 
 out VS_OUT {
     vec3 normal;
     vec3 localPosition;
+    vec2 textureCoordinates;
+    flat int instanceIndex;
 } vs_out;
 
-
-
+invariant gl_Position; // same depth as in the depth pre-pass, see depth/depth.vert
 
 void main()
 {
-    gl_Position = MVP * vec4(localPosition, 1.0);
-    vs_out.normal = localNormal;
+    vec3 localPosition = decode_position(inpPosition); // coordinate of vertex in local space of its obj
+    vs_out.instanceIndex = instance_index();
+    gl_Position = frame.viewProjection * instances[vs_out.instanceIndex].model * vec4(localPosition, 1.0);
+    vs_out.normal = decode_normal(inpNormal);
     vs_out.localPosition = localPosition;
+    vs_out.textureCoordinates = decode_texture_coordinates(inpTexCoords);
 }
\ No newline at end of file
@@ -1,48 +1,42 @@
 #version 460 core
+#extension GL_ARB_bindless_texture : enable
 
-struct Material 
-{
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-}; 
-uniform Material material;
-
-struct Light 
-{
-    vec3 position;  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-uniform Light light; 
-
-uniform vec3 objColor;
-uniform vec3 lightColor;
-uniform vec3 lightPosInObjSpace;
-uniform vec3 cameraPosInObjSpace;
-in vec3 fragPositionInObjSpace;
-in vec3 normalInLocalSpace;
+#include "../common/frame_constants.glsl"
+#include "../common/lights.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/material_textures.glsl"
+
+flat in int instanceIndex;
+in vec3 fragPositionInWorldSpace;
+in vec3 normalInWorldSpace;
+in vec2 textureCoordinates;
 
 out vec4 FragColor;
 
 void main()
 {
-    // ambient color
-    vec3 ambientComponent = light.ambient * material.ambient;
-
-    // diffuse color
-    vec3 norm = normalize(normalInLocalSpace);
-    vec3 lightDir = normalize(fragPositionInObjSpace - lightPosInObjSpace);
-    float diff = max(dot(-lightDir, norm), 0.0);
-    vec3 diffuseComponent = light.diffuse * (diff * material.diffuse);
-
-    // specular component
-    vec3 viewDir = normalize(fragPositionInObjSpace - cameraPosInObjSpace);
-    vec3 reflectionDir = reflect(lightDir, norm);
-    float specularEffect = pow(max(dot(reflectionDir, -viewDir), 0.0), 32);
-    vec3 specularComponent = light.specular * (specularEffect * material.specular); 
+    vec3 objColor = instances[instanceIndex].color.rgb;
+    int textureLayer = instances[instanceIndex].textureLayer;
+    if (textureLayer >= 0)
+        objColor *= material_texture(textureLayer, textureCoordinates);
+    vec3 materialAmbient = instances[instanceIndex].materialAmbient.rgb;
+    vec3 materialDiffuse = instances[instanceIndex].materialDiffuse.rgb;
+    vec3 materialSpecular = instances[instanceIndex].materialSpecular.rgb;
+
+    vec3 norm = normalize(normalInWorldSpace);
+    vec3 viewDir = normalize(fragPositionInWorldSpace - frame.cameraPosition.xyz);
+    vec3 ambientLight = vec3(0.0);
+    vec3 diffuseLight = vec3(0.0);
+    vec3 specularLight = vec3(0.0);
+
+    // only the lights of the fragment's cluster can reach it
+    LightList lightList = fragment_lights();
+    for (uint i = 0; i < lightList.count; i++)
+        accumulate_light(list_light(lightList, i), fragPositionInWorldSpace, norm, viewDir, ambientLight, diffuseLight, specularLight);
+
+    vec3 ambientComponent = ambientLight * materialAmbient;
+    vec3 diffuseComponent = diffuseLight * materialDiffuse;
+    vec3 specularComponent = specularLight * materialSpecular;
 
     // resulting fragment color
     vec3 result = (ambientComponent + diffuseComponent + specularComponent) * objColor;
@@ -1,16 +1,31 @@
 #version 460 core
 
-layout (location = 0) in vec3 vertexLocalPos; // coordinate of vertex in local space of its obj
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
+
+layout (location = 0) in vec3 inpPosition; // as stored, see vertex_attributes.glsl
 layout (location = 1) in vec3 inpNormal;
-//layout (location = 2) in vec2 texCoords;
+layout (location = 2) in vec2 inpTexCoords;
+
+out vec3 fragPositionInWorldSpace;
+out vec3 normalInWorldSpace;
+out vec2 textureCoordinates;
+flat out int instanceIndex;
 
-uniform mat4 MVP;
-out vec3 fragPositionInObjSpace;
-out vec3 normalInLocalSpace;
+invariant gl_Position; // same depth as in the depth pre-pass, see depth/depth.vert
 
 void main()
 {
-    gl_Position = MVP * vec4(vertexLocalPos, 1.0);
-    normalInLocalSpace = inpNormal;
-    fragPositionInObjSpace = vertexLocalPos;
-}
\ No newline at end of file
+    instanceIndex = instance_index();
+    InstanceData instance = instances[instanceIndex];
+    vec3 vertexLocalPos = decode_position(inpPosition); // coordinate of vertex in local space of its obj
+
+    gl_Position = frame.viewProjection * instance.model * vec4(vertexLocalPos, 1.0);
+    textureCoordinates = decode_texture_coordinates(inpTexCoords);
+
+    // lighting is done in world space, where the lights are, normals transform with the inverse transpose
+    fragPositionInWorldSpace = (instance.model * vec4(vertexLocalPos, 1.0)).xyz;
+    normalInWorldSpace = transpose(mat3(instance.inverseModel)) * decode_normal(inpNormal);
+}
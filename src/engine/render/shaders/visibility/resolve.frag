@@ -0,0 +1,260 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : enable
+
+// Shades every pixel of the visibility buffer once: finds the draw, instance and triangle of
+// the pixel's id, fetches the vertices of the triangle from the geometry buffer, computes
+// the barycentric coordinates of the pixel (and their screen space derivatives for the
+// texture lookups) and lights the surface like phong/object.frag, or like flat/flat_frag.frag
+// with flatNormals. After deferred/fullscreen.vert.
+
+#include "../common/frame_constants.glsl"
+#include "../common/lights.glsl"
+#include "../common/instance_data.glsl"
+#define DRAW_DATA_STRUCT_ONLY
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
+#include "../common/material_textures.glsl"
+#include "visibility_data.glsl"
+
+layout (std430, binding = 1) readonly buffer DrawBuffer
+{
+    DrawData draws[];
+};
+
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer DrawCommands
+{
+    DrawElementsIndirectCommand drawCommands[];
+};
+
+// the buffers of the geometry buffer as 32-bit words, see GeometryBuffer::bind_storage()
+layout (std430, binding = 19) readonly buffer VertexStream0 { uint vertexStream0[]; };
+layout (std430, binding = 20) readonly buffer VertexStream1 { uint vertexStream1[]; };
+layout (std430, binding = 21) readonly buffer VertexStream2 { uint vertexStream2[]; };
+layout (std430, binding = 22) readonly buffer VertexIndexes { uint vertexIndexes[]; };
+
+uniform usampler2D visibilityTriangles;
+uniform sampler2D visibilityDepth;
+uniform int drawCount; // visible draws
+
+// per attribute (position, normal, texture coordinates), see VertexLayout
+uniform ivec3 attributeFormats; // values of PositionFormat, NormalFormat and TexCoordFormat
+uniform ivec3 attributeStreams;
+uniform ivec3 attributeStrides; // in words
+uniform ivec3 attributeOffsets; // in words
+
+uniform int flatNormals; // 1: ShadingMode::FLAT
+
+// without bindless textures: the texture arrays (see TextureArrays), selected by the draw
+#define MAX_TEXTURE_ARRAYS 4 // same as VisibilityBuffer::MAX_TEXTURE_ARRAYS
+uniform sampler2DArray materialTextureArrays[MAX_TEXTURE_ARRAYS];
+
+out vec4 FragColor;
+
+uint stream_word(int stream, uint word)
+{
+    if (stream == 0) return vertexStream0[word];
+    if (stream == 1) return vertexStream1[word];
+    return vertexStream2[word];
+}
+
+// first word of an attribute of a vertex
+uint attribute_word(int attrib, uint vertex)
+{
+    return vertex * uint(attributeStrides[attrib]) + uint(attributeOffsets[attrib]);
+}
+
+vec3 fetch_position(uint vertex, DrawData draw)
+{
+    uint word = attribute_word(0, vertex);
+    int stream = attributeStreams[0];
+    uint w0 = stream_word(stream, word), w1 = stream_word(stream, word + 1);
+    vec3 position;
+    if (attributeFormats[0] == 0) position = uintBitsToFloat(uvec3(w0, w1, stream_word(stream, word + 2)));
+    else if (attributeFormats[0] == 1) position = vec3(unpackHalf2x16(w0), unpackHalf2x16(w1).x);
+    else position = vec3(unpackSnorm2x16(w0), unpackSnorm2x16(w1).x);
+    return decode_position(position, draw);
+}
+
+vec3 fetch_normal(uint vertex)
+{
+    uint word = attribute_word(1, vertex);
+    int stream = attributeStreams[1];
+    if (attributeFormats[1] == 0)
+        return uintBitsToFloat(uvec3(stream_word(stream, word), stream_word(stream, word + 1), stream_word(stream, word + 2)));
+    return decode_normal(vec3(unpackSnorm2x16(stream_word(stream, word)), 0.0));
+}
+
+vec2 fetch_texture_coordinates(uint vertex, DrawData draw)
+{
+    uint word = attribute_word(2, vertex);
+    int stream = attributeStreams[2];
+    vec2 textureCoordinates;
+    if (attributeFormats[2] == 0) textureCoordinates = uintBitsToFloat(uvec2(stream_word(stream, word), stream_word(stream, word + 1)));
+    else textureCoordinates = unpackUnorm2x16(stream_word(stream, word));
+    return decode_texture_coordinates(textureCoordinates, draw);
+}
+
+uint fetch_index(uint index, bool shortIndexes)
+{
+    if (!shortIndexes)
+        return vertexIndexes[index];
+    uint word = vertexIndexes[index >> 1];
+    return (index & 1u) == 0u ? word & 0xFFFFu : word >> 16;
+}
+
+// material_texture() with explicit derivatives of the coordinates, samplers of an array may
+// only be indexed with constants here since the array differs between pixels
+vec3 material_texture_grad(int textureArray, int textureIndex, vec2 textureCoordinates, vec2 dx, vec2 dy)
+{
+#ifdef GL_ARB_bindless_texture
+    if (frame.bindlessTextures != 0)
+        return textureGrad(sampler2D(materialTextureHandles[textureIndex]), textureCoordinates, dx, dy).rgb;
+#endif
+    vec3 coordinates = vec3(textureCoordinates, textureIndex);
+    switch (textureArray)
+    {
+        case 0: return textureGrad(materialTextureArrays[0], coordinates, dx, dy).rgb;
+        case 1: return textureGrad(materialTextureArrays[1], coordinates, dx, dy).rgb;
+        case 2: return textureGrad(materialTextureArrays[2], coordinates, dx, dy).rgb;
+        case 3: return textureGrad(materialTextureArrays[3], coordinates, dx, dy).rgb;
+    }
+    return vec3(1.0);
+}
+
+// the last draw whose first triangle is at most id
+uint find_draw(uint id)
+{
+    uint low = 0, high = uint(drawCount) - 1;
+    while (low < high)
+    {
+        uint middle = (low + high + 1) / 2;
+        if (visibleDraws[middle].firstTriangle <= id) low = middle;
+        else high = middle - 1;
+    }
+    return low;
+}
+
+// Perspective correct barycentric coordinates of a point of the window in normalized device
+// coordinates, and their change over one pixel to the right (dx) and up (dy).
+struct Barycentrics
+{
+    vec3 lambda;
+    vec3 dx;
+    vec3 dy;
+};
+
+Barycentrics barycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 ndc, vec2 windowSize)
+{
+    vec3 invW = 1.0 / vec3(clip0.w, clip1.w, clip2.w);
+    vec2 ndc0 = clip0.xy * invW.x;
+    vec2 ndc1 = clip1.xy * invW.y;
+    vec2 ndc2 = clip2.xy * invW.z;
+
+    // the barycentrics divided by w are linear in screen space
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = ddx.x + ddx.y + ddx.z;
+    float ddySum = ddy.x + ddy.y + ddy.z;
+
+    vec2 delta = ndc - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpW = 1.0 / interpInvW;
+
+    Barycentrics result;
+    result.lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy);
+
+    // one pixel is 2 / windowSize in normalized device coordinates
+    ddx *= 2.0 / windowSize.x;
+    ddy *= 2.0 / windowSize.y;
+    ddxSum *= 2.0 / windowSize.x;
+    ddySum *= 2.0 / windowSize.y;
+    result.dx = (result.lambda * interpInvW + ddx) / (interpInvW + ddxSum) - result.lambda;
+    result.dy = (result.lambda * interpInvW + ddy) / (interpInvW + ddySum) - result.lambda;
+    return result;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint id = texelFetch(visibilityTriangles, pixel, 0).r;
+    if (id == 0u)
+        discard;
+    float depth = texelFetch(visibilityDepth, pixel, 0).r;
+    gl_FragDepth = depth;
+
+    // draw, instance and triangle of the id
+    uint drawIndex = find_draw(id);
+    VisibleDraw visibleDraw = visibleDraws[drawIndex];
+    DrawElementsIndirectCommand command = drawCommands[drawIndex];
+    DrawData draw = draws[drawIndex];
+    uint triangle = id - visibleDraw.firstTriangle;
+    int instanceIndex = int(draw.firstInstance + triangle / visibleDraw.triangleCount);
+    triangle %= visibleDraw.triangleCount;
+    InstanceData instance = instances[instanceIndex];
+
+    // the vertices of the triangle
+    uint vertices[3];
+    vec3 positions[3];
+    vec4 clipPositions[3];
+    for (int i = 0; i < 3; i++)
+    {
+        uint index = fetch_index(command.firstIndex + triangle * 3u + uint(i), visibleDraw.shortIndexes != 0u);
+        vertices[i] = uint(int(index) + command.baseVertex);
+        vec4 worldPosition = instance.model * vec4(fetch_position(vertices[i], draw), 1.0);
+        positions[i] = worldPosition.xyz;
+        clipPositions[i] = frame.viewProjection * worldPosition;
+    }
+    vec2 windowSize = vec2(textureSize(visibilityTriangles, 0));
+    vec2 ndc = (gl_FragCoord.xy / windowSize) * 2.0 - 1.0;
+    Barycentrics bary = barycentrics(clipPositions[0], clipPositions[1], clipPositions[2], ndc, windowSize);
+
+    // material
+    vec3 objColor = instance.color.rgb;
+    if (instance.textureLayer >= 0)
+    {
+        vec2 uv0 = fetch_texture_coordinates(vertices[0], draw);
+        vec2 uv1 = fetch_texture_coordinates(vertices[1], draw);
+        vec2 uv2 = fetch_texture_coordinates(vertices[2], draw);
+        vec2 uv = bary.lambda.x * uv0 + bary.lambda.y * uv1 + bary.lambda.z * uv2;
+        vec2 uvDx = bary.dx.x * uv0 + bary.dx.y * uv1 + bary.dx.z * uv2;
+        vec2 uvDy = bary.dy.x * uv0 + bary.dy.y * uv1 + bary.dy.z * uv2;
+        objColor *= material_texture_grad(visibleDraw.textureArray, instance.textureLayer, uv, uvDx, uvDy);
+    }
+
+    // surface, flat shading lights the face at its center with the average vertex normal
+    vec3 n0 = fetch_normal(vertices[0]), n1 = fetch_normal(vertices[1]), n2 = fetch_normal(vertices[2]);
+    vec3 position, normal;
+    if (flatNormals != 0)
+    {
+        position = (positions[0] + positions[1] + positions[2]) / 3.0;
+        normal = (n0 + n1 + n2) / 3.0;
+    }
+    else
+    {
+        position = bary.lambda.x * positions[0] + bary.lambda.y * positions[1] + bary.lambda.z * positions[2];
+        normal = bary.lambda.x * n0 + bary.lambda.y * n1 + bary.lambda.z * n2;
+    }
+    normal = normalize(transpose(mat3(instance.inverseModel)) * normal);
+
+    vec3 viewDir = normalize(position - frame.cameraPosition.xyz);
+    vec3 ambientLight = vec3(0.0);
+    vec3 diffuseLight = vec3(0.0);
+    vec3 specularLight = vec3(0.0);
+    LightList lightList = pixel_lights(gl_FragCoord.xy, depth);
+    for (uint i = 0; i < lightList.count; i++)
+        accumulate_light(list_light(lightList, i), position, normal, viewDir, ambientLight, diffuseLight, specularLight);
+
+    vec3 materialSpecular = flatNormals != 0 ? vec3(0.0) : instance.materialSpecular.rgb; // no highlights with flat shading
+    vec3 result = ambientLight * instance.materialAmbient.rgb + diffuseLight * instance.materialDiffuse.rgb + specularLight * materialSpecular;
+    FragColor = vec4(result * objColor, 1.0);
+}
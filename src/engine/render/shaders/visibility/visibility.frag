@@ -0,0 +1,12 @@
+#version 460 core
+
+// Writes the id of the triangle, gl_PrimitiveID restarts at 0 for every instance.
+
+flat in uint firstTriangle;
+
+layout (location = 0) out uint outTriangle;
+
+void main()
+{
+    outTriangle = firstTriangle + uint(gl_PrimitiveID);
+}
@@ -0,0 +1,25 @@
+#version 460 core
+
+#include "../common/frame_constants.glsl"
+#include "../common/instance_data.glsl"
+#include "../common/draw_data.glsl"
+#include "../common/vertex_attributes.glsl"
+#include "visibility_data.glsl"
+
+// Visibility pass: only the position stream is fetched (GeometryBuffer::bind_positions()),
+// the fragment shader writes the id of the triangle. gl_Position is invariant and computed
+// like in depth/depth.vert, for the GL_EQUAL test after the depth pre-pass.
+layout (location = 0) in vec3 inpPosition; // as stored, see vertex_attributes.glsl
+
+flat out uint firstTriangle; // id of the first triangle of the instance
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 vertexLocalPos = decode_position(inpPosition);
+    gl_Position = frame.viewProjection * instances[instance_index()].model * vec4(vertexLocalPos, 1.0);
+
+    VisibleDraw draw = visibleDraws[drawOffset + gl_DrawID];
+    firstTriangle = draw.firstTriangle + uint(gl_InstanceID) * draw.triangleCount;
+}
@@ -0,0 +1,15 @@
+// Triangle ids of the visibility buffer, see VisibleDraw in engine/render/uniform_blocks.h
+// and VisibilityBuffer. Id 0 is the background, the triangles of the draws are numbered
+// from 1 in the order of the draw commands.
+struct VisibleDraw
+{
+    uint firstTriangle;
+    uint triangleCount; // per instance
+    uint shortIndexes; // 1: the command's firstIndex counts 16-bit indexes
+    int textureArray; // of the draw's textures (without bindless textures), -1 without texture
+};
+
+layout (std430, binding = 18) readonly buffer VisibleDraws
+{
+    VisibleDraw visibleDraws[];
+};
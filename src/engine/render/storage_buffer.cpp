@@ -0,0 +1,79 @@
+#include "storage_buffer.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+/*
+* Creates the buffer and binds it to the binding point. If capacity is 0, the storage is
+* allocated by the first upload().
+*/
+ruya::StorageBuffer::StorageBuffer(GLuint bindingPoint, GLsizeiptr capacity)
+	: mBufferID(0), mBindingPoint(bindingPoint), mCapacity(0)
+{
+	glCreateBuffers(1, &mBufferID);
+	if (capacity > 0)
+	{
+		glNamedBufferData(mBufferID, capacity, nullptr, GL_STREAM_DRAW);
+		mCapacity = capacity;
+		GpuResources::track(GpuResources::Type::BUFFER, mBufferID, mCapacity);
+	}
+	bind();
+}
+
+ruya::StorageBuffer::~StorageBuffer()
+{
+	GpuResources::release(GpuResources::Type::BUFFER, mBufferID);
+}
+
+/*
+* Replaces the contents of the buffer by size bytes of data.
+*	- the old storage is orphaned, so the upload doesn't wait for draw calls of the
+*	  previous frame that are still reading the buffer
+*	- the capacity is doubled until the data fits, it never shrinks
+*/
+void ruya::StorageBuffer::upload(const void* data, GLsizeiptr size)
+{
+	if (size <= 0) return;
+
+	GLsizeiptr newCapacity = mCapacity > 0 ? mCapacity : size;
+	while (newCapacity < size) newCapacity *= 2;
+	mCapacity = newCapacity;
+
+	glNamedBufferData(mBufferID, mCapacity, nullptr, GL_STREAM_DRAW); // orphan
+	GpuResources::track(GpuResources::Type::BUFFER, mBufferID, mCapacity);
+	glNamedBufferSubData(mBufferID, 0, size, data);
+}
+
+/*
+* Overwrites size bytes at offset without touching the rest of the buffer, for buffers that
+* are only partially changed between frames.
+* @pre offset + size <= capacity()
+*/
+void ruya::StorageBuffer::update(const void* data, GLsizeiptr size, GLintptr offset)
+{
+	if (size <= 0) return;
+	glNamedBufferSubData(mBufferID, offset, size, data);
+}
+
+/*
+* Makes sure the buffer can hold at least capacity bytes, for buffers that are filled by
+* shaders. The contents are undefined after the buffer has grown.
+*/
+void ruya::StorageBuffer::reserve(GLsizeiptr capacity)
+{
+	if (capacity <= mCapacity) return;
+
+	GLsizeiptr newCapacity = mCapacity > 0 ? mCapacity : capacity;
+	while (newCapacity < capacity) newCapacity *= 2;
+	mCapacity = newCapacity;
+
+	glNamedBufferData(mBufferID, mCapacity, nullptr, GL_DYNAMIC_COPY);
+	GpuResources::track(GpuResources::Type::BUFFER, mBufferID, mCapacity);
+}
+
+/*
+* (Re)binds the buffer to its binding point.
+*/
+void ruya::StorageBuffer::bind() const
+{
+	GLState::bind_buffer_base(GL_SHADER_STORAGE_BUFFER, mBindingPoint, mBufferID);
+}
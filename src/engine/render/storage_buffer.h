@@ -0,0 +1,41 @@
+#ifndef STORAGE_BUFFER_H
+#define STORAGE_BUFFER_H
+
+#include <vector>
+#include <glad/glad.h>
+
+namespace ruya
+{
+	/*
+	* Shader storage buffer object (SSBO) bound to a fixed binding point, for data that is
+	* streamed to the GPU every frame and whose size isn't known up front (per-instance data,
+	* ...). Shaders declare the buffer block with the same binding, e.g. 
+	* layout(std430, binding = 0) readonly buffer ...
+	*/
+	class StorageBuffer
+	{
+	public:
+		StorageBuffer(GLuint bindingPoint, GLsizeiptr capacity = 0);
+		~StorageBuffer();
+		StorageBuffer(const StorageBuffer&) = delete;
+		StorageBuffer& operator=(const StorageBuffer&) = delete;
+
+		void upload(const void* data, GLsizeiptr size);
+		template <class T>
+		void upload(const std::vector<T>& elements) { upload(elements.data(), elements.size() * sizeof(T)); }
+		void update(const void* data, GLsizeiptr size, GLintptr offset);
+		void reserve(GLsizeiptr capacity);
+		void bind() const;
+
+		GLuint ID() const { return mBufferID; }
+		GLuint binding_point() const { return mBindingPoint; }
+		GLsizeiptr capacity() const { return mCapacity; }
+
+	private:
+		GLuint mBufferID;
+		GLuint mBindingPoint;
+		GLsizeiptr mCapacity;
+	};
+}
+
+#endif // !STORAGE_BUFFER_H
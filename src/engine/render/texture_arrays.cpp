@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "texture_arrays.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+
+namespace
+{
+	GLenum internal_format(int channels)
+	{
+		switch (channels)
+		{
+			case 1: return GL_R8;
+			case 2: return GL_RG8;
+			case 3: return GL_RGB8;
+			default: return GL_RGBA8;
+		}
+	}
+}
+
+ruya::TextureArrays::~TextureArrays()
+{
+	for (Array& array : mArrays)
+		GpuResources::release(GpuResources::Type::TEXTURE, array.id);
+}
+
+/*
+* Copies the texture into a layer of the array for its size and format, textures that were
+* added before keep their layer. Free layers are reused before the array grows.
+* @returns an invalid Layer for textures without GL texture (failed to load or still loading)
+*/
+ruya::TextureArrays::Layer ruya::TextureArrays::add(const shared_ptr<Texture>& texturePtr)
+{
+	const Texture& texture = *texturePtr;
+	Layer found = find(texture);
+	if (found.valid()) return found;
+	if (texture.ID() == 0) return Layer();
+
+	auto stale = mLayers.find(texture.ID()); // of a destroyed texture that had the same name
+	if (stale != mLayers.end()) mArrays[stale->second.layer.array].freeLayers.push_back(stale->second.layer.layer);
+
+	Layer layer;
+	layer.array = array_for(texture.width(), texture.height(), texture.channels());
+	Array& array = mArrays[layer.array];
+	if (!array.freeLayers.empty())
+	{
+		layer.layer = array.freeLayers.back();
+		array.freeLayers.pop_back();
+	}
+	else
+	{
+		if (array.layers == array.capacity)
+			grow(array, array.capacity * 2);
+		layer.layer = array.layers++;
+	}
+
+	// the texture has the same format and mip levels as the array, nothing goes through the CPU
+	for (GLsizei level = 0; level < array.levels; level++)
+	{
+		GLsizei width = std::max(array.width >> level, 1);
+		GLsizei height = std::max(array.height >> level, 1);
+		glCopyImageSubData(texture.ID(), GL_TEXTURE_2D, level, 0, 0, 0, array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer.layer, width, height, 1);
+	}
+
+	mLayers[texture.ID()] = Entry{ layer, texturePtr };
+	return layer;
+}
+
+/*
+* The layer of a texture that has been added, an invalid Layer otherwise.
+*/
+ruya::TextureArrays::Layer ruya::TextureArrays::find(const Texture& texture) const
+{
+	auto it = mLayers.find(texture.ID());
+	if (it == mLayers.end()) return Layer();
+	shared_ptr<Texture> added = it->second.texture.lock();
+	return added.get() == &texture ? it->second.layer : Layer();
+}
+
+/*
+* Frees the layers of the textures that have been destroyed since they were added.
+*/
+void ruya::TextureArrays::collect()
+{
+	for (auto it = mLayers.begin(); it != mLayers.end();)
+	{
+		if (it->second.texture.expired())
+		{
+			mArrays[it->second.layer.array].freeLayers.push_back(it->second.layer.layer);
+			it = mLayers.erase(it);
+		}
+		else it++;
+	}
+}
+
+/*
+* Binds the array to a texture unit.
+*/
+void ruya::TextureArrays::bind(int array, GLuint unit)
+{
+	GLState::bind_texture_unit(unit, GL_TEXTURE_2D_ARRAY, mArrays[array].id);
+}
+
+/*
+* Index of the array holding textures of the given size and format, created if there is none.
+*/
+int ruya::TextureArrays::array_for(GLsizei width, GLsizei height, int channels)
+{
+	for (size_t i = 0; i < mArrays.size(); i++)
+	{
+		if (mArrays[i].width == width && mArrays[i].height == height && mArrays[i].channels == channels)
+			return static_cast<int>(i);
+	}
+
+	Array& array = mArrays.emplace_back();
+	array.width = width;
+	array.height = height;
+	array.channels = channels;
+	array.levels = static_cast<GLsizei>(std::floor(std::log2(std::max(width, height)))) + 1;
+	grow(array, INITIAL_LAYERS);
+	return static_cast<int>(mArrays.size() - 1);
+}
+
+/*
+* Replaces the storage of the array by one with room for capacity layers, the layers in
+* use (all mip levels) are copied over.
+* @throws std::runtime_error if the array would get more layers than the GPU supports
+*/
+void ruya::TextureArrays::grow(Array& array, GLsizei capacity)
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	if (array.layers >= maxLayers)
+		throw std::runtime_error("[TextureArrays] more than " + std::to_string(maxLayers) + " textures of the same size and format");
+	capacity = std::min<GLsizei>(capacity, maxLayers);
+
+	GLuint id;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+	glTextureStorage3D(id, array.levels, internal_format(array.channels), array.width, array.height, capacity);
+	GpuResources::track(GpuResources::Type::TEXTURE, id, GpuResources::texture_bytes(array.width, array.height, capacity, array.channels, true));
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT); // same sampling as Texture
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (array.id != 0)
+	{
+		for (GLsizei level = 0; level < array.levels && array.layers > 0; level++)
+		{
+			GLsizei width = std::max(array.width >> level, 1);
+			GLsizei height = std::max(array.height >> level, 1);
+			glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, array.layers);
+		}
+		GpuResources::release(GpuResources::Type::TEXTURE, array.id);
+	}
+	array.id = id;
+	array.capacity = capacity;
+}
@@ -0,0 +1,92 @@
+#ifndef TEXTURE_ARRAYS_H
+#define TEXTURE_ARRAYS_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "engine/scene/texture.h"
+
+using std::shared_ptr;
+using std::weak_ptr;
+using std::unordered_map;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Material textures packed into GL_TEXTURE_2D_ARRAYs: textures with the same size and
+	* number of channels become layers of the same array. All our materials (1K ambientCG 
+	* color maps) end up in one array, so a frame binds it once and the shaders select the
+	* texture of an object with its layer index (InstanceData::textureLayer) instead of the
+	* renderer switching textures between draws.
+	*	- a texture is copied into its array by the first add(), with all its mip levels and
+	*	  on the GPU (glCopyImageSubData), the Texture keeps its own GL texture
+	*	- the arrays don't keep textures alive, collect() frees the layers of textures that
+	*	  have been destroyed so that new textures reuse them
+	*	- arrays start small and double their layer count when full, the layers are copied
+	*	  on the GPU as well
+	*/
+	class TextureArrays
+	{
+	public:
+		/*
+		* Where a texture lives, array < 0 if it is not in any array.
+		*/
+		struct Layer
+		{
+			int array = -1;
+			int layer = -1;
+
+			bool valid() const { return array >= 0; }
+		};
+
+		static constexpr GLsizei INITIAL_LAYERS = 8;
+
+		TextureArrays() = default;
+		~TextureArrays();
+		TextureArrays(const TextureArrays&) = delete;
+		TextureArrays& operator=(const TextureArrays&) = delete;
+
+		Layer add(const shared_ptr<Texture>& texture);
+		Layer find(const Texture& texture) const;
+		void collect();
+		void bind(int array, GLuint unit);
+
+		size_t array_count() const { return mArrays.size(); }
+		GLsizei layer_count(int array) const { return mArrays[array].layers; }
+		GLuint ID(int array) const { return mArrays[array].id; }
+
+	private:
+		struct Array
+		{
+			GLuint id = 0;
+			GLsizei width = 0;
+			GLsizei height = 0;
+			int channels = 0;
+			GLsizei levels = 0;
+			GLsizei layers = 0; // in use or free
+			GLsizei capacity = 0;
+			vector<GLsizei> freeLayers; // of destroyed textures
+		};
+
+		int array_for(GLsizei width, GLsizei height, int channels);
+		void grow(Array& array, GLsizei capacity);
+
+		/*
+		* The texture is kept to tell a destroyed texture apart from a new one that got the
+		* same GL name.
+		*/
+		struct Entry
+		{
+			Layer layer;
+			weak_ptr<Texture> texture;
+		};
+
+		vector<Array> mArrays;
+		unordered_map<GLuint, Entry> mLayers; // by Texture::ID()
+	};
+}
+
+#endif // !TEXTURE_ARRAYS_H
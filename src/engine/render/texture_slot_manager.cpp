@@ -0,0 +1,112 @@
+#include "texture_slot_manager.h"
+#include "gl_state.h"
+
+ruya::TextureSlotManager::TextureSlotManager()
+{
+	// init slot maps and priority list
+	int fragShaderMaxSlots = Texture::get_num_texture_slots_fragment_shader();
+	for (int i = GL_TEXTURE0; i < GL_TEXTURE0 + fragShaderMaxSlots; i++)
+	{
+		// init all slots to 0 (= contains no texture)
+		mSlotTextureMap[i] = 0; 
+		// init priorities in numerical order
+		list<GLuint>::iterator slotIter = mSlotPriority.insert(mSlotPriority.end(), i); 
+		// init slot iterators
+		mSlotPriorityRefMap[i] = slotIter;
+	}
+}
+
+/*
+* Binds given texture to one of the slots and returns the slot number so that the
+* caller set the uniform location of the texture sampler to the correct slot number.
+* 
+* @pre: the given texture must have already been created with glTexImage2D()
+*		(which is done by default by the Texture class' constructor)
+*/
+GLuint ruya::TextureSlotManager::bind_texture(const ruya::Texture& texture)
+{
+	// Check whether the texture is already bound
+	if (mTextureSlotMap[texture.ID()] == 0)
+	{
+		// free new slot and set map values to new texture id
+		GLuint newSlot = free_slot();
+		mSlotTextureMap[newSlot] = texture.ID();
+		mTextureSlotMap[texture.ID()] = newSlot;
+
+		// make new slot top priority
+		set_top_priority(mSlotPriorityRefMap[newSlot]);
+
+		// bind texture to new slot
+		GLState::bind_texture_unit(newSlot - GL_TEXTURE0, GL_TEXTURE_2D, texture.ID());
+	}
+	else
+	{
+		// texture is already bound to a slot, increment slot priority
+		GLuint textureSlot = mTextureSlotMap[texture.ID()];
+		increment_priority(mSlotPriorityRefMap[textureSlot]);
+	}
+
+	// return slot number the texture has been (or was already) bound to
+	return mTextureSlotMap[texture.ID()];
+}
+
+/*
+* Frees a texture slot to be used by a new Texture.
+*	Is responsible for internal state changes of TextureSlotManager() when freeing a slot
+* @returns slot number that has been freed.
+*/
+GLuint ruya::TextureSlotManager::free_slot()
+{
+	// get number of least priority slot
+	GLuint slot = mSlotPriority.back();
+
+	// unregister texture residing in that slot
+	GLuint oldTextureId = mSlotTextureMap[slot];
+	mTextureSlotMap[oldTextureId] = 0; // tex id might be 0 (invalid) but does no harm
+
+	// mark texture slot as free by setting its mapped texture value to 0
+	mSlotTextureMap[slot] = 0;
+
+	// return slot num
+	return slot;
+}
+
+/*
+* Moves given slot up one position in the priority list.
+* (this is done when an already-binded texture is being rendered again)
+*/
+void ruya::TextureSlotManager::increment_priority(list<GLuint>::iterator& slotIt)
+{
+	// can't increment position if it's the first in the list
+	if (slotIt == mSlotPriority.begin())
+		return;
+
+	// swap values of elements at pos "slotIt" and the one before
+	GLuint temp1 = *slotIt;
+	slotIt--;
+	GLuint temp2 = *slotIt;
+	*slotIt = temp1;
+	slotIt++;
+	*slotIt = temp2;
+}
+
+/*
+* Makes given slot from the mSlotPriority list top priority by placing it at the front of the list.
+* @post: slotIt has been updated but is still pointing to the same slot (that is now at the front of the priority list)
+*/
+void ruya::TextureSlotManager::set_top_priority(list<GLuint>::iterator& slotIt)
+{
+	// save slot number and remove slot from priority list
+	GLuint slot = *slotIt;
+	mSlotPriority.erase(slotIt);
+
+	// reinsert slot to the front
+	mSlotPriority.push_front(slot);
+
+	// update slotIt iterator since it was invalidated with the erase operation
+	slotIt = mSlotPriority.begin();
+}
+
+
+
+
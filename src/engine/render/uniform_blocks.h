@@ -0,0 +1,254 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+/*
+* CPU side layouts of the uniform blocks and storage buffers shared by the shaders. They 
+* have to match the std140/std430 blocks in the shaders/common/ folder: every vec3 is stored 
+* as a vec4 and the size of each block is a multiple of 16 bytes.
+*/
+namespace ruya
+{
+	namespace UniformBindings
+	{
+		constexpr unsigned int FRAME_CONSTANTS = 0;
+		constexpr unsigned int LIGHTING_CONSTANTS = 1;
+	}
+
+	namespace StorageBindings
+	{
+		constexpr unsigned int INSTANCES = 0;
+		constexpr unsigned int DRAWS = 1;
+		constexpr unsigned int DRAW_COMMANDS = 2;
+
+		// GPU culling, see GpuCulling
+		constexpr unsigned int OBJECT_INSTANCES = 3;
+		constexpr unsigned int OBJECT_BOUNDS = 4;
+		constexpr unsigned int LOD_LEVELS = 5;
+		constexpr unsigned int CULL_COMMANDS = 6;
+		constexpr unsigned int CULL_COUNTERS = 7;
+
+		constexpr unsigned int MATERIAL_TEXTURES = 8; // bindless texture handles, see BindlessTextures
+		constexpr unsigned int CULL_DRAWS = 9; // DrawData of each GpuCulling command, copied by the compaction
+
+		// meshlet culling, see MeshletCulling
+		constexpr unsigned int MESHLETS = 10; // of all meshes, see GeometryBuffer::bind_meshlets()
+		constexpr unsigned int MESHLET_JOBS = 11;
+		constexpr unsigned int MESHLET_COUNTERS = 12;
+
+		constexpr unsigned int OBJECT_LODS = 13; // level each object was drawn with in the previous frame, see GpuCulling
+
+		// clustered lighting, see LightClusters
+		constexpr unsigned int LIGHTS = 14; // all lights of the frame
+		constexpr unsigned int CLUSTER_LIGHT_COUNTS = 15;
+		constexpr unsigned int CLUSTER_LIGHT_INDEXES = 16;
+		constexpr unsigned int TILE_LIGHT_COUNTS = 17; // deferred shading, see DeferredShading
+
+		// visibility buffer, see VisibilityBuffer
+		constexpr unsigned int VISIBLE_DRAWS = 18;
+		constexpr unsigned int VERTEX_STREAMS = 19; // 19 to 21, one per stream of the vertex layout, see GeometryBuffer::bind_storage()
+		constexpr unsigned int VERTEX_INDEXES = 22;
+	}
+
+	/*
+	* Constant for a whole frame, written once per Renderer::render_scene().
+	* shaders/common/frame_constants.glsl
+	*/
+	struct FrameConstants
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 viewProjection;
+		glm::vec4 cameraPosition; // w = 1
+		glm::vec4 frustumPlanes[6]; // see Frustum
+		float time; // seconds since the renderer was created
+		int bindlessTextures; // 1: material textures are sampled through BindlessTextures, 0: through TextureArrays
+		int octahedralNormals; // 1: normals are octahedral encoded, see VertexLayout
+		float lodScale; // projects an error at distance 1 to the screen, relative to the allowed error, see Renderer::set_lod_error()
+	};
+
+	/*
+	* How the lights of the frame are found by the object shaders, written once per
+	* Renderer::render_scene(). Without LightClusters (clusterCount.x = 0) every fragment
+	* loops over all lightCount lights.
+	* shaders/common/lights.glsl
+	*/
+	struct LightingConstants
+	{
+		glm::uvec4 clusterCount; // xyz = clusters along the width, height and depth of the view, w = capacity of the light list of a cluster
+		glm::vec2 tileSize; // pixels covered by a cluster
+		float sliceScale; // depth slice of a view depth z = floor(log(z) * sliceScale + sliceBias)
+		float sliceBias;
+		float nearPlane;
+		float farPlane;
+		GLuint lightCount; // in the light buffer
+		GLuint padding;
+	};
+
+	/*
+	* A point light, one element per LightSource in the light buffer. Lights with range 0
+	* reach everything and don't fade, see LightSource::range().
+	* shaders/common/lights.glsl
+	*/
+	struct LightData
+	{
+		glm::vec4 position; // world space, w = range
+		glm::vec4 ambient;
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+	};
+
+	/*
+	* Per-instance data of an object, one element per rendered object in the instance buffer.
+	* The shaders index it with DrawData::firstInstance + gl_InstanceID.
+	* shaders/common/instance_data.glsl
+	*/
+	struct InstanceData
+	{
+		glm::mat4 model;
+		glm::mat4 inverseModel;
+		glm::vec4 color;
+		glm::vec4 materialAmbient;
+		glm::vec4 materialDiffuse;
+		glm::vec4 materialSpecular; // w = shininess
+		int textureLayer; // in the texture array bound for the draw, or index of the bindless handle, -1 without texture
+		int padding[3];
+	};
+
+	/*
+	* Per-draw data, one element per draw command of a multi-draw call. The shaders index 
+	* it with drawOffset + gl_DrawID, where drawOffset is the index of the first command
+	* of the multi-draw call (gl_DrawID restarts at 0 for every call). The dequantization
+	* of the draw's mesh maps its stored vertex attributes back to local space, see
+	* VertexLayout::Dequantization.
+	* shaders/common/draw_data.glsl
+	*/
+	struct DrawData
+	{
+		GLuint firstInstance; // index of the first instance of the draw in the instance buffer
+		GLuint padding[3];
+		glm::vec4 positionScale;
+		glm::vec4 positionOffset;
+		glm::vec4 texCoordTransform; // xy = scale, zw = offset
+
+		bool operator==(const DrawData& other) const = default;
+	};
+
+	/*
+	* Triangles of a draw command in the visibility buffer, one element per draw command of
+	* the objects. The triangles of all instances of all draws are numbered consecutively
+	* from 1 (0 is the background): instance i of the draw has the ids
+	* [firstTriangle + i * triangleCount, firstTriangle + (i + 1) * triangleCount).
+	* shaders/visibility/visibility_data.glsl
+	*/
+	struct VisibleDraw
+	{
+		GLuint firstTriangle;
+		GLuint triangleCount; // per instance
+		GLuint shortIndexes; // 1: GL_UNSIGNED_SHORT, the command's firstIndex counts 16-bit indexes
+		GLint textureArray; // of the draw's textures (without bindless textures), -1 without texture
+	};
+
+	/*
+	* Layout of the commands read by glMultiDrawElementsIndirect() from the draw indirect
+	* buffer, defined by OpenGL.
+	*/
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count; // number of indexes
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/*
+	* Culling data of an object for the GPU culling pass, its levels of detail are
+	* lodLevels[firstLod, firstLod + lodCount). lodCount = 0 for objects that aren't drawn.
+	* shaders/culling/culling_data.glsl
+	*/
+	struct ObjectBounds
+	{
+		glm::vec4 sphere; // world space bounding sphere: center, w = radius
+		GLuint firstLod;
+		GLuint lodCount;
+		GLuint padding[2];
+	};
+
+	/*
+	* A level of detail of an object: the draw command of its mesh and its error relative
+	* to the bounding radius of the most detailed level, see LodChain.
+	*/
+	struct LodLevel
+	{
+		GLuint command;
+		float error;
+	};
+
+	/*
+	* Counters written by the GPU culling pass.
+	*/
+	struct CullCounters
+	{
+		GLuint drawCount[2]; // compacted draw commands with 16-bit and with 32-bit indexes, read by glMultiDrawElementsIndirectCount()
+		GLuint visible;
+		GLuint frustumCulled;
+		GLuint occlusionCulled;
+		GLuint padding[3];
+	};
+
+	/*
+	* Culling data of a meshlet (see Meshlet), in the local space of its mesh. Element of the
+	* meshlet buffer of the GeometryBuffer.
+	* shaders/culling/meshlet_data.glsl
+	*/
+	struct MeshletData
+	{
+		glm::vec4 sphere; // center, w = radius
+		glm::vec4 coneApex; // w unused
+		glm::vec4 coneAxis; // w = cutoff
+		GLuint firstIndex; // relative to the first index of the mesh
+		GLuint indexCount;
+		GLuint padding[2];
+	};
+
+	/*
+	* The meshlets of the instances of a mesh that MeshletCulling tests: one invocation per
+	* instance and meshlet, the invocations of the job start at firstWork. Each draw command
+	* the job writes gets a copy of draw with the firstInstance of its instance.
+	* shaders/culling/meshlet_data.glsl
+	*/
+	struct MeshletJob
+	{
+		GLuint firstWork;
+		GLuint firstMeshlet; // in the meshlet buffer
+		GLuint meshletCount;
+		GLuint firstInstance; // in the instance buffer
+		GLuint instanceCount;
+		GLuint firstIndex; // of the mesh, in indexes of its type
+		GLint baseVertex;
+		GLuint shortIndexes; // 1: the commands go to the 16-bit index draw
+		DrawData draw;
+	};
+
+	/*
+	* Counters written by the meshlet culling pass.
+	*/
+	struct MeshletCounters
+	{
+		GLuint drawCount[2]; // like CullCounters
+		GLuint visible;
+		GLuint frustumCulled;
+		GLuint backfaceCulled;
+		GLuint padding[3];
+	};
+
+	static_assert(sizeof(FrameConstants) % 16 == 0 && sizeof(LightingConstants) % 16 == 0, "std140 blocks must be multiples of 16 bytes");
+	static_assert(sizeof(InstanceData) % 16 == 0 && sizeof(DrawData) % 16 == 0, "std430 array elements must be multiples of 16 bytes");
+	static_assert(sizeof(MeshletData) % 16 == 0 && sizeof(MeshletJob) % 16 == 0, "std430 array elements must be multiples of 16 bytes");
+	static_assert(sizeof(LightData) % 16 == 0 && sizeof(VisibleDraw) % 16 == 0, "std430 array elements must be multiples of 16 bytes");
+}
+
+#endif // !UNIFORM_BLOCKS_H
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include "vertex_layout.h"
+#include "engine/scene/mesh_optimizer.h"
+
+namespace
+{
+	template <class T>
+	void store(uint8_t* destination, const T& value)
+	{
+		std::memcpy(destination, &value, sizeof(T));
+	}
+
+	/*
+	* IEEE half float of the value, rounded to the nearest even like the GL conversions. Values
+	* out of range become infinity, tiny ones denormals or zero. Local instead of glm's
+	* packHalf, whose header trips -Wvolatile in C++20.
+	*/
+	uint16_t half_float(float value)
+	{
+		uint32_t bits = std::bit_cast<uint32_t>(value);
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+		if (exponent == 128 + 15) return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // infinity, NaN
+		if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00);
+		if (exponent < -10) return static_cast<uint16_t>(sign);
+
+		int shift = 13;
+		uint32_t half = (static_cast<uint32_t>(std::max(exponent, 0)) << 10);
+		if (exponent <= 0) // denormal, the implicit leading bit becomes part of the mantissa
+		{
+			mantissa |= 0x800000;
+			shift = 14 - exponent;
+		}
+		half += mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) half++; // may carry into the exponent, up to infinity
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	int16_t snorm16(float value)
+	{
+		return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint16_t unorm16(float value)
+	{
+		return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	// the packed attributes, positions are padded to 4 components for the alignment
+	std::array<uint16_t, 4> pack_half(const glm::vec3& v) { return { half_float(v.x), half_float(v.y), half_float(v.z), 0 }; }
+	std::array<int16_t, 4> pack_snorm(const glm::vec3& v) { return { snorm16(v.x), snorm16(v.y), snorm16(v.z), 0 }; }
+	std::array<int16_t, 2> pack_snorm(const glm::vec2& v) { return { snorm16(v.x), snorm16(v.y) }; }
+	std::array<uint16_t, 2> pack_unorm(const glm::vec2& v) { return { unorm16(v.x), unorm16(v.y) }; }
+
+	/*
+	* Folds the unit vector onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half
+	* (z < 0) onto the corners of the square [-1, 1]², see decode_normal() in
+	* shaders/common/vertex_attributes.glsl.
+	*/
+	glm::vec2 octahedral(glm::vec3 n)
+	{
+		float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (sum == 0.0f) return glm::vec2(0.0f);
+		n /= sum;
+		if (n.z >= 0.0f) return glm::vec2(n);
+		glm::vec2 sign(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		return (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+	}
+
+	/*
+	* Half of the size of the range, 1 for empty ranges so that dequantizing doesn't need
+	* a special case.
+	*/
+	glm::vec3 half_extent(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 extent = (max - min) * 0.5f;
+		return glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+	}
+}
+
+/*
+* The smallest layout: interleaved, snorm16 positions, octahedral normals, unorm16 texture
+* coordinates and 16-bit indexes where they fit.
+*/
+ruya::VertexLayout ruya::VertexLayout::quantized()
+{
+	VertexLayout layout;
+	layout.position = PositionFormat::SNORM16;
+	layout.normal = NormalFormat::OCTAHEDRAL;
+	layout.texCoord = TexCoordFormat::UNORM16;
+	layout.interleaved = true;
+	layout.shortIndexes = true;
+	return layout;
+}
+
+/*
+* Bytes between two vertices in the buffer of the stream.
+*/
+GLuint ruya::VertexLayout::stride(GLuint stream) const
+{
+	return interleaved ? vertex_size() : attribute_size(stream);
+}
+
+GLuint ruya::VertexLayout::attribute_size(GLuint attrib) const
+{
+	switch (attrib)
+	{
+		case POSITION_ATTRIB:	return position == PositionFormat::FLOAT ? 12 : 8;
+		case NORMAL_ATTRIB:		return normal == NormalFormat::FLOAT ? 12 : 4;
+		default:				return texCoord == TexCoordFormat::FLOAT ? 8 : 4;
+	}
+}
+
+/*
+* Offset of the attribute in a vertex of its stream, the attributes of an interleaved
+* vertex are stored in the order of their index.
+*/
+GLuint ruya::VertexLayout::attribute_offset(GLuint attrib) const
+{
+	GLuint offset = 0;
+	for (GLuint previous = 0; interleaved && previous < attrib; previous++)
+		offset += attribute_size(previous);
+	return offset;
+}
+
+/*
+* Index type of a mesh with the given number of vertices.
+*/
+GLenum ruya::VertexLayout::index_type(GLuint vertexCount) const
+{
+	return shortIndexes && vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+/*
+* Sets the format and buffer binding of each attribute of the vertex array, the binding of
+* an attribute is its stream. Only the first attribCount attributes are enabled, 1 for a
+* position-only vertex array (depth pre-pass).
+*/
+void ruya::VertexLayout::set_formats(GLuint vao, GLuint attribCount) const
+{
+	struct Format { GLint size; GLenum type; GLboolean normalized; };
+	Format formats[ATTRIB_COUNT];
+	switch (position)
+	{
+		case PositionFormat::FLOAT:			formats[POSITION_ATTRIB] = { 3, GL_FLOAT, GL_FALSE };		break;
+		case PositionFormat::HALF_FLOAT:	formats[POSITION_ATTRIB] = { 3, GL_HALF_FLOAT, GL_FALSE };	break;
+		case PositionFormat::SNORM16:		formats[POSITION_ATTRIB] = { 3, GL_SHORT, GL_TRUE };		break;
+	}
+	formats[NORMAL_ATTRIB] = normal == NormalFormat::FLOAT ? Format{ 3, GL_FLOAT, GL_FALSE } : Format{ 2, GL_SHORT, GL_TRUE };
+	formats[TEXTURE_ATTRIB] = texCoord == TexCoordFormat::FLOAT ? Format{ 2, GL_FLOAT, GL_FALSE } : Format{ 2, GL_UNSIGNED_SHORT, GL_TRUE };
+
+	for (GLuint attrib = 0; attrib < attribCount; attrib++)
+	{
+		glVertexArrayAttribFormat(vao, attrib, formats[attrib].size, formats[attrib].type, formats[attrib].normalized, attribute_offset(attrib));
+		glVertexArrayAttribBinding(vao, attrib, stream(attrib));
+		glEnableVertexArrayAttrib(vao, attrib);
+	}
+}
+
+/*
+* Converts the vertices and faces of the mesh to this layout. Positions are quantized over
+* the bounding box of the vertices, texture coordinates over their range. Vertices without
+* a normal or texture coordinates (e.g. meshes without texture coordinates) get zeros.
+* Meshes that haven't been optimized (e.g. imported ones) are optimized first, on a copy:
+* the mesh may be in use on another thread. Safe to call from any thread, no GL calls.
+*/
+ruya::VertexLayout::EncodedMesh ruya::VertexLayout::encode(const Mesh& source) const
+{
+	Mesh optimized;
+	if (!source.optimized)
+	{
+		optimized = source;
+		MeshOptimizer::optimize(optimized);
+	}
+	const Mesh& mesh = source.optimized ? source : optimized;
+
+	EncodedMesh encoded;
+	encoded.vertexCount = static_cast<GLuint>(mesh.vertices.size());
+	encoded.indexCount = static_cast<GLuint>(mesh.faces.size() * 3);
+	encoded.indexType = index_type(encoded.vertexCount);
+	for (GLuint s = 0; s < stream_count(); s++)
+		encoded.streams[s].assign(static_cast<size_t>(stride(s)) * encoded.vertexCount, 0);
+
+	Dequantization& dequantization = encoded.dequantization;
+	if (position != PositionFormat::FLOAT && !mesh.vertices.empty())
+	{
+		glm::vec3 min = mesh.vertices.front(), max = mesh.vertices.front();
+		for (const glm::vec3& v : mesh.vertices)
+		{
+			min = glm::min(min, v);
+			max = glm::max(max, v);
+		}
+		dequantization.positionScale = glm::vec4(half_extent(min, max), 1.0f);
+		dequantization.positionOffset = glm::vec4((min + max) * 0.5f, 0.0f);
+	}
+	size_t texCoordCount = std::min(mesh.textureCoordinates.size(), mesh.vertices.size());
+	if (texCoord != TexCoordFormat::FLOAT && texCoordCount > 0)
+	{
+		glm::vec2 min = mesh.textureCoordinates.front(), max = mesh.textureCoordinates.front();
+		for (size_t v = 0; v < texCoordCount; v++)
+		{
+			min = glm::min(min, mesh.textureCoordinates[v]);
+			max = glm::max(max, mesh.textureCoordinates[v]);
+		}
+		glm::vec2 range(max.x > min.x ? max.x - min.x : 1.0f, max.y > min.y ? max.y - min.y : 1.0f);
+		dequantization.texCoordTransform = glm::vec4(range, min);
+	}
+
+	glm::vec3 positionScale(dequantization.positionScale), positionOffset(dequantization.positionOffset);
+	glm::vec2 texCoordScale(dequantization.texCoordTransform), texCoordOffset(dequantization.texCoordTransform.z, dequantization.texCoordTransform.w);
+	for (GLuint v = 0; v < encoded.vertexCount; v++)
+	{
+		uint8_t* attributes[ATTRIB_COUNT];
+		for (GLuint attrib = 0; attrib < ATTRIB_COUNT; attrib++)
+			attributes[attrib] = encoded.streams[stream(attrib)].data() + static_cast<size_t>(v) * stride(stream(attrib)) + attribute_offset(attrib);
+
+		glm::vec3 quantized = (mesh.vertices[v] - positionOffset) / positionScale;
+		switch (position)
+		{
+			case PositionFormat::FLOAT:			store(attributes[POSITION_ATTRIB], mesh.vertices[v]);							break;
+			case PositionFormat::HALF_FLOAT:	store(attributes[POSITION_ATTRIB], pack_half(quantized));	break;
+			case PositionFormat::SNORM16:		store(attributes[POSITION_ATTRIB], pack_snorm(quantized));	break;
+		}
+
+		glm::vec3 n = v < mesh.normals.size() ? mesh.normals[v] : glm::vec3(0.0f);
+		if (normal == NormalFormat::FLOAT) store(attributes[NORMAL_ATTRIB], n);
+		else store(attributes[NORMAL_ATTRIB], pack_snorm(octahedral(n)));
+
+		glm::vec2 uv = v < texCoordCount ? mesh.textureCoordinates[v] : glm::vec2(0.0f);
+		if (texCoord == TexCoordFormat::FLOAT) store(attributes[TEXTURE_ATTRIB], uv);
+		else store(attributes[TEXTURE_ATTRIB], pack_unorm((uv - texCoordOffset) / texCoordScale));
+	}
+
+	encoded.indexes.resize(static_cast<size_t>(encoded.indexCount) * index_size(encoded.indexType));
+	if (encoded.indexType == GL_UNSIGNED_INT)
+	{
+		if (encoded.indexCount > 0) std::memcpy(encoded.indexes.data(), mesh.faces.data(), encoded.indexes.size());
+	}
+	else
+	{
+		const GLuint* indexes = reinterpret_cast<const GLuint*>(mesh.faces.data());
+		for (GLuint i = 0; i < encoded.indexCount; i++)
+			store(encoded.indexes.data() + 2 * static_cast<size_t>(i), static_cast<uint16_t>(indexes[i]));
+	}
+
+	for (const Meshlet& meshlet : mesh.meshlets)
+	{
+		MeshletData data{};
+		data.sphere = glm::vec4(meshlet.center, meshlet.radius);
+		data.coneApex = glm::vec4(meshlet.coneApex, 1.0f);
+		data.coneAxis = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+		data.firstIndex = meshlet.firstFace * 3;
+		data.indexCount = meshlet.faceCount * 3;
+		encoded.meshlets.push_back(data);
+	}
+	return encoded;
+}
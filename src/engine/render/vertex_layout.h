@@ -0,0 +1,99 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "engine/scene/mesh.h"
+#include "engine/render/uniform_blocks.h"
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* How the vertices and indexes of meshes are stored in the GeometryBuffer. Vertex fetch
+	* is bandwidth bound for dense meshes, the smaller the vertex the more of them fit in a
+	* cache line.
+	*	- positions: FLOAT (12 bytes), or HALF_FLOAT / SNORM16 (8 bytes, the 4th component
+	*	  is padding) quantized over the mesh's bounding box: the stored value is in [-1, 1]
+	*	  and the shaders map it back with a per-mesh scale and offset (see Dequantization)
+	*	- normals: FLOAT (12 bytes) or OCTAHEDRAL, the unit vector folded onto an octahedron
+	*	  and stored as two snorm16 (4 bytes), decoded in the vertex shader
+	*	- texture coordinates: FLOAT (8 bytes) or UNORM16 (4 bytes) over the range of the
+	*	  mesh's coordinates, mapped back like the positions
+	*	- interleaved: all attributes of a vertex next to each other in one buffer (one
+	*	  fetch stream), otherwise one buffer per attribute
+	*	- shortIndexes: 16-bit indexes for meshes with at most 65536 vertices, the other
+	*	  meshes keep 32-bit indexes
+	*
+	* The default layout is the planar float layout the engine has always used, quantized()
+	* is 16 bytes per vertex instead of 32. The shaders decode the attributes with
+	* shaders/common/vertex_attributes.glsl.
+	*/
+	struct VertexLayout
+	{
+		static constexpr GLuint POSITION_ATTRIB = 0; // the attribute indexes the shaders declare with layout(location = ..)
+		static constexpr GLuint NORMAL_ATTRIB = 1;
+		static constexpr GLuint TEXTURE_ATTRIB = 2;
+		static constexpr GLuint ATTRIB_COUNT = 3;
+
+		enum class PositionFormat { FLOAT, HALF_FLOAT, SNORM16 };
+		enum class NormalFormat { FLOAT, OCTAHEDRAL };
+		enum class TexCoordFormat { FLOAT, UNORM16 };
+
+		/*
+		* Maps the stored attributes of a mesh back to its local space: value * scale + offset.
+		* Identity for float attributes.
+		*/
+		struct Dequantization
+		{
+			glm::vec4 positionScale = glm::vec4(1.0f); // w unused
+			glm::vec4 positionOffset = glm::vec4(0.0f);
+			glm::vec4 texCoordTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); // xy = scale, zw = offset
+
+			bool operator==(const Dequantization& other) const = default;
+		};
+
+		/*
+		* A mesh in this layout, ready to be copied into the buffers: the vertex data of each
+		* stream (only the first stream_count() are used), the indexes and the meshlets.
+		*/
+		struct EncodedMesh
+		{
+			vector<uint8_t> streams[ATTRIB_COUNT];
+			vector<uint8_t> indexes;
+			vector<MeshletData> meshlets;
+			GLuint vertexCount = 0;
+			GLuint indexCount = 0;
+			GLenum indexType = GL_UNSIGNED_INT;
+			Dequantization dequantization;
+		};
+
+		PositionFormat position = PositionFormat::FLOAT;
+		NormalFormat normal = NormalFormat::FLOAT;
+		TexCoordFormat texCoord = TexCoordFormat::FLOAT;
+		bool interleaved = false;
+		bool shortIndexes = false;
+
+		static VertexLayout quantized();
+
+		bool operator==(const VertexLayout& other) const = default;
+
+		GLuint stream_count() const { return interleaved ? 1 : ATTRIB_COUNT; }
+		GLuint stream(GLuint attrib) const { return interleaved ? 0 : attrib; } // buffer binding of the attribute
+		GLuint stride(GLuint stream) const;
+		GLuint vertex_size() const { return attribute_size(POSITION_ATTRIB) + attribute_size(NORMAL_ATTRIB) + attribute_size(TEXTURE_ATTRIB); }
+		GLuint attribute_size(GLuint attrib) const;
+		GLuint attribute_offset(GLuint attrib) const;
+		GLenum index_type(GLuint vertexCount) const;
+		static GLuint index_size(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? 2 : 4; }
+
+		void set_formats(GLuint vao, GLuint attribCount = ATTRIB_COUNT) const;
+		EncodedMesh encode(const Mesh& mesh) const;
+	};
+}
+
+#endif // !VERTEX_LAYOUT_H
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "visibility_buffer.h"
+#include "gl_state.h"
+#include "gpu_resources.h"
+#include "engine/scene/texture.h"
+
+ruya::VisibilityBuffer::VisibilityBuffer(const std::string& shaderDir)
+	: mVisibilityShader((shaderDir + "/visibility/visibility.vert").c_str(), (shaderDir + "/visibility/visibility.frag").c_str()),
+	  mResolveShader((shaderDir + "/deferred/fullscreen.vert").c_str(), (shaderDir + "/visibility/resolve.frag").c_str()),
+	  mTrianglesUniform(mResolveShader.uniform<int>("visibilityTriangles")),
+	  mDepthUniform(mResolveShader.uniform<int>("visibilityDepth")),
+	  mDrawCountUniform(mResolveShader.uniform<int>("drawCount")),
+	  mAttributeFormatsUniform(mResolveShader.uniform<glm::ivec3>("attributeFormats")),
+	  mAttributeStreamsUniform(mResolveShader.uniform<glm::ivec3>("attributeStreams")),
+	  mAttributeStridesUniform(mResolveShader.uniform<glm::ivec3>("attributeStrides")),
+	  mAttributeOffsetsUniform(mResolveShader.uniform<glm::ivec3>("attributeOffsets")),
+	  mFlatNormalsUniform(mResolveShader.uniform<int>("flatNormals")),
+	  mTextureArraysUniform(mResolveShader.uniform<int>("materialTextureArrays[0]")),
+	  mEmptyVaoID(0), mFramebufferID(0), mTriangleTexture(0), mDepthTexture(0), mWidth(0), mHeight(0)
+{
+	glCreateVertexArrays(1, &mEmptyVaoID);
+	GpuResources::track(GpuResources::Type::VERTEX_ARRAY, mEmptyVaoID, 0);
+}
+
+ruya::VisibilityBuffer::~VisibilityBuffer()
+{
+	delete_targets();
+	GpuResources::release(GpuResources::Type::VERTEX_ARRAY, mEmptyVaoID);
+}
+
+/*
+* Binds and clears the visibility buffer (id 0, the background), the objects are then drawn
+* with visibility_shader() and the positions only VAO. The render targets are recreated
+* when the size changed.
+*/
+void ruya::VisibilityBuffer::begin(GLsizei width, GLsizei height)
+{
+	if (width != mWidth || height != mHeight)
+		create_targets(width, height);
+
+	GLState::bind_framebuffer(mFramebufferID);
+	GLState::depth_mask(true); // clears respect the write masks
+	GLState::color_mask(true);
+	const GLuint background[4] = { 0, 0, 0, 0 };
+	const GLfloat farDepth = 1.0f;
+	RUYA_GL(glClearNamedFramebufferuiv(mFramebufferID, GL_COLOR, 0, background));
+	RUYA_GL(glClearNamedFramebufferfv(mFramebufferID, GL_DEPTH, 0, &farDepth));
+}
+
+/*
+* Shades the visibility buffer into the default framebuffer, with the depth of the
+* visibility buffer so that what is drawn afterwards is still depth tested against the
+* scene. textureArrays: the arrays of the material textures, nullptr with bindless textures.
+* drawCount: number of VisibleDraws.
+* @pre the frame constants, the lights, the instance and draw data, the draw commands and
+*	   the visible draws of the frame must be bound
+*/
+void ruya::VisibilityBuffer::resolve(const GeometryBuffer& geometry, TextureArrays* textureArrays, GLuint drawCount, bool flatNormals)
+{
+	GLState::bind_framebuffer(0);
+	if (drawCount == 0) return; // nothing was drawn, every pixel is background
+
+	// the visibility buffer is sampled on the units after the ones the texture slot manager uses
+	GLuint unit = Texture::get_num_texture_slots_fragment_shader();
+	GLState::bind_texture_unit(unit + 0, GL_TEXTURE_2D, mTriangleTexture);
+	GLState::bind_texture_unit(unit + 1, GL_TEXTURE_2D, mDepthTexture);
+	GLuint arrayCount = textureArrays ? std::min(static_cast<GLuint>(textureArrays->array_count()), MAX_TEXTURE_ARRAYS) : 0;
+	for (GLuint array = 0; array < arrayCount; array++)
+		textureArrays->bind(array, unit + 2 + array);
+	geometry.bind_storage();
+
+	const VertexLayout& layout = geometry.layout();
+	glm::ivec3 formats(static_cast<int>(layout.position), static_cast<int>(layout.normal), static_cast<int>(layout.texCoord));
+	glm::ivec3 streams, strides, offsets;
+	for (GLuint attrib = 0; attrib < VertexLayout::ATTRIB_COUNT; attrib++)
+	{
+		streams[attrib] = layout.stream(attrib);
+		strides[attrib] = layout.stride(layout.stream(attrib)) / 4;
+		offsets[attrib] = layout.attribute_offset(attrib) / 4;
+	}
+
+	mResolveShader.use();
+	mResolveShader.set(mTrianglesUniform, (int)unit + 0);
+	mResolveShader.set(mDepthUniform, (int)unit + 1);
+	mResolveShader.set(mDrawCountUniform, (int)drawCount);
+	mResolveShader.set(mAttributeFormatsUniform, formats);
+	mResolveShader.set(mAttributeStreamsUniform, streams);
+	mResolveShader.set(mAttributeStridesUniform, strides);
+	mResolveShader.set(mAttributeOffsetsUniform, offsets);
+	mResolveShader.set(mFlatNormalsUniform, flatNormals ? 1 : 0);
+	for (GLuint array = 0; array < MAX_TEXTURE_ARRAYS; array++)
+	{
+		// the elements of a sampler array have consecutive locations, unused ones get the first unit
+		UniformHandle<int> element{ mTextureArraysUniform.valid() ? mTextureArraysUniform.location + static_cast<GLint>(array) : -1 };
+		mResolveShader.set(element, (int)unit + 2 + (array < arrayCount ? array : 0));
+	}
+	GLState::bind_vertex_array(mEmptyVaoID);
+	RUYA_GL(glDrawArrays(GL_TRIANGLES, 0, 3));
+}
+
+void ruya::VisibilityBuffer::create_targets(GLsizei width, GLsizei height)
+{
+	delete_targets();
+	mWidth = width;
+	mHeight = height;
+
+	auto create_texture = [this](GLuint& texture, GLenum format)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, format, mWidth, mHeight);
+		GpuResources::track(GpuResources::Type::TEXTURE, texture, GpuResources::texture_bytes(mWidth, mHeight, 1, 4, false));
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	};
+	create_texture(mTriangleTexture, GL_R32UI);
+	create_texture(mDepthTexture, GL_DEPTH_COMPONENT32F);
+
+	glCreateFramebuffers(1, &mFramebufferID);
+	glNamedFramebufferTexture(mFramebufferID, GL_COLOR_ATTACHMENT0, mTriangleTexture, 0);
+	glNamedFramebufferTexture(mFramebufferID, GL_DEPTH_ATTACHMENT, mDepthTexture, 0);
+	GpuResources::track(GpuResources::Type::FRAMEBUFFER, mFramebufferID, 0);
+	if (glCheckNamedFramebufferStatus(mFramebufferID, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("[VisibilityBuffer] visibility framebuffer is incomplete");
+}
+
+void ruya::VisibilityBuffer::delete_targets()
+{
+	GpuResources::release(GpuResources::Type::FRAMEBUFFER, mFramebufferID);
+	GpuResources::release(GpuResources::Type::TEXTURE, mTriangleTexture);
+	GpuResources::release(GpuResources::Type::TEXTURE, mDepthTexture);
+	mFramebufferID = mTriangleTexture = mDepthTexture = 0;
+	mWidth = mHeight = 0;
+}
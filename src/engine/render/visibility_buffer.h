@@ -0,0 +1,83 @@
+#ifndef VISIBILITY_BUFFER_H
+#define VISIBILITY_BUFFER_H
+
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "engine/render/shader.h"
+#include "engine/render/geometry_buffer.h"
+#include "engine/render/texture_arrays.h"
+
+namespace ruya
+{
+	/*
+	* Visibility buffer rendering, for scenes of many small triangles: the objects are
+	* rasterized with only their positions into a buffer of 32-bit triangle ids, a full screen
+	* pass then shades every covered pixel exactly once.
+	*	- the id of a pixel numbers the triangles of all instances of all draw commands of the
+	*	  frame consecutively (see VisibleDraw), the resolve finds the draw with a binary search
+	*	  over their first ids, then the instance and the triangle
+	*	- the resolve fetches the three vertices of the triangle itself (in any VertexLayout,
+	*	  see GeometryBuffer::bind_storage()), computes the perspective correct barycentric
+	*	  coordinates of the pixel and their screen space derivatives and interpolates the
+	*	  attributes, texture lookups use the derivatives (no 2x2 quads of the triangle)
+	*	- small triangles cost the rasterization of an id instead of partly filled quads of the
+	*	  object shader, and the cost of the material doesn't depend on the triangle density
+	*	- ShadingMode::FLAT lights each triangle at its center with the average of its vertex
+	*	  normals, like the flat shader
+	*
+	* The Renderer draws the objects with visibility_shader() between begin() and resolve(),
+	* on the CPU path (the draws of GpuCulling and MeshletCulling are generated on the GPU).
+	* Without bindless textures the resolve samples the first MAX_TEXTURE_ARRAYS texture
+	* arrays, each on its own unit. The textures follow the size of the window.
+	*
+	* Shaders: shaders/visibility/visibility.vert and visibility.frag, resolve.frag (after
+	* deferred/fullscreen.vert)
+	*/
+	class VisibilityBuffer
+	{
+	public:
+		static constexpr GLuint MAX_TEXTURE_ARRAYS = 4; // same as in resolve.frag
+
+		VisibilityBuffer(const std::string& shaderDir); // the shaders folder
+		~VisibilityBuffer();
+		VisibilityBuffer(const VisibilityBuffer&) = delete;
+		VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+		Shader& visibility_shader() { return mVisibilityShader; }
+		void begin(GLsizei width, GLsizei height);
+		void resolve(const GeometryBuffer& geometry, TextureArrays* textureArrays, GLuint drawCount, bool flatNormals);
+
+		GLsizei width() const { return mWidth; }
+		GLsizei height() const { return mHeight; }
+
+	private:
+		void create_targets(GLsizei width, GLsizei height);
+		void delete_targets();
+
+		// visibility pass
+		Shader mVisibilityShader;
+
+		// resolve pass
+		Shader mResolveShader;
+		UniformHandle<int> mTrianglesUniform;
+		UniformHandle<int> mDepthUniform;
+		UniformHandle<int> mDrawCountUniform;
+		UniformHandle<glm::ivec3> mAttributeFormatsUniform;
+		UniformHandle<glm::ivec3> mAttributeStreamsUniform;
+		UniformHandle<glm::ivec3> mAttributeStridesUniform;
+		UniformHandle<glm::ivec3> mAttributeOffsetsUniform;
+		UniformHandle<int> mFlatNormalsUniform;
+		UniformHandle<int> mTextureArraysUniform; // first element of the sampler array
+		GLuint mEmptyVaoID; // the full screen triangle has no vertex data
+
+		// render targets, recreated when the size changes
+		GLuint mFramebufferID;
+		GLuint mTriangleTexture;
+		GLuint mDepthTexture;
+		GLsizei mWidth, mHeight;
+	};
+}
+
+#endif // !VISIBILITY_BUFFER_H
@@ -0,0 +1,77 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <algorithm>
+#include <limits>
+#include <glm/glm.hpp>
+
+#include "engine/scene/mesh.h"
+
+namespace ruya
+{
+	/*
+	* Axis aligned bounding box. A default constructed box is empty (min > max), growing
+	* it by a point or a box makes it that point or box.
+	*/
+	struct Aabb
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		Aabb() = default;
+		Aabb(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+		bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+		glm::vec3 center() const { return (min + max) * 0.5f; }
+		glm::vec3 extent() const { return max - min; }
+		float surface_area() const
+		{
+			if (empty()) return 0.0f;
+			glm::vec3 e = extent();
+			return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+
+		void grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+		void grow(const Aabb& box) { min = glm::min(min, box.min); max = glm::max(max, box.max); }
+		static Aabb merge(const Aabb& a, const Aabb& b) { return Aabb(glm::min(a.min, b.min), glm::max(a.max, b.max)); }
+
+		bool contains(const Aabb& box) const { return glm::all(glm::lessThanEqual(min, box.min)) && glm::all(glm::lessThanEqual(box.max, max)); }
+		bool intersects(const Aabb& box) const { return glm::all(glm::lessThanEqual(min, box.max)) && glm::all(glm::lessThanEqual(box.min, max)); }
+		bool intersects_sphere(const glm::vec3& center, float radius) const
+		{
+			glm::vec3 offset = glm::clamp(center, min, max) - center;
+			return glm::dot(offset, offset) <= radius * radius;
+		}
+
+		/*
+		* Slab test of the ray origin + t * direction against the box.
+		* @param inverseDirection: 1 / direction per component (inf for 0 components)
+		* @returns the distance t at which the ray enters the box (0 if it starts inside), or
+		*		   a negative value if it misses the box within [0, maxT]
+		*/
+		float intersect_ray(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxT) const
+		{
+			glm::vec3 t0 = (min - origin) * inverseDirection;
+			glm::vec3 t1 = (max - origin) * inverseDirection;
+			glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+			float enter = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+			float exit = std::min({ tFar.x, tFar.y, tFar.z, maxT });
+			return enter <= exit ? enter : -1.0f;
+		}
+
+		/*
+		* The world space box around the local bounds of a mesh transformed by the model matrix:
+		* the half extent on world axis i is the sum of the local half extents weighted by
+		* |model[j][i]| (Arvo).
+		*/
+		static Aabb transformed(const MeshBounds& bounds, const glm::mat4& model)
+		{
+			glm::vec3 center = glm::vec3(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+			glm::mat3 absModel(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+			glm::vec3 halfExtent = absModel * ((bounds.max - bounds.min) * 0.5f);
+			return Aabb(center - halfExtent, center + halfExtent);
+		}
+	};
+}
+
+#endif // !AABB_H
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <numeric>
+#include "bvh.h"
+
+namespace
+{
+	constexpr int BIN_COUNT = 16; // SAH split candidates per axis
+	constexpr float TRAVERSAL_COST = 1.0f; // relative to the cost of testing an item
+}
+
+/*
+* Builds the tree over the items, item i has bounds itemBounds[i].
+*/
+void ruya::Bvh::build(const vector<Aabb>& itemBounds)
+{
+	clear();
+	if (itemBounds.empty()) return;
+
+	mItemBounds = itemBounds;
+	mItems.resize(mItemBounds.size());
+	std::iota(mItems.begin(), mItems.end(), 0);
+
+	vector<glm::vec3> centroids(mItemBounds.size());
+	for (size_t i = 0; i < mItemBounds.size(); i++)
+		centroids[i] = mItemBounds[i].empty() ? glm::vec3(0.0f) : mItemBounds[i].center();
+
+	mNodes.reserve(2 * mItemBounds.size());
+	Node& root = mNodes.emplace_back();
+	root.first = 0;
+	root.count = static_cast<uint32_t>(mItems.size());
+	update_node_bounds(0);
+	subdivide(0, centroids, 0);
+
+	mLeafOfItem.resize(mItemBounds.size());
+	mLeafDirty.assign(mNodes.size(), 0);
+	mCostSum = 0.0;
+	for (uint32_t n = 0; n < mNodes.size(); n++)
+	{
+		mCostSum += node_cost(mNodes[n]);
+		if (mNodes[n].leaf())
+		{
+			for (uint32_t i = mNodes[n].first; i < mNodes[n].first + mNodes[n].count; i++)
+				mLeafOfItem[mItems[i]] = n;
+		}
+	}
+	mBuildCost = sah_cost();
+}
+
+/*
+* Splits a node on the binned SAH split with the lowest cost, or keeps it as a leaf when no
+* split is cheaper than testing all its items (and it holds at most MAX_LEAF_SIZE items).
+*/
+void ruya::Bvh::subdivide(uint32_t nodeIndex, const vector<glm::vec3>& centroids, int depth)
+{
+	const uint32_t first = mNodes[nodeIndex].first;
+	const uint32_t count = mNodes[nodeIndex].count;
+	if (count <= 1 || depth >= MAX_DEPTH) return;
+
+	Aabb centroidBounds;
+	for (uint32_t i = first; i < first + count; i++)
+		centroidBounds.grow(centroids[mItems[i]]);
+	glm::vec3 extent = centroidBounds.extent();
+
+	// evaluate BIN_COUNT - 1 split planes per axis
+	int bestAxis = -1, bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] <= 0.0f) continue;
+
+		struct Bin { Aabb bounds; uint32_t count = 0; };
+		Bin bins[BIN_COUNT];
+		float scale = BIN_COUNT / extent[axis];
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			uint32_t item = mItems[i];
+			int bin = std::min(BIN_COUNT - 1, static_cast<int>((centroids[item][axis] - centroidBounds.min[axis]) * scale));
+			bins[bin].bounds.grow(mItemBounds[item]);
+			bins[bin].count++;
+		}
+
+		// sweep from the right to get the area and count of everything right of each plane
+		float rightArea[BIN_COUNT - 1];
+		uint32_t rightCount[BIN_COUNT - 1];
+		Aabb right;
+		uint32_t rightSum = 0;
+		for (int b = BIN_COUNT - 1; b > 0; b--)
+		{
+			right.grow(bins[b].bounds);
+			rightSum += bins[b].count;
+			rightArea[b - 1] = right.surface_area();
+			rightCount[b - 1] = rightSum;
+		}
+
+		Aabb left;
+		uint32_t leftSum = 0;
+		for (int b = 0; b < BIN_COUNT - 1; b++)
+		{
+			left.grow(bins[b].bounds);
+			leftSum += bins[b].count;
+			if (leftSum == 0 || rightCount[b] == 0) continue;
+
+			float cost = left.surface_area() * leftSum + rightArea[b] * rightCount[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b + 1; // bins [0, bestSplit) go left
+			}
+		}
+	}
+
+	float area = mNodes[nodeIndex].bounds.surface_area();
+	float leafCost = static_cast<float>(count);
+	float splitCost = bestAxis >= 0 && area > 0.0f ? TRAVERSAL_COST + bestCost / area : std::numeric_limits<float>::max();
+	if (splitCost >= leafCost && count <= MAX_LEAF_SIZE) return;
+
+	// partition the items, fall back to a split in the middle if all centroids coincide
+	uint32_t middle;
+	if (bestAxis >= 0)
+	{
+		float scale = BIN_COUNT / extent[bestAxis];
+		float minimum = centroidBounds.min[bestAxis];
+		auto begin = mItems.begin() + first;
+		auto it = std::partition(begin, begin + count, [&](uint32_t item) {
+			return std::min(BIN_COUNT - 1, static_cast<int>((centroids[item][bestAxis] - minimum) * scale)) < bestSplit;
+		});
+		middle = static_cast<uint32_t>(it - mItems.begin());
+	}
+	else
+	{
+		middle = first + count / 2;
+	}
+
+	uint32_t leftIndex = static_cast<uint32_t>(mNodes.size());
+	mNodes.emplace_back();
+	mNodes.emplace_back();
+	mNodes[leftIndex].first = first;
+	mNodes[leftIndex].count = middle - first;
+	mNodes[leftIndex].parent = nodeIndex;
+	mNodes[leftIndex + 1].first = middle;
+	mNodes[leftIndex + 1].count = first + count - middle;
+	mNodes[leftIndex + 1].parent = nodeIndex;
+	mNodes[nodeIndex].first = leftIndex;
+	mNodes[nodeIndex].count = 0;
+
+	update_node_bounds(leftIndex);
+	update_node_bounds(leftIndex + 1);
+	subdivide(leftIndex, centroids, depth + 1);
+	subdivide(leftIndex + 1, centroids, depth + 1);
+}
+
+/*
+* Changes the bounds of an item, the tree is updated by the next refit().
+*/
+void ruya::Bvh::update(uint32_t item, const Aabb& bounds)
+{
+	mItemBounds[item] = bounds;
+	uint32_t leaf = mLeafOfItem[item];
+	if (!mLeafDirty[leaf])
+	{
+		mLeafDirty[leaf] = 1;
+		mDirtyLeaves.push_back(leaf);
+	}
+}
+
+/*
+* Recomputes the bounds of the leaves with updated items and of their ancestors, a walk up
+* stops at the first node whose bounds didn't change.
+*/
+void ruya::Bvh::refit()
+{
+	for (uint32_t leaf : mDirtyLeaves)
+	{
+		mLeafDirty[leaf] = 0;
+		uint32_t n = leaf;
+		while (true)
+		{
+			Aabb old = mNodes[n].bounds;
+			mCostSum -= node_cost(mNodes[n]);
+			update_node_bounds(n);
+			mCostSum += node_cost(mNodes[n]);
+			if (n == 0 || (old.min == mNodes[n].bounds.min && old.max == mNodes[n].bounds.max)) break;
+			n = mNodes[n].parent;
+		}
+	}
+	mDirtyLeaves.clear();
+}
+
+void ruya::Bvh::clear()
+{
+	mNodes.clear();
+	mItems.clear();
+	mLeafOfItem.clear();
+	mItemBounds.clear();
+	mDirtyLeaves.clear();
+	mLeafDirty.clear();
+	mCostSum = 0.0;
+	mBuildCost = 0.0f;
+}
+
+/*
+* Expected cost of a query that hits the root, relative to testing one item: the cost of
+* each node weighted by the probability (area ratio) that a query hitting the root hits it.
+*/
+float ruya::Bvh::sah_cost() const
+{
+	if (mNodes.empty()) return 0.0f;
+	float rootArea = mNodes.front().bounds.surface_area();
+	return rootArea > 0.0f ? static_cast<float>(mCostSum / rootArea) : 0.0f;
+}
+
+void ruya::Bvh::update_node_bounds(uint32_t nodeIndex)
+{
+	Node& node = mNodes[nodeIndex];
+	if (node.leaf())
+	{
+		node.bounds = Aabb();
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+			node.bounds.grow(mItemBounds[mItems[i]]);
+	}
+	else
+	{
+		node.bounds = Aabb::merge(mNodes[node.first].bounds, mNodes[node.first + 1].bounds);
+	}
+}
+
+float ruya::Bvh::node_cost(const Node& node) const
+{
+	return node.bounds.surface_area() * (node.leaf() ? static_cast<float>(node.count) : TRAVERSAL_COST);
+}
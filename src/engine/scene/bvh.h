@@ -0,0 +1,191 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "engine/scene/aabb.h"
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Bounding volume hierarchy over a set of items that each have a bounding box, the items
+	* are identified by their index in the bounds passed to build().
+	*	- built top-down with the surface area heuristic (SAH) on binned centroids
+	*	- items that move are updated with update() + refit(): only the leaves of the changed
+	*	  items and their ancestors are recomputed, the tree structure stays the same
+	*	- refitting makes the tree worse over time, sah_cost() / build_cost() tells how much,
+	*	  needs_rebuild() is true once it degraded more than the rebuild threshold
+	*
+	* Queries pass every candidate item to a callback: raycast() visits the nodes front to
+	* back and lets the callback shorten the ray, so that farther subtrees are skipped.
+	*/
+	class Bvh
+	{
+	public:
+		static constexpr uint32_t MAX_LEAF_SIZE = 4;
+		static constexpr int MAX_DEPTH = 60; // deeper nodes become leaves, keeps the traversal stacks bounded
+		static constexpr float REBUILD_THRESHOLD = 1.5f; // sah_cost() relative to the cost right after the build
+
+		void build(const vector<Aabb>& itemBounds);
+		void update(uint32_t item, const Aabb& bounds);
+		void refit();
+		void clear();
+
+		template <class Visitor> void query_aabb(const Aabb& box, Visitor&& visit) const;
+		template <class Visitor> void query_sphere(const glm::vec3& center, float radius, Visitor&& visit) const;
+		template <class HitItem> void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxT, HitItem&& hit_item) const;
+
+		bool empty() const { return mNodes.empty(); }
+		size_t item_count() const { return mItemBounds.size(); }
+		size_t node_count() const { return mNodes.size(); }
+		const Aabb& bounds() const { return mNodes.front().bounds; } // @pre !empty()
+		const Aabb& item_bounds(uint32_t item) const { return mItemBounds[item]; }
+		float sah_cost() const;
+		float build_cost() const { return mBuildCost; }
+		bool needs_rebuild() const { return !empty() && sah_cost() > REBUILD_THRESHOLD * mBuildCost; }
+
+	private:
+		/*
+		* Children of an inner node are stored next to each other: left = first, right = first + 1.
+		* A leaf holds the items mItems[first, first + count).
+		*/
+		struct Node
+		{
+			Aabb bounds;
+			uint32_t first = 0;
+			uint32_t count = 0; // 0 for inner nodes
+			uint32_t parent = 0;
+
+			bool leaf() const { return count > 0; }
+		};
+
+		void subdivide(uint32_t nodeIndex, const vector<glm::vec3>& centroids, int depth);
+		void update_node_bounds(uint32_t nodeIndex);
+		float node_cost(const Node& node) const;
+
+		vector<Node> mNodes; // root at 0
+		vector<uint32_t> mItems; // item indexes, grouped per leaf
+		vector<uint32_t> mLeafOfItem;
+		vector<Aabb> mItemBounds;
+		vector<uint32_t> mDirtyLeaves;
+		vector<uint8_t> mLeafDirty;
+		double mCostSum = 0.0; // sum of node_cost() over all nodes, kept up to date by refit()
+		float mBuildCost = 0.0f;
+	};
+
+	/*
+	* Calls visit(item) for every item whose box intersects the given box.
+	*/
+	template <class Visitor>
+	void Bvh::query_aabb(const Aabb& box, Visitor&& visit) const
+	{
+		if (mNodes.empty()) return;
+
+		uint32_t stack[MAX_DEPTH + 2];
+		int size = 0;
+		stack[size++] = 0;
+		while (size > 0)
+		{
+			const Node& node = mNodes[stack[--size]];
+			if (!node.bounds.intersects(box)) continue;
+
+			if (node.leaf())
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					if (mItemBounds[mItems[i]].intersects(box))
+						visit(mItems[i]);
+				}
+			}
+			else
+			{
+				stack[size++] = node.first;
+				stack[size++] = node.first + 1;
+			}
+		}
+	}
+
+	/*
+	* Calls visit(item) for every item whose box intersects the sphere.
+	*/
+	template <class Visitor>
+	void Bvh::query_sphere(const glm::vec3& center, float radius, Visitor&& visit) const
+	{
+		if (mNodes.empty()) return;
+
+		uint32_t stack[MAX_DEPTH + 2];
+		int size = 0;
+		stack[size++] = 0;
+		while (size > 0)
+		{
+			const Node& node = mNodes[stack[--size]];
+			if (!node.bounds.intersects_sphere(center, radius)) continue;
+
+			if (node.leaf())
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					if (mItemBounds[mItems[i]].intersects_sphere(center, radius))
+						visit(mItems[i]);
+				}
+			}
+			else
+			{
+				stack[size++] = node.first;
+				stack[size++] = node.first + 1;
+			}
+		}
+	}
+
+	/*
+	* Walks the items whose box is hit by the ray origin + t * direction, t in [0, maxT],
+	* nearest nodes first. hit_item(item, t) is called with the distance at which the ray
+	* enters the item's box and returns the distance of an actual hit with the item, or a
+	* negative value for a miss. Every hit shortens the ray.
+	*/
+	template <class HitItem>
+	void Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxT, HitItem&& hit_item) const
+	{
+		if (mNodes.empty()) return;
+
+		glm::vec3 inverseDirection = 1.0f / direction;
+		struct Entry { uint32_t node; float t; };
+		Entry stack[MAX_DEPTH + 2];
+		int size = 0;
+
+		float rootT = mNodes[0].bounds.intersect_ray(origin, inverseDirection, maxT);
+		if (rootT >= 0.0f) stack[size++] = Entry{ 0, rootT };
+		while (size > 0)
+		{
+			Entry entry = stack[--size];
+			if (entry.t > maxT) continue; // a hit closer than this node was found meanwhile
+			const Node& node = mNodes[entry.node];
+
+			if (node.leaf())
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					float t = mItemBounds[mItems[i]].intersect_ray(origin, inverseDirection, maxT);
+					if (t < 0.0f) continue;
+					float hitT = hit_item(mItems[i], t);
+					if (hitT >= 0.0f && hitT < maxT) maxT = hitT;
+				}
+				continue;
+			}
+
+			// push the farther child first so that the nearer one is visited first
+			float tLeft = mNodes[node.first].bounds.intersect_ray(origin, inverseDirection, maxT);
+			float tRight = mNodes[node.first + 1].bounds.intersect_ray(origin, inverseDirection, maxT);
+			Entry left{ node.first, tLeft }, right{ node.first + 1, tRight };
+			if (tLeft >= 0.0f && tRight >= 0.0f && tLeft < tRight) std::swap(left, right);
+			if (left.t >= 0.0f) stack[size++] = left;
+			if (right.t >= 0.0f) stack[size++] = right;
+		}
+	}
+}
+
+#endif // !BVH_H
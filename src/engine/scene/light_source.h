@@ -10,11 +10,16 @@ using glm::vec3;
 namespace ruya
 {
 	
+	/*
+	* A point light. Lights with a range fade out towards it and don't light anything
+	* beyond it, which lets the renderer only shade each pixel with the lights that reach it
+	* (see LightClusters). Lights without range (0, the default) light the whole scene.
+	*/
 	class LightSource
 	{
 	public:
-		LightSource() : mColor(1.0f), mAmbient(1), mDiffuse(1), mSpecular(1) {}
-		LightSource(const vec3& color) : mColor(color), mAmbient(1), mDiffuse(1), mSpecular(1) {}
+		LightSource() : mColor(1.0f), mAmbient(1), mDiffuse(1), mSpecular(1), mRange(0.0f) {}
+		LightSource(const vec3& color) : mColor(color), mAmbient(1), mDiffuse(1), mSpecular(1), mRange(0.0f) {}
 
 		// GETTERS
 		vec3 position() const	{ return mModel.position(); }
@@ -22,6 +27,7 @@ namespace ruya
 		vec3 ambient() const	{ return mAmbient; }
 		vec3 diffuse() const	{ return mDiffuse; }
 		vec3 specular() const	{ return mSpecular; }
+		float range() const		{ return mRange; }
 		Object& model()			{ return mModel; }
 
 
@@ -31,12 +37,14 @@ namespace ruya
 		void set_ambient(const vec3& ambient)   { mAmbient = ambient; }
 		void set_diffuse(const vec3& diffuse)   { mDiffuse = diffuse; }
 		void set_specular(const vec3& specular) { mSpecular = specular; }
+		void set_range(float range)				{ mRange = range; } // world units, 0 = unlimited
 
 	private:
 		vec3 mColor;
 		vec3 mAmbient;
 		vec3 mDiffuse;
 		vec3 mSpecular;
+		float mRange;
 		Object mModel;
 		UUID mUUID;
 	};
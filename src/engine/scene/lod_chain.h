@@ -0,0 +1,52 @@
+#ifndef LOD_CHAIN_H
+#define LOD_CHAIN_H
+
+#include <memory>
+#include <vector>
+#include "engine/scene/mesh.h"
+
+using std::shared_ptr;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Levels of detail of a mesh, shared by all objects that use the same mesh.
+	*	- levels[0] is the most detailed mesh, every next level is coarser
+	*	- errors[i] is how far level i deviates from the surface it approximates, in the
+	*	  local units of the meshes. The renderer projects it to the screen and draws the
+	*	  coarsest level whose error stays below its pixel threshold, see select_level()
+	*	- a level only becomes coarser once its error is HYSTERESIS below the threshold, so
+	*	  that objects near a switching distance don't pop back and forth between two levels
+	*/
+	struct LodChain
+	{
+		static constexpr float HYSTERESIS = 0.25f; // same as in shaders/culling/cull_objects.comp
+
+		vector<shared_ptr<Mesh>> levels;
+		vector<float> errors; // one per level, increasing
+
+		size_t size() const { return levels.size(); }
+
+		/*
+		* Level to draw when the errors are multiplied by errorScale to get their size on screen
+		* relative to the allowed error (1 = at the threshold), the object was last drawn with
+		* level current.
+		*/
+		size_t select_level(float errorScale, size_t current) const
+		{
+			size_t finest = 0, coarsest = 0; // coarsest levels within the threshold, without and with hysteresis
+			for (size_t level = 1; level < errors.size(); level++)
+			{
+				float error = errors[level] * errorScale;
+				if (error <= 1.0f) finest = level;
+				if (error <= 1.0f - HYSTERESIS) coarsest = level;
+			}
+			if (current > finest) return finest;
+			if (current < coarsest) return coarsest;
+			return current;
+		}
+	};
+}
+
+#endif // !LOD_CHAIN_H
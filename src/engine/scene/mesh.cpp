@@ -1,4 +1,6 @@
 #include "mesh.h"
+#include <algorithm>
+#include <cmath>
 
 namespace
 {
@@ -114,3 +116,31 @@ void ruya::Mesh::update_vertex_normals()
         normals[i] /= counts[i];
     }
 }
+
+/*
+* Recalculates the bounding box and sphere from the vertices, an empty mesh gets empty
+* bounds at the origin.
+*   - the sphere is centered on the box, its radius is the distance to the farthest vertex
+*     (at most half the diagonal of the box, usually less)
+*/
+void ruya::Mesh::update_bounds()
+{
+    bounds = MeshBounds();
+    if (vertices.empty()) return;
+
+    bounds.min = bounds.max = vertices.front();
+    for (const vec3& vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex);
+        bounds.max = glm::max(bounds.max, vertex);
+    }
+
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radius2 = 0.0f;
+    for (const vec3& vertex : vertices)
+    {
+        vec3 offset = vertex - bounds.center;
+        radius2 = std::max(radius2, glm::dot(offset, offset));
+    }
+    bounds.radius = std::sqrt(radius2);
+}
@@ -1,6 +1,7 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -12,12 +13,46 @@ using std::vector;
 
 namespace ruya
 {
+	/*
+	* Bounding volumes of a mesh in its local space, the sphere is centered on the box.
+	*/
+	struct MeshBounds
+	{
+		vec3 min = vec3(0.0f); // axis aligned bounding box
+		vec3 max = vec3(0.0f);
+		vec3 center = vec3(0.0f); // center of the box and the sphere
+		float radius = 0.0f; // distance from center to the farthest vertex
+	};
+
+	/*
+	* A cluster of at most a few dozen vertices and about a hundred faces, the faces
+	* [firstFace, firstFace + faceCount) of its mesh. The GPU culls meshlets that are outside
+	* of the view or that face away from the camera, see MeshOptimizer::build_meshlets().
+	*	- the sphere bounds the meshlet in the local space of the mesh
+	*	- the normal cone: all faces face away from a camera at c if
+	*	  dot(normalize(coneApex - c), coneAxis) >= coneCutoff, never for a cutoff above 1
+	*/
+	struct Meshlet
+	{
+		uint32_t firstFace = 0;
+		uint32_t faceCount = 0;
+		uint32_t vertexCount = 0; // distinct vertices of the faces
+		vec3 center = vec3(0.0f);
+		float radius = 0.0f;
+		vec3 coneApex = vec3(0.0f);
+		vec3 coneAxis = vec3(0.0f, 0.0f, 1.0f);
+		float coneCutoff = 2.0f;
+	};
+
 	struct Mesh
 	{
 		vector<vec3> vertices;
 		vector<uvec3> faces;
 		vector<vec3> normals;
 		vector<vec2> textureCoordinates;
+		MeshBounds bounds; // call update_bounds() after changing the vertices
+		bool optimized = false; // set by MeshOptimizer::optimize(), reset it after changing the faces
+		vector<Meshlet> meshlets; // in face order, see MeshOptimizer::build_meshlets()
 
 		long int size() const;
 		long int size_vertices() const;
@@ -28,6 +63,7 @@ namespace ruya
 		// TODO: remove two functions below? Make creator of mesh responsible for initializing?
 		void update_surface_normals();
 		void update_vertex_normals();
+		void update_bounds();
 	};
 }
 
@@ -0,0 +1,626 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include "mesh_optimizer.h"
+
+namespace
+{
+	constexpr float OVERDRAW_THRESHOLD = 1.05f; // clusters may be this much worse than the whole mesh (ACMR)
+
+	/*
+	* FIFO post-transform cache: a vertex is cached if it missed less than size misses ago.
+	* Stamps are miss counts, so that the cache needs no queue.
+	*/
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, unsigned int size)
+			: mStamps(vertexCount, 0), mSize(size), mTime(size + 1) {}
+
+		bool cached(uint32_t vertex) const { return mTime - mStamps[vertex] <= mSize; }
+		uint32_t misses() const { return mTime - mSize - 1 - mFlushed; }
+
+		/*
+		* Transforms the vertex if it isn't cached, returns true if it was a miss.
+		*/
+		bool touch(uint32_t vertex)
+		{
+			if (cached(vertex)) return false;
+			mStamps[vertex] = mTime++;
+			return true;
+		}
+
+		void flush()
+		{
+			mTime += mSize + 1;
+			mFlushed += mSize + 1;
+		}
+
+	private:
+		vector<uint32_t> mStamps;
+		uint32_t mSize;
+		uint32_t mTime;
+		uint32_t mFlushed = 0;
+	};
+
+	/*
+	* Vertex with all its attributes, compared bitwise so that the hash agrees with ==.
+	*/
+	struct VertexKey
+	{
+		vec3 position;
+		vec3 normal;
+		vec2 textureCoordinates;
+
+		bool operator==(const VertexKey& other) const { return std::memcmp(this, &other, sizeof(VertexKey)) == 0; }
+	};
+
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			uint32_t words[sizeof(VertexKey) / sizeof(uint32_t)];
+			std::memcpy(words, &key, sizeof(VertexKey));
+			size_t hash = 0;
+			for (uint32_t word : words)
+				hash = (hash ^ word) * 1099511628211ull; // FNV-1a on words
+			return hash;
+		}
+	};
+
+	/*
+	* Replaces the values by values[order[i]]. Attributes may be missing (empty) or shorter than
+	* the vertices, missing values become zero.
+	*/
+	template <class T>
+	void permute(vector<T>& values, const vector<uint32_t>& order)
+	{
+		if (values.empty()) return;
+		vector<T> permuted(order.size(), T(0));
+		for (size_t i = 0; i < order.size(); i++)
+			if (order[i] < values.size()) permuted[i] = values[order[i]];
+		values.swap(permuted);
+	}
+
+	/*
+	* Renumbers the vertices: order[new] is the old index of the new vertex, remap[old] its new
+	* index.
+	*/
+	void reindex(ruya::Mesh& mesh, const vector<uint32_t>& order, const vector<uint32_t>& remap)
+	{
+		permute(mesh.vertices, order);
+		permute(mesh.normals, order);
+		permute(mesh.textureCoordinates, order);
+		for (uvec3& face : mesh.faces)
+			face = uvec3(remap[face.x], remap[face.y], remap[face.z]);
+	}
+
+	/*
+	* Cross product of the edges, twice the area in the direction of the normal. The winding
+	* of the generated meshes isn't consistent (back faces aren't culled), so the direction is
+	* taken from the vertex normals if the mesh has them.
+	*/
+	vec3 area_normal(const ruya::Mesh& mesh, const uvec3& face)
+	{
+		const vec3& a = mesh.vertices[face.x];
+		vec3 normal = glm::cross(mesh.vertices[face.y] - a, mesh.vertices[face.z] - a);
+		if (mesh.normals.size() < mesh.vertices.size()) return normal;
+
+		vec3 vertexNormals = mesh.normals[face.x] + mesh.normals[face.y] + mesh.normals[face.z];
+		return glm::dot(normal, vertexNormals) < 0.0f ? -normal : normal;
+	}
+
+	vec3 centroid(const ruya::Mesh& mesh, const uvec3& face)
+	{
+		return (mesh.vertices[face.x] + mesh.vertices[face.y] + mesh.vertices[face.z]) / 3.0f;
+	}
+
+	/*
+	* Faces of each vertex: faces[offsets[v]] .. faces[offsets[v + 1]].
+	*/
+	struct Adjacency
+	{
+		vector<uint32_t> offsets;
+		vector<uint32_t> faces;
+
+		explicit Adjacency(const ruya::Mesh& mesh)
+			: offsets(mesh.vertices.size() + 1, 0), faces(mesh.faces.size() * 3)
+		{
+			for (const uvec3& face : mesh.faces)
+				for (int k = 0; k < 3; k++) offsets[face[k] + 1]++;
+			for (size_t v = 0; v < mesh.vertices.size(); v++)
+				offsets[v + 1] += offsets[v];
+			vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+			for (uint32_t f = 0; f < mesh.faces.size(); f++)
+				for (int k = 0; k < 3; k++) faces[next[mesh.faces[f][k]]++] = f;
+		}
+
+		uint32_t count(uint32_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+	};
+
+	/*
+	* Bounding sphere and normal cone of the faces of the meshlet. The sphere is centered on
+	* the bounding box. The cone axis is the average face normal, the cutoff the sine of the
+	* widest angle between it and a face normal, and the apex lies behind the center, far
+	* enough along the axis to be behind the planes of all faces (the camera sees the back of
+	* every face from inside the cone). Meshlets with faces at right angles or more to the
+	* axis get a cutoff of 2 and are never culled.
+	*/
+	void meshlet_bounds(const ruya::Mesh& mesh, ruya::Meshlet& meshlet)
+	{
+		vec3 min = mesh.vertices[mesh.faces[meshlet.firstFace].x], max = min;
+		vec3 axis(0.0f);
+		for (uint32_t f = meshlet.firstFace; f < meshlet.firstFace + meshlet.faceCount; f++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				min = glm::min(min, mesh.vertices[mesh.faces[f][k]]);
+				max = glm::max(max, mesh.vertices[mesh.faces[f][k]]);
+			}
+			vec3 normal = area_normal(mesh, mesh.faces[f]);
+			float length = glm::length(normal);
+			if (length > 0.0f) axis += normal / length;
+		}
+
+		meshlet.center = (min + max) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (uint32_t f = meshlet.firstFace; f < meshlet.firstFace + meshlet.faceCount; f++)
+			for (int k = 0; k < 3; k++)
+				meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, mesh.vertices[mesh.faces[f][k]]));
+
+		meshlet.coneApex = meshlet.center;
+		meshlet.coneCutoff = 2.0f;
+		float axisLength = glm::length(axis);
+		if (axisLength == 0.0f) return;
+		meshlet.coneAxis = axis / axisLength;
+
+		float minDot = 1.0f, apexDistance = 0.0f;
+		for (uint32_t f = meshlet.firstFace; f < meshlet.firstFace + meshlet.faceCount; f++)
+		{
+			vec3 normal = area_normal(mesh, mesh.faces[f]);
+			float length = glm::length(normal);
+			if (length == 0.0f) continue;
+			normal /= length;
+			float d = glm::dot(normal, meshlet.coneAxis);
+			minDot = std::min(minDot, d);
+			if (d > 0.0f)
+				apexDistance = std::max(apexDistance, glm::dot(meshlet.center - mesh.vertices[mesh.faces[f].x], normal) / d);
+		}
+		if (minDot <= 0.0f) return;
+		meshlet.coneApex = meshlet.center - meshlet.coneAxis * apexDistance;
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+/*
+* Runs all steps on the mesh (see the class) and marks it as optimized, the bounds are
+* updated because unused vertices are dropped. The faces keep their order if the new one
+* has a higher ACMR (the overdraw step trades some of it).
+*/
+ruya::MeshOptimizer::Report ruya::MeshOptimizer::optimize(Mesh& mesh, unsigned int cacheSize)
+{
+	Report report;
+	report.verticesBefore = mesh.vertices.size();
+	report.before = vertex_cache_metrics(mesh, cacheSize);
+
+	weld_vertices(mesh);
+	float welded = vertex_cache_metrics(mesh, cacheSize).acmr;
+	vector<uvec3> faces = mesh.faces;
+	vector<uint32_t> clusters = optimize_vertex_cache(mesh, cacheSize);
+	optimize_overdraw(mesh, clusters, cacheSize);
+	if (vertex_cache_metrics(mesh, cacheSize).acmr > welded) mesh.faces.swap(faces); // the order was better already
+	build_meshlets(mesh);
+	optimize_vertex_fetch(mesh);
+	mesh.update_bounds();
+	mesh.optimized = true;
+
+	report.verticesAfter = mesh.vertices.size();
+	report.after = vertex_cache_metrics(mesh, cacheSize);
+	return report;
+}
+
+/*
+* Simulates drawing the faces in order with a FIFO cache of the given size. ATVR counts
+* the vertices the faces use, unused vertices aren't transformed.
+*/
+ruya::MeshOptimizer::Metrics ruya::MeshOptimizer::vertex_cache_metrics(const Mesh& mesh, unsigned int cacheSize)
+{
+	Metrics metrics;
+	if (mesh.faces.empty()) return metrics;
+
+	FifoCache cache(mesh.vertices.size(), cacheSize);
+	vector<bool> used(mesh.vertices.size(), false);
+	size_t usedCount = 0;
+	for (const uvec3& face : mesh.faces)
+		for (int k = 0; k < 3; k++)
+		{
+			cache.touch(face[k]);
+			if (!used[face[k]]) usedCount++;
+			used[face[k]] = true;
+		}
+
+	metrics.acmr = static_cast<float>(cache.misses()) / mesh.faces.size();
+	metrics.atvr = static_cast<float>(cache.misses()) / usedCount;
+	return metrics;
+}
+
+/*
+* Merges vertices whose position, normal and texture coordinates are bitwise equal, keeps
+* the first of them. Faces that use a vertex more than once after merging have no area and
+* are dropped.
+*/
+void ruya::MeshOptimizer::weld_vertices(Mesh& mesh)
+{
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+	unique.reserve(mesh.vertices.size());
+	vector<uint32_t> order, remap(mesh.vertices.size());
+	for (uint32_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		VertexKey key{ mesh.vertices[v], vec3(0.0f), vec2(0.0f) };
+		if (v < mesh.normals.size()) key.normal = mesh.normals[v];
+		if (v < mesh.textureCoordinates.size()) key.textureCoordinates = mesh.textureCoordinates[v];
+
+		auto [it, inserted] = unique.try_emplace(key, static_cast<uint32_t>(order.size()));
+		if (inserted) order.push_back(v);
+		remap[v] = it->second;
+	}
+	if (order.size() < mesh.vertices.size()) reindex(mesh, order, remap);
+
+	auto degenerate = [](const uvec3& face) { return face.x == face.y || face.y == face.z || face.z == face.x; };
+	mesh.faces.erase(std::remove_if(mesh.faces.begin(), mesh.faces.end(), degenerate), mesh.faces.end());
+}
+
+/*
+* Tipsify: fans around a vertex, emitting all its faces that haven't been emitted, then
+* continues with the vertex that was just used (candidates) that has the most faces left
+* and stays in the cache until they are drawn. If no candidate has faces left it backtracks
+* through the vertices used recently (dead ends), then takes the next vertex in input order.
+* Linear in the number of faces.
+* @return first face of each cluster: the faces start over from a vertex that isn't cached,
+*		  see optimize_overdraw()
+*/
+vector<uint32_t> ruya::MeshOptimizer::optimize_vertex_cache(Mesh& mesh, unsigned int cacheSize)
+{
+	vector<uint32_t> clusters;
+	const size_t vertexCount = mesh.vertices.size(), faceCount = mesh.faces.size();
+	if (faceCount == 0) return clusters;
+
+	Adjacency adjacency(mesh);
+	vector<uint32_t> live(vertexCount, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		live[v] = adjacency.count(v);
+
+	// cacheTime like FifoCache, a vertex is cached if time - cacheTime <= cacheSize
+	vector<uint32_t> cacheTime(vertexCount, 0), deadEnds, candidates;
+	uint32_t time = cacheSize + 1;
+	vector<bool> emitted(faceCount, false);
+	vector<uvec3> faces;
+	faces.reserve(faceCount);
+	deadEnds.reserve(faceCount * 3);
+
+	uint32_t cursor = 0;
+	int64_t fanning = 0;
+	clusters.push_back(0);
+	while (fanning >= 0)
+	{
+		candidates.clear();
+		for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++)
+		{
+			uint32_t f = adjacency.faces[i];
+			if (emitted[f]) continue;
+			emitted[f] = true;
+			faces.push_back(mesh.faces[f]);
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t v = mesh.faces[f][k];
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+			}
+		}
+
+		// prefer the oldest cached candidate whose faces all fit in the cache
+		int64_t best = -1, bestPriority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (live[v] == 0) continue;
+			int64_t age = time - cacheTime[v], priority = 0;
+			if (age + 2 * static_cast<int64_t>(live[v]) <= cacheSize) priority = age;
+			if (priority > bestPriority)
+			{
+				best = v;
+				bestPriority = priority;
+			}
+		}
+		while (best < 0 && !deadEnds.empty())
+		{
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0) best = v;
+		}
+		for (; best < 0 && cursor < vertexCount; cursor++)
+			if (live[cursor] > 0) best = cursor;
+
+		if (best >= 0 && time - cacheTime[best] > cacheSize)
+			clusters.push_back(static_cast<uint32_t>(faces.size()));
+		fanning = best;
+	}
+
+	mesh.faces.swap(faces);
+	return clusters;
+}
+
+/*
+* Splits the clusters further where the cache efficiency of a cluster on its own (starting
+* with an empty cache) is close to that of the whole mesh, then sorts them by occlusion
+* potential: dot(cluster centroid - mesh centroid, cluster normal). Clusters on the outside
+* facing outwards are drawn first, they occlude the clusters behind them from most view
+* directions. Centroids and normals are weighted by area.
+* @param clusters first face of each cluster, in order, see optimize_vertex_cache()
+*/
+void ruya::MeshOptimizer::optimize_overdraw(Mesh& mesh, const vector<uint32_t>& clusters, unsigned int cacheSize)
+{
+	const size_t faceCount = mesh.faces.size();
+	if (clusters.size() == 0 || faceCount == 0) return;
+
+	float threshold = vertex_cache_metrics(mesh, cacheSize).acmr * OVERDRAW_THRESHOLD;
+	vector<uint32_t> starts;
+	FifoCache cache(mesh.vertices.size(), cacheSize);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(faceCount);
+		uint32_t start = clusters[c], misses = cache.misses();
+		starts.push_back(start);
+		cache.flush();
+		for (uint32_t f = start; f < end; f++)
+		{
+			for (int k = 0; k < 3; k++) cache.touch(mesh.faces[f][k]);
+			if (f + 1 < end && static_cast<float>(cache.misses() - misses) / (f + 1 - start) <= threshold)
+			{
+				start = f + 1;
+				misses = cache.misses();
+				starts.push_back(start);
+				cache.flush();
+			}
+		}
+	}
+
+	vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (const uvec3& face : mesh.faces)
+	{
+		float area = glm::length(area_normal(mesh, face));
+		meshCentroid += centroid(mesh, face) * area;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	struct Cluster { uint32_t start, end; float occlusion; };
+	vector<Cluster> sorted(starts.size());
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		Cluster& cluster = sorted[c];
+		cluster.start = starts[c];
+		cluster.end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(faceCount);
+
+		vec3 clusterCentroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (uint32_t f = cluster.start; f < cluster.end; f++)
+		{
+			vec3 faceNormal = area_normal(mesh, mesh.faces[f]);
+			float faceArea = glm::length(faceNormal);
+			clusterCentroid += centroid(mesh, mesh.faces[f]) * faceArea;
+			normal += faceNormal;
+			area += faceArea;
+		}
+		float length = glm::length(normal);
+		cluster.occlusion = area > 0.0f && length > 0.0f ? glm::dot(clusterCentroid / area - meshCentroid, normal / length) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.occlusion > b.occlusion; });
+
+	vector<uvec3> faces;
+	faces.reserve(faceCount);
+	for (const Cluster& cluster : sorted)
+		faces.insert(faces.end(), mesh.faces.begin() + cluster.start, mesh.faces.begin() + cluster.end);
+	mesh.faces.swap(faces);
+}
+
+/*
+* Splits the faces into meshlets of at most maxVertices distinct vertices and maxFaces faces
+* and reorders them so that the faces of each meshlet are contiguous. A meshlet starts next
+* to the previous one, at the face with the fewest faces left around it, and grows with the adjacent face that adds the
+* fewest new vertices, the one closest to the meshlet's center on ties, until it is full or
+* no adjacent face fits. The faces of a meshlet keep their order, so that the vertex cache
+* order is mostly kept: meshlets are local. Replaces the meshlets of the mesh.
+*/
+void ruya::MeshOptimizer::build_meshlets(Mesh& mesh, unsigned int maxVertices, unsigned int maxFaces)
+{
+	constexpr uint32_t NONE = ~0u;
+	const size_t faceCount = mesh.faces.size();
+	mesh.meshlets.clear();
+	if (faceCount == 0) return;
+
+	Adjacency adjacency(mesh);
+	vector<uint32_t> owner(mesh.vertices.size(), NONE), queued(faceCount, NONE), candidates, vertices;
+	vector<bool> assigned(faceCount, false);
+	vector<uint32_t> order, live(mesh.vertices.size()); // faces in meshlet order, faces left of each vertex
+	order.reserve(faceCount);
+	for (uint32_t v = 0; v < mesh.vertices.size(); v++)
+		live[v] = adjacency.count(v);
+
+	uint32_t cursor = 0;
+	while (order.size() < faceCount)
+	{
+		// next to the previous meshlet where the fewest faces are left, so that no holes are left
+		// behind, else the first face left in order
+		int64_t seed = -1;
+		uint32_t seedLive = 0;
+		for (uint32_t f : candidates)
+		{
+			if (assigned[f]) continue;
+			uint32_t faceLive = live[mesh.faces[f].x] + live[mesh.faces[f].y] + live[mesh.faces[f].z];
+			if (seed < 0 || faceLive < seedLive)
+			{
+				seed = f;
+				seedLive = faceLive;
+			}
+		}
+		while (assigned[cursor]) cursor++;
+		if (seed < 0) seed = cursor;
+
+		const uint32_t id = static_cast<uint32_t>(mesh.meshlets.size());
+		Meshlet meshlet;
+		meshlet.firstFace = static_cast<uint32_t>(order.size());
+		vertices.clear();
+		candidates.clear();
+		vec3 sum(0.0f);
+
+		for (int64_t next = seed; next >= 0;)
+		{
+			const uvec3& face = mesh.faces[next];
+			assigned[next] = true;
+			order.push_back(static_cast<uint32_t>(next));
+			meshlet.faceCount++;
+			for (int k = 0; k < 3; k++)
+			{
+				live[face[k]]--;
+				if (owner[face[k]] == id) continue;
+				owner[face[k]] = id;
+				vertices.push_back(face[k]);
+				sum += mesh.vertices[face[k]];
+				for (uint32_t i = adjacency.offsets[face[k]]; i < adjacency.offsets[face[k] + 1]; i++)
+				{
+					uint32_t f = adjacency.faces[i];
+					if (assigned[f] || queued[f] == id) continue;
+					queued[f] = id;
+					candidates.push_back(f);
+				}
+			}
+			if (meshlet.faceCount == maxFaces) break;
+
+			vec3 center = sum / static_cast<float>(vertices.size());
+			int64_t best = -1;
+			int bestNew = 4;
+			float bestDistance = 0.0f;
+			size_t kept = 0;
+			for (uint32_t f : candidates)
+			{
+				if (assigned[f]) continue;
+				candidates[kept++] = f;
+				int added = 0;
+				for (int k = 0; k < 3; k++) added += owner[mesh.faces[f][k]] != id;
+				if (vertices.size() + added > maxVertices) continue;
+				float distance = glm::distance(centroid(mesh, mesh.faces[f]), center);
+				if (best < 0 || ((added == 0) != (bestNew == 0) ? added == 0 : distance < bestDistance))
+				{
+					best = f;
+					bestNew = added;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(kept);
+			next = best;
+		}
+
+		meshlet.vertexCount = static_cast<uint32_t>(vertices.size());
+		mesh.meshlets.push_back(meshlet);
+		std::sort(order.begin() + meshlet.firstFace, order.end()); // the vertex cache order
+	}
+
+	vector<uvec3> faces(faceCount);
+	for (size_t f = 0; f < faceCount; f++)
+		faces[f] = mesh.faces[order[f]];
+	mesh.faces.swap(faces);
+	for (Meshlet& meshlet : mesh.meshlets)
+		meshlet_bounds(mesh, meshlet);
+}
+
+/*
+* Renumbers the vertices in the order the faces first use them, vertices no face uses are
+* dropped.
+*/
+void ruya::MeshOptimizer::optimize_vertex_fetch(Mesh& mesh)
+{
+	constexpr uint32_t UNUSED = ~0u;
+	vector<uint32_t> order, remap(mesh.vertices.size(), UNUSED);
+	order.reserve(mesh.vertices.size());
+	for (const uvec3& face : mesh.faces)
+		for (int k = 0; k < 3; k++)
+			if (remap[face[k]] == UNUSED)
+			{
+				remap[face[k]] = static_cast<uint32_t>(order.size());
+				order.push_back(face[k]);
+			}
+	reindex(mesh, order, remap);
+}
+
+/*
+* Rotates the faces so that their last vertex, the provoking vertex of GL_LAST_VERTEX_CONVENTION
+* (the default), is provoking for no other face, and gives it the normal of its face: the
+* average of the vertex normals, like shaders/flat/flat_geom.geom, or the area normal without
+* normals. `flat` outputs then carry per-face values without a geometry shader. A face takes
+* the vertex with the fewest faces left to rotate, so that the vertices shared by many faces
+* stay free for them, a vertex is duplicated when all three are taken (closed meshes have
+* about twice as many faces as vertices). The rotation keeps the winding, the face order
+* and the meshlets, the vertices are renumbered for vertex fetch. Only for flat shading: the
+* provoking vertices lose their smooth normals. Returns the number of added vertices.
+*/
+size_t ruya::MeshOptimizer::assign_provoking_vertices(Mesh& mesh)
+{
+	const size_t vertexCount = mesh.vertices.size();
+	const bool hasNormals = mesh.normals.size() >= vertexCount;
+	const bool hasTextureCoordinates = mesh.textureCoordinates.size() >= vertexCount;
+	mesh.normals.resize(vertexCount, vec3(0.0f));
+	vector<vec3> sourceNormals = mesh.normals;
+
+	Adjacency adjacency(mesh);
+	vector<uint32_t> remaining(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		remaining[v] = adjacency.count(v);
+	vector<bool> taken(vertexCount, false);
+
+	for (uvec3& face : mesh.faces)
+	{
+		vec3 normal = hasNormals ? (sourceNormals[face.x] + sourceNormals[face.y] + sourceNormals[face.z]) / 3.0f : area_normal(mesh, face);
+		int provoking = -1;
+		for (int k = 0; k < 3; k++)
+		{
+			remaining[face[k]]--;
+			if (!taken[face[k]] && (provoking < 0 || remaining[face[k]] < remaining[face[provoking]]))
+				provoking = k;
+		}
+
+		if (provoking < 0)
+		{
+			provoking = 2;
+			mesh.vertices.push_back(mesh.vertices[face.z]);
+			mesh.normals.push_back(vec3(0.0f));
+			if (hasTextureCoordinates) mesh.textureCoordinates.push_back(mesh.textureCoordinates[face.z]);
+			face.z = static_cast<uint32_t>(mesh.vertices.size() - 1);
+			taken.push_back(false);
+		}
+		taken[face[provoking]] = true;
+		mesh.normals[face[provoking]] = normal;
+		if (provoking == 0) face = uvec3(face.y, face.z, face.x);
+		else if (provoking == 1) face = uvec3(face.z, face.x, face.y);
+	}
+
+	size_t added = mesh.vertices.size() - vertexCount;
+	optimize_vertex_fetch(mesh);
+	vector<uint32_t> stamps(mesh.vertices.size(), ~0u);
+	for (uint32_t m = 0; m < mesh.meshlets.size(); m++)
+	{
+		Meshlet& meshlet = mesh.meshlets[m];
+		meshlet.vertexCount = 0;
+		for (uint32_t f = meshlet.firstFace; f < meshlet.firstFace + meshlet.faceCount; f++)
+			for (int k = 0; k < 3; k++)
+				if (stamps[mesh.faces[f][k]] != m)
+				{
+					stamps[mesh.faces[f][k]] = m;
+					meshlet.vertexCount++;
+				}
+	}
+	return added;
+}
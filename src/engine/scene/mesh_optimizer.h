@@ -0,0 +1,80 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/scene/mesh.h"
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* Reorders the vertices and faces of meshes for the GPU, without changing what they look
+	* like. optimize() runs all steps in this order:
+	*	- weld_vertices(): vertices with the same position, normal and texture coordinates
+	*	  become one, faces that use a vertex twice are dropped
+	*	- optimize_vertex_cache(): orders the faces so that the post-transform vertex cache
+	*	  reuses as many vertices as possible (Tipsify, Sander et al. 2007: fan around a
+	*	  vertex that is still in the cache, the next one is the cached vertex with the most
+	*	  remaining faces that won't be evicted before they are drawn)
+	*	- optimize_overdraw(): the face order is split into clusters where the cache starts
+	*	  over anyway, the clusters facing away from the mesh's center are drawn first so
+	*	  that they occlude the rest (same paper), the cache efficiency stays the same
+	*	- build_meshlets(): splits the faces into meshlets (see Meshlet) of at most
+	*	  MESHLET_VERTICES vertices and MESHLET_FACES faces, with bounding spheres and normal
+	*	  cones for culling them on the GPU (see MeshletCulling)
+	*	- optimize_vertex_fetch(): renumbers the vertices in the order the faces first use
+	*	  them, so that vertex fetch reads memory sequentially. Unused vertices are dropped
+	*
+	* The metrics are those of a FIFO cache of the given size:
+	*	- ACMR: average cache miss ratio, transformed vertices per triangle. 0.5 is the limit
+	*	  for large regular meshes, 3 means no reuse at all
+	*	- ATVR: average transformed vertex ratio, transformed vertices per vertex. 1 is
+	*	  ideal, every vertex is transformed once
+	*
+	* Procedural meshes are optimized when they are generated (see models/), meshes that
+	* haven't been optimized are optimized by the AssetLoader when it stages them.
+	*
+	* assign_provoking_vertices() isn't part of optimize(): it prepares a copy of a mesh for
+	* flat shading with `flat` vertex outputs (Renderer::FlatShading::PROVOKING_VERTEX).
+	*/
+	class MeshOptimizer
+	{
+	public:
+		static constexpr unsigned int DEFAULT_CACHE_SIZE = 16; // entries, conservative for current GPUs
+		static constexpr unsigned int MESHLET_VERTICES = 64; // the usual limits of mesh shader meshlets
+		static constexpr unsigned int MESHLET_FACES = 124;
+
+		struct Metrics
+		{
+			float acmr = 0.0f;
+			float atvr = 0.0f;
+		};
+
+		/*
+		* Result of optimize().
+		*/
+		struct Report
+		{
+			Metrics before;
+			Metrics after;
+			size_t verticesBefore = 0;
+			size_t verticesAfter = 0;
+		};
+
+		static Report optimize(Mesh& mesh, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+		static Metrics vertex_cache_metrics(const Mesh& mesh, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+		static void weld_vertices(Mesh& mesh);
+		static vector<uint32_t> optimize_vertex_cache(Mesh& mesh, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+		static void optimize_overdraw(Mesh& mesh, const vector<uint32_t>& clusters, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+		static void build_meshlets(Mesh& mesh, unsigned int maxVertices = MESHLET_VERTICES, unsigned int maxFaces = MESHLET_FACES);
+		static void optimize_vertex_fetch(Mesh& mesh);
+		static size_t assign_provoking_vertices(Mesh& mesh);
+	};
+}
+
+#endif // !MESH_OPTIMIZER_H
@@ -0,0 +1,684 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+#include "mesh_simplifier.h"
+#include "mesh_optimizer.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr double BORDER_WEIGHT = 10.0; // of the planes along borders and seams, per squared edge length
+	constexpr uint32_t CACHE_MAGIC = 0x444F4C52; // "RLOD"
+	constexpr uint32_t CACHE_VERSION = 1;
+	constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+	/*
+	* What a position may do in a collapse, see MeshSimplifier.
+	*/
+	enum class VertexKind : uint8_t { MANIFOLD, BORDER, SEAM, LOCKED };
+
+	/*
+	* Sum of weighted squared distances to planes: p^T A p + 2 b^T p + c, A symmetric.
+	*/
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+		double weight = 0.0;
+
+		// plane dot(normal, p) + d = 0, normal of unit length
+		void add_plane(const glm::dvec3& normal, double d, double w)
+		{
+			a00 += w * normal.x * normal.x;	a01 += w * normal.x * normal.y;	a02 += w * normal.x * normal.z;
+			a11 += w * normal.y * normal.y;	a12 += w * normal.y * normal.z;	a22 += w * normal.z * normal.z;
+			b0 += w * normal.x * d;	b1 += w * normal.y * d;	b2 += w * normal.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+			weight += q.weight;
+		}
+
+		// RMS distance of the point to the planes
+		float distance(const vec3& point) const
+		{
+			if (weight <= 0.0) return 0.0f;
+			double x = point.x, y = point.y, z = point.z;
+			double error = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return static_cast<float>(std::sqrt(std::max(error, 0.0) / weight));
+		}
+	};
+
+	uint64_t edge_key(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	/*
+	* A vertex moving onto a neighbor, for seams with the vertex on the other side of the seam.
+	*/
+	struct Collapse
+	{
+		uint64_t edge;
+		uint32_t from, to;
+		uint32_t siblingFrom = NONE, siblingTo = NONE;
+		float error = 0.0f;
+	};
+
+	/*
+	* The simplification of one mesh. Vertices are indexes in the mesh, a position is the
+	* first vertex with that position (all vertices with the same position share its kind
+	* and quadric).
+	*/
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const ruya::Mesh& mesh)
+			: mMesh(mesh), mPositions(mesh.vertices.size())
+		{
+			std::unordered_map<vec3, uint32_t, PositionHash> firstOf;
+			for (uint32_t v = 0; v < mesh.vertices.size(); v++)
+				mPositions[v] = firstOf.try_emplace(mesh.vertices[v], v).first->second;
+
+			for (const uvec3& face : mesh.faces)
+			{
+				if (!degenerate(face)) mFaces.push_back(face);
+			}
+			update_topology();
+			init_quadrics();
+		}
+
+		/*
+		* Simplifies further, can be called again with a lower target or a higher error limit.
+		* @returns the largest error of the collapses so far
+		*/
+		float run(size_t targetFaces, float maxError)
+		{
+			while (mFaces.size() > targetFaces)
+			{
+				vector<Collapse> collapses = collect_collapses(maxError);
+				if (collapses.empty()) break;
+
+				// cheapest collapses first, up to a bit more than the error of the last one that
+				// would reach the target if all of them could be done in this pass
+				size_t goal = std::max<size_t>((mFaces.size() - targetFaces) / 2, 1);
+				float passLimit = goal < collapses.size() ? collapses[goal].error * 1.5f : maxError;
+				size_t done = apply_collapses(collapses, std::min(passLimit, maxError), targetFaces);
+				if (done == 0) break;
+				update_topology();
+			}
+			return mError;
+		}
+
+		size_t face_count() const { return mFaces.size(); }
+
+		shared_ptr<ruya::Mesh> result() const
+		{
+			shared_ptr<ruya::Mesh> mesh = std::make_shared<ruya::Mesh>();
+			vector<uint32_t> remap(mMesh.vertices.size(), NONE);
+			for (const uvec3& face : mFaces)
+			{
+				uvec3& newFace = mesh->faces.emplace_back();
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t v = face[k];
+					if (remap[v] == NONE)
+					{
+						remap[v] = static_cast<uint32_t>(mesh->vertices.size());
+						mesh->vertices.push_back(mMesh.vertices[v]);
+						if (v < mMesh.normals.size()) mesh->normals.push_back(mMesh.normals[v]);
+						if (v < mMesh.textureCoordinates.size()) mesh->textureCoordinates.push_back(mMesh.textureCoordinates[v]);
+					}
+					newFace[k] = remap[v];
+				}
+			}
+			mesh->update_bounds();
+			return mesh;
+		}
+
+	private:
+		struct PositionHash
+		{
+			size_t operator()(const vec3& v) const
+			{
+				return std::hash<float>()(v.x) ^ (std::hash<float>()(v.y) * 31) ^ (std::hash<float>()(v.z) * 131);
+			}
+		};
+
+		const ruya::Mesh& mMesh;
+		vector<uint32_t> mPositions; // per vertex
+		vector<uvec3> mFaces;
+		vector<Quadric> mQuadrics; // per position
+		float mError = 0.0f;
+
+		// topology of mFaces, see update_topology()
+		vector<uint32_t> mOpenEdges; // per vertex: the other ends of its first 2 open edges
+		vector<uint8_t> mOpenCounts; // per vertex
+		vector<uint32_t> mWedges; // per position: its first 2 vertices in use
+		vector<VertexKind> mKinds; // per position
+		vector<uint32_t> mFaceOffsets; // faces of position p: mPositionFaces[mFaceOffsets[p]] .. [mFaceOffsets[p + 1]]
+		vector<uint32_t> mPositionFaces;
+
+		const vec3& point(uint32_t vertex) const { return mMesh.vertices[vertex]; }
+
+		bool degenerate(const uvec3& face) const
+		{
+			uint32_t a = mPositions[face.x], b = mPositions[face.y], c = mPositions[face.z];
+			return a == b || b == c || c == a;
+		}
+
+		bool open_edge(uint32_t from, uint32_t to) const
+		{
+			return mOpenEdges[2 * from] == to || mOpenEdges[2 * from + 1] == to;
+		}
+
+		/*
+		* Open edges (of one face, counted over vertices: a seam is open on both sides), the
+		* vertices of each position and the kinds of the positions.
+		*/
+		void update_topology()
+		{
+			size_t count = mMesh.vertices.size();
+			std::unordered_map<uint64_t, uint32_t> vertexEdges, positionEdges;
+			vertexEdges.reserve(mFaces.size() * 3);
+			positionEdges.reserve(mFaces.size() * 3);
+			for (const uvec3& face : mFaces)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = face[k], b = face[(k + 1) % 3];
+					vertexEdges[edge_key(a, b)]++;
+					positionEdges[edge_key(mPositions[a], mPositions[b])]++;
+				}
+			}
+
+			mOpenEdges.assign(2 * count, NONE);
+			mOpenCounts.assign(count, 0);
+			mWedges.assign(2 * count, NONE);
+			mKinds.assign(count, VertexKind::MANIFOLD);
+			vector<uint8_t> wedgeCounts(count, 0);
+			enum : uint8_t { BORDER_EDGE = 1, SEAM_EDGE = 2, IRREGULAR = 4 };
+			vector<uint8_t> flags(count, 0);
+
+			vector<bool> used(count, false);
+			for (const uvec3& face : mFaces)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t v = face[k], p = mPositions[v];
+					if (used[v]) continue;
+					used[v] = true;
+					if (wedgeCounts[p] < 2) mWedges[2 * p + wedgeCounts[p]] = v;
+					wedgeCounts[p] = static_cast<uint8_t>(std::min(wedgeCounts[p] + 1, 3));
+				}
+			}
+
+			// an edge between two faces that have different vertices at only one end is a seam for
+			// that end, the other end has the same attributes on both sides of the edge
+			auto add_open = [&](uint32_t from, uint32_t to, uint8_t flag) {
+				uint32_t p = mPositions[from];
+				if (flag == SEAM_EDGE && wedgeCounts[p] == 1) return;
+				if (mOpenCounts[from] < 2) mOpenEdges[2 * from + mOpenCounts[from]] = to;
+				mOpenCounts[from] = static_cast<uint8_t>(std::min(mOpenCounts[from] + 1, 3));
+				flags[p] |= flag;
+			};
+			for (const auto& [key, faces] : vertexEdges)
+			{
+				if (faces != 1) continue;
+				uint32_t a = static_cast<uint32_t>(key >> 32), b = static_cast<uint32_t>(key);
+				uint32_t positionFaces = positionEdges[edge_key(mPositions[a], mPositions[b])];
+				uint8_t flag = positionFaces == 1 ? BORDER_EDGE : positionFaces == 2 ? SEAM_EDGE : IRREGULAR;
+				add_open(a, b, flag);
+				add_open(b, a, flag);
+			}
+			for (const auto& [key, faces] : positionEdges)
+			{
+				if (faces <= 2) continue;
+				flags[key >> 32] |= IRREGULAR; // non-manifold
+				flags[static_cast<uint32_t>(key)] |= IRREGULAR;
+			}
+
+			for (uint32_t v = 0; v < count; v++)
+			{
+				uint32_t p = mPositions[v];
+				if (used[v] && mOpenCounts[v] != 0 && mOpenCounts[v] != 2) flags[p] |= IRREGULAR;
+				if (used[v] && wedgeCounts[p] > 1 && mOpenCounts[v] != 2) flags[p] |= IRREGULAR;
+			}
+			for (uint32_t p = 0; p < count; p++)
+			{
+				if (mPositions[p] != p || wedgeCounts[p] == 0) continue;
+				if (wedgeCounts[p] == 1 && flags[p] == 0) mKinds[p] = VertexKind::MANIFOLD;
+				else if (wedgeCounts[p] == 1 && flags[p] == BORDER_EDGE) mKinds[p] = VertexKind::BORDER;
+				else if (wedgeCounts[p] == 2 && flags[p] == SEAM_EDGE) mKinds[p] = VertexKind::SEAM;
+				else mKinds[p] = VertexKind::LOCKED;
+			}
+
+			mFaceOffsets.assign(count + 1, 0);
+			for (const uvec3& face : mFaces)
+				for (int k = 0; k < 3; k++) mFaceOffsets[mPositions[face[k]] + 1]++;
+			for (size_t p = 0; p < count; p++)
+				mFaceOffsets[p + 1] += mFaceOffsets[p];
+			mPositionFaces.resize(mFaces.size() * 3);
+			vector<uint32_t> next(mFaceOffsets.begin(), mFaceOffsets.end() - 1);
+			for (uint32_t f = 0; f < mFaces.size(); f++)
+				for (int k = 0; k < 3; k++) mPositionFaces[next[mPositions[mFaces[f][k]]]++] = f;
+		}
+
+		/*
+		* Planes of the faces around each position, weighted by the area of the faces, and the
+		* planes through the open edges perpendicular to their face.
+		*/
+		void init_quadrics()
+		{
+			mQuadrics.assign(mMesh.vertices.size(), Quadric());
+			for (const uvec3& face : mFaces)
+			{
+				glm::dvec3 p0 = point(face.x), p1 = point(face.y), p2 = point(face.z);
+				glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+				double length = glm::length(normal);
+				if (length == 0.0) continue;
+				normal /= length;
+				double d = -glm::dot(normal, p0);
+				for (int k = 0; k < 3; k++)
+					mQuadrics[mPositions[face[k]]].add_plane(normal, d, length * 0.5);
+
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = face[k], b = face[(k + 1) % 3];
+					if (!open_edge(a, b) && !open_edge(b, a)) continue;
+					glm::dvec3 edge = glm::dvec3(point(b)) - glm::dvec3(point(a));
+					glm::dvec3 edgeNormal = glm::cross(edge, normal);
+					double edgeLength = glm::length(edgeNormal);
+					if (edgeLength == 0.0) continue;
+					edgeNormal /= edgeLength;
+					double edgeD = -glm::dot(edgeNormal, glm::dvec3(point(a)));
+					double weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+					mQuadrics[mPositions[a]].add_plane(edgeNormal, edgeD, weight);
+					mQuadrics[mPositions[b]].add_plane(edgeNormal, edgeD, weight);
+				}
+			}
+		}
+
+		/*
+		* Whether from may move onto to, fills in the other side of a seam.
+		*/
+		bool can_collapse(Collapse& collapse) const
+		{
+			uint32_t from = collapse.from, to = collapse.to;
+			uint32_t p = mPositions[from], q = mPositions[to];
+			VertexKind target = mKinds[q];
+			switch (mKinds[p])
+			{
+				case VertexKind::MANIFOLD:
+					return true;
+				case VertexKind::BORDER:
+					return open_edge(from, to) && (target == VertexKind::BORDER || target == VertexKind::LOCKED);
+				case VertexKind::SEAM:
+				{
+					if (!open_edge(from, to) || (target != VertexKind::SEAM && target != VertexKind::LOCKED)) return false;
+					uint32_t sibling = mWedges[2 * p] == from ? mWedges[2 * p + 1] : mWedges[2 * p];
+					for (int i = 0; i < 2; i++)
+					{
+						uint32_t other = mOpenEdges[2 * sibling + i];
+						if (other != NONE && mPositions[other] == q)
+						{
+							collapse.siblingFrom = sibling;
+							collapse.siblingTo = other;
+							return true;
+						}
+					}
+					return false;
+				}
+				default:
+					return false;
+			}
+		}
+
+		/*
+		* The cheaper direction of every edge that can collapse within maxError, sorted on error.
+		*/
+		vector<Collapse> collect_collapses(float maxError) const
+		{
+			vector<Collapse> collapses;
+			collapses.reserve(mFaces.size() * 3);
+			for (const uvec3& face : mFaces)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t a = face[k], b = face[(k + 1) % 3];
+					for (int direction = 0; direction < 2; direction++)
+					{
+						Collapse collapse{ edge_key(mPositions[a], mPositions[b]), direction ? b : a, direction ? a : b };
+						if (!can_collapse(collapse)) continue;
+						collapse.error = mQuadrics[mPositions[collapse.from]].distance(point(collapse.to));
+						if (collapse.error <= maxError) collapses.push_back(collapse);
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+				return x.edge != y.edge ? x.edge < y.edge : x.error < y.error;
+			});
+			collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.edge == y.edge; }), collapses.end());
+			std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+			return collapses;
+		}
+
+		/*
+		* Does the collapses in order as long as their error is within the limit, skipping the
+		* ones whose positions already took part in a collapse of this pass and the ones that
+		* would flip a face or pinch the mesh (the two positions share more neighbors than
+		* faces). The faces are rewritten at the end.
+		* @returns the number of collapses done
+		*/
+		size_t apply_collapses(const vector<Collapse>& collapses, float limit, size_t targetFaces)
+		{
+			size_t count = mMesh.vertices.size();
+			vector<uint32_t> moved(count);
+			for (uint32_t v = 0; v < count; v++)
+				moved[v] = v;
+			vector<bool> touched(count, false);
+			size_t faceCount = mFaces.size(), done = 0;
+			vector<uint32_t> neighborsP, neighborsQ;
+
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.error > limit || faceCount <= targetFaces) break;
+				uint32_t p = mPositions[collapse.from], q = mPositions[collapse.to];
+				if (touched[p] || touched[q]) continue;
+
+				// faces around p: the ones with q disappear, the others must not flip
+				size_t removed = 0;
+				bool flips = false;
+				neighborsP.clear();
+				for (uint32_t i = mFaceOffsets[p]; i < mFaceOffsets[p + 1] && !flips; i++)
+				{
+					const uvec3& face = mFaces[mPositionFaces[i]];
+					uvec3 current(moved[face.x], moved[face.y], moved[face.z]);
+					bool hasQ = false;
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t position = mPositions[current[k]];
+						hasQ |= position == q;
+						if (position != p) neighborsP.push_back(position);
+					}
+					if (hasQ)
+					{
+						removed++;
+						continue;
+					}
+					vec3 before[3], after[3];
+					for (int k = 0; k < 3; k++)
+					{
+						before[k] = point(current[k]);
+						after[k] = mPositions[current[k]] == p ? point(collapse.to) : before[k];
+					}
+					vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+					vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+					flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+				}
+				if (flips || removed == 0) continue;
+
+				neighborsQ.clear();
+				for (uint32_t i = mFaceOffsets[q]; i < mFaceOffsets[q + 1]; i++)
+				{
+					const uvec3& face = mFaces[mPositionFaces[i]];
+					for (int k = 0; k < 3; k++)
+					{
+						uint32_t position = mPositions[moved[face[k]]];
+						if (position != q) neighborsQ.push_back(position);
+					}
+				}
+				std::sort(neighborsP.begin(), neighborsP.end());
+				neighborsP.erase(std::unique(neighborsP.begin(), neighborsP.end()), neighborsP.end());
+				std::sort(neighborsQ.begin(), neighborsQ.end());
+				neighborsQ.erase(std::unique(neighborsQ.begin(), neighborsQ.end()), neighborsQ.end());
+				size_t shared = 0;
+				for (uint32_t position : neighborsP)
+					shared += std::binary_search(neighborsQ.begin(), neighborsQ.end(), position);
+				if (shared != removed) continue;
+
+				moved[collapse.from] = collapse.to;
+				if (collapse.siblingFrom != NONE) moved[collapse.siblingFrom] = collapse.siblingTo;
+				mQuadrics[q].add(mQuadrics[p]);
+				touched[p] = touched[q] = true;
+				for (uint32_t i = mFaceOffsets[p]; i < mFaceOffsets[p + 1]; i++)
+				{
+					for (int k = 0; k < 3; k++)
+						touched[mPositions[mFaces[mPositionFaces[i]][k]]] = true; // keeps the flip tests of the neighbors valid
+				}
+				faceCount -= removed;
+				mError = std::max(mError, collapse.error);
+				done++;
+			}
+
+			vector<uvec3> faces;
+			faces.reserve(faceCount);
+			for (const uvec3& face : mFaces)
+			{
+				uvec3 current(moved[face.x], moved[face.y], moved[face.z]);
+				if (!degenerate(current)) faces.push_back(current);
+			}
+			mFaces.swap(faces);
+			return done;
+		}
+	};
+
+	void hash_bytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull; // FNV-1a
+	}
+
+	template <class T>
+	void hash_vector(uint64_t& hash, const vector<T>& values)
+	{
+		uint64_t size = values.size();
+		hash_bytes(hash, &size, sizeof(size));
+		hash_bytes(hash, values.data(), values.size() * sizeof(T));
+	}
+
+	template <class T>
+	void write_vector(std::ofstream& file, const vector<T>& values)
+	{
+		uint64_t size = values.size();
+		file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	template <class T>
+	bool read_vector(std::ifstream& file, vector<T>& values)
+	{
+		uint64_t size = 0;
+		if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size > (uint64_t(1) << 32)) return false;
+		values.resize(size);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)));
+	}
+}
+
+/*
+* Collapses edges of the mesh until it has at most targetFaces faces or no collapse is left
+* within maxError (in the units of the mesh). The mesh isn't changed, the result is a new
+* mesh with the vertices that are still used.
+*/
+ruya::MeshSimplifier::Result ruya::MeshSimplifier::simplify(const Mesh& mesh, size_t targetFaces, float maxError)
+{
+	Simplifier simplifier(mesh);
+	Result result;
+	result.error = simplifier.run(targetFaces, maxError);
+	result.mesh = simplifier.result();
+	return result;
+}
+
+/*
+* The mesh as first level followed by the simplifications of the settings. The levels are
+* simplified one after the other from the same collapses, whose quadrics still hold the
+* planes of the original faces, so the error of every level is measured against the
+* original surface.
+*/
+shared_ptr<ruya::LodChain> ruya::MeshSimplifier::build_lod_chain(const shared_ptr<Mesh>& mesh, const LodSettings& settings)
+{
+	shared_ptr<LodChain> chain = std::make_shared<LodChain>();
+	chain->levels.push_back(mesh);
+	chain->errors.push_back(0.0f);
+
+	Simplifier simplifier(*mesh);
+	float radius = mesh->bounds.radius;
+	size_t faces = mesh->faces.size();
+	for (float relativeError : settings.errors)
+	{
+		if (faces <= settings.minFaces) break;
+		float error = simplifier.run(settings.minFaces, relativeError * radius);
+		if (simplifier.face_count() > faces * settings.minReduction) continue;
+
+		shared_ptr<Mesh> level = simplifier.result();
+		MeshOptimizer::optimize(*level);
+		chain->levels.push_back(level);
+		chain->errors.push_back(error);
+		faces = level->faces.size();
+	}
+	return chain;
+}
+
+/*
+* LOD chains of the meshes, built on the given number of threads (0: one per core). A mesh
+* that is in the list more than once is simplified once. With a cache directory the chains
+* are loaded from it if they were built before (for the same mesh and settings) and saved to
+* it otherwise.
+*/
+vector<shared_ptr<ruya::LodChain>> ruya::MeshSimplifier::build_lod_chains(const vector<shared_ptr<Mesh>>& meshes, const LodSettings& settings,
+	const string& cacheDir, unsigned int threads)
+{
+	vector<shared_ptr<LodChain>> chains(meshes.size());
+	std::unordered_map<const Mesh*, size_t> firstOf;
+	vector<size_t> jobs;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] && firstOf.try_emplace(meshes[i].get(), i).second)
+			jobs.push_back(i);
+	}
+
+	if (!cacheDir.empty())
+	{
+		std::error_code error;
+		fs::create_directories(cacheDir, error);
+	}
+
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t job = next++; job < jobs.size(); job = next++)
+		{
+			const shared_ptr<Mesh>& mesh = meshes[jobs[job]];
+			string path;
+			if (!cacheDir.empty())
+			{
+				char name[32];
+				std::snprintf(name, sizeof(name), "%016llx.lod", static_cast<unsigned long long>(hash(*mesh, settings)));
+				path = (fs::path(cacheDir) / name).string();
+				if (shared_ptr<LodChain> chain = load_lod_chain(mesh, path))
+				{
+					chains[jobs[job]] = chain;
+					continue;
+				}
+			}
+			chains[jobs[job]] = build_lod_chain(mesh, settings);
+			if (!path.empty()) save_lod_chain(*chains[jobs[job]], path);
+		}
+	};
+
+	if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+	vector<std::thread> workers;
+	for (size_t t = 1; t < std::min<size_t>(threads, jobs.size()); t++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i] && !chains[i]) chains[i] = chains[firstOf[meshes[i].get()]];
+	}
+	return chains;
+}
+
+/*
+* Hash of everything the LOD chain of the mesh depends on, names its cache file.
+*/
+uint64_t ruya::MeshSimplifier::hash(const Mesh& mesh, const LodSettings& settings)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash_bytes(hash, &CACHE_VERSION, sizeof(CACHE_VERSION));
+	hash_vector(hash, mesh.vertices);
+	hash_vector(hash, mesh.normals);
+	hash_vector(hash, mesh.textureCoordinates);
+	hash_vector(hash, mesh.faces);
+	hash_vector(hash, settings.errors);
+	hash_bytes(hash, &settings.minReduction, sizeof(settings.minReduction));
+	uint64_t minFaces = settings.minFaces;
+	hash_bytes(hash, &minFaces, sizeof(minFaces));
+	return hash;
+}
+
+/*
+* Writes the levels after the first (the original mesh isn't stored) with their errors.
+* @returns false if the file couldn't be written
+*/
+bool ruya::MeshSimplifier::save_lod_chain(const LodChain& chain, const string& path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	uint32_t header[3] = { CACHE_MAGIC, CACHE_VERSION, static_cast<uint32_t>(chain.size()) };
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	for (size_t level = 1; level < chain.size(); level++)
+	{
+		const Mesh& mesh = *chain.levels[level];
+		file.write(reinterpret_cast<const char*>(&chain.errors[level]), sizeof(float));
+		write_vector(file, mesh.vertices);
+		write_vector(file, mesh.normals);
+		write_vector(file, mesh.textureCoordinates);
+		write_vector(file, mesh.faces);
+		write_vector(file, mesh.meshlets);
+	}
+	return static_cast<bool>(file);
+}
+
+/*
+* Reads a chain written by save_lod_chain(), mesh becomes its first level.
+* @returns nullptr if the file doesn't exist or isn't a chain of this version
+*/
+shared_ptr<ruya::LodChain> ruya::MeshSimplifier::load_lod_chain(const shared_ptr<Mesh>& mesh, const string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	uint32_t header[3] = {};
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION || header[2] == 0)
+		return nullptr;
+
+	shared_ptr<LodChain> chain = std::make_shared<LodChain>();
+	chain->levels.push_back(mesh);
+	chain->errors.push_back(0.0f);
+	for (uint32_t level = 1; level < header[2]; level++)
+	{
+		shared_ptr<Mesh> levelMesh = std::make_shared<Mesh>();
+		float error = 0.0f;
+		if (!file.read(reinterpret_cast<char*>(&error), sizeof(error)) || !read_vector(file, levelMesh->vertices) || !read_vector(file, levelMesh->normals)
+			|| !read_vector(file, levelMesh->textureCoordinates) || !read_vector(file, levelMesh->faces) || !read_vector(file, levelMesh->meshlets))
+			return nullptr;
+		levelMesh->update_bounds();
+		levelMesh->optimized = true; // saved after MeshOptimizer::optimize()
+		chain->levels.push_back(levelMesh);
+		chain->errors.push_back(error);
+	}
+	return chain;
+}
@@ -0,0 +1,75 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/scene/mesh.h"
+#include "engine/scene/lod_chain.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* How MeshSimplifier::build_lod_chain() makes the levels after the original mesh: one
+	* simplification per error limit, levels that don't drop enough faces compared to the
+	* previous one are skipped. The meshes are optimized (see MeshOptimizer).
+	*/
+	struct LodSettings
+	{
+		vector<float> errors = { 0.0025f, 0.005f, 0.01f, 0.02f, 0.04f, 0.08f }; // relative to the bounding radius of the mesh
+		float minReduction = 0.75f; // a level has at most this fraction of the faces of the previous one
+		size_t minFaces = 16; // levels are never simplified below this
+	};
+
+	/*
+	* Simplifies meshes with edge collapses in the order of their quadric error (Garland and
+	* Heckbert 1997) and builds LodChains out of them.
+	*	- half-edge collapses: a vertex moves onto one of its neighbors, which keeps its
+	*	  position, normal and texture coordinates, so no attribute is ever interpolated
+	*	- vertices that share a position but not their normal or texture coordinates (UV and
+	*	  normal seams) only move along their seam, the vertices on both sides together, so
+	*	  that the seam stays closed. Vertices on open borders only move along the border.
+	*	  Vertices where seams or borders meet or branch, and those of non-manifold edges,
+	*	  never move
+	*	- the error of a collapse is the RMS distance (area weighted) of the new position to
+	*	  the planes of the original faces around the vertex, borders and seams add planes
+	*	  perpendicular to their faces so that they keep their shape. Collapses that flip a
+	*	  face are rejected
+	*	- the collapses are done in passes, each pass does the cheapest ones whose vertices
+	*	  haven't moved yet in the pass, until the face target or the error limit is reached
+	*
+	* build_lod_chains() simplifies a list of meshes on all cores and caches the chains on
+	* disk, keyed by a hash of the mesh and the settings.
+	*/
+	class MeshSimplifier
+	{
+	public:
+		/*
+		* Result of simplify(), error is the largest error of the collapses that were done (in
+		* the units of the mesh).
+		*/
+		struct Result
+		{
+			shared_ptr<Mesh> mesh;
+			float error = 0.0f;
+		};
+
+		static Result simplify(const Mesh& mesh, size_t targetFaces, float maxError);
+		static shared_ptr<LodChain> build_lod_chain(const shared_ptr<Mesh>& mesh, const LodSettings& settings = LodSettings());
+		static vector<shared_ptr<LodChain>> build_lod_chains(const vector<shared_ptr<Mesh>>& meshes, const LodSettings& settings = LodSettings(),
+			const string& cacheDir = "", unsigned int threads = 0);
+
+		static uint64_t hash(const Mesh& mesh, const LodSettings& settings);
+		static bool save_lod_chain(const LodChain& chain, const string& path);
+		static shared_ptr<LodChain> load_lod_chain(const shared_ptr<Mesh>& mesh, const string& path);
+	};
+}
+
+#endif // !MESH_SIMPLIFIER_H
@@ -1,5 +1,6 @@
 #include "cube.h"
 #include "engine/scene/mesh.h"
+#include "engine/scene/mesh_optimizer.h"
 #include "engine/scene/texture.h"
 #include <memory>
 
@@ -156,5 +157,7 @@ std::shared_ptr<Mesh> Cube::init_mesh()
 
 
 
+	mesh->update_bounds();
+	ruya::MeshOptimizer::optimize(*mesh);
 	return mesh;
 }
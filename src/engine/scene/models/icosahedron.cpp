@@ -1,5 +1,6 @@
 #include "icosahedron.h"
 #include "engine/scene/mesh.h"
+#include "engine/scene/mesh_optimizer.h"
 #include <memory>
 #include <vector>
 #include <limits>
@@ -113,7 +114,13 @@ namespace
 }
 
 
-std::shared_ptr<Mesh> Icosahedron::mMesh = create_icosahedron_mesh();
+// optimized here, Icosphere::init_mesh() subdivides the mesh as created
+std::shared_ptr<Mesh> Icosahedron::mMesh = []()
+{
+	std::shared_ptr<Mesh> mesh = create_icosahedron_mesh();
+	ruya::MeshOptimizer::optimize(*mesh);
+	return mesh;
+}();
 
 Icosahedron::Icosahedron()
 {
@@ -239,5 +246,6 @@ std::shared_ptr<Mesh> Icosahedron::create_icosahedron_mesh()
 		mesh->normals[i] /= 5;
 	}
 
+	mesh->update_bounds();
 	return mesh;
 }
@@ -2,8 +2,10 @@
 #define ICOSPHERE_H
 
 #include "engine/scene/object.h"
+#include "engine/scene/mesh_optimizer.h"
 #include "engine/scene/models/icosahedron.h"
 #include <unordered_map>
+#include <stdexcept>
 
 
 using std::unordered_map;
@@ -31,25 +33,45 @@ namespace ruya::models
 	public:
 		Icosphere(int level_of_detail = 5)
 		{
-			if (level_of_detail >= mMeshes.size())
-			{
-				mMeshes.resize(level_of_detail + 1);
-			}
-
-			if (!mMeshes[level_of_detail])
-			{
-				mMeshes[level_of_detail] = init_mesh(level_of_detail);
-			}
-
-			set_mesh(mMeshes[level_of_detail]);
+			set_mesh(mesh_of_level(level_of_detail));
 		}
 
 		~Icosphere(){}
 
-	private:
-		static std::shared_ptr<Mesh> mMesh;
-		static std::vector<std::shared_ptr<Mesh>> mMeshes;
+		/*
+		* The sphere meshes from level maxLevel down to 0 (the icosahedron) as a LodChain, the 
+		* same chain is returned on every call with the same maxLevel. The error of a level is
+		* how far its flat faces sink below the unit sphere, each level roughly quarters it.
+		* @throws std::runtime_error if maxLevel is negative
+		*/
+		static shared_ptr<LodChain> lod_chain(int maxLevel = 5)
+		{
+			if (maxLevel < 0)
+				throw std::runtime_error("[Icosphere] negative level of detail for the LOD chain");
+			if (static_cast<size_t>(maxLevel) >= mLodChains.size())
+				mLodChains.resize(maxLevel + 1);
 
+			if (!mLodChains[maxLevel])
+			{
+				shared_ptr<LodChain> chain = std::make_shared<LodChain>();
+				for (int level = maxLevel; level >= 0; level--)
+				{
+					shared_ptr<Mesh> mesh = mesh_of_level(level);
+					float error = 0.0f;
+					for (const uvec3& face : mesh->faces)
+					{
+						const vec3& v0 = mesh->vertices[face[0]];
+						vec3 normal = glm::cross(mesh->vertices[face[1]] - v0, mesh->vertices[face[2]] - v0);
+						if (glm::length(normal) > 0.0f)
+							error = std::max(error, 1.0f - std::abs(glm::dot(glm::normalize(normal), v0))); // distance of the face's plane to the sphere
+					}
+					chain->levels.push_back(mesh);
+					chain->errors.push_back(error);
+				}
+				mLodChains[maxLevel] = chain;
+			}
+			return mLodChains[maxLevel];
+		}
 
 		/*
 		* Basically: 
@@ -59,6 +81,8 @@ namespace ruya::models
 		*		to make the result more spherish.
 		* 
 		*		Repeat this a couple times to get more detail
+		*
+		*		The mesh isn't optimized (see MeshOptimizer), the spheres of mesh_of_level() are.
 		*/
 		static std::shared_ptr<Mesh> init_mesh(int levelOfDetail = 5)
 		{
@@ -160,14 +184,36 @@ namespace ruya::models
 			for (int i = 0; i < icoMesh->normals.size(); i++)
 				icoMesh->normals[i] /= useCounts[i];
 
+			icoMesh->update_bounds();
 			return icoMesh;
 		}
+
+	private:
+		static std::shared_ptr<Mesh> mMesh;
+		static std::vector<std::shared_ptr<Mesh>> mMeshes;
+		static std::vector<std::shared_ptr<LodChain>> mLodChains;
+
+		static shared_ptr<Mesh> mesh_of_level(int levelOfDetail)
+		{
+			if (levelOfDetail >= mMeshes.size())
+			{
+				mMeshes.resize(levelOfDetail + 1);
+			}
+
+			if (!mMeshes[levelOfDetail])
+			{
+				mMeshes[levelOfDetail] = init_mesh(levelOfDetail);
+				MeshOptimizer::optimize(*mMeshes[levelOfDetail]);
+			}
+			return mMeshes[levelOfDetail];
+		}
 	};
 
 	// init static vars
 	//std::shared_ptr<Mesh> ruya::Icosphere::mMesh = init_mesh();
 	std::shared_ptr<Mesh> Icosphere::mMesh;
 	vector<std::shared_ptr<Mesh>> Icosphere::mMeshes(10);
+	vector<std::shared_ptr<LodChain>> Icosphere::mLodChains;
 
 }
 
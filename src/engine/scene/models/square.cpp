@@ -2,6 +2,7 @@
 #include <memory>
 #include <engine/scene/texture.h>
 #include "engine/scene/mesh.h"
+#include "engine/scene/mesh_optimizer.h"
 
 using ruya::Texture;
 using ruya::Mesh;
@@ -44,5 +45,7 @@ std::shared_ptr<Mesh> Square::init_square_mesh()
 		uvec3(1, 2, 3)    // second triangle
 	};
 
+	mesh->update_bounds();
+	ruya::MeshOptimizer::optimize(*mesh);
 	return mesh;
 }
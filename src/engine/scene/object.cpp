@@ -1,83 +1,70 @@
 #include "object.h"
-#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
 
 
 ruya::Object::Object()
-    : mPosition(0.0f), mRotation(0.0f), mScale(1.0f), mColor(0.99f), mMesh(nullptr), mTexture(nullptr), mParent(nullptr), mMaterial(Materials::silver)
+    : mPosition(0.0f), mRotation(0.0f), mScale(1.0f), mColor(0.99f), mMesh(nullptr), mTexture(nullptr), mLodLevel(0), mParent(nullptr), mMaterial(Materials::silver)
 {
 }
 
 ruya::Object::~Object()
 {
-    
+    for (const ObserverLinks::Link& link : mObservers.links)
+        link.observer->object_destroyed(link.index);
 }
 
-
 /*
-* Get the model matrix that defines the transformation (scaling, rotation 
-* and translation) of this object.
+* Registers an observer that is notified of changes and of the destruction of this object.
+* The observer has to remove itself (or outlive the object).
 */
-mat4 ruya::Object::model_matrix()
+void ruya::Object::add_observer(ObjectObserver* observer, uint32_t index)
 {
-    mat4 scalingMatrix(1.0f);
-    mat4 rotationMatrix(1.0f);
-    mat4 translationMatrix(1.0f);
-
-    scalingMatrix = glm::scale(scalingMatrix, mScale);
-
-    // rotate around custom axis
-    //if (mRotation.x != 0 || mRotation.y != 0 || mRotation.z != 0)
-    //    rotationMatrix = glm::rotate(rotationMatrix, glm::radians(mRotation.w), glm::vec3(mRotation.x, mRotation.y, mRotation.z));
-
-    // rotate separately around each axis
-    if (mRotation.x != 0)   rotationMatrix = glm::rotate(rotationMatrix, glm::radians(mRotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-    if (mRotation.y != 0)   rotationMatrix = glm::rotate(rotationMatrix, glm::radians(mRotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    if (mRotation.z != 0)   rotationMatrix = glm::rotate(rotationMatrix, glm::radians(mRotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    for (ObserverLinks::Link& link : mObservers.links)
+    {
+        if (link.observer == observer)
+        {
+            link.index = index;
+            return;
+        }
+    }
+    mObservers.links.push_back(ObserverLinks::Link{ observer, index });
+}
 
-    translationMatrix = glm::translate(translationMatrix, mPosition);
+void ruya::Object::remove_observer(ObjectObserver* observer)
+{
+    std::erase_if(mObservers.links, [observer](const ObserverLinks::Link& link) { return link.observer == observer; });
+}
 
-    return translationMatrix * rotationMatrix * scalingMatrix;
+bool ruya::Object::has_observer(const ObjectObserver* observer) const
+{
+    return std::any_of(mObservers.links.begin(), mObservers.links.end(), [observer](const ObserverLinks::Link& link) { return link.observer == observer; });
 }
 
+
 /*
-* The inverse of the model matrix. 
-*
-* Translation is disregarded, the inverse of Scale * Rotation is returned. 
-* Rotation and uniform scaling is orthonormal so the inverse of the model 
-* matrix is just its transpose. 
-* 
-* If the scaling is non-uniform (different amount for x, y and/or z axis, then
-* the inverse has to be calculated the normal way.
+* Passes the rotation to the TransformSystem as a quaternion: the rotations around x, y and
+* z in this order, applied to the object from right to left (z first).
 */
-mat4 ruya::Object::inverse_model_matrix()
+void ruya::Object::rotation_changed()
 {
-    return model_matrix_and_inverse().second;
+    glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    if (mRotation.x != 0)   rotation = rotation * glm::angleAxis(glm::radians(mRotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    if (mRotation.y != 0)   rotation = rotation * glm::angleAxis(glm::radians(mRotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    if (mRotation.z != 0)   rotation = rotation * glm::angleAxis(glm::radians(mRotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    TransformSystem::set_rotation(mTransform.slot, rotation);
+    changed();
 }
 
-std::pair<mat4, mat4> ruya::Object::model_matrix_and_inverse()
+ruya::Object::TransformSlot& ruya::Object::TransformSlot::operator=(const TransformSlot& other)
 {
-    std::pair<mat4, mat4> model_invModel;
-    float d1 = abs(mScale.x - mScale.y);
-    float d2 = abs(mScale.y - mScale.z);
-    float d3 = abs(mScale.x - mScale.z);
-
-    model_invModel.first = model_matrix();
-
-    float thresh = 0.001;
-    if (d1 > thresh || d2 > thresh || d3 > thresh)
-        model_invModel.second = glm::inverse(model_invModel.first);
-    else
+    if (this != &other)
     {
-        //model_invModel.second =  mat4(glm::transpose(glm::mat3(model_invModel.first)));
-        //model_invModel.second[3][0] = -mPosition[0];
-        //model_invModel.second[3][1] = -mPosition[1];
-        //model_invModel.second[3][2] = -mPosition[2];
-        //model_invModel.second[3][3] = 1.0f;
-        model_invModel.second = glm::inverse(model_invModel.first);
-        //TODO: optimize calculation of the inverse 
+        uint32_t copy = TransformSystem::allocate(other.slot);
+        TransformSystem::free(slot);
+        slot = copy;
     }
-
-    return model_invModel;
+    return *this;
 }
 
 /*
@@ -89,6 +76,7 @@ void ruya::Object::rotate(float xDegrees, float yDegrees, float zDegrees)
     mRotation.x = fmod(mRotation.x + xDegrees, 360);
     mRotation.y = fmod(mRotation.y + yDegrees, 360);
     mRotation.z = fmod(mRotation.z + zDegrees, 360);
+    rotation_changed();
 }
 
 /*
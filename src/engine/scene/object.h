@@ -9,6 +9,8 @@
 #include "engine/scene/mesh.h"
 #include "engine/scene/texture.h"
 #include "engine/scene/material.h"
+#include "engine/scene/lod_chain.h"
+#include "engine/scene/transform_system.h"
 
 using glm::vec4;
 using glm::vec3;
@@ -19,6 +21,21 @@ using std::shared_ptr;
 
 namespace ruya
 {
+	class Object;
+
+	/*
+	* Gets notified when an object that it observes changes, so that it doesn't have to check
+	* every object every frame (e.g. GPU copies of the objects, the scene BVH). See
+	* Object::add_observer().
+	*/
+	class ObjectObserver
+	{
+	public:
+		virtual ~ObjectObserver() = default;
+		virtual void object_changed(Object& obj, uint32_t index) = 0; // transform, color, material, mesh, ...
+		virtual void object_destroyed(uint32_t index) = 0;
+	};
+
 	/*
 	* The Object class is for representing objects that are
 	* going to be rendered on the scene. Each instance of 
@@ -47,41 +64,53 @@ namespace ruya
 	*			  to be done, you can expect errors to happen. shared_ptr is the
 	*			  safe variant in this case but comes with additional overhead.
 	*		
+	*
+	* The transform lives in a slot of the TransformSystem, which caches the model matrix and
+	* its inverse: they are only recomputed after the object moved.
 	*/
 	class Object
 	{
 	public:
 		// CONSTRUCTORS & DESTRUCTOR
 		Object();
-		~Object();
+		virtual ~Object();
 
 		// GETTERS & QUERIES
 		shared_ptr<Mesh> mesh() { return mMesh; }
 		shared_ptr<Texture> texture() { return mTexture; }
-		mat4 model_matrix();
-		mat4 inverse_model_matrix();
-		std::pair<mat4, mat4> model_matrix_and_inverse(); // first model, second inverse model
+		shared_ptr<LodChain> lod_chain() { return mLodChain; }
+		uint32_t lod_level() const { return mLodLevel; } // level of the LodChain the object was last drawn with
+		const mat4& model_matrix() const { return TransformSystem::world(mTransform.slot); } // valid until the next object is created
+		const mat4& inverse_model_matrix() const { return TransformSystem::inverse(mTransform.slot); }
+		std::pair<mat4, mat4> model_matrix_and_inverse() const { return { model_matrix(), inverse_model_matrix() }; } // first model, second inverse model
 		vec3 color() const		{ return mColor; }
 		vec3 position() const	{ return mPosition; }
 		vec3 scale() const		{ return mScale; }
-		Material& material()	{ return mMaterial; }
+		Material& material()	{ return mMaterial; } // changes made through this reference don't notify the observer, use set_material()
 
 		// MANIPULATORS
-		inline void set_mesh(const shared_ptr<Mesh>& mesh) { mMesh = mesh; }
-		inline void set_texture(const shared_ptr<Texture>& texture) { mTexture = texture; }
-		void set_position(const glm::vec3& position) { mPosition = position; }
-		void set_position(float x, float y, float z) { mPosition.x = x; mPosition.y = y; mPosition.z = z; }
-		void set_scale(const glm::vec3& scale) { mScale = scale; }
-		void set_scale(float scale) { mScale.x = scale, mScale.y = scale, mScale.z = scale; }
-		void set_color(const glm::vec3& color) { mColor = color; }
-		void set_color(float r, float g, float b) { mColor.r = r; mColor.g = g; mColor.b = b; }
-		void set_rotation(const glm::vec3& rotation) { mRotation = rotation; } // resets rotation to given amount per axis
-		void set_material(const Material& material) { mMaterial = material; }
+		inline void set_mesh(const shared_ptr<Mesh>& mesh) { mMesh = mesh; changed(); }
+		inline void set_texture(const shared_ptr<Texture>& texture) { mTexture = texture; changed(); }
+		void set_lod_chain(const shared_ptr<LodChain>& lodChain) { mLodChain = lodChain; mLodLevel = 0; changed(); } // nullptr: always use mesh()
+		void set_lod_level(uint32_t level) { mLodLevel = level; } // set by the renderer, doesn't notify the observers
+		void set_position(const glm::vec3& position) { mPosition = position; position_changed(); }
+		void set_position(float x, float y, float z) { mPosition.x = x; mPosition.y = y; mPosition.z = z; position_changed(); }
+		void set_scale(const glm::vec3& scale) { mScale = scale; scale_changed(); }
+		void set_scale(float scale) { mScale.x = scale, mScale.y = scale, mScale.z = scale; scale_changed(); }
+		void set_color(const glm::vec3& color) { mColor = color; changed(); }
+		void set_color(float r, float g, float b) { mColor.r = r; mColor.g = g; mColor.b = b; changed(); }
+		void set_rotation(const glm::vec3& rotation) { mRotation = rotation; rotation_changed(); } // resets rotation to given amount per axis
+		void set_material(const Material& material) { mMaterial = material; changed(); }
 
 		void rotate(float x, float y, float z);
-		void rotate_x(float degrees) { mRotation.x = fmod(mRotation.x + degrees, 360); } // idem rotate() but on 1 axis
-		void rotate_y(float degrees) { mRotation.y = fmod(mRotation.y + degrees, 360); } 
-		void rotate_z(float degrees) { mRotation.z = fmod(mRotation.z + degrees, 360); }
+		void rotate_x(float degrees) { mRotation.x = fmod(mRotation.x + degrees, 360); rotation_changed(); } // idem rotate() but on 1 axis
+		void rotate_y(float degrees) { mRotation.y = fmod(mRotation.y + degrees, 360); rotation_changed(); } 
+		void rotate_z(float degrees) { mRotation.z = fmod(mRotation.z + degrees, 360); rotation_changed(); }
+
+		// index is passed back to the observer in its notifications, adding an observer twice updates its index
+		void add_observer(ObjectObserver* observer, uint32_t index = 0);
+		void remove_observer(ObjectObserver* observer);
+		bool has_observer(const ObjectObserver* observer) const;
 
 		void add_child(Object* obj);
 		bool remove_child(Object& obj);
@@ -91,17 +120,54 @@ namespace ruya
 
 	protected:
 		vec3 mPosition; // position relative to parent or world coordinates.
-		vec3 mRotation;
+		vec3 mRotation; // degrees around x, then y, then z
 		vec3 mScale;
 		vec3 mColor;
 		shared_ptr<Mesh> mMesh; // vertices, faces, texture coords
 		shared_ptr<Texture> mTexture; // vertices, faces, texture coords
+		shared_ptr<LodChain> mLodChain;
+		uint32_t mLodLevel; // hysteresis state of the LOD selection, see LodChain::select_level()
 		Material mMaterial;
 
+		void changed() { for (const ObserverLinks::Link& link : mObservers.links) link.observer->object_changed(*this, link.index); }
+		void position_changed() { TransformSystem::set_position(mTransform.slot, mPosition); changed(); }
+		void scale_changed() { TransformSystem::set_scale(mTransform.slot, mScale); changed(); }
+		void rotation_changed();
+
 	private:
+		/*
+		* The observers are not copied along with the object, a copy is a new object that isn't
+		* being observed.
+		*/
+		struct ObserverLinks
+		{
+			struct Link { ObjectObserver* observer; uint32_t index; };
+			std::vector<Link> links; // usually 0-2 observers
+
+			ObserverLinks() = default;
+			ObserverLinks(const ObserverLinks&) {}
+			ObserverLinks& operator=(const ObserverLinks&) { return *this; }
+		};
+
+		/*
+		* Slot of the object in the TransformSystem, a copy of the object gets its own slot with
+		* the same transform.
+		*/
+		struct TransformSlot
+		{
+			uint32_t slot;
+
+			TransformSlot() : slot(TransformSystem::allocate()) {}
+			TransformSlot(const TransformSlot& other) : slot(TransformSystem::allocate(other.slot)) {}
+			TransformSlot& operator=(const TransformSlot& other);
+			~TransformSlot() { TransformSystem::free(slot); }
+		};
+
+		TransformSlot mTransform;
 		Object* mParent;
 		list<Object*> mChildren;
 		UUID mUUID;
+		ObserverLinks mObservers;
 
 		// private helper functions
 		void dislodge_from_parent();
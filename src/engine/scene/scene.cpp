@@ -1,6 +1,6 @@
 #include "scene.h"
 
-ruya::Scene::Scene()
+ruya::Scene::Scene() : mBvhRebuild(false)
 {
 }
 
@@ -8,6 +8,7 @@ ruya::Scene::~Scene()
 {
 	for (auto i = mObjects.begin(); i != mObjects.end(); i++)
 	{
+		(*i)->remove_observer(this);
 		delete *i;
 	}
 
@@ -24,6 +25,11 @@ ruya::Scene::~Scene()
 void ruya::Scene::add_object(Object* obj)
 {
 	mObjects.push_back(obj);
+
+	obj->add_observer(this, static_cast<uint32_t>(mIndexedObjects.size()));
+	mIndexedObjects.push_back(obj);
+	mObjectChanged.push_back(0);
+	mBvhRebuild = true;
 }
 
 void ruya::Scene::add_light(LightSource* light)
@@ -31,3 +37,196 @@ void ruya::Scene::add_light(LightSource* light)
 	mLightSources.push_back(light);
 }
 
+void ruya::Scene::object_changed(Object& obj, uint32_t index)
+{
+	if (mObjectChanged[index]) return;
+	mObjectChanged[index] = 1;
+	mChangedObjects.push_back(index);
+}
+
+void ruya::Scene::object_destroyed(uint32_t index)
+{
+	mIndexedObjects[index] = nullptr;
+	mBvhRebuild = true;
+}
+
+/*
+* Brings the BVH up to date with the objects: refits it for the objects that changed since
+* the last update, or rebuilds it.
+*/
+void ruya::Scene::update_bvh()
+{
+	if (!mBvhRebuild)
+	{
+		for (uint32_t index : mChangedObjects)
+		{
+			if (mIndexedObjects[index])
+				mBvh.update(index, world_bounds(*mIndexedObjects[index]));
+		}
+		mBvh.refit();
+		mBvhRebuild = mBvh.needs_rebuild();
+	}
+
+	if (mBvhRebuild)
+	{
+		vector<Aabb> bounds(mIndexedObjects.size());
+		for (size_t i = 0; i < mIndexedObjects.size(); i++)
+		{
+			if (mIndexedObjects[i])
+				bounds[i] = world_bounds(*mIndexedObjects[i]);
+		}
+		mBvh.build(bounds);
+		mBvhRebuild = false;
+	}
+
+	for (uint32_t index : mChangedObjects)
+		mObjectChanged[index] = 0;
+	mChangedObjects.clear();
+}
+
+/*
+* Finds the nearest object hit by the ray origin + t * direction, t in [0, maxDistance].
+* @param exact: true to intersect the triangles of the meshes, false to stop at the
+*				bounding boxes of the objects (faster, for coarse picking)
+* @returns false if nothing was hit, hit is left unchanged then
+*/
+bool ruya::Scene::raycast(const glm::vec3& origin, const glm::vec3& direction, RaycastHit& hit, float maxDistance, bool exact)
+{
+	update_bvh();
+
+	RaycastHit nearest;
+	nearest.distance = maxDistance;
+	mBvh.raycast(origin, direction, maxDistance, [&](uint32_t item, float boxDistance) {
+		Object& obj = *mIndexedObjects[item];
+		int triangle = -1;
+		float distance = exact ? raycast_triangles(obj, origin, direction, nearest.distance, triangle) : boxDistance;
+		if (distance < 0.0f || distance >= nearest.distance) return -1.0f;
+
+		nearest.object = &obj;
+		nearest.distance = distance;
+		nearest.triangle = triangle;
+		return distance;
+	});
+
+	if (!nearest.object) return false;
+	nearest.point = origin + nearest.distance * direction;
+	hit = nearest;
+	return true;
+}
+
+/*
+* Appends the objects whose bounding box intersects the box.
+*/
+void ruya::Scene::query_aabb(const Aabb& box, vector<Object*>& objects)
+{
+	update_bvh();
+	mBvh.query_aabb(box, [&](uint32_t item) { objects.push_back(mIndexedObjects[item]); });
+}
+
+/*
+* Appends the objects whose bounding box intersects the sphere.
+*/
+void ruya::Scene::query_sphere(const glm::vec3& center, float radius, vector<Object*>& objects)
+{
+	update_bvh();
+	mBvh.query_sphere(center, radius, [&](uint32_t item) { objects.push_back(mIndexedObjects[item]); });
+}
+
+/*
+* World space bounding box of the object's mesh, empty for objects without mesh.
+*/
+ruya::Aabb ruya::Scene::world_bounds(Object& obj)
+{
+	if (!obj.mesh()) return Aabb();
+	return Aabb::transformed(obj.mesh()->bounds, obj.model_matrix());
+}
+
+/*
+* Intersects the ray with the triangles of the object's mesh (Moller-Trumbore), in the
+* local space of the object so that the mesh BVH can be shared by all objects using the mesh.
+* An affine transform keeps the ray parameter t, so the distance needs no conversion.
+* @returns the distance of the nearest hit closer than maxDistance or -1
+*/
+float ruya::Scene::raycast_triangles(Object& obj, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, int& triangle)
+{
+	shared_ptr<Mesh> mesh = obj.mesh();
+	if (!mesh || mesh->faces.empty()) return -1.0f;
+
+	glm::mat4 inverseModel = obj.inverse_model_matrix();
+	glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::vec3(inverseModel * glm::vec4(direction, 0.0f));
+
+	float nearest = -1.0f;
+	mesh_bvh(mesh).raycast(localOrigin, localDirection, maxDistance, [&](uint32_t face, float) {
+		const uvec3& f = mesh->faces[face];
+		glm::vec3 v0 = mesh->vertices[f[0]], v1 = mesh->vertices[f[1]], v2 = mesh->vertices[f[2]];
+		glm::vec3 edge1 = v1 - v0, edge2 = v2 - v0;
+		glm::vec3 p = glm::cross(localDirection, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (std::abs(determinant) < 1e-12f) return -1.0f; // parallel to the triangle
+
+		float inverseDeterminant = 1.0f / determinant;
+		glm::vec3 s = localOrigin - v0;
+		float u = glm::dot(s, p) * inverseDeterminant;
+		if (u < 0.0f || u > 1.0f) return -1.0f;
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(localDirection, q) * inverseDeterminant;
+		if (v < 0.0f || u + v > 1.0f) return -1.0f;
+
+		// the BVH visits the faces by the distance to their box, not to the face itself
+		float t = glm::dot(edge2, q) * inverseDeterminant;
+		if (t < 0.0f || t > maxDistance || (nearest >= 0.0f && t >= nearest)) return -1.0f;
+		nearest = t;
+		triangle = static_cast<int>(face);
+		return t;
+	});
+	return nearest;
+}
+
+/*
+* BVH over the triangles of the mesh, item i is face i. The BVH is rebuilt when the mesh's
+* faces or vertices were replaced, BVHs of meshes that no longer exist are dropped whenever
+* a new one is built. See mesh_changed() for meshes changed in place.
+*/
+const ruya::Bvh& ruya::Scene::mesh_bvh(const shared_ptr<Mesh>& mesh)
+{
+	auto [it, inserted] = mMeshBvhs.try_emplace(mesh.get());
+	MeshBvh& entry = it->second;
+	if (!inserted && entry.mesh.lock() == mesh && entry.faces == mesh->faces.data() && entry.faceCount == mesh->faces.size()
+		&& entry.vertices == mesh->vertices.data() && entry.vertexCount == mesh->vertices.size())
+		return entry.bvh;
+
+	if (inserted)
+	{
+		for (auto expired = mMeshBvhs.begin(); expired != mMeshBvhs.end();)
+		{
+			if (expired->second.mesh.expired() && expired != it) expired = mMeshBvhs.erase(expired);
+			else expired++;
+		}
+	}
+	entry.mesh = mesh;
+	entry.faces = mesh->faces.data();
+	entry.faceCount = mesh->faces.size();
+	entry.vertices = mesh->vertices.data();
+	entry.vertexCount = mesh->vertices.size();
+	{
+		vector<Aabb> triangleBounds(mesh->faces.size());
+		for (size_t i = 0; i < mesh->faces.size(); i++)
+		{
+			const uvec3& face = mesh->faces[i];
+			for (int corner = 0; corner < 3; corner++)
+				triangleBounds[i].grow(mesh->vertices[face[corner]]);
+		}
+		entry.bvh.build(triangleBounds);
+	}
+	return entry.bvh;
+}
+
+/*
+* Drops the triangle BVH of the mesh, for meshes whose vertices or faces were changed in
+* place. The next exact raycast that hits an object using the mesh builds it again.
+*/
+void ruya::Scene::mesh_changed(const Mesh& mesh)
+{
+	mMeshBvhs.erase(&mesh);
+}
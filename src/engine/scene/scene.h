@@ -1,22 +1,48 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <limits>
 #include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include "engine/scene/object.h"
 #include "engine/scene/light_source.h"
+#include "engine/scene/aabb.h"
+#include "engine/scene/bvh.h"
 
 using std::list;
+using std::vector;
 
 namespace ruya
 {
+	/*
+	* Result of Scene::raycast().
+	*/
+	struct RaycastHit
+	{
+		Object* object = nullptr;
+		float distance = 0.0f; // along the ray, in units of the ray direction
+		glm::vec3 point = glm::vec3(0.0f); // world space
+		int triangle = -1; // face index in the object's mesh, -1 for hits with the bounding box
+	};
+
 	/*
 	* Represents the to-be-rendered scene.
+	*
+	* The world space bounding boxes of the objects are kept in a BVH for picking and spatial
+	* queries. The scene observes its objects: a moved object only refits its path in the tree,
+	* the tree is rebuilt when objects were added or destroyed or when refitting degraded it too
+	* much (see Bvh::needs_rebuild()). The tree is brought up to date by the queries (or 
+	* update_bvh()), not by every change.
 	*/
-	class Scene
+	class Scene : public ObjectObserver
 	{
 	public:
 		Scene();
 		~Scene();
+		Scene(const Scene&) = delete;
+		Scene& operator=(const Scene&) = delete;
 
 		list<Object*>& get_scene_objects() { return mObjects; }
 		list<LightSource*>& get_light_sources() { return mLightSources; }
@@ -24,10 +50,51 @@ namespace ruya
 		void add_light(LightSource* light);
 		//bool remove_object(Object* obj); // TODO: is this necessary?
 
+		// SPATIAL QUERIES
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, RaycastHit& hit,
+					 float maxDistance = std::numeric_limits<float>::max(), bool exact = true);
+		void query_aabb(const Aabb& box, vector<Object*>& objects);
+		void query_sphere(const glm::vec3& center, float radius, vector<Object*>& objects);
+		void update_bvh();
+		const Bvh& bvh() const { return mBvh; }
+		void mesh_changed(const Mesh& mesh);
+
+		// ObjectObserver
+		void object_changed(Object& obj, uint32_t index) override;
+		void object_destroyed(uint32_t index) override;
+
 	private:
+		static Aabb world_bounds(Object& obj);
+		float raycast_triangles(Object& obj, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, int& triangle);
+		const Bvh& mesh_bvh(const shared_ptr<Mesh>& mesh);
+
 		list<Object*> mObjects;
 		list<LightSource*> mLightSources;
+
+		// BVH over the objects, item i is mIndexedObjects[i] (nullptr once destroyed)
+		Bvh mBvh;
+		vector<Object*> mIndexedObjects;
+		vector<uint32_t> mChangedObjects;
+		vector<uint8_t> mObjectChanged;
+		bool mBvhRebuild;
+
+		/*
+		* BVH over the triangles of a mesh, with what it was built from: the scene doesn't keep
+		* the mesh alive, and a replaced or reallocated faces/vertices vector triggers a rebuild.
+		*/
+		struct MeshBvh
+		{
+			std::weak_ptr<Mesh> mesh;
+			const uvec3* faces = nullptr;
+			size_t faceCount = 0;
+			const vec3* vertices = nullptr;
+			size_t vertexCount = 0;
+			Bvh bvh;
+		};
+
+		// per-mesh BVHs for exact ray hits, built on the first raycast that needs them
+		std::unordered_map<const Mesh*, MeshBvh> mMeshBvhs;
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,9 @@
 #include "texture.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "io/stb_image.h"
+#include "engine/render/gpu_resources.h"
 
 ruya::Texture::Texture()
 	: mWidth(0), mHeight(0), mChannels(0), mData(nullptr), mTextureID(0)
@@ -22,21 +25,8 @@ ruya::Texture::Texture(const char* texturePath)
 		return;
 	}
 
-	// create opengl texture
-	glGenTextures(1, &mTextureID);
-	glBindTexture(GL_TEXTURE_2D, mTextureID);
-	
-	// texture settings
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT); // wrap around in s- and t-axi
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST); // nearest neighbor filtering with best fitting mipmap when minifying
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // bilinear interpolation when magnifying
-
-	// generate opengl texture and "move it to the GPU" (whether it actually gets moved is driver dependent)
-	GLuint sourceColorType;
-	mChannels == 3 ? sourceColorType = GL_RGB : sourceColorType = GL_RGBA;
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, mWidth, mHeight, 0, sourceColorType, GL_UNSIGNED_BYTE, mData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	mTextureID = create_texture(mWidth, mHeight, mChannels, mData);
+	GpuResources::track(GpuResources::Type::TEXTURE, mTextureID, gpu_bytes(mWidth, mHeight, mChannels));
 
 	/*
 		Note:	activating a texture slot then binding this texture's ID will move the texture
@@ -54,8 +44,60 @@ ruya::Texture::Texture(const char* texturePath)
 	*/
 }
 
+/*
+* Creates the GL texture of an image and generates its mipmaps. Pixels is an offset in the
+* buffer bound to GL_PIXEL_UNPACK_BUFFER if there is one (see AssetLoader).
+*/
+GLuint ruya::Texture::create_texture(int width, int height, int channels, const void* pixels)
+{
+	// create opengl texture, with the DSA functions so that no texture unit binding is touched
+	GLuint textureID;
+	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+	
+	// texture settings
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT); // wrap around in s- and t-axi
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST); // nearest neighbor filtering with best fitting mipmap when minifying
+	glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // bilinear interpolation when magnifying
+
+	// generate opengl texture and "move it to the GPU" (whether it actually gets moved is driver dependent)
+	// grayscale maps (roughness, displacement, ...) have 1 channel, their rows aren't 4 byte aligned
+	// the internal format matches the channels, like the layers of TextureArrays it is copied into
+	const GLenum sourceColorTypes[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	int format = std::clamp(channels, 1, 4) - 1;
+	GLsizei levels = static_cast<GLsizei>(std::floor(std::log2(std::max(width, height)))) + 1;
+	glTextureStorage2D(textureID, levels, internalFormats[format], width, height);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(textureID, 0, 0, 0, width, height, sourceColorTypes[format], GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateTextureMipmap(textureID);
+	return textureID;
+}
+
+size_t ruya::Texture::gpu_bytes(int width, int height, int channels)
+{
+	return GpuResources::texture_bytes(width, height, 1, std::clamp(channels, 1, 4), true);
+}
+
+/*
+* Takes over a GL texture and the pixel data it was created from.
+*/
+void ruya::Texture::set_image(GLuint textureID, int width, int height, int channels, unsigned char* data)
+{
+	GpuResources::release(GpuResources::Type::TEXTURE, mTextureID);
+	stbi_image_free(mData);
+	mTextureID = textureID;
+	mWidth = width;
+	mHeight = height;
+	mChannels = channels;
+	mData = data;
+	GpuResources::track(GpuResources::Type::TEXTURE, mTextureID, gpu_bytes(mWidth, mHeight, mChannels));
+}
+
 ruya::Texture::~Texture()
 {
+	GpuResources::release(GpuResources::Type::TEXTURE, mTextureID);
 	stbi_image_free(mData);
 }
 
@@ -1,29 +1,43 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cstddef>
 #include <glad/glad.h>
 
 namespace ruya
 {
+	class AssetLoader;
 	
-	
+	/*
+	* Image file as an OpenGL texture (GL_TEXTURE_2D with mipmaps), the decoded pixels are kept
+	* in data(). AssetLoader creates textures that are empty (ID() == 0) until their image has
+	* been loaded on its thread.
+	*/
 	class Texture
 	{
 	public:
 		Texture();
 		Texture(const char* texturePath);
 		~Texture();
+		Texture(const Texture&) = delete; // owns its GL texture and pixel data
+		Texture& operator=(const Texture&) = delete;
 
 		GLuint ID() const { return mTextureID; }
 		int height() const { return mHeight; }
 		int width() const { return mWidth; }
 		int channels() const { return mChannels; }
 		unsigned char* data() { return mData; }
+		const unsigned char* data() const { return mData; }
 
 		static void print_max_texture_slots_info();
 		static int get_num_texture_slots_fragment_shader();
 
 	private:
+		friend class AssetLoader;
+
+		static GLuint create_texture(int width, int height, int channels, const void* pixels);
+		static size_t gpu_bytes(int width, int height, int channels);
+		void set_image(GLuint textureID, int width, int height, int channels, unsigned char* data);
 
 		int mWidth;
 		int mHeight;
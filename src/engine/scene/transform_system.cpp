@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cstring>
+#include "transform_system.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define RUYA_TRANSFORM_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define RUYA_TRANSFORM_SSE
+#endif
+
+vector<float> ruya::TransformSystem::sPositionX, ruya::TransformSystem::sPositionY, ruya::TransformSystem::sPositionZ;
+vector<float> ruya::TransformSystem::sRotationX, ruya::TransformSystem::sRotationY, ruya::TransformSystem::sRotationZ, ruya::TransformSystem::sRotationW;
+vector<float> ruya::TransformSystem::sScaleX, ruya::TransformSystem::sScaleY, ruya::TransformSystem::sScaleZ;
+vector<glm::mat4> ruya::TransformSystem::sWorld;
+vector<glm::mat4> ruya::TransformSystem::sInverse;
+vector<uint8_t> ruya::TransformSystem::sDirty;
+vector<uint8_t> ruya::TransformSystem::sBlockQueued;
+vector<uint32_t> ruya::TransformSystem::sDirtyBlocks;
+vector<uint32_t> ruya::TransformSystem::sFree;
+size_t ruya::TransformSystem::sDirtyCount = 0;
+
+namespace
+{
+	/*
+	* Arithmetic on LANES floats at once, so that the kernel is written once for every
+	* instruction set.
+	*/
+	struct Scalar
+	{
+		static constexpr uint32_t LANES = 1;
+		float v;
+
+		static Scalar load(const float* p) { return { *p }; }
+		static Scalar set(float f) { return { f }; }
+		void store(float* p) const { *p = v; }
+		friend Scalar operator+(Scalar a, Scalar b) { return { a.v + b.v }; }
+		friend Scalar operator-(Scalar a, Scalar b) { return { a.v - b.v }; }
+		friend Scalar operator*(Scalar a, Scalar b) { return { a.v * b.v }; }
+		friend Scalar operator/(Scalar a, Scalar b) { return { a.v / b.v }; }
+	};
+
+#if defined(RUYA_TRANSFORM_AVX)
+	struct Wide
+	{
+		static constexpr uint32_t LANES = 8;
+		__m256 v;
+
+		static Wide load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static Wide set(float f) { return { _mm256_set1_ps(f) }; }
+		void store(float* p) const { _mm256_storeu_ps(p, v); }
+		friend Wide operator+(Wide a, Wide b) { return { _mm256_add_ps(a.v, b.v) }; }
+		friend Wide operator-(Wide a, Wide b) { return { _mm256_sub_ps(a.v, b.v) }; }
+		friend Wide operator*(Wide a, Wide b) { return { _mm256_mul_ps(a.v, b.v) }; }
+		friend Wide operator/(Wide a, Wide b) { return { _mm256_div_ps(a.v, b.v) }; }
+	};
+#elif defined(RUYA_TRANSFORM_SSE)
+	struct Wide
+	{
+		static constexpr uint32_t LANES = 4;
+		__m128 v;
+
+		static Wide load(const float* p) { return { _mm_loadu_ps(p) }; }
+		static Wide set(float f) { return { _mm_set1_ps(f) }; }
+		void store(float* p) const { _mm_storeu_ps(p, v); }
+		friend Wide operator+(Wide a, Wide b) { return { _mm_add_ps(a.v, b.v) }; }
+		friend Wide operator-(Wide a, Wide b) { return { _mm_sub_ps(a.v, b.v) }; }
+		friend Wide operator*(Wide a, Wide b) { return { _mm_mul_ps(a.v, b.v) }; }
+		friend Wide operator/(Wide a, Wide b) { return { _mm_div_ps(a.v, b.v) }; }
+	};
+#else
+	using Wide = Scalar;
+#endif
+
+	/*
+	* The component arrays of the TransformSystem.
+	*/
+	struct Components
+	{
+		const float* position[3];
+		const float* rotation[4]; // x, y, z, w
+		const float* scale[3];
+	};
+
+	/*
+	* World and inverse matrices of the slots [first, first + LANES), column major: matrix k
+	* of lane l is world[l]. Every lane runs the same operations in the same order, so all
+	* widths compute the same bits.
+	*/
+	template <class L>
+	void compute_matrices(const Components& c, size_t first, float (*world)[16], float (*inverse)[16])
+	{
+		L px = L::load(c.position[0] + first), py = L::load(c.position[1] + first), pz = L::load(c.position[2] + first);
+		L qx = L::load(c.rotation[0] + first), qy = L::load(c.rotation[1] + first), qz = L::load(c.rotation[2] + first), qw = L::load(c.rotation[3] + first);
+		L sx = L::load(c.scale[0] + first), sy = L::load(c.scale[1] + first), sz = L::load(c.scale[2] + first);
+		L zero = L::set(0.0f), one = L::set(1.0f);
+
+		// rotation matrix of the quaternion, 2 / |q|^2 normalizes it
+		L n = L::set(2.0f) / (qx * qx + qy * qy + qz * qz + qw * qw);
+		L xx = qx * qx * n, yy = qy * qy * n, zz = qz * qz * n;
+		L xy = qx * qy * n, xz = qx * qz * n, yz = qy * qz * n;
+		L wx = qw * qx * n, wy = qw * qy * n, wz = qw * qz * n;
+		L r00 = one - (yy + zz), r01 = xy + wz, r02 = xz - wy; // column 0
+		L r10 = xy - wz, r11 = one - (xx + zz), r12 = yz + wx; // column 1
+		L r20 = xz + wy, r21 = yz - wx, r22 = one - (xx + yy); // column 2
+
+		// T * R * S: the columns of R scaled, the translation in the last column
+		const L model[16] = { r00 * sx, r01 * sx, r02 * sx, zero,
+							  r10 * sy, r11 * sy, r12 * sy, zero,
+							  r20 * sz, r21 * sz, r22 * sz, zero,
+							  px, py, pz, one };
+
+		// S^-1 * R^T * T^-1: row i is column i of R divided by scale i
+		L ix = one / sx, iy = one / sy, iz = one / sz;
+		L tx = zero - (r00 * px + r01 * py + r02 * pz) * ix;
+		L ty = zero - (r10 * px + r11 * py + r12 * pz) * iy;
+		L tz = zero - (r20 * px + r21 * py + r22 * pz) * iz;
+		const L inverseModel[16] = { r00 * ix, r10 * iy, r20 * iz, zero,
+									 r01 * ix, r11 * iy, r21 * iz, zero,
+									 r02 * ix, r12 * iy, r22 * iz, zero,
+									 tx, ty, tz, one };
+
+		float lanes[16][L::LANES];
+		for (int k = 0; k < 16; k++) model[k].store(lanes[k]);
+		for (uint32_t l = 0; l < L::LANES; l++)
+			for (int k = 0; k < 16; k++) world[l][k] = lanes[k][l];
+		for (int k = 0; k < 16; k++) inverseModel[k].store(lanes[k]);
+		for (uint32_t l = 0; l < L::LANES; l++)
+			for (int k = 0; k < 16; k++) inverse[l][k] = lanes[k][l];
+	}
+}
+
+/*
+* A new slot with the identity transform.
+*/
+uint32_t ruya::TransformSystem::allocate()
+{
+	uint32_t slot;
+	if (!sFree.empty())
+	{
+		slot = sFree.back();
+		sFree.pop_back();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(sDirty.size());
+		sDirty.push_back(0);
+		sWorld.emplace_back(1.0f);
+		sInverse.emplace_back(1.0f);
+		if (slot % BLOCK == 0)
+		{
+			for (vector<float>* component : { &sPositionX, &sPositionY, &sPositionZ, &sRotationX, &sRotationY, &sRotationZ })
+				component->resize(slot + BLOCK, 0.0f);
+			for (vector<float>* component : { &sRotationW, &sScaleX, &sScaleY, &sScaleZ })
+				component->resize(slot + BLOCK, 1.0f);
+			sBlockQueued.push_back(0);
+		}
+	}
+	reset(slot);
+	return slot;
+}
+
+/*
+* A new slot with the transform (and matrices) of another slot.
+*/
+uint32_t ruya::TransformSystem::allocate(uint32_t copyOf)
+{
+	uint32_t slot = allocate();
+	for (vector<float>* component : { &sPositionX, &sPositionY, &sPositionZ, &sRotationX, &sRotationY, &sRotationZ, &sRotationW, &sScaleX, &sScaleY, &sScaleZ })
+		(*component)[slot] = (*component)[copyOf];
+	sWorld[slot] = sWorld[copyOf];
+	sInverse[slot] = sInverse[copyOf];
+	if (sDirty[copyOf]) mark_dirty(slot);
+	return slot;
+}
+
+void ruya::TransformSystem::free(uint32_t slot)
+{
+	reset(slot);
+	sFree.push_back(slot);
+}
+
+void ruya::TransformSystem::set_position(uint32_t slot, const glm::vec3& position)
+{
+	sPositionX[slot] = position.x;	sPositionY[slot] = position.y;	sPositionZ[slot] = position.z;
+	mark_dirty(slot);
+}
+
+void ruya::TransformSystem::set_rotation(uint32_t slot, const glm::quat& rotation)
+{
+	sRotationX[slot] = rotation.x;	sRotationY[slot] = rotation.y;	sRotationZ[slot] = rotation.z;	sRotationW[slot] = rotation.w;
+	mark_dirty(slot);
+}
+
+void ruya::TransformSystem::set_scale(uint32_t slot, const glm::vec3& scale)
+{
+	sScaleX[slot] = scale.x;	sScaleY[slot] = scale.y;	sScaleZ[slot] = scale.z;
+	mark_dirty(slot);
+}
+
+const glm::mat4& ruya::TransformSystem::world(uint32_t slot)
+{
+	if (sDirty[slot]) update_slot(slot);
+	return sWorld[slot];
+}
+
+const glm::mat4& ruya::TransformSystem::inverse(uint32_t slot)
+{
+	if (sDirty[slot]) update_slot(slot);
+	return sInverse[slot];
+}
+
+/*
+* Recomputes the matrices of all dirty slots, a block of slots at a time with SIMD.
+* @returns the number of slots that were updated
+*/
+size_t ruya::TransformSystem::update()
+{
+	return update_blocks(true);
+}
+
+/*
+* Same result as update() without SIMD, one slot at a time.
+*/
+size_t ruya::TransformSystem::update_scalar()
+{
+	return update_blocks(false);
+}
+
+const char* ruya::TransformSystem::instruction_set()
+{
+#if defined(RUYA_TRANSFORM_AVX)
+	return "AVX";
+#elif defined(RUYA_TRANSFORM_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+void ruya::TransformSystem::mark_dirty(uint32_t slot)
+{
+	if (!sDirty[slot])
+	{
+		sDirty[slot] = 1;
+		sDirtyCount++;
+	}
+	uint32_t block = slot / BLOCK;
+	if (!sBlockQueued[block])
+	{
+		sBlockQueued[block] = 1;
+		sDirtyBlocks.push_back(block);
+	}
+}
+
+/*
+* Identity transform and matrices, the slot is clean afterwards. Its block may stay queued.
+*/
+void ruya::TransformSystem::reset(uint32_t slot)
+{
+	sPositionX[slot] = sPositionY[slot] = sPositionZ[slot] = 0.0f;
+	sRotationX[slot] = sRotationY[slot] = sRotationZ[slot] = 0.0f;
+	sRotationW[slot] = 1.0f;
+	sScaleX[slot] = sScaleY[slot] = sScaleZ[slot] = 1.0f;
+	sWorld[slot] = glm::mat4(1.0f);
+	sInverse[slot] = glm::mat4(1.0f);
+	if (sDirty[slot])
+	{
+		sDirty[slot] = 0;
+		sDirtyCount--;
+	}
+}
+
+void ruya::TransformSystem::update_slot(uint32_t slot)
+{
+	Components components{ { sPositionX.data(), sPositionY.data(), sPositionZ.data() },
+						   { sRotationX.data(), sRotationY.data(), sRotationZ.data(), sRotationW.data() },
+						   { sScaleX.data(), sScaleY.data(), sScaleZ.data() } };
+	float world[1][16], inverse[1][16];
+	compute_matrices<Scalar>(components, slot, world, inverse);
+	std::memcpy(&sWorld[slot][0][0], world[0], sizeof(world[0]));
+	std::memcpy(&sInverse[slot][0][0], inverse[0], sizeof(inverse[0]));
+	sDirty[slot] = 0;
+	sDirtyCount--;
+}
+
+/*
+* Computes the matrices of whole blocks, only the slots that are still dirty take them (the
+* others may have been computed by world() or freed since their block was queued).
+*/
+size_t ruya::TransformSystem::update_blocks(bool simd)
+{
+	Components components{ { sPositionX.data(), sPositionY.data(), sPositionZ.data() },
+						   { sRotationX.data(), sRotationY.data(), sRotationZ.data(), sRotationW.data() },
+						   { sScaleX.data(), sScaleY.data(), sScaleZ.data() } };
+	size_t updated = 0;
+	for (uint32_t block : sDirtyBlocks)
+	{
+		sBlockQueued[block] = 0;
+		const uint32_t first = block * BLOCK, last = std::min<uint32_t>(first + BLOCK, static_cast<uint32_t>(sDirty.size()));
+		if (std::none_of(sDirty.begin() + first, sDirty.begin() + last, [](uint8_t dirty) { return dirty != 0; }))
+			continue;
+
+		float world[BLOCK][16], inverse[BLOCK][16];
+		if (simd)
+			for (uint32_t l = 0; l < BLOCK; l += Wide::LANES)
+				compute_matrices<Wide>(components, first + l, world + l, inverse + l);
+		else
+			for (uint32_t l = 0; l < BLOCK; l++)
+				compute_matrices<Scalar>(components, first + l, world + l, inverse + l);
+
+		for (uint32_t slot = first; slot < last; slot++)
+		{
+			if (!sDirty[slot]) continue;
+			std::memcpy(&sWorld[slot][0][0], world[slot - first], sizeof(world[0]));
+			std::memcpy(&sInverse[slot][0][0], inverse[slot - first], sizeof(inverse[0]));
+			sDirty[slot] = 0;
+			updated++;
+		}
+	}
+	sDirtyBlocks.clear();
+	sDirtyCount -= updated;
+	return updated;
+}
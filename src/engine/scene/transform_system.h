@@ -0,0 +1,73 @@
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using std::vector;
+
+namespace ruya
+{
+	/*
+	* The transforms of all objects: position, rotation (unit quaternion) and scale, with the
+	* world (model) matrix T * R * S and its inverse computed from them.
+	*	- the components are kept as structure of arrays (one array per component), each
+	*	  object owns a slot (see Object), setting a component marks the slot dirty
+	*	- update() recomputes the matrices of the dirty slots only, in blocks of BLOCK
+	*	  slots: 8 (AVX) or 4 (SSE) slots per instruction, the matrices of the slots of a
+	*	  block that didn't change are left as they are
+	*	- world() and inverse() of a dirty slot compute its matrices first, one slot at a
+	*	  time, so they are always up to date. The Renderer calls update() at the start of
+	*	  each frame, the objects moved since are then computed in batches
+	*	- the inverse needs no general 4x4 inversion: (T * R * S)^-1 = S^-1 * R^T * T^-1
+	*
+	* Slots are reused after free(), their matrices stay where they are until the storage
+	* grows: references returned by world() and inverse() are valid until the next allocate().
+	* The objects are only moved on the main thread, so the state is static, like GpuResources.
+	*/
+	class TransformSystem
+	{
+	public:
+		static constexpr uint32_t BLOCK = 8; // slots updated together, the width of AVX
+
+		static uint32_t allocate();
+		static uint32_t allocate(uint32_t copyOf);
+		static void free(uint32_t slot);
+
+		static void set_position(uint32_t slot, const glm::vec3& position);
+		static void set_rotation(uint32_t slot, const glm::quat& rotation);
+		static void set_scale(uint32_t slot, const glm::vec3& scale);
+		static const glm::mat4& world(uint32_t slot);
+		static const glm::mat4& inverse(uint32_t slot);
+
+		static size_t update();
+		static size_t update_scalar();
+		static size_t dirty_count() { return sDirtyCount; } // slots whose matrices are out of date
+		static size_t size() { return sDirty.size() - sFree.size(); } // allocated slots
+		static const char* instruction_set(); // used by update()
+
+	private:
+		static void mark_dirty(uint32_t slot);
+		static void reset(uint32_t slot);
+		static void update_slot(uint32_t slot);
+		static size_t update_blocks(bool simd);
+
+		// components, padded to whole blocks
+		static vector<float> sPositionX, sPositionY, sPositionZ;
+		static vector<float> sRotationX, sRotationY, sRotationZ, sRotationW;
+		static vector<float> sScaleX, sScaleY, sScaleZ;
+
+		static vector<glm::mat4> sWorld;
+		static vector<glm::mat4> sInverse;
+		static vector<uint8_t> sDirty; // per slot
+		static vector<uint8_t> sBlockQueued; // per block, in sDirtyBlocks
+		static vector<uint32_t> sDirtyBlocks; // blocks with dirty slots, in the order they changed
+		static vector<uint32_t> sFree; // free slots, the last one is reused first
+		static size_t sDirtyCount;
+	};
+}
+
+#endif // !TRANSFORM_SYSTEM_H
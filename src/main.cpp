@@ -1,13 +1,15 @@
 #include <iostream>
 #include <filesystem>
+#include <string>
 
 #include "test_app.hpp"
+#include "bench_app.hpp"
 #include "engine/core/window.h"
 #include <whereami/whereami++.h>
 
 namespace fs = std::filesystem;
 
-int main()
+int main(int argc, char** argv)
 {
 	ruya::Window window(1450, 875);
 	window.make_context_current();
@@ -25,6 +27,14 @@ int main()
     std::cout << whereami::getExecutablePath().basename() << std::endl;
     std::cout << whereami::getExecutablePath().dirname() << std::endl;
 
+	// `./main --bench` runs the benchmarks instead of the test app
+	if (argc > 1 && std::string(argv[1]) == "--bench")
+	{
+		ruya::BenchApp bench(window);
+		bench.run();
+		return 0;
+	}
+
 	ruya::TestApp app(window);
 
 	try
@@ -46,6 +46,10 @@ using ruya::Texture;	using ruya::Camera;
 using ruya::models::Cube;		using ruya::Timer;
 using ruya::models::Icosahedron; using ruya::Scene;
 using ruya::LightSource; using ruya::models::Icosphere;
+using ruya::GpuCulling;
+using ruya::LightClusters;
+using ruya::DeferredShading;
+using ruya::VisibilityBuffer;
 
 
 namespace ruya
@@ -58,11 +62,18 @@ namespace ruya
 		Window& mWindow;
 		dvec2 mOldMousePos;
 		bool mAllowShadingModeChange;
+		bool mAllowDepthPrepassChange;
+		bool mAllowDeferredChange;
+		bool mAllowVisibilityChange;
+		bool mAllowFlatShadingChange;
 		Renderer* mRenderer;
+		DeferredShading* mDeferredShading; // toggled with key 4
+		VisibilityBuffer* mVisibilityBuffer; // toggled with key 5
 
 	public: // FUNCTIONS
 		/*** CONSTRUCT ***/
-		TestApp(Window& window) : mWindow(window), mOldMousePos(-1.0, -1.0), mAllowShadingModeChange(true)
+		TestApp(Window& window) : mWindow(window), mOldMousePos(-1.0, -1.0), mAllowShadingModeChange(true), mAllowDepthPrepassChange(true),
+			mAllowDeferredChange(true), mAllowVisibilityChange(true), mAllowFlatShadingChange(true), mRenderer(nullptr), mDeferredShading(nullptr), mVisibilityBuffer(nullptr)
 		{
 			glfwSetInputMode(window.get_GLFW_window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 		}
@@ -83,6 +94,7 @@ namespace ruya
 			fs::path baseDir {whereami::getExecutablePath().dirname()};
 			fs::path phongDir {baseDir / "shaders" / "phong"};
 			fs::path flatDir {baseDir / "shaders" / "flat"};
+			fs::path depthDir {baseDir / "shaders" / "depth"};
 
 			fs::path phongVertShader {phongDir / "object.vert"};
 			fs::path phongFragShader {phongDir / "object.frag"};
@@ -91,38 +103,80 @@ namespace ruya
 			fs::path flatVertShader {flatDir / "flat_vert.vert"};
 			fs::path flatFragShader {flatDir / "flat_frag.frag"};
 			fs::path flatGeomShader {flatDir / "flat_geom.geom"};
+			fs::path flatDerivativesFragShader {flatDir / "flat_derivatives.frag"};
+			fs::path flatProvokingVertShader {flatDir / "flat_provoking.vert"};
+
+			fs::path depthVertShader {depthDir / "depth.vert"};
+			fs::path depthFragShader {depthDir / "depth.frag"};
 
 			Shader shaderPhongObjects(phongVertShader.string().c_str(), phongFragShader.string().c_str());
 			Shader shaderPhongLights(phongVertShader.string().c_str(), phongFragShaderLights.string().c_str());
 			Shader shaderFlat(flatVertShader.string().c_str(), flatGeomShader.string().c_str(), flatFragShader.string().c_str());
+			Shader shaderFlatDerivatives(phongVertShader.string().c_str(), flatDerivativesFragShader.string().c_str());
+			Shader shaderFlatProvoking(flatProvokingVertShader.string().c_str(), flatFragShader.string().c_str());
+			Shader shaderDepth(depthVertShader.string().c_str(), depthFragShader.string().c_str());
+			Shader shaderFlatDepth(flatVertShader.string().c_str(), flatGeomShader.string().c_str(), depthFragShader.string().c_str());
 			std::cout << "Init shaders" << std::endl;
 
+			// meshes and textures are uploaded on the loader thread, objects show placeholders until then
+			AssetLoader assetLoader(mWindow);
 			Renderer renderer(&shaderPhongObjects, &shaderPhongLights, &mWindow, &mCamera);
+			// flat shading implementations (key 6), the ones without geometry shader share the smooth depth shader
 			renderer.set_flat_shader(&shaderFlat);
+			renderer.set_flat_shader(&shaderFlatDerivatives, Renderer::FlatShading::DERIVATIVES);
+			renderer.set_flat_shader(&shaderFlatProvoking, Renderer::FlatShading::PROVOKING_VERTEX);
+			renderer.set_depth_shader(&shaderDepth);
+			renderer.set_depth_shader(&shaderFlatDepth, Renderer::ShadingMode::FLAT);
+			renderer.set_asset_loader(&assetLoader);
 			mRenderer = &renderer;
 			std::cout << "Init renderer" << std::endl;
 
+			// every fragment is only lit by the lights that reach its cluster
+			LightClusters lightClusters((baseDir / "shaders" / "lighting").string());
+			renderer.set_light_clusters(&lightClusters);
+			std::cout << "Init light clusters" << std::endl;
+
+			// deferred shading (key 4), off at the start
+			DeferredShading deferredShading((baseDir / "shaders").string());
+			mDeferredShading = &deferredShading;
+			std::cout << "Init deferred shading" << std::endl;
+
+			// visibility buffer (key 5), off at the start, not with GPU culling
+			VisibilityBuffer visibilityBuffer((baseDir / "shaders").string());
+			mVisibilityBuffer = &visibilityBuffer;
+			std::cout << "Init visibility buffer" << std::endl;
+
+			// a 3D grid of spheres with levels of detail, culled and drawn on the GPU
+			bool grid3D = false;
+			std::unique_ptr<GpuCulling> gpuCulling;
+			if (grid3D)
+			{
+				gpuCulling = std::make_unique<GpuCulling>((baseDir / "shaders" / "culling").string());
+				renderer.set_gpu_culling(gpuCulling.get());
+				std::cout << "Init GPU culling" << std::endl;
+			}
+
 			// init scene
 			Scene scene;
 			std::cout << "Init Scene" << std::endl;
 
 			// the object to render
 			// vector< shared_ptr<Texture>> textures;
-			// textures.push_back(std::make_shared<Texture>("resources/Wood049_1K-PNG/Wood049_1K_Color.png"));
-			// textures.push_back(std::make_shared<Texture>("resources/Leather026_1K-PNG/Leather026_1K_Color.png"));
-			// textures.push_back(std::make_shared<Texture>("resources/Marble023_1K-PNG/Marble023_1K_Color.png"));
-			// textures.push_back(std::make_shared<Texture>("resources/Metal032_1K-PNG/Metal032_1K_Color.png"));
-			// textures.push_back(std::make_shared<Texture>("resources/Fabric004_1K-PNG/Fabric004_1K_Color.png"));
+			// textures.push_back(assetLoader.load_texture("resources/Wood049_1K-PNG/Wood049_1K_Color.png"));
+			// textures.push_back(assetLoader.load_texture("resources/Leather026_1K-PNG/Leather026_1K_Color.png"));
+			// textures.push_back(assetLoader.load_texture("resources/Marble023_1K-PNG/Marble023_1K_Color.png"));
+			// textures.push_back(assetLoader.load_texture("resources/Metal032_1K-PNG/Metal032_1K_Color.png"));
+			// textures.push_back(assetLoader.load_texture("resources/Fabric004_1K-PNG/Fabric004_1K_Color.png"));
 			// std::cout << "Init textures" << std::endl;
 
 			vector<Object*> objects;
-			int radius = 2; // radius of grid, so grid will have 2r+1 cols and rows
+			int radius = grid3D ? 10 : 2; // radius of grid, so grid will have 2r+1 cols and rows
 			float d = 7.5f;
 			for (float i = -radius; i <= radius; i++)
 			{
 				for (float j = -radius; j <= radius; j++)
 				{
-					if (false)
+					if (grid3D)
 					{
 						for (float k = -radius; k <= radius; k++)
 						{
@@ -132,7 +186,8 @@ namespace ruya
 							//else 
 							//	newObjptr = new Icosahedron();
 
-							Object* newObjptr = new Icosphere(i + radius);
+							Object* newObjptr = new Icosphere(5);
+							newObjptr->set_lod_chain(Icosphere::lod_chain());
 							float g = (i + radius) / (2 * radius) * 0.8 + 0.1; // map i and j from [-r, r] to [0.1, 0.8]
 							float b = (j + radius) / (2 * radius) * 0.8 + 0.1;
 							float r = (k + radius) / (2 * radius) * 0.8 + 0.1;
@@ -145,13 +200,14 @@ namespace ruya
 							newObjptr->material().specular = vec3(1.0f);
 							newObjptr->material().shininess = 1.0f;
 							//newCube.set_texture(textures[i % textures.size()]);
-							objects.push_back(newObjptr);
-							scene.add_object(newObjptr);
+							scene.add_object(newObjptr); // static, rotating thousands of objects would rewrite all of them every frame
 						}
 					}
 					else
 					{
+						// the column sets the most detailed level, farther spheres drop to coarser levels
 						Object* newObjptr = new Icosphere(i + radius);
+						newObjptr->set_lod_chain(Icosphere::lod_chain(i + radius));
 						float g = (i + radius) / (2 * radius) * 0.8 + 0.1; // map i and j from [-r, r] to [0.1, 0.8]
 						float b = (j + radius) / (2 * radius) * 0.8 + 0.1;
 						//float r = (k + radius) / (2 * radius) * 0.8 + 0.1;
@@ -269,6 +325,17 @@ namespace ruya
 				if (timerOutput.elapsed_time_s() > 1.0)
 				{
 					std::cout << fps << " fps"
+						<< "\tdraw calls: " << renderer.frame_stats().drawCalls
+						<< " (" << renderer.frame_stats().drawCommands << " commands)"
+						<< "\tobjects visible: " << renderer.frame_stats().visibleObjects << ", culled: " << renderer.frame_stats().culledObjects
+						<< "\ttriangles: " << renderer.frame_stats().triangles
+						<< "\tlights: " << renderer.frame_stats().lights
+						<< "\toverdraw: " << renderer.frame_stats().overdraw << (renderer.depth_prepass() ? " (depth pre-pass)" : "")
+						<< (renderer.deferred_shading() ? "\tdeferred" : "") << (renderer.visibility_buffer() ? "\tvisibility buffer" : "")
+						<< "\tstreamed: " << renderer.frame_stats().bytesStreamed / 1024.0 << " KB (fence wait " << renderer.frame_stats().fenceWaitMs << " ms)"
+						<< "\tgl calls: " << renderer.frame_stats().glCalls << " (" << renderer.frame_stats().glCallsSkipped << " skipped)"
+						<< "\tgpu memory: " << renderer.frame_stats().gpuBytes / (1024.0 * 1024.0) << " MB (meshes " << renderer.frame_stats().meshBytes / (1024.0 * 1024.0) << " MB)"
+						<< "\tloading: " << renderer.frame_stats().pendingAssets << " assets"
 						<< "\tElapsed time: " << timerOutput.time_since_creation_s() << "s" 
 						<< "\tmouse pos: ("<< mOldMousePos.x <<","<< mOldMousePos.y <<")\n";
 					timerOutput.start();
@@ -359,6 +426,60 @@ namespace ruya
 				mAllowShadingModeChange = true;
 			}
 
+			if (glfwGetKey(glfwWindow, GLFW_KEY_3) == GLFW_PRESS && mAllowDepthPrepassChange && mRenderer != nullptr)
+			{
+				mRenderer->set_depth_prepass(!mRenderer->depth_prepass());
+				mAllowDepthPrepassChange = false;
+			}
+			if (glfwGetKey(glfwWindow, GLFW_KEY_3) == GLFW_RELEASE)
+			{
+				mAllowDepthPrepassChange = true;
+			}
+
+			if (glfwGetKey(glfwWindow, GLFW_KEY_4) == GLFW_PRESS && mAllowDeferredChange && mRenderer != nullptr)
+			{
+				mRenderer->set_visibility_buffer(nullptr);
+				mRenderer->set_deferred_shading(mRenderer->deferred_shading() ? nullptr : mDeferredShading);
+				mAllowDeferredChange = false;
+			}
+			if (glfwGetKey(glfwWindow, GLFW_KEY_4) == GLFW_RELEASE)
+			{
+				mAllowDeferredChange = true;
+			}
+
+			if (glfwGetKey(glfwWindow, GLFW_KEY_5) == GLFW_PRESS && mAllowVisibilityChange && mRenderer != nullptr && mRenderer->gpu_culling() == nullptr)
+			{
+				mRenderer->set_deferred_shading(nullptr);
+				mRenderer->set_visibility_buffer(mRenderer->visibility_buffer() ? nullptr : mVisibilityBuffer);
+				mAllowVisibilityChange = false;
+			}
+			if (glfwGetKey(glfwWindow, GLFW_KEY_5) == GLFW_RELEASE)
+			{
+				mAllowVisibilityChange = true;
+			}
+
+			// geometry shader -> derivatives -> provoking vertex (not with GPU culling)
+			if (glfwGetKey(glfwWindow, GLFW_KEY_6) == GLFW_PRESS && mAllowFlatShadingChange && mRenderer != nullptr)
+			{
+				switch (mRenderer->flat_shading())
+				{
+					case Renderer::FlatShading::GEOMETRY_SHADER:
+						mRenderer->set_flat_shading(Renderer::FlatShading::DERIVATIVES);
+						break;
+					case Renderer::FlatShading::DERIVATIVES:
+						mRenderer->set_flat_shading(mRenderer->gpu_culling() ? Renderer::FlatShading::GEOMETRY_SHADER : Renderer::FlatShading::PROVOKING_VERTEX);
+						break;
+					case Renderer::FlatShading::PROVOKING_VERTEX:
+						mRenderer->set_flat_shading(Renderer::FlatShading::GEOMETRY_SHADER);
+						break;
+				}
+				mAllowFlatShadingChange = false;
+			}
+			if (glfwGetKey(glfwWindow, GLFW_KEY_6) == GLFW_RELEASE)
+			{
+				mAllowFlatShadingChange = true;
+			}
+
 
 			// MOUSE MOVEMENT
 			update_camera_look_direction();